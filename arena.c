@@ -0,0 +1,71 @@
+/*
+ * arena.c
+ * Implements a region allocator with chunked bump allocation
+ *
+ * IFJ project 2025
+ * FIT VUT
+ *
+ * Authors:
+ * Michal Šebesta (xsebesm00)
+ */
+#include "arena.h"
+#include <stdalign.h>
+#include <stdlib.h>
+
+/// Block of memory the allocations are carved from
+struct arena_chunk {
+    struct arena_chunk *next;
+    size_t used;
+    size_t capacity;
+    alignas(max_align_t) char data[];
+};
+
+void *arena_alloc(Arena *arena, size_t size) {
+    size = (size + alignof(max_align_t) - 1) & ~(alignof(max_align_t) - 1);
+
+    ArenaChunk *chunk = arena->chunks;
+    if (chunk == NULL || chunk->capacity - chunk->used < size) {
+        if (arena->spare != NULL && size <= arena->spare->capacity) {
+            chunk = arena->spare;
+            arena->spare = NULL;
+        } else {
+            size_t capacity = size > _ARENA_CHUNK_SIZE ? size : _ARENA_CHUNK_SIZE;
+            chunk = malloc(sizeof(ArenaChunk) + capacity);
+            if (chunk == NULL) return NULL;
+            chunk->capacity = capacity;
+        }
+        chunk->used = 0;
+        chunk->next = arena->chunks;
+        arena->chunks = chunk;
+    }
+
+    void *ptr = chunk->data + chunk->used;
+    chunk->used += size;
+    return ptr;
+}
+
+ArenaMark arena_mark(Arena *arena) {
+    ArenaMark mark = { arena->chunks, arena->chunks == NULL ? 0 : arena->chunks->used };
+    return mark;
+}
+
+void arena_release(Arena *arena, ArenaMark mark) {
+    while (arena->chunks != mark.chunk) {
+        ArenaChunk *chunk = arena->chunks;
+        arena->chunks = chunk->next;
+        // Only one chunk of the default size is kept, the rest goes back to the system
+        if (arena->spare == NULL && chunk->capacity == _ARENA_CHUNK_SIZE) {
+            arena->spare = chunk;
+        } else {
+            free(chunk);
+        }
+    }
+    if (mark.chunk != NULL) mark.chunk->used = mark.used;
+}
+
+void arena_free(Arena *arena) {
+    ArenaMark start = { NULL, 0 };
+    arena_release(arena, start);
+    free(arena->spare);
+    arena->spare = NULL;
+}
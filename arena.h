@@ -0,0 +1,47 @@
+/*
+ * arena.h
+ * Defines a region allocator with chunked bump allocation
+ *
+ * IFJ project 2025
+ * FIT VUT
+ *
+ * Authors:
+ * Michal Šebesta (xsebesm00)
+ */
+#ifndef _ARENA_H_
+#define _ARENA_H_
+
+#include <stddef.h>
+
+#define _ARENA_CHUNK_SIZE 65536
+
+typedef struct arena_chunk ArenaChunk;
+
+/// Region of memory the allocations are carved from one after another. Nothing is freed
+/// on its own, the whole region or everything after a mark is freed at once
+typedef struct arena {
+    /// Chunk the allocations are carved from, the older ones follow it
+    ArenaChunk *chunks;
+    /// Released chunk kept for the next allocations, so releasing and allocating again does not call malloc
+    ArenaChunk *spare;
+} Arena;
+
+/// Position in an arena, everything allocated after it can be released
+typedef struct arena_mark {
+    ArenaChunk *chunk;
+    size_t used;
+} ArenaMark;
+
+/// Returns size bytes aligned for any type or NULL if allocation failed
+void *arena_alloc(Arena *arena, size_t size);
+
+/// Returns the current position of the arena
+ArenaMark arena_mark(Arena *arena);
+
+/// Frees everything allocated after the mark was taken
+void arena_release(Arena *arena, ArenaMark mark);
+
+/// Frees the whole arena, it can be allocated from again afterwards
+void arena_free(Arena *arena);
+
+#endif // !_ARENA_H_
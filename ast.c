@@ -10,89 +10,285 @@
  * Tomáš Hanák (xhanakt00)
  */
 #include "ast.h"
+#include "arena.h"
 #include "string.h"
 #include "symtable.h"
+#include <assert.h>
 #include <stdlib.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <string.h>
+
+/// Heap string owned by the AST, freed when the nodes allocated before it are released
+struct ast_owned_string {
+    String *str;
+    AstOwnedString *next;
+};
+
+/// Every node of the AST is allocated from this arena, so the AST is freed all at once
+static struct {
+    Arena arena;
+    /// Strings owned by the nodes, the most recent first
+    AstOwnedString *strings;
+} pool = { { NULL, NULL }, NULL };
+
+// Carves a node out of the arena
+static void *ast_alloc(size_t size) {
+    return arena_alloc(&pool.arena, size);
+}
+
+// Makes room for count more statements in the block, the array is moved to one twice as large when it is full
+static bool block_grow(AstBlock *block, size_t count) {
+    size_t capacity = block->capacity == 0 ? _AST_BLOCK_INITIAL_CAPACITY : block->capacity;
+    while (capacity - block->count < count) {
+        capacity *= 2;
+    }
+    AstStatement *statements = ast_alloc(capacity * sizeof(AstStatement));
+    if (statements == NULL) {
+        return false;
+    }
+    if (block->count > 0) {
+        memcpy(statements, block->statements, block->count * sizeof(AstStatement));
+    }
+    block->statements = statements;
+    block->capacity = capacity;
+    return true;
+}
+
+// Adds a statement of the type to the end of the block, returns NULL if allocation failed
+static AstStatement *block_append(AstBlock *block, AstStatementType type) {
+    if (block->count == block->capacity && !block_grow(block, 1)) {
+        return NULL;
+    }
+    AstStatement *statement = &block->statements[block->count++];
+    statement->type = type;
+    return statement;
+}
+
+// A node takes the same number of bytes in every expression column, its children take an ExprId each
+#define _AST_COLUMN_SIZE(column) sizeof(*((AstExprs *)0)->column)
+#define _AST_EXPR_NODE_SIZE (_AST_COLUMN_SIZE(type) + _AST_COLUMN_SIZE(assumed_type) + _AST_COLUMN_SIZE(val_known) \
+    + _AST_COLUMN_SIZE(surely_int) + _AST_COLUMN_SIZE(child_count) + _AST_COLUMN_SIZE(first_child) \
+    + _AST_COLUMN_SIZE(value) + _AST_COLUMN_SIZE(slot))
+// Size of the cache line the nodes with inline children used to fill
+#define _AST_EXPR_CACHE_LINE 64
+
+// The columns have to stay at most half of the old node, and a ternary with its children has to fit in its cache line
+static_assert(_AST_EXPR_NODE_SIZE <= _AST_EXPR_CACHE_LINE / 2, "Expression node grew past half a cache line");
+static_assert(_AST_EXPR_NODE_SIZE + 3 * sizeof(ExprId) <= _AST_EXPR_CACHE_LINE, "Ternary node no longer fits in a cache line");
+
+/// Moves an expression column to an allocation for new_capacity items, returns false if it failed
+#define GROW_COLUMN(column, new_capacity) do { \
+    void *new_column = realloc((column), (new_capacity) * sizeof(*(column))); \
+    if (new_column == NULL) { \
+        return false; \
+    } \
+    (column) = new_column; \
+} while(0)
+
+/// Initializes an empty expression store
+void ast_exprs_init(AstExprs *exprs) {
+    AstExprs empty = { NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, 0, 0, NULL, 0, 0 };
+    *exprs = empty;
+}
+
+// Makes room for another node in every expression column
+static bool grow_exprs(AstExprs *exprs) {
+    uint32_t capacity = exprs->capacity == 0 ? _AST_EXPRS_INITIAL_CAPACITY : exprs->capacity * 2;
+    GROW_COLUMN(exprs->type, capacity);
+    GROW_COLUMN(exprs->assumed_type, capacity);
+    GROW_COLUMN(exprs->val_known, capacity);
+    GROW_COLUMN(exprs->surely_int, capacity);
+    GROW_COLUMN(exprs->child_count, capacity);
+    GROW_COLUMN(exprs->first_child, capacity);
+    GROW_COLUMN(exprs->value, capacity);
+    GROW_COLUMN(exprs->slot, capacity);
+    exprs->capacity = capacity;
+    return true;
+}
+
+// Makes room for count more children
+static bool grow_children(AstExprs *exprs, uint32_t count) {
+    uint32_t capacity = exprs->children_capacity == 0 ? _AST_EXPRS_INITIAL_CAPACITY : exprs->children_capacity;
+    while (capacity - exprs->children_count < count) {
+        capacity *= 2;
+    }
+    GROW_COLUMN(exprs->children, capacity);
+    exprs->children_capacity = capacity;
+    return true;
+}
 
 /// Creates a new AST expression node
-AstExpression *ast_expr_create(AstExprType type, size_t child_count) {
-    AstExpression *expr = malloc(sizeof(AstExpression));
-    if (expr == NULL) {
+ExprId ast_expr_create(AstExprs *exprs, AstExprType type, size_t child_count) {
+    if (exprs->count == exprs->capacity && !grow_exprs(exprs)) {
+        return EXPR_NONE;
+    }
+    if (exprs->children_capacity - exprs->children_count < child_count && !grow_children(exprs, child_count)) {
+        return EXPR_NONE;
+    }
+
+    ExprId expr = exprs->count++;
+    exprs->type[expr] = type;
+    exprs->assumed_type[expr] = DT_UNKNOWN;
+    exprs->val_known[expr] = false;
+    exprs->surely_int[expr] = false;
+    exprs->child_count[expr] = child_count;
+    exprs->first_child[expr] = exprs->children_count;
+    exprs->value[expr].string_val = NULL; // Initialize union to NULL
+    exprs->slot[expr] = SLOT_NONE;
+    exprs->children_count += child_count;
+    return expr;
+}
+
+/// Hands a heap string over to the AST
+String *ast_own_string(String *str) {
+    if (str == NULL) {
         return NULL;
     }
-    expr->params = malloc(child_count * sizeof(AstExpression *));
-    if (expr->params == NULL) {
-        free(expr);
+    AstOwnedString *owned = ast_alloc(sizeof(AstOwnedString));
+    if (owned == NULL) {
+        str_free(&str);
         return NULL;
     }
-    expr->type = type;
-    expr->child_count = child_count;
-    expr->assumed_type = DT_UNKNOWN;
-    expr->val_known = false;
-    expr->surely_int = false;
-    expr->string_val = NULL; // Initialize union to NULL
-    return expr;
+    owned->str = str;
+    owned->next = pool.strings;
+    pool.strings = owned;
+    return str;
+}
+
+/// Starts a walk from the root expression
+void ast_walk_init(AstWalk *walk, AstExprs *exprs, ExprId root) {
+    walk->exprs = exprs;
+    walk->frames = walk->inline_frames;
+    walk->capacity = _AST_WALK_INLINE_DEPTH;
+    walk->count = 0;
+    walk->pending = false;
+    walk->failed = false;
+    if (root != EXPR_NONE) {
+        walk->frames[walk->count++] = (AstWalkFrame){ root, 0 };
+    }
 }
 
-/// Initializes a new AST 
+// Pushes a node to the walk stack, moving it to the heap once it outgrows the inline frames
+static bool walk_push(AstWalk *walk, ExprId expr) {
+    if (walk->count == walk->capacity) {
+        size_t capacity = walk->capacity * 2;
+        AstWalkFrame *frames;
+        if (walk->frames == walk->inline_frames) {
+            frames = malloc(capacity * sizeof(AstWalkFrame));
+            if (frames != NULL) {
+                memcpy(frames, walk->inline_frames, walk->count * sizeof(AstWalkFrame));
+            }
+        } else {
+            frames = realloc(walk->frames, capacity * sizeof(AstWalkFrame));
+        }
+        if (frames == NULL) {
+            return false;
+        }
+        walk->frames = frames;
+        walk->capacity = capacity;
+    }
+    walk->frames[walk->count++] = (AstWalkFrame){ expr, 0 };
+    return true;
+}
+
+/// Moves to the next step of the walk
+bool ast_walk_next(AstWalk *walk, AstWalkFrame *out) {
+    if (walk->pending) {
+        walk->pending = false;
+        AstWalkFrame *top = &walk->frames[walk->count - 1];
+        if (top->done < EXPR_CHILD_COUNT(walk->exprs, top->expr)) {
+            ExprId child = EXPR_CHILD(walk->exprs, top->expr, top->done);
+            top->done++;
+            if (!walk_push(walk, child)) {
+                walk->failed = true;
+                return false;
+            }
+        } else {
+            walk->count--;
+        }
+    }
+    if (walk->count == 0) {
+        return false;
+    }
+    *out = walk->frames[walk->count - 1];
+    walk->pending = true;
+    return true;
+}
+
+/// Skips the children of the node returned last that were not walked yet
+void ast_walk_skip(AstWalk *walk) {
+    if (walk->pending) {
+        AstWalkFrame *top = &walk->frames[walk->count - 1];
+        top->done = EXPR_CHILD_COUNT(walk->exprs, top->expr);
+    }
+}
+
+/// Frees the stack of the walk
+void ast_walk_free(AstWalk *walk) {
+    if (walk->frames != walk->inline_frames) {
+        free(walk->frames);
+    }
+    walk->frames = walk->inline_frames;
+    walk->count = 0;
+}
+
+/// Initializes a new AST
 AstStatement *ast_statement_init() {
-    AstStatement *statement = malloc(sizeof(AstStatement));
+    AstStatement *statement = ast_alloc(sizeof(AstStatement));
     if (statement == NULL) {
         return NULL;
     }
     statement->type = ST_ROOT;
-    
-    // Allocate next element
-    statement->next = malloc(sizeof(AstStatement));
-    if (statement->next == NULL) {
-        free(statement);
+
+    // Block for the definitions
+    statement->block = ast_block_create();
+    if (statement->block == NULL) {
         return NULL;
     }
-    statement->next->type = ST_END;
-    statement->next->next = NULL;
-    
+
     return statement;
 }
 
 /// Creates a new AST block
 AstBlock *ast_block_create() {
-    AstBlock *block = malloc(sizeof(AstBlock));
+    AstBlock *block = ast_alloc(sizeof(AstBlock));
     if (block == NULL) {
         return NULL;
     }
-    
-    // Allocate first statement as EMPTY
-    block->statements = malloc(sizeof(AstStatement));
-    if (block->statements == NULL) {
-        free(block);
-        return NULL;
-    }
-    block->statements->type = ST_END;
-    block->statements->next = NULL;
-    
+
+    // The statement array is allocated with the first statement
+    block->statements = NULL;
+    block->count = 0;
+    block->capacity = 0;
+
     return block;
 }
 
+/// Makes room for count more statements in the block
+bool ast_block_reserve(AstBlock *block, size_t count) {
+    if (block->capacity - block->count >= count) {
+        return true;
+    }
+    return block_grow(block, count);
+}
+
 /// Adds a if statement to the AST
-bool ast_add_if_statement(AstStatement *statement, AstExpression *condition) {
-    // Check if statement is NULL or not EMPTY
-    if (statement == NULL || statement->type != ST_END) {
-        return false;
+AstStatement *ast_add_if_statement(AstBlock *block, ExprId condition) {
+    if (block == NULL) {
+        return NULL;
     }
 
     // Create AstIfStatement structure
-    AstIfStatement *if_st = malloc(sizeof(AstIfStatement));
+    AstIfStatement *if_st = ast_alloc(sizeof(AstIfStatement));
     if (if_st == NULL) {
-        return false;
+        return NULL;
     }
 
     // Create true branch block
     AstBlock *true_branch = ast_block_create();
     if (true_branch == NULL) {
-        free(if_st);
-        return false;
+        return NULL;
     }
 
     // Fill AstIfStatement structure
@@ -102,27 +298,18 @@ bool ast_add_if_statement(AstStatement *statement, AstExpression *condition) {
     if_st->else_if_count = 0;
     if_st->else_if_branches = NULL;
 
-    // Set statement type and union
-    statement->type = ST_IF;
+    // Add the statement to the block
+    AstStatement *statement = block_append(block, ST_IF);
+    if (statement == NULL) {
+        return NULL;
+    }
     statement->if_st = if_st;
     
-    // Allocate next element if not already allocated
-    if (statement->next == NULL) {
-        statement->next = malloc(sizeof(AstStatement));
-        if (statement->next == NULL) {
-            free(true_branch);
-            free(if_st);
-            return false;
-        }
-        statement->next->type = ST_END;
-        statement->next->next = NULL;
-    }
-
-    return true;
+    return statement;
 }
 
 /// Adds an else-if branch to an existing if statement
-bool ast_add_else_if_branch(AstStatement *if_statement, AstExpression *condition) {
+bool ast_add_else_if_branch(AstStatement *if_statement, ExprId condition) {
     // Check if statement is NULL or not an IF statement
     if (if_statement == NULL || if_statement->type != ST_IF) {
         return false;
@@ -133,33 +320,36 @@ bool ast_add_else_if_branch(AstStatement *if_statement, AstExpression *condition
     }
 
     // Create new else-if branch
-    AstElseIfStatement *else_if = malloc(sizeof(AstElseIfStatement));
+    AstElseIfStatement *else_if = ast_alloc(sizeof(AstElseIfStatement));
     if (else_if == NULL) {
         return false;
     }
 
     AstBlock *body = ast_block_create();
     if (body == NULL) {
-        free(else_if);
         return false;
     }
 
     else_if->condition = condition;
     else_if->body = body;
 
-    // Reallocate else_if_branches array to hold the new branch
-    size_t new_count = if_statement->if_st->else_if_count + 1;
-    AstElseIfStatement **new_branches = realloc(if_statement->if_st->else_if_branches, new_count * sizeof(AstElseIfStatement *));
-    if (new_branches == NULL) {
-        free(body);
-        free(else_if);
-        return false;
+    // The array is full whenever the count is a power of two, it is then moved to one twice as large
+    size_t count = if_statement->if_st->else_if_count;
+    if ((count & (count - 1)) == 0) {
+        size_t capacity = count == 0 ? 1 : count * 2;
+        AstElseIfStatement **new_branches = ast_alloc(capacity * sizeof(AstElseIfStatement *));
+        if (new_branches == NULL) {
+            return false;
+        }
+        if (count > 0) {
+            memcpy(new_branches, if_statement->if_st->else_if_branches, count * sizeof(AstElseIfStatement *));
+        }
+        if_statement->if_st->else_if_branches = new_branches;
     }
 
     // Add new branch to the array
-    new_branches[if_statement->if_st->else_if_count] = else_if;
-    if_statement->if_st->else_if_branches = new_branches;
-    if_statement->if_st->else_if_count = new_count;
+    if_statement->if_st->else_if_branches[count] = else_if;
+    if_statement->if_st->else_if_count = count + 1;
 
     return true;
 }
@@ -194,628 +384,352 @@ bool ast_add_else_branch(AstStatement *if_statement) {
 }
 
 /// Adds a while statement to the AST
-bool ast_add_while_statement(AstStatement *statement, AstExpression *condition) {
-    // Check if statement is NULL or not EMPTY
-    if (statement == NULL || statement->type != ST_END) {
-        return false;
+AstStatement *ast_add_while_statement(AstBlock *block, ExprId condition) {
+    if (block == NULL) {
+        return NULL;
     }
 
     // Create AstWhileStatement structure
-    AstWhileStatement *while_st = malloc(sizeof(AstWhileStatement));
+    AstWhileStatement *while_st = ast_alloc(sizeof(AstWhileStatement));
     if (while_st == NULL) {
-        return false;
+        return NULL;
     }
 
     // Create body block
     AstBlock *body = ast_block_create();
     if (body == NULL) {
-        free(while_st);
-        return false;
+        return NULL;
     }
 
     // Fill AstWhileStatement structure
     while_st->condition = condition;
     while_st->body = body;
 
-    // Set statement type and union
-    statement->type = ST_WHILE;
+    // Add the statement to the block
+    AstStatement *statement = block_append(block, ST_WHILE);
+    if (statement == NULL) {
+        return NULL;
+    }
     statement->while_st = while_st;
     
-    // Allocate next element if not already allocated
-    if (statement->next == NULL) {
-        statement->next = malloc(sizeof(AstStatement));
-        if (statement->next == NULL) {
-            free(body);
-            free(while_st);
-            return false;
-        }
-        statement->next->type = ST_END;
-        statement->next->next = NULL;
-    }
-
-    return true;
+    return statement;
 }
 
 /// Adds a return statement to the AST
-bool ast_add_return_statement(AstStatement *statement, AstExpression *return_expr) {
-    // Check if statement is NULL or not EMPTY
-    if (statement == NULL || statement->type != ST_END) {
-        return false;
+AstStatement *ast_add_return_statement(AstBlock *block, ExprId return_expr) {
+    if (block == NULL) {
+        return NULL;
     }
 
-    // Set statement type and expression
-    statement->type = ST_RETURN;
+    // Add the statement to the block
+    AstStatement *statement = block_append(block, ST_RETURN);
+    if (statement == NULL) {
+        return NULL;
+    }
     statement->return_expr = return_expr;
     
-    // Allocate next element if not already allocated
-    if (statement->next == NULL) {
-        statement->next = malloc(sizeof(AstStatement));
-        if (statement->next == NULL) {
-            return false;
-        }
-        statement->next->type = ST_END;
-        statement->next->next = NULL;
-    }
-
-    return true;
+    return statement;
 }
 
 /// Adds a local variable to the AST
-bool ast_add_local_var(AstStatement *statement, char *name, AstExpression *expression) {
-    // Check if statement is NULL or not EMPTY
-    if (statement == NULL || statement->type != ST_END) {
-        return false;
-    }
-
-    // Create variable name as String
-    String *var_name = str_init();
-    if (var_name == NULL) {
-        return false;
-    }
-    if (!str_append_string(var_name, name)) {
-        str_free(&var_name);
-        return false;
+AstStatement *ast_add_local_var(AstBlock *block, const Ident *name, int slot, ExprId expression) {
+    if (block == NULL) {
+        return NULL;
     }
 
     // Create AstVariable structure
-    AstVariable *local_var = malloc(sizeof(AstVariable));
+    AstVariable *local_var = ast_alloc(sizeof(AstVariable));
     if (local_var == NULL) {
-        str_free(&var_name);
-        return false;
+        return NULL;
     }
 
     // Fill AstVariable structure
-    local_var->name = var_name;
+    local_var->name = name;
+    local_var->slot = slot;
     local_var->expression = expression;
 
-    // Set statement type and union
-    statement->type = ST_LOCAL_VAR;
+    // Add the statement to the block
+    AstStatement *statement = block_append(block, ST_LOCAL_VAR);
+    if (statement == NULL) {
+        return NULL;
+    }
     statement->local_var = local_var;
     
-    // Allocate next element if not already allocated
-    if (statement->next == NULL) {
-        statement->next = malloc(sizeof(AstStatement));
-        if (statement->next == NULL) {
-            str_free(&var_name);
-            free(local_var);
-            return false;
-        }
-        statement->next->type = ST_END;
-        statement->next->next = NULL;
-    }
-
-    return true;
+    return statement;
 }
 
 /// Adds a global variable to the AST
-bool ast_add_global_var(AstStatement *statement, char *name, AstExpression *expression) {
-    // Check if statement is NULL or not EMPTY
-    if (statement == NULL || statement->type != ST_END) {
-        return false;
-    }
-
-    // Create variable name as String
-    String *var_name = str_init();
-    if (var_name == NULL) {
-        return false;
-    }
-    if (!str_append_string(var_name, name)) {
-        str_free(&var_name);
-        return false;
+AstStatement *ast_add_global_var(AstBlock *block, const Ident *name, int slot, ExprId expression) {
+    if (block == NULL) {
+        return NULL;
     }
 
     // Create AstVariable structure
-    AstVariable *global_var = malloc(sizeof(AstVariable));
+    AstVariable *global_var = ast_alloc(sizeof(AstVariable));
     if (global_var == NULL) {
-        str_free(&var_name);
-        return false;
+        return NULL;
     }
 
     // Fill AstVariable structure
-    global_var->name = var_name;
+    global_var->name = name;
+    global_var->slot = slot;
     global_var->expression = expression;
 
-    // Set statement type and union
-    statement->type = ST_GLOBAL_VAR;
+    // Add the statement to the block
+    AstStatement *statement = block_append(block, ST_GLOBAL_VAR);
+    if (statement == NULL) {
+        return NULL;
+    }
     statement->global_var = global_var;
     
-    // Allocate next element if not already allocated
-    if (statement->next == NULL) {
-        statement->next = malloc(sizeof(AstStatement));
-        if (statement->next == NULL) {
-            str_free(&var_name);
-            free(global_var);
-            return false;
-        }
-        statement->next->type = ST_END;
-        statement->next->next = NULL;
-    }
-
-    return true;
+    return statement;
 }
 
 /// Adds a getter to the AST
-bool ast_add_getter(AstStatement *statement, char *name, Symtable *symtable) {
-    // Check if statement is NULL or not EMPTY
-    if (statement == NULL || statement->type != ST_END) {
-        return false;
-    }
-
-    // Create getter name as String
-    String *getter_name = str_init();
-    if (getter_name == NULL) {
-        return false;
-    }
-    if (!str_append_string(getter_name, name)) {
-        str_free(&getter_name);
-        return false;
-    }
-    if (!str_append_char(getter_name, '!')) {
-        str_free(&getter_name);
-        return false;
+AstStatement *ast_add_getter(AstBlock *block, const Ident *name, Symtable *symtable) {
+    if (block == NULL) {
+        return NULL;
     }
 
     // Create AstGetter structure
-    AstGetter *getter = malloc(sizeof(AstGetter));
+    AstGetter *getter = ast_alloc(sizeof(AstGetter));
     if (getter == NULL) {
-        str_free(&getter_name);
-        return false;
+        return NULL;
     }
 
     // Create body block
     AstBlock *body = ast_block_create();
     if (body == NULL) {
-        str_free(&getter_name);
-        free(getter);
-        return false;
+        return NULL;
     }
 
     // Fill AstGetter structure
-    getter->name = getter_name;
+    getter->name = name;
     getter->body = body;
     getter->symtable = symtable;
 
-    // Set statement type and union
-    statement->type = ST_GETTER;
+    // Add the statement to the block
+    AstStatement *statement = block_append(block, ST_GETTER);
+    if (statement == NULL) {
+        return NULL;
+    }
     statement->getter = getter;
     
-    // Allocate next element if not already allocated
-    if (statement->next == NULL) {
-        statement->next = malloc(sizeof(AstStatement));
-        if (statement->next == NULL) {
-            str_free(&getter_name);
-            free(body);
-            free(getter);
-            return false;
-        }
-        statement->next->type = ST_END;
-        statement->next->next = NULL;
-    }
-
-    return true;
+    return statement;
 }
 
 /// Adds a setter to the AST
-bool ast_add_setter(AstStatement *statement, char *name, char *param_name, Symtable *symtable) {
-    // Check if statement is NULL or not EMPTY
-    if (statement == NULL || statement->type != ST_END) {
-        return false;
-    }
-
-    // Create setter name as String
-    String *setter_name = str_init();
-    if (setter_name == NULL) {
-        return false;
-    }
-    if (!str_append_string(setter_name, name)) {
-        str_free(&setter_name);
-        return false;
-    }
-    if (!str_append_char(setter_name, '*')) {
-        str_free(&setter_name);
-        return false;
-    }
-
-    // Create parameter name as String
-    String *setter_param_name = str_init();
-    if (setter_param_name == NULL) {
-        str_free(&setter_name);
-        return false;
-    }
-    if (!str_append_string(setter_param_name, param_name)) {
-        str_free(&setter_param_name);
-        str_free(&setter_name);
-        return false;
+AstStatement *ast_add_setter(AstBlock *block, const Ident *name, const Ident *param_name, Symtable *symtable) {
+    if (block == NULL) {
+        return NULL;
     }
 
     // Create AstSetter structure
-    AstSetter *setter = malloc(sizeof(AstSetter));
+    AstSetter *setter = ast_alloc(sizeof(AstSetter));
     if (setter == NULL) {
-        str_free(&setter_param_name);
-        str_free(&setter_name);
-        return false;
+        return NULL;
     }
 
     // Create body block
     AstBlock *body = ast_block_create();
     if (body == NULL) {
-        str_free(&setter_param_name);
-        str_free(&setter_name);
-        free(setter);
-        return false;
+        return NULL;
     }
 
     // Fill AstSetter structure
-    setter->name = setter_name;
-    setter->param_name = setter_param_name;
+    setter->name = name;
+    setter->param_name = param_name;
     setter->body = body;
     setter->symtable = symtable;
 
-    // Set statement type and union
-    statement->type = ST_SETTER;
+    // Add the statement to the block
+    AstStatement *statement = block_append(block, ST_SETTER);
+    if (statement == NULL) {
+        return NULL;
+    }
     statement->setter = setter;
     
-    // Allocate next element if not already allocated
-    if (statement->next == NULL) {
-        statement->next = malloc(sizeof(AstStatement));
-        if (statement->next == NULL) {
-            str_free(&setter_param_name);
-            str_free(&setter_name);
-            free(body);
-            free(setter);
-            return false;
-        }
-        statement->next->type = ST_END;
-        statement->next->next = NULL;
-    }
-
-    return true;
+    return statement;
 }
 
 /// Adds a function to the AST program
-bool ast_add_function(AstStatement *statement, char *name, size_t param_count, Symtable *symtable, String **param_names) {
-    // Check if statement is NULL or not EMPTY
-    if (statement == NULL || statement->type != ST_END) {
-        return false;
-    }
-
-    // Create function name as String
-    String *func_name = str_init();
-    if (func_name == NULL) {
-        return false;
-    }
-    if (!str_append_string(func_name, name)) {
-        str_free(&func_name);
-        return false;
+AstStatement *ast_add_function(AstBlock *block, const Ident *name, size_t param_count, Symtable *symtable, const Ident **param_names) {
+    if (block == NULL) {
+        return NULL;
     }
 
     // Create AstFunction structure
-    AstFunction *function = malloc(sizeof(AstFunction));
+    AstFunction *function = ast_alloc(sizeof(AstFunction));
     if (function == NULL) {
-        str_free(&func_name);
-        return false;
+        return NULL;
+    }
+
+    // Copy the parameter names, the names themselves are interned
+    const Ident **names = ast_alloc(param_count * sizeof(const Ident *));
+    if (names == NULL) {
+        return NULL;
+    }
+    if (param_count > 0) {
+        memcpy(names, param_names, param_count * sizeof(const Ident *));
     }
 
     // Create function body block
     AstBlock *body = ast_block_create();
     if (body == NULL) {
-        str_free(&func_name);
-        free(function);
-        return false;
+        return NULL;
     }
 
     // Fill AstFunction structure
-    function->name = func_name;
+    function->name = name;
     function->param_count = param_count;
-    function->param_names = param_names;
+    function->param_names = names;
     function->body = body;
     function->symtable = symtable;
 
-    // Set statement type and union
-    statement->type = ST_FUNCTION;
+    // Add the statement to the block
+    AstStatement *statement = block_append(block, ST_FUNCTION);
+    if (statement == NULL) {
+        return NULL;
+    }
     statement->function = function;
     
-    // Allocate next element if not already allocated
-    if (statement->next == NULL) {
-        statement->next = malloc(sizeof(AstStatement));
-        if (statement->next == NULL) {
-            str_free(&func_name);
-            free(body);
-            free(function);
-            return false;
-        }
-        statement->next->type = ST_END;
-        statement->next->next = NULL;
-    }
-
-    return true;
+    return statement;
 }
 
 /// Adds a setter call to the AST
-bool ast_add_setter_call(AstStatement *statement, char *name, AstExpression *expression) {
-    // Check if statement is NULL or not EMPTY
-    if (statement == NULL || statement->type != ST_END) {
-        return false;
-    }  
-    // Create setter call name as String
-    String *setter_name = str_init();
-    if (setter_name == NULL) {
-        return false;
+AstStatement *ast_add_setter_call(AstBlock *block, const Ident *name, ExprId expression) {
+    if (block == NULL) {
+        return NULL;
     }
-
-    if (!str_append_string(setter_name, name)) {
-        str_free(&setter_name);
-        return false;
-    } 
-
     // Create AstVariable structure for setter call
-    AstVariable *setter_call = malloc(sizeof(AstVariable));
+    AstVariable *setter_call = ast_alloc(sizeof(AstVariable));
     if (setter_call == NULL) {
-        str_free(&setter_name);
-        return false;
+        return NULL;
     }
 
     // Fill AstVariable structure
-    setter_call->name = setter_name;
+    setter_call->name = name;
+    setter_call->slot = SLOT_NONE;
     setter_call->expression = expression;
 
-    // Set statement type and union
-    statement->type = ST_SETTER_CALL;
+    // Add the statement to the block
+    AstStatement *statement = block_append(block, ST_SETTER_CALL);
+    if (statement == NULL) {
+        return NULL;
+    }
     statement->setter_call = setter_call;
     
-    // Allocate next element if not already allocated
-    if (statement->next == NULL) {
-        statement->next = malloc(sizeof(AstStatement));
-        if (statement->next == NULL) {
-            str_free(&setter_name);
-            free(setter_call);
-            return false;
-        }
-        statement->next->type = ST_END;
-        statement->next->next = NULL;
-    }
-
-    return true;
+    return statement;
 }
 
 /// Adds a block to the AST
-bool ast_add_block(AstStatement *statement) {
-    // Check if statement is NULL or not EMPTY
-    if (statement == NULL || statement->type != ST_END) {
-        return false;
+AstStatement *ast_add_block(AstBlock *block) {
+    if (block == NULL) {
+        return NULL;
     }
 
-    // Set statement type and union
-    statement->type = ST_BLOCK;
-    statement->block = ast_block_create();
-
-    if (statement->block == NULL) {
-        return false;
+    AstBlock *inner = ast_block_create();
+    if (inner == NULL) {
+        return NULL;
     }
 
-    // Allocate next element if not already allocated
-    if (statement->next == NULL) {
-        statement->next = malloc(sizeof(AstStatement));
-        if (statement->next == NULL) {
-            return false;
-        }
-        statement->next->type = ST_END;
-        statement->next->next = NULL;
+    // Add the statement to the block
+    AstStatement *statement = block_append(block, ST_BLOCK);
+    if (statement == NULL) {
+        return NULL;
     }
+    statement->block = inner;
 
-    return true;
+    return statement;
 }
 
 /// Adds an inline expression to the AST
-bool ast_add_inline_expression(AstStatement *statement, AstExpression *expression) {
-    // Check if statement is NULL or not EMPTY
-    if (statement == NULL || statement->type != ST_END) {
-        return false;
+AstStatement *ast_add_inline_expression(AstBlock *block, ExprId expression) {
+    if (block == NULL) {
+        return NULL;
     }
 
-    // Set statement type and union
-    statement->type = ST_EXPRESSION;
+    // Add the statement to the block
+    AstStatement *statement = block_append(block, ST_EXPRESSION);
+    if (statement == NULL) {
+        return NULL;
+    }
     statement->expression = expression;
     
-    // Allocate next element if not already allocated
-    if (statement->next == NULL) {
-        statement->next = malloc(sizeof(AstStatement));
-        if (statement->next == NULL) {
-            return false;
-        }
-        statement->next->type = ST_END;
-        statement->next->next = NULL;
-    }
-
-    return true;
+    return statement;
 }
 
-/// Frees an AST expression recursively
-void ast_expr_free(AstExpression *expr) {
-    if (expr == NULL) {
-        return;
-    }
-
-    // Free all child expressions
-    for (size_t i = 0; i < expr->child_count; i++) {
-        ast_expr_free(expr->params[i]);
-    }
-    free(expr->params);
-
-    // Free string value if its a string expression
-    // Check both original type and optimized type (val_known with DT_STRING)
-    if (expr->type == EX_STRING || expr->type == EX_ID || expr->type == EX_GLOBAL_ID ||
-        expr->type == EX_FUN || expr->type == EX_BUILTIN_FUN || expr->type == EX_GETTER ||
-        (expr->val_known && expr->assumed_type == DT_STRING)) {
-        // We only free if the value is a known string or is unknown
-        // because if the value is known, the identifier is already freed
-        if (!expr->val_known || expr->assumed_type == DT_STRING) {
-            str_free(&expr->string_val);
-        }
-    }
-
-    free(expr);
+/// Returns the current position of the AST arena and of the expression store
+AstMark ast_mark(AstExprs *exprs) {
+    AstMark mark = { arena_mark(&pool.arena), pool.strings, exprs->count, exprs->children_count };
+    return mark;
 }
 
-/// Frees an AST statement recursively
-void ast_statement_free(AstStatement *statement) {
-    if (statement == NULL) {
-        return;
+// Frees the statements and strings allocated after the mark was taken
+static void release_nodes(AstMark mark) {
+    while (pool.strings != mark.strings) {
+        str_free(&pool.strings->str);
+        pool.strings = pool.strings->next;
     }
+    arena_release(&pool.arena, mark.arena);
+}
 
-    // Free next statement in the list
-    ast_statement_free(statement->next);
+/// Frees every node and string allocated after the mark was taken
+void ast_release(AstExprs *exprs, AstMark mark) {
+    release_nodes(mark);
+    exprs->count = mark.expr_count;
+    exprs->children_count = mark.children_count;
+}
 
-    // Free based on statement type
+// Frees the symtable of a definition, the only part of the AST not allocated from the arena
+static void free_definition_symtable(AstStatement *statement) {
     switch (statement->type) {
-        case ST_BLOCK:
-            ast_block_free(statement->block);
-            break;
-
-        case ST_IF:
-            if (statement->if_st != NULL) {
-                ast_expr_free(statement->if_st->condition);
-                ast_block_free(statement->if_st->true_branch);
-                
-                // Free else-if branches
-                if (statement->if_st->else_if_branches != NULL) {
-                    for (size_t i = 0; i < statement->if_st->else_if_count; i++) {
-                        if (statement->if_st->else_if_branches[i] != NULL) {
-                            ast_expr_free(statement->if_st->else_if_branches[i]->condition);
-                            ast_block_free(statement->if_st->else_if_branches[i]->body);
-                            free(statement->if_st->else_if_branches[i]);
-                        }
-                    }
-                    free(statement->if_st->else_if_branches);
-                }
-                
-                ast_block_free(statement->if_st->false_branch);
-                free(statement->if_st);
-            }
-            break;
-
-        case ST_WHILE:
-            if (statement->while_st != NULL) {
-                ast_expr_free(statement->while_st->condition);
-                ast_block_free(statement->while_st->body);
-                free(statement->while_st);
-            }
-            break;
-
-        case ST_EXPRESSION:
-            ast_expr_free(statement->expression);
-            break;
-
-        case ST_RETURN:
-            ast_expr_free(statement->return_expr);
-            break;
-
-        case ST_LOCAL_VAR:
-            if (statement->local_var != NULL) {
-                str_free(&statement->local_var->name);
-                ast_expr_free(statement->local_var->expression);
-                free(statement->local_var);
-            }
-            break;
-
-        case ST_GLOBAL_VAR:
-            if (statement->global_var != NULL) {
-                str_free(&statement->global_var->name);
-                ast_expr_free(statement->global_var->expression);
-                free(statement->global_var);
-            }
-            break;
-
-        case ST_SETTER_CALL:
-            if (statement->setter_call != NULL) {
-                str_free(&statement->setter_call->name);
-                ast_expr_free(statement->setter_call->expression);
-                free(statement->setter_call);
-            }
-            break;
-
         case ST_FUNCTION:
-            if (statement->function != NULL) {
-                str_free(&statement->function->name);
-                
-                // Free parameter names
-                if (statement->function->param_names != NULL) {
-                    for (size_t i = 0; i < statement->function->param_count; i++) {
-                        str_free(&statement->function->param_names[i]);
-                    }
-                    free(statement->function->param_names);
-                }
-                
-                ast_block_free(statement->function->body);
-                symtable_free(statement->function->symtable);
-                free(statement->function);
-            }
+            symtable_free(statement->function->symtable);
             break;
-
         case ST_GETTER:
-            if (statement->getter != NULL) {
-                str_free(&statement->getter->name);
-                ast_block_free(statement->getter->body);
-                symtable_free(statement->getter->symtable);
-                free(statement->getter);
-            }
+            symtable_free(statement->getter->symtable);
             break;
-
         case ST_SETTER:
-            if (statement->setter != NULL) {
-                str_free(&statement->setter->name);
-                str_free(&statement->setter->param_name);
-                ast_block_free(statement->setter->body);
-                symtable_free(statement->setter->symtable);
-                free(statement->setter);
-            }
+            symtable_free(statement->setter->symtable);
             break;
-
-        case ST_ROOT:
-            // Root statement doesn't have additional data to free
-            break;
-
-        case ST_END:
-            // Empty statement doesn't have additional data to free
+        default:
             break;
-        }
+    }
+}
 
-    free(statement);
+/// Frees the last statement of the block, a definition allocated after the mark was taken
+void ast_block_release_last(AstExprs *exprs, AstBlock *block, AstMark mark) {
+    free_definition_symtable(&block->statements[--block->count]);
+    ast_release(exprs, mark);
 }
 
-/// Frees an AST block recursively
-void ast_block_free(AstBlock *block) {
-    if (block == NULL) {
-        return;
+/// Frees the entire AST starting from the root statement
+void ast_free(AstStatement *root) {
+    // Definitions are only in the top level statement list
+    if (root != NULL) {
+        for (size_t i = 0; i < root->block->count; i++) {
+            free_definition_symtable(&root->block->statements[i]);
+        }
     }
 
-    ast_statement_free(block->statements);
-    free(block);
+    AstMark start = { { NULL, 0 }, NULL, 0, 0 };
+    release_nodes(start);
+    arena_free(&pool.arena);
 }
 
-/// Frees the entire AST starting from the root statement
-void ast_free(AstStatement *root) {
-    ast_statement_free(root);
+/// Frees the columns of the expression store
+void ast_exprs_free(AstExprs *exprs) {
+    free(exprs->type);
+    free(exprs->assumed_type);
+    free(exprs->val_known);
+    free(exprs->surely_int);
+    free(exprs->child_count);
+    free(exprs->first_child);
+    free(exprs->value);
+    free(exprs->slot);
+    free(exprs->children);
+    ast_exprs_init(exprs);
 }
 
 // Helper function for printing with indentation
@@ -826,26 +740,43 @@ static void ast_print_indent(int indent) {
 }
 
 // Forward declarations
-static void ast_print_block(AstBlock *block, int indent);
-static void ast_print_statement(AstStatement *statement, int indent);
-static void ast_print_expression(AstExpression *expr);
+static void ast_print_block(AstExprs *exprs, AstBlock *block, int indent);
+static void ast_print_statement(AstExprs *exprs, AstStatement *statement, int indent);
+static void ast_print_expression(AstExprs *exprs, ExprId expr);
+static void ast_print_node(AstExprs *exprs, ExprId expr);
 
 // Helper function for printing block
-static void ast_print_block(AstBlock *block, int indent) {
+static void ast_print_block(AstExprs *exprs, AstBlock *block, int indent) {
     if (block == NULL) {
         return;
     }
-    ast_print_statement(block->statements, indent);
+    // Statements at the same level (vedle, ne vnořené)
+    for (size_t i = 0; i < block->count; i++) {
+        ast_print_statement(exprs, &block->statements[i], indent);
+    }
 }
 
-// Print an expression tree recursively (simple readable form)
-static void ast_print_expression(AstExpression *expr) {
-    if (expr == NULL) {
+// Print an expression tree in pre-order (simple readable form)
+static void ast_print_expression(AstExprs *exprs, ExprId root) {
+    if (root == EXPR_NONE) {
         printf("(null expression)\n");
         return;
     }
 
-    switch (expr->type) {
+    AstWalk walk;
+    AstWalkFrame step;
+    ast_walk_init(&walk, exprs, root);
+    while (ast_walk_next(&walk, &step)) {
+        if (step.done == 0) {
+            ast_print_node(exprs, step.expr);
+        }
+    }
+    ast_walk_free(&walk);
+}
+
+// Prints a single expression node, the children are printed by the caller
+static void ast_print_node(AstExprs *exprs, ExprId expr) {
+    switch (EXPR_TYPE(exprs, expr)) {
         case EX_ID:
             // For AST printing replace identifier text with the generic label
             printf("EXPRESSION\n");
@@ -859,27 +790,23 @@ static void ast_print_expression(AstExpression *expr) {
             printf("EXPRESSION\n");
             break;
         case EX_DOUBLE:
-            printf("%f\n", expr->double_val);
+            printf("%f\n", EXPR_DOUBLE(exprs, expr));
             break;
         case EX_BOOL:
-            printf("%s\n", expr->bool_val ? "true" : "false");
+            printf("%s\n", EXPR_BOOL(exprs, expr) ? "true" : "false");
             break;
         case EX_NULL:
             printf("null\n");
             break;
         default:
             // For non-leaf nodes (operators, function calls, etc.) don't print labels,
-            // just recurse into children so only leaf values appear in output.
+            // so only leaf values appear in output.
             break;
     }
-
-    for (size_t i = 0; i < expr->child_count; i++) {
-        ast_print_expression(expr->params[i]);
-    }
 }
 
-// Helper function for printing statement
-static void ast_print_statement(AstStatement *statement, int indent) {
+// Helper function for printing a single statement
+static void ast_print_statement(AstExprs *exprs, AstStatement *statement, int indent) {
     if (statement == NULL) {
         return;
     }
@@ -894,7 +821,7 @@ static void ast_print_statement(AstStatement *statement, int indent) {
         case ST_BLOCK:
             printf("BLOCK\n");
             if (statement->block != NULL) {
-                ast_print_block(statement->block, indent + 1);
+                ast_print_block(exprs, statement->block, indent + 1);
             }
             break;
 
@@ -904,7 +831,7 @@ static void ast_print_statement(AstStatement *statement, int indent) {
                        statement->function->name ? statement->function->name->val : "?",
                        statement->function->param_count);
                 if (statement->function->body != NULL) {
-                    ast_print_block(statement->function->body, indent + 1);
+                    ast_print_block(exprs, statement->function->body, indent + 1);
                 }
             } else {
                 printf("FUNCTION: (null)\n");
@@ -913,10 +840,10 @@ static void ast_print_statement(AstStatement *statement, int indent) {
 
         case ST_GETTER:
             if (statement->getter != NULL) {
-                printf("GETTER: %s\n", 
+                printf("GETTER: %s!\n",
                        statement->getter->name ? statement->getter->name->val : "?");
                 if (statement->getter->body != NULL) {
-                    ast_print_block(statement->getter->body, indent + 1);
+                    ast_print_block(exprs, statement->getter->body, indent + 1);
                 }
             } else {
                 printf("GETTER: (null)\n");
@@ -925,11 +852,11 @@ static void ast_print_statement(AstStatement *statement, int indent) {
 
         case ST_SETTER:
             if (statement->setter != NULL) {
-                printf("SETTER: %s (param: %s)\n", 
+                printf("SETTER: %s* (param: %s)\n",
                        statement->setter->name ? statement->setter->name->val : "?",
                        statement->setter->param_name ? statement->setter->param_name->val : "?");
                 if (statement->setter->body != NULL) {
-                    ast_print_block(statement->setter->body, indent + 1);
+                    ast_print_block(exprs, statement->setter->body, indent + 1);
                 }
             } else {
                 printf("SETTER: (null)\n");
@@ -942,7 +869,7 @@ static void ast_print_statement(AstStatement *statement, int indent) {
                 ast_print_indent(indent + 1);
                 printf("TRUE_BRANCH:\n");
                 if (statement->if_st->true_branch != NULL) {
-                    ast_print_block(statement->if_st->true_branch, indent + 2);
+                    ast_print_block(exprs, statement->if_st->true_branch, indent + 2);
                 }
                 
                 // Print else-if branches
@@ -951,7 +878,7 @@ static void ast_print_statement(AstStatement *statement, int indent) {
                         ast_print_indent(indent + 1);
                         printf("ELSE_IF_BRANCH:\n");
                         if (statement->if_st->else_if_branches[i]->body != NULL) {
-                            ast_print_block(statement->if_st->else_if_branches[i]->body, indent + 2);
+                            ast_print_block(exprs, statement->if_st->else_if_branches[i]->body, indent + 2);
                         }
                     }
                 }
@@ -959,7 +886,7 @@ static void ast_print_statement(AstStatement *statement, int indent) {
                 if (statement->if_st->false_branch != NULL) {
                     ast_print_indent(indent + 1);
                     printf("FALSE_BRANCH:\n");
-                    ast_print_block(statement->if_st->false_branch, indent + 2);
+                    ast_print_block(exprs, statement->if_st->false_branch, indent + 2);
                 }
             } else {
                 printf("IF: (null)\n");
@@ -970,7 +897,7 @@ static void ast_print_statement(AstStatement *statement, int indent) {
             if (statement->while_st != NULL) {
                 printf("WHILE\n");
                 if (statement->while_st->body != NULL) {
-                    ast_print_block(statement->while_st->body, indent + 1);
+                    ast_print_block(exprs, statement->while_st->body, indent + 1);
                 }
             } else {
                 printf("WHILE: (null)\n");
@@ -983,17 +910,17 @@ static void ast_print_statement(AstStatement *statement, int indent) {
 
         case ST_SETTER_CALL:
             if (statement->setter_call != NULL) {
-                if (statement->setter_call->expression != NULL) {
+                if (statement->setter_call->expression != EXPR_NONE) {
                     // print only the expression (no labels or additional text)
-                    ast_print_expression(statement->setter_call->expression);
+                    ast_print_expression(exprs, statement->setter_call->expression);
                 }
             }
             break;
 
         case ST_LOCAL_VAR:
             if (statement->local_var != NULL) {
-                printf("LOCAL_VAR: %s\n", 
-                       statement->local_var->name ? statement->local_var->name->val : "?");
+                printf("LOCAL_VAR: %s?%d\n",
+                       statement->local_var->name ? statement->local_var->name->val : "?", statement->local_var->slot);
             } else {
                 printf("LOCAL_VAR: (null)\n");
             }
@@ -1009,30 +936,25 @@ static void ast_print_statement(AstStatement *statement, int indent) {
             break;
 
         case ST_EXPRESSION:
-            if (statement->expression != NULL) {
-                ast_print_expression(statement->expression);
+            if (statement->expression != EXPR_NONE) {
+                ast_print_expression(exprs, statement->expression);
             }
             break;
 
-        case ST_END:
-            printf("END\n");
-            break;
-
         default:
             printf("UNKNOWN_STATEMENT\n");
             break;
     }
 
-    // Print next statement at same level (vedle, ne vnořené)
-    if (statement->next != NULL) {
-        ast_print_statement(statement->next, indent);
-    }
 }
 
 /// Prints the entire AST tree to stdout with indentation
-void ast_print(AstStatement *root) {
+void ast_print(AstExprs *exprs, AstStatement *root) {
     printf("\n=== AST TREE ===\n");
-    ast_print_statement(root, 0);
+    if (root != NULL) {
+        ast_print_statement(exprs, root, 0);
+        ast_print_block(exprs, root->block, 0);
+    }
     printf("=== END AST ===\n\n");
 }
 
@@ -13,7 +13,10 @@
 #ifndef _AST_H_
 #define _AST_H_
 
+#include "arena.h"
 #include "string.h"
+#include "intern.h"
+#include <stdint.h>
 #include <stdlib.h>
 
 // Forward declaration to avoid circular dependency
@@ -63,30 +66,98 @@ typedef enum ast_expr_type {
     EX_BUILTIN_FUN,
 } AstExprType;
 
-/// Structure holding expression
-typedef struct ast_expression AstExpression;
-struct ast_expression {
-    /// Subtrees for operands or function parameters
-    AstExpression **params;
-    /// Number of children in params, 1 - unary, 2 - binary, 3 - ternary, everything for functions (0 - N)
-    size_t child_count;
-    /// Expression type
-    AstExprType type;
-    /// Type assumption from static analysis
-    DataType assumed_type;
-    /// True if the value of this expression is known at compile time
-    bool val_known;
+#define _AST_EXPRS_INITIAL_CAPACITY 256
+
+/// Index of an expression node in the expression columns
+typedef uint32_t ExprId;
+
+/// Stands for a missing expression
+#define EXPR_NONE UINT32_MAX
+
+/// Frame slot of the names that are not local variables
+#define SLOT_NONE (-1)
+
+/// Value for literals or the whole expression if val_known
+typedef union ast_value {
+    String *string_val;
+    /// Interned name for identifiers, getters and function calls
+    const Ident *ident;
+    int int_val;
+    double double_val;
+    bool bool_val;
+    DataType data_type;
+} AstValue;
+
+/// Expression nodes of the AST stored column by column and addressed by ExprId, so a pass only
+/// touches the columns it reads. The children of a node are created before it and their ids are
+/// stored next to each other in the children column. The store is owned by the caller of the parser
+/// and passed to every pass together with the AST, an ExprId means nothing without it
+typedef struct ast_exprs {
+    /// Expression type, an AstExprType
+    unsigned char *type;
+    /// Type assumption from static analysis, a DataType
+    unsigned char *assumed_type;
+    /// True if the value of the expression is known at compile time
+    bool *val_known;
     /// True if the num value is an surely integer
-    bool surely_int;
+    bool *surely_int;
+    /// Number of children, 1 - unary, 2 - binary, 3 - ternary, everything for functions (0 - N)
+    uint32_t *child_count;
+    /// Position of the first child in the children column
+    uint32_t *first_child;
     /// Value for literals or the whole expression if val_known
-    union {
-        String *string_val;
-        int int_val;
-        double double_val;
-        bool bool_val;
-        DataType data_type;
-    };
-};
+    AstValue *value;
+    /// Slot of the variable an identifier is bound to, the frame slot for local variables and
+    /// the slot in the global symtable for global ones. SLOT_NONE for the other nodes
+    int *slot;
+    /// Number of nodes and the capacity of the columns above
+    uint32_t count;
+    uint32_t capacity;
+
+    /// Subtrees for operands or function parameters of all nodes
+    ExprId *children;
+    uint32_t children_count;
+    uint32_t children_capacity;
+} AstExprs;
+
+// Columns of a single expression in the store the AST was parsed into. The columns are moved
+// when they grow, so only ids may be kept
+#define EXPR_TYPE(exprs, e) ((exprs)->type[e])
+#define EXPR_ASSUMED_TYPE(exprs, e) ((exprs)->assumed_type[e])
+#define EXPR_VAL_KNOWN(exprs, e) ((exprs)->val_known[e])
+#define EXPR_SURELY_INT(exprs, e) ((exprs)->surely_int[e])
+#define EXPR_CHILD_COUNT(exprs, e) ((exprs)->child_count[e])
+#define EXPR_CHILD(exprs, e, i) ((exprs)->children[(exprs)->first_child[e] + (i)])
+#define EXPR_STRING(exprs, e) ((exprs)->value[e].string_val)
+#define EXPR_IDENT(exprs, e) ((exprs)->value[e].ident)
+#define EXPR_SLOT(exprs, e) ((exprs)->slot[e])
+#define EXPR_DOUBLE(exprs, e) ((exprs)->value[e].double_val)
+#define EXPR_BOOL(exprs, e) ((exprs)->value[e].bool_val)
+#define EXPR_DATA_TYPE(exprs, e) ((exprs)->value[e].data_type)
+
+#define _AST_WALK_INLINE_DEPTH 64
+
+/// Node on the path of an expression walk with the number of its children walked so far
+typedef struct ast_walk_frame {
+    ExprId expr;
+    uint32_t done;
+} AstWalkFrame;
+
+/// Depth first walk over an expression with an explicit stack, so the depth of the expression is
+/// bounded only by the heap. Walks shallower than _AST_WALK_INLINE_DEPTH do not allocate.
+/// The frames may point into the structure, so it must not be copied
+typedef struct ast_walk {
+    /// Store of the walked expression
+    AstExprs *exprs;
+    AstWalkFrame *frames;
+    size_t count;
+    size_t capacity;
+    /// The node returned last still has to be moved past
+    bool pending;
+    /// Growing the stack failed, the walk ended early
+    bool failed;
+    AstWalkFrame inline_frames[_AST_WALK_INLINE_DEPTH];
+} AstWalk;
 
 // Forward declarations
 typedef struct ast_block AstBlock;
@@ -113,25 +184,33 @@ typedef enum ast_statement_type {
     ST_GETTER,
     ST_SETTER,
     ST_EXPRESSION,
-    ST_END
 } AstStatementType;
 
+#define _AST_BLOCK_INITIAL_CAPACITY 4
+
 /// Structure holding a block with a statement list
 typedef struct ast_block {
-    /// First statement in the block
+    /// Statements of the block stored next to each other, the array is moved when it grows,
+    /// so a pointer to a statement is only valid until another one is added to the block
     AstStatement *statements;
+
+    /// Number of statements
+    size_t count;
+
+    /// Number of statements the array has room for
+    size_t capacity;
 } AstBlock;
 
 /// Structure holding a function
 typedef struct ast_function {
     /// Name of the function
-    String *name;
+    const Ident *name;
 
     /// Number of parameters
     size_t param_count;
 
     /// Name of parameters
-    String **param_names;
+    const Ident **param_names;
 
     /// Function body
     AstBlock *body;
@@ -143,7 +222,7 @@ typedef struct ast_function {
 /// Structure holding a getter
 typedef struct ast_getter {
     /// Name of the getter
-    String *name;
+    const Ident *name;
 
     /// Body of the getter
     AstBlock *body;
@@ -155,10 +234,10 @@ typedef struct ast_getter {
 /// Structure holding a setter
 typedef struct ast_setter {
     /// Name of the setter
-    String *name;
+    const Ident *name;
 
     /// Name of the parameter
-    String *param_name;
+    const Ident *param_name;
 
     /// Body of the setter
     AstBlock *body;
@@ -170,19 +249,22 @@ typedef struct ast_setter {
 /// Structure holding a var
 typedef struct ast_variable {
     /// Name of the variable
-    String *name;
+    const Ident *name;
+
+    /// Frame slot of a local variable, slot in the global symtable of a global one, SLOT_NONE for setter calls
+    int slot;
 
     /// Expression assigned to the variable
-    AstExpression *expression;
+    ExprId expression;
 } AstVariable;
 
 /// Structure holding a function call
 typedef struct ast_function_call {
     /// Name of the function
-    String *name;
+    const Ident *name;
 
     /// Arguments expressions
-    AstExpression *arguments;
+    ExprId arguments;
 
     /// Number of arguments
     size_t argument_count;
@@ -191,7 +273,7 @@ typedef struct ast_function_call {
 /// Structure holding a if statement
 typedef struct ast_if_statement {
     /// Condition expression
-    AstExpression *condition;
+    ExprId condition;
 
     /// True branch
     AstBlock *true_branch;
@@ -208,7 +290,7 @@ typedef struct ast_if_statement {
 
 typedef struct ast_else_if_statement {
     /// Condition expression
-    AstExpression *condition;
+    ExprId condition;
 
     /// Body of the else-if branch
     AstBlock *body;
@@ -217,7 +299,7 @@ typedef struct ast_else_if_statement {
 
 typedef struct ast_while_statement {
     /// Condition expression
-    AstExpression *condition;
+    ExprId condition;
 
     /// Body of the while loop
     AstBlock *body;
@@ -228,92 +310,137 @@ typedef struct ast_statement {
     /// Statement type
     AstStatementType type;
 
-    /// Next statement in the statement list
-    AstStatement *next;
-
     /// Union holding specific statement data
     union {
+        /// Nested block, or the definitions for the root
         AstBlock *block;
         AstIfStatement *if_st;
         AstWhileStatement *while_st;
-        AstExpression *return_expr;
+        ExprId return_expr;
         AstVariable *local_var;
         AstVariable *global_var;
         AstVariable *setter_call;
         AstFunction *function;
         AstGetter *getter;
         AstSetter *setter;
-        AstExpression *expression;
+        ExprId expression;
     };
 } AstStatement;
 
+typedef struct ast_owned_string AstOwnedString;
+
+/// Position in the AST, the nodes allocated after it can be freed at once
+typedef struct ast_mark {
+    ArenaMark arena;
+    AstOwnedString *strings;
+    uint32_t expr_count;
+    uint32_t children_count;
+} AstMark;
+
 // AST creation functions
+// Statements and blocks are owned by one arena, expressions by the expression columns and strings
+// by the AST, so the nodes are never freed one by one
+
+/// Initializes an empty expression store, the columns are allocated with the first node
+void ast_exprs_init(AstExprs *exprs);
 
-/// Creates a new AST expression node
-AstExpression *ast_expr_create(AstExprType type, size_t child_count);
+/// Creates a new AST expression node in the store with room for child_count children, which are set
+/// by EXPR_CHILD. Returns EXPR_NONE if allocation failed
+ExprId ast_expr_create(AstExprs *exprs, AstExprType type, size_t child_count);
 
-/// Initializes a new AST statement
+/// Hands a heap string over to the AST, it is freed together with the nodes.
+/// Returns the string or NULL if it is NULL or allocation failed, the string is freed then
+String *ast_own_string(String *str);
+
+/// Initializes the root statement of a new AST with an empty block for the definitions
 AstStatement *ast_statement_init();
 
-/// Creates a new AST block
+/// Creates a new empty AST block
 AstBlock *ast_block_create();
 
+/// Makes room for count more statements in the block, so adding them does not allocate
+bool ast_block_reserve(AstBlock *block, size_t count);
+
+// The functions adding a statement to a block return the new statement or NULL if allocation failed
+
 /// Adds an if statement to the AST
-bool ast_add_if_statement(AstStatement *statement, AstExpression *condition);
+AstStatement *ast_add_if_statement(AstBlock *block, ExprId condition);
 
 /// Adds an else-if branch to an existing if statement
-bool ast_add_else_if_branch(AstStatement *if_statement, AstExpression *condition);
+bool ast_add_else_if_branch(AstStatement *if_statement, ExprId condition);
 
 /// Adds an else branch to an existing if statement
 bool ast_add_else_branch(AstStatement *if_statement);
 
 /// Adds a while statement to the AST
-bool ast_add_while_statement(AstStatement *statement, AstExpression *condition);
+AstStatement *ast_add_while_statement(AstBlock *block, ExprId condition);
 
 /// Adds a return statement to the AST
-bool ast_add_return_statement(AstStatement *statement, AstExpression *return_expr);
+AstStatement *ast_add_return_statement(AstBlock *block, ExprId return_expr);
 
 /// Adds a local variable to the AST
-bool ast_add_local_var(AstStatement *statement, char *name, AstExpression *expression);
+AstStatement *ast_add_local_var(AstBlock *block, const Ident *name, int slot, ExprId expression);
 
 /// Adds a global variable to the AST
-bool ast_add_global_var(AstStatement *statement, char *name, AstExpression *expression);
+AstStatement *ast_add_global_var(AstBlock *block, const Ident *name, int slot, ExprId expression);
 
 /// Adds a getter to the AST
-bool ast_add_getter(AstStatement *statement, char *name, Symtable *symtable);
+AstStatement *ast_add_getter(AstBlock *block, const Ident *name, Symtable *symtable);
 
 /// Adds a setter to the AST
-bool ast_add_setter(AstStatement *statement, char *name, char *param_name, Symtable *symtable);
+AstStatement *ast_add_setter(AstBlock *block, const Ident *name, const Ident *param_name, Symtable *symtable);
 
-/// Adds a function to the AST program
-bool ast_add_function(AstStatement *statement, char *name, size_t param_count, Symtable *symtable, String **param_names);
+/// Adds a function to the AST program, the parameter names are copied
+AstStatement *ast_add_function(AstBlock *block, const Ident *name, size_t param_count, Symtable *symtable, const Ident **param_names);
 
 /// Adds a setter call to the AST
-bool ast_add_setter_call(AstStatement *statement, char *name, AstExpression *expression);
+AstStatement *ast_add_setter_call(AstBlock *block, const Ident *name, ExprId expression);
 
 /// Adds a block to the AST
-bool ast_add_block(AstStatement *statement);
+AstStatement *ast_add_block(AstBlock *block);
 
 /// Adds an inline expression to the AST
-bool ast_add_inline_expression(AstStatement *statement, AstExpression *expression);
+AstStatement *ast_add_inline_expression(AstBlock *block, ExprId expression);
+
+// Expression walking functions
+
+/// Starts a walk from the root expression in the store, root may be EXPR_NONE
+void ast_walk_init(AstWalk *walk, AstExprs *exprs, ExprId root);
+
+/// Moves to the next step of the walk. A node is returned once before each of its children and
+/// once after the last one, done tells how many children were walked. Returns false when the walk
+/// is over or when it failed, which is told by walk->failed
+bool ast_walk_next(AstWalk *walk, AstWalkFrame *out);
+
+/// Skips the children of the node returned last that were not walked yet
+void ast_walk_skip(AstWalk *walk);
+
+/// Frees the stack of the walk, it must be called even if the walk ended early
+void ast_walk_free(AstWalk *walk);
 
 // AST cleanup functions
 
-/// Frees an AST expression recursively
-void ast_expr_free(AstExpression *expr);
+/// Returns the current position of the AST arena and of the expression store
+AstMark ast_mark(AstExprs *exprs);
 
-/// Frees an AST statement recursively
-void ast_statement_free(AstStatement *statement);
+/// Frees every node and string allocated after the mark was taken
+void ast_release(AstExprs *exprs, AstMark mark);
 
-/// Frees an AST block recursively
-void ast_block_free(AstBlock *block);
+/// Frees the last statement of the block, a definition allocated after the mark was taken.
+/// The block must not have grown since the mark was taken, see ast_block_reserve
+void ast_block_release_last(AstExprs *exprs, AstBlock *block, AstMark mark);
 
-/// Frees the entire AST starting from the root statement
+/// Frees the entire AST starting from the root statement, root may be NULL.
+/// Only the symtables of the definitions are freed one by one, the nodes are freed at once.
+/// The expressions are freed by ast_exprs_free
 void ast_free(AstStatement *root);
 
+/// Frees the columns of the expression store, it is empty again afterwards
+void ast_exprs_free(AstExprs *exprs);
+
 // AST printing functions
 
 /// Prints the entire AST tree to stdout with indentation
-void ast_print(AstStatement *root);
+void ast_print(AstExprs *exprs, AstStatement *root);
 
 #endif // !_AST_H_
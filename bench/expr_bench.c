@@ -0,0 +1,221 @@
+/*
+ * expr_bench.c
+ * Benchmark of the table and Pratt expression engines on deeply nested and very long expressions
+ *
+ * IFJ project 2025
+ * FIT VUT
+ *
+ * Authors:
+ * Michal Šebesta (xsebesm00)
+ */
+#define _POSIX_C_SOURCE 200809L
+#include "../expr_parser.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define _NESTING_DEPTH 2000
+#define _OPERATOR_COUNT 20000
+/// Depths well past what a recursive parser survives
+#define _DEEP_NESTING_DEPTH 50000
+#define _DEEP_TERNARY_DEPTH 100000
+/// The table engine still parses call arguments recursively, so calls are nested less deep
+#define _DEEP_CALL_DEPTH 10000
+/// Tokens parsed by each engine for every expression, shorter ones are parsed several times
+#define _TOKENS_PER_RUN 4000000
+
+typedef ErrorCode (*Engine)(Lexer *lexer, AstExprs *exprs, ExprId *out_expr);
+
+/// Returns (((a + 1) * 1) ... ), nested depth times
+static char *nested_expression(size_t depth) {
+    char *src = malloc(depth * 8 + 2);
+    if (src == NULL) return NULL;
+    char *p = src;
+    for (size_t i = 0; i < depth; i++) *p++ = '(';
+    *p++ = 'a';
+    for (size_t i = 0; i < depth; i++) {
+        memcpy(p, i % 2 ? " * 1)" : " + 1)", 5);
+        p += 5;
+    }
+    *p++ = '\n';
+    *p = '\0';
+    return src;
+}
+
+/// Returns -(!(-(... a ...))), each of the depth operators followed by a parenthesis
+static char *prefix_expression(size_t depth) {
+    char *src = malloc(depth * 4 + 3);
+    if (src == NULL) return NULL;
+    char *p = src;
+    for (size_t i = 0; i < depth; i++) {
+        memcpy(p, i % 2 ? "!(" : "-(", 2);
+        p += 2;
+    }
+    *p++ = 'a';
+    for (size_t i = 0; i < depth; i++) *p++ = ')';
+    *p++ = '\n';
+    *p = '\0';
+    return src;
+}
+
+/// Returns a > 1 ? a : a > 1 ? a : ... a, with depth ternaries nested in the false branches
+static char *ternary_expression(size_t depth) {
+    static const char link[] = "a > 1 ? a : ";
+    char *src = malloc(depth * (sizeof(link) - 1) + 3);
+    if (src == NULL) return NULL;
+    char *p = src;
+    for (size_t i = 0; i < depth; i++) {
+        memcpy(p, link, sizeof(link) - 1);
+        p += sizeof(link) - 1;
+    }
+    *p++ = 'a';
+    *p++ = '\n';
+    *p = '\0';
+    return src;
+}
+
+/// Returns f(a, f(a, ... f(a) ...)), depth calls nested in the last argument
+static char *call_expression(size_t depth) {
+    char *src = malloc(depth * 6 + 6);
+    if (src == NULL) return NULL;
+    char *p = src;
+    for (size_t i = 0; i < depth; i++) {
+        memcpy(p, "f(a, ", 5);
+        p += 5;
+    }
+    memcpy(p, "f(a", 3);
+    p += 3;
+    for (size_t i = 0; i <= depth; i++) *p++ = ')';
+    *p++ = '\n';
+    *p = '\0';
+    return src;
+}
+
+/// Returns a + b * c - d / e < ... with count operators of mixed precedence
+static char *long_expression(size_t count) {
+    static const char *ops[] = { " + ", " * ", " - ", " / ", " < ", " && ", " == ", " || " };
+    char *src = malloc(count * 6 + 3);
+    if (src == NULL) return NULL;
+    char *p = src;
+    *p++ = 'a';
+    for (size_t i = 0; i < count; i++) {
+        const char *op = ops[i % (sizeof(ops) / sizeof(ops[0]))];
+        memcpy(p, op, strlen(op));
+        p += strlen(op);
+        *p++ = 'a' + i % 26;
+    }
+    *p++ = '\n';
+    *p = '\0';
+    return src;
+}
+
+/// Compares the trees node by node, the pairs left to compare are kept on the heap so deep trees fit
+static bool same_expr(AstExprs *exprs, ExprId a, ExprId b) {
+    size_t count = 0, capacity = 64;
+    ExprId *pairs = malloc(capacity * 2 * sizeof(ExprId));
+    if (pairs == NULL) return false;
+    pairs[count * 2] = a;
+    pairs[count * 2 + 1] = b;
+    count++;
+
+    bool same = true;
+    while (same && count > 0) {
+        count--;
+        a = pairs[count * 2];
+        b = pairs[count * 2 + 1];
+        if (EXPR_TYPE(exprs, a) != EXPR_TYPE(exprs, b) || EXPR_CHILD_COUNT(exprs, a) != EXPR_CHILD_COUNT(exprs, b) ||
+            ((EXPR_TYPE(exprs, a) == EX_ID || EXPR_TYPE(exprs, a) == EX_FUN) && EXPR_IDENT(exprs, a) != EXPR_IDENT(exprs, b)) || (EXPR_TYPE(exprs, a) == EX_DOUBLE && EXPR_DOUBLE(exprs, a) != EXPR_DOUBLE(exprs, b))) {
+            same = false;
+            break;
+        }
+        for (size_t i = 0; i < EXPR_CHILD_COUNT(exprs, a); i++) {
+            if (count == capacity) {
+                capacity *= 2;
+                ExprId *new_pairs = realloc(pairs, capacity * 2 * sizeof(ExprId));
+                if (new_pairs == NULL) {
+                    same = false;
+                    break;
+                }
+                pairs = new_pairs;
+            }
+            pairs[count * 2] = EXPR_CHILD(exprs, a, i);
+            pairs[count * 2 + 1] = EXPR_CHILD(exprs, b, i);
+            count++;
+        }
+    }
+    free(pairs);
+    return same;
+}
+
+static double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/// Parses the expression rounds times, returns the time of one parse in seconds or a negative number on error
+static double time_engine(Lexer *lexer, AstExprs *exprs, Engine engine, size_t rounds) {
+    AstMark mark = ast_mark(exprs);
+    double start = now();
+    for (size_t r = 0; r < rounds; r++) {
+        ExprId expr;
+        lexer_rewind(lexer, 0);
+        if (engine(lexer, exprs, &expr) != OK) return -1;
+        ast_release(exprs, mark);
+    }
+    return (now() - start) / rounds;
+}
+
+static bool run(AstExprs *exprs, const char *name, char *src) {
+    if (src == NULL) return false;
+    FILE *f = fmemopen(src, strlen(src), "r");
+    Lexer lexer;
+    if (f == NULL || !lexer_init(&lexer, f) || !lexer_tokenize(&lexer)) {
+        fprintf(stderr, "%s: cannot lex the input\n", name);
+        return false;
+    }
+
+    AstMark mark = ast_mark(exprs);
+    ExprId table_expr, pratt_expr;
+    if (parse_expression_table(&lexer, exprs, &table_expr) != OK) return false;
+    lexer_rewind(&lexer, 0);
+    if (parse_expression_pratt(&lexer, exprs, &pratt_expr) != OK) return false;
+    bool same = same_expr(exprs, table_expr, pratt_expr);
+    ast_release(exprs, mark);
+    if (!same) {
+        fprintf(stderr, "%s: the engines built different trees\n", name);
+        return false;
+    }
+
+    size_t rounds = lexer.token_count >= _TOKENS_PER_RUN ? 1 : _TOKENS_PER_RUN / lexer.token_count;
+    double table = time_engine(&lexer, exprs, parse_expression_table, rounds);
+    double pratt = time_engine(&lexer, exprs, parse_expression_pratt, rounds);
+    if (table < 0 || pratt < 0) return false;
+
+    double tokens = lexer.token_count;
+    printf("%s: %zu tokens, rounds: %zu\n", name, lexer.token_count, rounds);
+    printf("  table:   %6.2f ns/token\n", table / tokens * 1e9);
+    printf("  pratt:   %6.2f ns/token\n", pratt / tokens * 1e9);
+    printf("  speedup: %6.2fx\n", table / pratt);
+
+    lexer_free(&lexer);
+    fclose(f);
+    free(src);
+    return true;
+}
+
+int main() {
+    AstExprs exprs;
+    ast_exprs_init(&exprs);
+    bool ok = run(&exprs, "nested", nested_expression(_NESTING_DEPTH))
+        && run(&exprs, "long", long_expression(_OPERATOR_COUNT))
+        && run(&exprs, "deep nested", nested_expression(_DEEP_NESTING_DEPTH))
+        && run(&exprs, "deep prefix", prefix_expression(_DEEP_NESTING_DEPTH))
+        && run(&exprs, "deep ternary", ternary_expression(_DEEP_TERNARY_DEPTH))
+        && run(&exprs, "deep calls", call_expression(_DEEP_CALL_DEPTH));
+    ast_free(NULL);
+    ast_exprs_free(&exprs);
+    intern_free_all();
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,130 @@
+/*
+ * keyword_bench.c
+ * Microbenchmark of keyword recognition on identifier-heavy input
+ *
+ * IFJ project 2025
+ * FIT VUT
+ *
+ * Authors:
+ * Michal Šebesta (xsebesm00)
+ */
+#define _POSIX_C_SOURCE 200809L
+#include "../lexer.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define _ROUNDS 2000
+
+typedef struct word {
+    char *val;
+    size_t length;
+} Word;
+
+/// The previous recognizer, a linear scan with strcmp, kept as the baseline
+static TokType linear_check_keyword(char *id) {
+    static struct {
+        char *kw;
+        TokType type;
+    } keywordTable[] = {
+        {"class", TOK_KW_CLASS}, {"if", TOK_KW_IF}, {"else", TOK_KW_ELSE},
+        {"is", TOK_OP_IS}, {"null", TOK_KW_NULL}, {"return", TOK_KW_RETURN},
+        {"var", TOK_KW_VAR}, {"while", TOK_KW_WHILE}, {"Ifj", TOK_KW_IFJ},
+        {"static", TOK_KW_STATIC}, {"import", TOK_KW_IMPORT}, {"for", TOK_KW_FOR},
+        {"Num", TOK_TYPE_NUM}, {"String", TOK_TYPE_STRING}, {"Bool", TOK_TYPE_BOOL},
+        {"Null", TOK_TYPE_NULL}, {"true", TOK_KW_TRUE}, {"false", TOK_KW_FALSE},
+        {"in", TOK_KW_IN}, {"", TOK_IDENTIFIER},
+    };
+    for (int i = 0; keywordTable[i].kw[0] != '\0'; i++) {
+        if (strcmp(keywordTable[i].kw, id) == 0) return keywordTable[i].type;
+    }
+    return TOK_IDENTIFIER;
+}
+
+/// Appends every identifier-shaped word of the given file to the word list
+static bool collect_words(const char *path, Word **words, size_t *count, size_t *capacity) {
+    FILE *f = fopen(path, "r");
+    if (f == NULL) return false;
+    char buf[256];
+    size_t len = 0;
+    int ch;
+    do {
+        ch = fgetc(f);
+        if (ch != EOF && (isalnum(ch) || ch == '_') && len < sizeof(buf) - 1) {
+            buf[len++] = ch;
+            continue;
+        }
+        if (len == 0 || isdigit((unsigned char)buf[0])) {
+            len = 0;
+            continue;
+        }
+        if (*count == *capacity) {
+            *capacity = *capacity ? *capacity * 2 : 1024;
+            *words = realloc(*words, *capacity * sizeof(Word));
+            if (*words == NULL) return false;
+        }
+        buf[len] = '\0';
+        (*words)[*count].val = strdup(buf);
+        (*words)[*count].length = len;
+        (*count)++;
+        len = 0;
+    } while (ch != EOF);
+    fclose(f);
+    return true;
+}
+
+static double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s FILE...\n", argv[0]);
+        return 1;
+    }
+    Word *words = NULL;
+    size_t count = 0, capacity = 0;
+    for (int i = 1; i < argc; i++) {
+        if (!collect_words(argv[i], &words, &count, &capacity)) {
+            fprintf(stderr, "cannot read %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    size_t keywords = 0;
+    for (size_t i = 0; i < count; i++) {
+        TokType expected = linear_check_keyword(words[i].val);
+        if (check_keyword(words[i].val, words[i].length) != expected) {
+            fprintf(stderr, "mismatch on '%s'\n", words[i].val);
+            return 1;
+        }
+        if (expected != TOK_IDENTIFIER) keywords++;
+    }
+
+    volatile unsigned sink = 0;
+    double start = now();
+    for (int r = 0; r < _ROUNDS; r++) {
+        for (size_t i = 0; i < count; i++) sink += linear_check_keyword(words[i].val);
+    }
+    double linear = now() - start;
+
+    start = now();
+    for (int r = 0; r < _ROUNDS; r++) {
+        for (size_t i = 0; i < count; i++) sink += check_keyword(words[i].val, words[i].length);
+    }
+    double hashed = now() - start;
+
+    double lookups = (double)count * _ROUNDS;
+    printf("words: %zu (%zu keywords), rounds: %d\n", count, keywords, _ROUNDS);
+    printf("linear scan:  %6.2f ns/lookup\n", linear / lookups * 1e9);
+    printf("perfect hash: %6.2f ns/lookup\n", hashed / lookups * 1e9);
+    printf("speedup:      %6.2fx\n", linear / hashed);
+
+    for (size_t i = 0; i < count; i++) free(words[i].val);
+    free(words);
+    return 0;
+}
@@ -0,0 +1,95 @@
+/*
+ * symtable_bench.c
+ * Microbenchmark of symtable inserts and lookups with growing numbers of symbols
+ *
+ * IFJ project 2025
+ * FIT VUT
+ *
+ * Authors:
+ * Michal Šebesta (xsebesm00)
+ */
+#define _POSIX_C_SOURCE 200809L
+#include "../symtable.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/// Operations timed for every table size, smaller tables are filled several times
+#define _OPERATIONS 2000000
+
+static double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/// Interns count names with the given prefix, returns NULL if allocation failed
+static const Ident **make_names(const char *prefix, size_t count) {
+    const Ident **names = malloc(count * sizeof(const Ident *));
+    if (names == NULL) return NULL;
+    char buf[64];
+    for (size_t i = 0; i < count; i++) {
+        int length = snprintf(buf, sizeof(buf), "%s%zu", prefix, i);
+        names[i] = intern(buf, (size_t)length);
+        if (names[i] == NULL) {
+            free(names);
+            return NULL;
+        }
+    }
+    return names;
+}
+
+/// Times inserts of count symbols and lookups of them and of count missing ones
+static bool run(size_t count) {
+    const Ident **names = make_names("sym", count);
+    const Ident **missing = make_names("miss", count);
+    if (names == NULL || missing == NULL) return false;
+
+    size_t rounds = count >= _OPERATIONS ? 1 : _OPERATIONS / count;
+    double insert = 0, hit = 0, miss = 0;
+    size_t found = 0;
+
+    for (size_t r = 0; r < rounds; r++) {
+        Symtable *st = symtable_init();
+        if (st == NULL) return false;
+
+        double start = now();
+        for (size_t i = 0; i < count; i++) {
+            if (symtable_insert(st, SYM_GLOBAL_VAR, names[i], 0) == NULL) return false;
+        }
+        double inserted = now();
+        for (size_t i = 0; i < count; i++) {
+            found += symtable_find(st, SYM_GLOBAL_VAR, names[i], 0) != NULL;
+        }
+        double hits = now();
+        for (size_t i = 0; i < count; i++) {
+            found += symtable_find(st, SYM_GLOBAL_VAR, missing[i], 0) != NULL;
+        }
+        double misses = now();
+
+        insert += inserted - start;
+        hit += hits - inserted;
+        miss += misses - hits;
+        symtable_free(st);
+    }
+    if (found != count * rounds) {
+        fprintf(stderr, "%zu symbols: lookups found %zu of %zu\n", count, found, count * rounds);
+        return false;
+    }
+
+    double ops = (double)count * rounds;
+    printf("%zu symbols, rounds: %zu\n", count, rounds);
+    printf("  insert: %6.2f ns/op\n", insert / ops * 1e9);
+    printf("  hit:    %6.2f ns/op\n", hit / ops * 1e9);
+    printf("  miss:   %6.2f ns/op\n", miss / ops * 1e9);
+
+    free(names);
+    free(missing);
+    return true;
+}
+
+int main() {
+    bool ok = run(1000) && run(100000) && run(1000000);
+    intern_free_all();
+    return ok ? 0 : 1;
+}
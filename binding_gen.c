@@ -0,0 +1,148 @@
+/*
+ * binding_gen.c
+ * Build-time generator of the operator binding powers used by the Pratt expression parser
+ *
+ * IFJ project 2025
+ * FIT VUT
+ *
+ * Authors:
+ * Michal Šebesta (xsebesm00)
+ */
+#include <limits.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include "precedence_table.h"
+
+static const char *symbols[PREC_TABLE_SIZE] = {
+    "+", "-", "*", "/", ">", "<", ">=", "<=", "==", "!=", "&&", "||",
+    "id", "(", ")", "is", "?", ":", "!", "$",
+};
+
+/// Rows that can be the topmost terminal while an operand is being parsed
+static bool is_context(int row) {
+    return row != PREC_OPERAND && row != PREC_RIGHT_PAR;
+}
+
+/// Columns of the tokens that decide whether the operand on their left is complete.
+/// Binary operators, the ternary and the prefix operators, unary minus shares the column with binary one
+static bool is_operator(int col) {
+    return col <= PREC_OR || col == PREC_IS || col == PREC_QUESTION_MARK || col == PREC_NOT;
+}
+
+/// Returns true if the incoming col binds into the right operand of row, false if that operand ends.
+/// A missing relation ends the operand, the caller then fails on the token it did not expect
+static bool binds(int row, int col) {
+    return precedence_table[row][col] == '<';
+}
+
+/// Finds the smallest binding powers for which left[col] > right[row] exactly when col binds into row
+/// for every row marked in rows. This is the classic construction of precedence functions,
+/// it fails if the relations form a cycle
+static bool find_binding_powers(const bool rows[], unsigned left[], unsigned right[]) {
+    for (int i = 0; i < PREC_TABLE_SIZE; i++) left[i] = right[i] = 0;
+
+    bool changed = true;
+    for (int round = 0; changed; round++) {
+        // Every power is at most one more than the longest chain of strict relations
+        if (round > 2 * PREC_TABLE_SIZE) return false;
+        changed = false;
+        for (int row = 0; row < PREC_TABLE_SIZE; row++) {
+            if (!rows[row]) continue;
+            for (int col = 0; col < PREC_TABLE_SIZE; col++) {
+                if (!is_operator(col)) continue;
+                if (binds(row, col) && left[col] <= right[row]) {
+                    left[col] = right[row] + 1;
+                    changed = true;
+                } else if (!binds(row, col) && right[row] < left[col]) {
+                    right[row] = left[col];
+                    changed = true;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+/// Adds the rows one by one and keeps the ones the binding powers can express. The rest get a mask
+/// of the operators that bind into them instead, like ! which binds tighter than * but looser than is
+static void find_relations(unsigned left[], unsigned right[], unsigned long masks[]) {
+    bool rows[PREC_TABLE_SIZE] = { false };
+    for (int row = 0; row < PREC_TABLE_SIZE; row++) {
+        if (!is_context(row)) continue;
+        rows[row] = true;
+        if (!find_binding_powers(rows, left, right)) rows[row] = false;
+    }
+    find_binding_powers(rows, left, right);
+
+    for (int row = 0; row < PREC_TABLE_SIZE; row++) {
+        masks[row] = 0;
+        if (!is_context(row) || rows[row]) continue;
+        right[row] = UCHAR_MAX;
+        for (int col = 0; col < PREC_TABLE_SIZE; col++) {
+            if (is_operator(col) && binds(row, col)) masks[row] |= 1ul << col;
+        }
+    }
+}
+
+static void print_powers(const char *name, const char *doc, const unsigned powers[]) {
+    printf("/// %s\n"
+           "static const unsigned char %s[PREC_TABLE_SIZE] = {\n", doc, name);
+    for (int i = 0; i < PREC_TABLE_SIZE; i++) {
+        printf("    [%d] = %u, // %s\n", i, powers[i], symbols[i]);
+    }
+    printf("};\n");
+}
+
+int main() {
+    unsigned left[PREC_TABLE_SIZE], right[PREC_TABLE_SIZE];
+    unsigned long masks[PREC_TABLE_SIZE];
+    find_relations(left, right, masks);
+
+    // Both together have to reproduce every relation of the table
+    for (int row = 0; row < PREC_TABLE_SIZE; row++) {
+        for (int col = 0; col < PREC_TABLE_SIZE; col++) {
+            if (!is_context(row) || !is_operator(col)) continue;
+            bool generated = left[col] > right[row] || (masks[row] >> col & 1);
+            if (generated != binds(row, col)) {
+                fprintf(stderr, "binding_gen: wrong relation of %s and %s\n", symbols[row], symbols[col]);
+                return 1;
+            }
+        }
+    }
+
+    printf("/*\n"
+           " * binding_powers.h\n"
+           " * Binding powers of the expression operators\n"
+           " * Generated by binding_gen from precedence_table.h, do not edit\n"
+           " */\n"
+           "#ifndef _BINDING_POWERS_H_\n"
+           "#define _BINDING_POWERS_H_\n"
+           "\n"
+           "#include \"precedence_table.h\"\n"
+           "\n");
+    print_powers("left_bp", "How strongly an operator binds to the operand on its left", left);
+    printf("\n");
+    print_powers("right_bp", "Operators with a higher left binding power belong to the operand on the right of this one", right);
+    printf("\n"
+           "/// Operators that belong to the operand on the right of the ones binding powers cannot express\n"
+           "static const unsigned long binds_mask[PREC_TABLE_SIZE] = {\n");
+    bool any_mask = false;
+    for (int row = 0; row < PREC_TABLE_SIZE; row++) {
+        if (masks[row] == 0) continue;
+        any_mask = true;
+        printf("    [%d] = 0x%lx, // %s:", row, masks[row], symbols[row]);
+        for (int col = 0; col < PREC_TABLE_SIZE; col++) {
+            if (masks[row] >> col & 1) printf(" %s", symbols[col]);
+        }
+        printf("\n");
+    }
+    // An empty initializer is not valid C11
+    if (!any_mask) printf("    0,\n");
+    printf("};\n"
+           "\n"
+           "/// True if the operator op belongs to the operand on the right of ctx\n"
+           "#define BINDS(ctx, op) (left_bp[op] > right_bp[ctx] || (binds_mask[ctx] >> (op) & 1))\n"
+           "\n"
+           "#endif // !_BINDING_POWERS_H_\n");
+    return 0;
+}
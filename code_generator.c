@@ -14,6 +14,7 @@
 #include "string.h"
 #include "symtable.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #define CG_ASSERT(cond) \
@@ -31,14 +32,20 @@ do {\
 unsigned internal_names_cntr = 0;
 
 /// Helper that returns true if an expression contains any function calls
-bool has_fun_call(AstExpression *ex) {
-    if (ex->type == EX_GETTER || ex->type == EX_FUN || ex->type == EX_BUILTIN_FUN) {
-        return true;
-    }
-    for (unsigned i = 0; i < ex->child_count; i++) {
-        if (has_fun_call(ex->params[i])) return true;
+bool has_fun_call(AstExprs *exprs, ExprId ex) {
+    bool found = false;
+    AstWalk walk;
+    AstWalkFrame step;
+    ast_walk_init(&walk, exprs, ex);
+    while (!found && ast_walk_next(&walk, &step)) {
+        if (step.done == 0) {
+            AstExprType type = EXPR_TYPE(exprs, step.expr);
+            found = type == EX_GETTER || type == EX_FUN || type == EX_BUILTIN_FUN;
+        }
     }
-    return false;
+    ast_walk_free(&walk);
+    // If the walk failed we can't tell, evaluating the expression is always correct
+    return found || walk.failed;
 }
 
 /// Generates code which checks if the value in a given var is the desired type
@@ -80,49 +87,146 @@ typedef enum required_branches {
     B_FALSE = 2,
 } RequiredBranches;
 
+/// Builtin function whose code is generated once its arguments are evaluated
+typedef enum builtin_fun {
+    BI_WRITE,
+    BI_FLOOR,
+    BI_STR,
+    BI_LENGTH,
+    BI_SUBSTRING,
+    BI_STRCMP,
+    BI_ORD,
+    BI_CHR,
+} BuiltinFun;
+
+#define _CG_INLINE_DEPTH 32
+
+/// Statement with nested blocks whose code is being generated
+typedef struct statement_frame {
+    /// ST_BLOCK, ST_IF or ST_WHILE
+    AstStatementType type;
+    union {
+        AstBlock *block;
+        AstIfStatement *if_st;
+        AstWhileStatement *while_st;
+    };
+    /// Step of the generation the statement is at
+    unsigned phase;
+    /// Id for the labels of the statement and its current else-if branch
+    unsigned id;
+    unsigned elif_id;
+    /// Branches the condition of the statement requires
+    unsigned char branches;
+    /// True while a nested block is generated, body is the block and pos its next statement
+    bool in_block;
+    AstBlock *body;
+    size_t pos;
+    /// Else-if branch being generated
+    size_t index;
+} StatementFrame;
+
+/// Stack of frames of the given size, it starts in a buffer on the C stack and moves
+/// to the heap when the buffer is full
+typedef struct cg_stack {
+    void *frames;
+    void *inline_frames;
+    size_t size;
+    size_t count;
+    size_t capacity;
+} CgStack;
+
+/// Creates a stack in the inline buffer of capacity frames
+static CgStack cg_stack_init(void *inline_frames, size_t size, size_t capacity) {
+    return (CgStack){
+        .frames = inline_frames,
+        .inline_frames = inline_frames,
+        .size = size,
+        .count = 0,
+        .capacity = capacity,
+    };
+}
+
+/// Returns a new frame on the top of the stack or NULL if allocation failed
+static void *cg_push(CgStack *stack) {
+    if (stack->count == stack->capacity) {
+        size_t capacity = stack->capacity * 2;
+        void *frames;
+        if (stack->frames == stack->inline_frames) {
+            frames = malloc(capacity * stack->size);
+            if (frames != NULL) {
+                memcpy(frames, stack->frames, stack->count * stack->size);
+            }
+        } else {
+            frames = realloc(stack->frames, capacity * stack->size);
+        }
+        if (frames == NULL) {
+            return NULL;
+        }
+        stack->frames = frames;
+        stack->capacity = capacity;
+    }
+    return (char *)stack->frames + stack->count++ * stack->size;
+}
+
+/// Frees the stack if it moved to the heap
+static void cg_stack_free(CgStack *stack) {
+    if (stack->frames != stack->inline_frames) {
+        free(stack->frames);
+    }
+}
+
+/// Makes the driver evaluate the child and call the step of the node again in the given phase
+static ErrorCode evaluate_child(EvalFrame *f, ExprId *next, ExprId child, unsigned phase) {
+    f->phase = phase;
+    *next = child;
+    return OK;
+}
+
+/// Returns true if the expression has to be evaluated before its truthness is assessed
+static bool truth_needs_evaluation(AstExprs *exprs, ExprId ex) {
+    DataType type = EXPR_ASSUMED_TYPE(exprs, ex);
+    if (type == DT_UNKNOWN || (type == DT_BOOL && !EXPR_VAL_KNOWN(exprs, ex))) {
+        return true;
+    }
+    // The truthness is known, but we still have to evaluate the expression if it has a function call
+    return has_fun_call(exprs, ex);
+}
+
 /// Generates code which assesses the truthness of an expression and jumps to the propel label
+/// The value of the expression is on the top of the stack if it was evaluated
 /// Assumes the true label is right below below the assessment and the return value to be respected
 /// Returns which branches are possible to take and have to be generated
-RequiredBranches generate_truth_assessment(FILE *output, AstExpression *ex, char *true_label, char *false_label, unsigned expr_id) {
-    DataType type = ex->assumed_type;
-    bool fun_call = has_fun_call(ex);
+static RequiredBranches generate_truth_jumps(FILE *output, AstExprs *exprs, ExprId ex, bool evaluated, char *true_label, char *false_label, unsigned expr_id) {
+    DataType type = EXPR_ASSUMED_TYPE(exprs, ex);
     // Null is false
     if (type == DT_NULL) {
-        if (fun_call) {
-            // We still have to evaluate the expression if it has a function call
-            generate_expression_evaluation(output, ex);
+        if (evaluated) {
             fprintf(output, "POPS GF@&&inter1\n");
         }
         return B_FALSE;
     }
     // Everything except bools is true
     if (type != DT_UNKNOWN && type != DT_BOOL) {
-        if (fun_call) {
-            // We still have to evaluate the expression if it has a function call
-            generate_expression_evaluation(output, ex);
+        if (evaluated) {
             fprintf(output, "POPS GF@&&inter1\n");
         }
         return B_TRUE;
     }
     // We known the bool value
-    if (type == DT_BOOL && ex->val_known) {
-        if (fun_call) {
-            // We still have to evaluate the expression if it has a function call
-            generate_expression_evaluation(output, ex);
+    if (type == DT_BOOL && EXPR_VAL_KNOWN(exprs, ex)) {
+        if (evaluated) {
             fprintf(output, "POPS GF@&&inter1\n");
         }
-        return ex->bool_val ? B_TRUE : B_FALSE;
+        return EXPR_BOOL(exprs, ex) ? B_TRUE : B_FALSE;
     }
     // We know it is a bool but don't know it's value
     if (type == DT_BOOL) {
-        generate_expression_evaluation(output, ex);
         fprintf(output, "PUSHS bool@true\n"
                         "JUMPIFNEQS %s%u\n",
                         false_label, expr_id);
         return B_TRUE | B_FALSE;
     }
     // We know nothing
-    generate_expression_evaluation(output, ex);
     // Check null
     fprintf(output, "POPS GF@&&inter1\n"
                     "PUSHS GF@&&inter1\n"
@@ -144,160 +248,130 @@ RequiredBranches generate_truth_assessment(FILE *output, AstExpression *ex, char
     return B_TRUE | B_FALSE;
 }
 
-ErrorCode generate_compound_statement(FILE *output, AstBlock *st) {
-    DEBUG_WRITE(output, "#v v v v v BLOCK v v v v v\n");
-    for (AstStatement *cur = st->statements; cur->type != ST_END; cur = cur->next) {
-        CG_ASSERT(generate_statement(output, cur) == OK);
-        DEBUG_WRITE(output, "#------------\n");
-        if (cur->type == ST_RETURN) {
-            DEBUG_WRITE(output, "# SKIPPING DEAD CODE AFTER RETURN\n");
-            break;
-        }
-    }
-    DEBUG_WRITE(output, "#^ ^ ^ ^ ^ BLOCK ^ ^ ^ ^ ^\n");
-    return OK;
-}
-
-ErrorCode generate_if_statement(FILE *output, AstIfStatement *st) {
-    unsigned expr_id = internal_names_cntr++;
-    RequiredBranches b = generate_truth_assessment(output, st->condition, "$&&if_true", "$&&if_false", expr_id);
-    if (b & B_TRUE) {
-        fprintf(output, "LABEL $&&if_true%u\n", expr_id);
-        generate_compound_statement(output, st->true_branch);
-        // Skip the else branch if it is generated
-        if (b & B_FALSE) {
-            fprintf(output, "JUMP $&&if_end%u\n", expr_id);
-        }
-    }
-    if (b & B_FALSE) {
-        fprintf(output, "LABEL $&&if_false%u\n", expr_id);
-        // Generate else-if branches
-        for (size_t i = 0; i < st->else_if_count; i++) {
-            AstElseIfStatement *elif = st->else_if_branches[i];
-            unsigned elif_id = internal_names_cntr++;
-            RequiredBranches b = generate_truth_assessment(output, elif->condition, "$&&elif_true", "$&&elif_false", elif_id);
-            if (b & B_TRUE) {
-                fprintf(output, "LABEL $&&elif_true%u\n", elif_id);
-                generate_compound_statement(output, elif->body);
-                fprintf(output, "JUMP $&&if_end%u\n", expr_id);
-            }
-            fprintf(output, "LABEL $&&elif_false%u\n", elif_id);
-        }
-        // Else branch
-        if (st->false_branch != NULL) {
-            generate_compound_statement(output, st->false_branch);
-        }
-    }
-    fprintf(output, "LABEL $&&if_end%u\n", expr_id);
-
-    return OK;
-}
-
-ErrorCode generate_while_statement(FILE *output, AstWhileStatement *st) {
-    unsigned expr_id = internal_names_cntr++;
-    AstExpression *cond = st->condition;
-
-    fprintf(output, "LABEL $&&while_cond%u\n", expr_id);
-    RequiredBranches b = generate_truth_assessment(output, cond, "$&&while_body", "$&&while_end", expr_id);
-    if (b & B_TRUE) {
-        fprintf(output, "LABEL $&&while_body%u\n", expr_id);
-        generate_compound_statement(output, st->body);
-
-        fprintf(output, "JUMP $&&while_cond%u\n", expr_id);
+/// Generates code which evaluates an expression if needed, assesses its truthness and jumps to the propel label
+/// Returns which branches are possible to take and have to be generated
+RequiredBranches generate_truth_assessment(FILE *output, AstExprs *exprs, ExprId ex, char *true_label, char *false_label, unsigned expr_id) {
+    bool evaluated = truth_needs_evaluation(exprs, ex);
+    if (evaluated) {
+        generate_expression_evaluation(output, exprs, ex);
     }
-    fprintf(output, "LABEL $&&while_end%u\n", expr_id);
-
-    return OK;
+    return generate_truth_jumps(output, exprs, ex, evaluated, true_label, false_label, expr_id);
 }
 
-ErrorCode generate_function_call(FILE *output, AstExpression *call) {
-    for (unsigned i = 0; i < call->child_count; i++) {
-        CG_ASSERT(generate_expression_evaluation(output, call->params[i]) == OK);
+ErrorCode generate_function_call(FILE *output, AstExprs *exprs, EvalFrame *f, ExprId *next) {
+    ExprId call = f->ex;
+    // Arguments are pushed in order
+    if (f->phase < EXPR_CHILD_COUNT(exprs, call)) {
+        return evaluate_child(f, next, EXPR_CHILD(exprs, call, f->phase), f->phase + 1);
     }
-    fprintf(output, "CALL $%s$%zu\n", call->string_val->val, call->child_count);
+    fprintf(output, "CALL $%s$%u\n", EXPR_IDENT(exprs, call)->val, EXPR_CHILD_COUNT(exprs, call));
     return OK;
 }
 
-ErrorCode generate_and_expr(FILE *output, AstExpression *ex) {
-    unsigned expr_id = internal_names_cntr++;
+ErrorCode generate_and_expr(FILE *output, AstExprs *exprs, EvalFrame *f, ExprId *next) {
+    ExprId ex = f->ex;
     RequiredBranches b;
-    b = generate_truth_assessment(output, ex->params[0], "$&&and_first_true", "$&&and_false", expr_id);
-    if (b & B_TRUE) {
-        fprintf(output, "LABEL $&&and_first_true%u\n", expr_id);
-        b = generate_truth_assessment(output, ex->params[1], "$&&and_true", "$&&and_false", expr_id);
+    if (f->phase == 0) {
+        f->id = internal_names_cntr++;
+        f->evaluated = truth_needs_evaluation(exprs, EXPR_CHILD(exprs, ex, 0));
+        f->phase = 1;
+        if (f->evaluated) return evaluate_child(f, next, EXPR_CHILD(exprs, ex, 0), 1);
+    }
+    if (f->phase == 1) {
+        b = generate_truth_jumps(output, exprs, EXPR_CHILD(exprs, ex, 0), f->evaluated, "$&&and_first_true", "$&&and_false", f->id);
+        f->phase = 3;
+        if (b & B_TRUE) {
+            fprintf(output, "LABEL $&&and_first_true%u\n", f->id);
+            f->evaluated = truth_needs_evaluation(exprs, EXPR_CHILD(exprs, ex, 1));
+            f->phase = 2;
+            if (f->evaluated) return evaluate_child(f, next, EXPR_CHILD(exprs, ex, 1), 2);
+        }
+    }
+    if (f->phase == 2) {
+        b = generate_truth_jumps(output, exprs, EXPR_CHILD(exprs, ex, 1), f->evaluated, "$&&and_true", "$&&and_false", f->id);
         if (b & B_TRUE) {
             fprintf(output, "LABEL $&&and_true%u\n"
                             "PUSHS bool@true\n"
                             "JUMP $&&and_end%u\n",
-                            expr_id, expr_id);
+                            f->id, f->id);
         }
     }
     fprintf(output, "LABEL $&&and_false%u\n"
                     "PUSHS bool@false\n"
                     "LABEL $&&and_end%u\n",
-                    expr_id, expr_id);
+                    f->id, f->id);
     return OK;
 }
 
-ErrorCode generate_or_expr(FILE *output, AstExpression *ex) {
-    unsigned expr_id = internal_names_cntr++;
+ErrorCode generate_or_expr(FILE *output, AstExprs *exprs, EvalFrame *f, ExprId *next) {
+    ExprId ex = f->ex;
     RequiredBranches b;
-    b = generate_truth_assessment(output, ex->params[0], "$&&or_first_true", "$&&or_first_false", expr_id);
-    if (b & B_TRUE) {
-        fprintf(output, "LABEL $&&or_first_true%u\n"
-                        "PUSHS bool@true\n"
-                        "JUMP $&&or_end%u\n",
-                        expr_id, expr_id);
+    if (f->phase == 0) {
+        f->id = internal_names_cntr++;
+        f->evaluated = truth_needs_evaluation(exprs, EXPR_CHILD(exprs, ex, 0));
+        f->phase = 1;
+        if (f->evaluated) return evaluate_child(f, next, EXPR_CHILD(exprs, ex, 0), 1);
+    }
+    if (f->phase == 1) {
+        b = generate_truth_jumps(output, exprs, EXPR_CHILD(exprs, ex, 0), f->evaluated, "$&&or_first_true", "$&&or_first_false", f->id);
+        if (b & B_TRUE) {
+            fprintf(output, "LABEL $&&or_first_true%u\n"
+                            "PUSHS bool@true\n"
+                            "JUMP $&&or_end%u\n",
+                            f->id, f->id);
+        }
+        f->phase = 3;
+        if (b & B_FALSE) {
+            fprintf(output, "LABEL $&&or_first_false%u\n", f->id);
+            f->evaluated = truth_needs_evaluation(exprs, EXPR_CHILD(exprs, ex, 1));
+            f->phase = 2;
+            if (f->evaluated) return evaluate_child(f, next, EXPR_CHILD(exprs, ex, 1), 2);
+        }
     }
-    if (b & B_FALSE) {
-        fprintf(output, "LABEL $&&or_first_false%u\n", expr_id);
-        b = generate_truth_assessment(output, ex->params[1], "$&&or_true", "$&&or_false", expr_id);
+    if (f->phase == 2) {
+        b = generate_truth_jumps(output, exprs, EXPR_CHILD(exprs, ex, 1), f->evaluated, "$&&or_true", "$&&or_false", f->id);
         if (b & B_TRUE) {
             fprintf(output, "LABEL $&&or_true%u\n"
                             "PUSHS bool@true\n"
                             "JUMP $&&or_end%u\n",
-                            expr_id, expr_id);
+                            f->id, f->id);
         }
         if (b & B_FALSE) {
             fprintf(output, "LABEL $&&or_false%u\n"
                             "PUSHS bool@false\n",
-                            expr_id);
+                            f->id);
         }
     }
-    fprintf(output, "LABEL $&&or_end%u\n", expr_id);
+    fprintf(output, "LABEL $&&or_end%u\n", f->id);
     return OK;
 }
 
-ErrorCode generate_is_expr(FILE *output, AstExpression *ex) {
-    CG_ASSERT(ex->params[1]->type == EX_DATA_TYPE);
-    DataType expr_type = ex->params[0]->assumed_type;
-    DataType checked_type = ex->params[1]->data_type;
-    if (expr_type == checked_type) {
-        // Types are the same, we can just push true
+ErrorCode generate_is_expr(FILE *output, AstExprs *exprs, EvalFrame *f, ExprId *next) {
+    ExprId ex = f->ex;
+    CG_ASSERT(EXPR_TYPE(exprs, EXPR_CHILD(exprs, ex, 1)) == EX_DATA_TYPE);
+    DataType expr_type = EXPR_ASSUMED_TYPE(exprs, EXPR_CHILD(exprs, ex, 0));
+    DataType checked_type = EXPR_DATA_TYPE(exprs, EXPR_CHILD(exprs, ex, 1));
+    if (expr_type == checked_type || expr_type != DT_UNKNOWN) {
+        // Types are known, so we can just push whether they are the same
         // Unless they have function calls, which we need to do
-        if (has_fun_call(ex->params[0])) {
-            generate_expression_evaluation(output, ex->params[0]);
-            fprintf(output, "POPS GF@&&inter1\n");
+        if (f->phase == 0) {
+            f->evaluated = has_fun_call(exprs, EXPR_CHILD(exprs, ex, 0));
+            if (f->evaluated) return evaluate_child(f, next, EXPR_CHILD(exprs, ex, 0), 1);
         }
-        fprintf(output, "PUSHS bool@true\n");
-        return OK;
-    }
-    if (expr_type != DT_UNKNOWN) {
-        // The type isn't uknown and it isn't the same, so we can push false
-        // Unless they have function calls, which we need to do
-        if (has_fun_call(ex->params[0])) {
-            generate_expression_evaluation(output, ex->params[0]);
+        if (f->evaluated) {
             fprintf(output, "POPS GF@&&inter1\n");
         }
-        fprintf(output, "PUSHS bool@false\n");
+        fprintf(output, "PUSHS bool@%s\n", expr_type == checked_type ? "true" : "false");
         return OK;
     }
-    CG_ASSERT(generate_expression_evaluation(output, ex->params[0]) == OK);
+    if (f->phase == 0) {
+        return evaluate_child(f, next, EXPR_CHILD(exprs, ex, 0), 1);
+    }
 
     fprintf(output, "TYPES\n");
 
     char *desired_type = NULL;
-    switch (ex->params[1]->data_type) {
+    switch (EXPR_DATA_TYPE(exprs, EXPR_CHILD(exprs, ex, 1))) {
     case DT_NULL:
         desired_type = "nil"; break;
     case DT_NUM:
@@ -315,24 +389,35 @@ ErrorCode generate_is_expr(FILE *output, AstExpression *ex) {
     return OK;
 }
 
-ErrorCode generate_ternary_expr(FILE *output, AstExpression *ex) {
-    unsigned expr_id = internal_names_cntr++;
-    AstExpression *cond = ex->params[0];
-    RequiredBranches b;
-    b = generate_truth_assessment(output, cond, "$&&ternary_true", "$&&ternary_false", expr_id);
-    if (b & B_TRUE) {
-        fprintf(output, "LABEL $&&ternary_true%u\n", expr_id);
-        CG_ASSERT(generate_expression_evaluation(output, ex->params[1]) == OK);
-        if (b & B_FALSE) {
-            // There is a false branch we have to skip
-            fprintf(output, "JUMP $&&ternary_end%u\n", expr_id);
+ErrorCode generate_ternary_expr(FILE *output, AstExprs *exprs, EvalFrame *f, ExprId *next) {
+    ExprId ex = f->ex;
+    ExprId cond = EXPR_CHILD(exprs, ex, 0);
+    if (f->phase == 0) {
+        f->id = internal_names_cntr++;
+        f->evaluated = truth_needs_evaluation(exprs, cond);
+        f->phase = 1;
+        if (f->evaluated) return evaluate_child(f, next, cond, 1);
+    }
+    if (f->phase == 1) {
+        f->branches = generate_truth_jumps(output, exprs, cond, f->evaluated, "$&&ternary_true", "$&&ternary_false", f->id);
+        f->phase = 2;
+        if (f->branches & B_TRUE) {
+            fprintf(output, "LABEL $&&ternary_true%u\n", f->id);
+            return evaluate_child(f, next, EXPR_CHILD(exprs, ex, 1), 2);
         }
     }
-    if (b & B_FALSE) {
-        fprintf(output, "LABEL $&&ternary_false%u\n", expr_id);
-        CG_ASSERT(generate_expression_evaluation(output, ex->params[2]) == OK);
+    if (f->phase == 2) {
+        if ((f->branches & B_TRUE) && (f->branches & B_FALSE)) {
+            // There is a false branch we have to skip
+            fprintf(output, "JUMP $&&ternary_end%u\n", f->id);
+        }
+        f->phase = 3;
+        if (f->branches & B_FALSE) {
+            fprintf(output, "LABEL $&&ternary_false%u\n", f->id);
+            return evaluate_child(f, next, EXPR_CHILD(exprs, ex, 2), 3);
+        }
     }
-    fprintf(output, "LABEL $&&ternary_end%u\n", expr_id);
+    fprintf(output, "LABEL $&&ternary_end%u\n", f->id);
 
     internal_names_cntr++;
     return OK;
@@ -341,6 +426,8 @@ ErrorCode generate_ternary_expr(FILE *output, AstExpression *ex) {
 ErrorCode convert_string(char *input, String **out) {
     String *str = str_init();
     CG_ASSERT(str != NULL);
+    // Most characters are copied as they are
+    CG_ASSERT(str_reserve(str, strlen(input)));
     for (unsigned i = 0; input[i] != '\0'; i++) {
         unsigned char c = input[i];
         if (c > 32 && c != 35 && c != 92) {
@@ -349,21 +436,18 @@ ErrorCode convert_string(char *input, String **out) {
             continue;
         }
         // Others - print their escape sequence
-        char buf[4];
-        CG_ASSERT(snprintf(buf, 4, "%03d", c) <= 4);
-        CG_ASSERT(str_append_char(str, '\\'));
-        CG_ASSERT(str_append_string(str, buf));
+        char buf[5];
+        CG_ASSERT(snprintf(buf, 5, "\\%03d", c) == 4);
+        CG_ASSERT(str_append_n(str, buf, 4));
     }
     *out = str;
     return OK;
 }
 
-/// Generates code for Ifj.str
-ErrorCode generate_builtin_str(FILE *output, AstExpression *ex) {
-    // Push parameter
-    CG_ASSERT(generate_expression_evaluation(output, ex->params[0]) == OK);
+/// Generates code for Ifj.str, the parameter is on the top of the stack
+ErrorCode generate_builtin_str(FILE *output, AstExprs *exprs, ExprId ex) {
     unsigned expr_id = internal_names_cntr++;
-    unsigned type = ex->params[0]->assumed_type;
+    unsigned type = EXPR_ASSUMED_TYPE(exprs, EXPR_CHILD(exprs, ex, 0));
 
     if (type == DT_STRING) {
         // We don't need to do anything for strings
@@ -414,7 +498,7 @@ ErrorCode generate_builtin_str(FILE *output, AstExpression *ex) {
     // Generate num branch
     if (type == DT_NUM || type == DT_UNKNOWN) {
         fprintf(output, "LABEL $&&ifj_str_float%u\n", expr_id);
-        if (ex->params[0]->surely_int) {
+        if (EXPR_SURELY_INT(exprs, EXPR_CHILD(exprs, ex, 0))) {
             fprintf(output, "PUSHS GF@&&inter1\n"
                             "FLOAT2INTS\n"
                             "INT2STRS\n");
@@ -437,11 +521,9 @@ ErrorCode generate_builtin_str(FILE *output, AstExpression *ex) {
     return OK;
 }
 
-/// Generates code for Ifj.write
-ErrorCode generate_builtin_write(FILE *output, AstExpression *ex) {
-    // Push parameter
-    CG_ASSERT(generate_expression_evaluation(output, ex->params[0]) == OK);
-    unsigned type = ex->params[0]->assumed_type;
+/// Generates code for Ifj.write, the parameter is on the top of the stack
+ErrorCode generate_builtin_write(FILE *output, AstExprs *exprs, ExprId ex) {
+    unsigned type = EXPR_ASSUMED_TYPE(exprs, EXPR_CHILD(exprs, ex, 0));
     unsigned expr_id = internal_names_cntr++;
     fprintf(output, "POPS GF@&&inter1\n");
     if (type == DT_UNKNOWN) {
@@ -453,7 +535,7 @@ ErrorCode generate_builtin_write(FILE *output, AstExpression *ex) {
                         expr_id);
     }
     if (type == DT_NUM || type == DT_UNKNOWN) {
-        if (!ex->params[0]->surely_int) {
+        if (!EXPR_SURELY_INT(exprs, EXPR_CHILD(exprs, ex, 0))) {
             fprintf(output, "PUSHS GF@&&inter1\n"
                             "ISINTS\n"
                             "PUSHS bool@false\n"
@@ -469,15 +551,13 @@ ErrorCode generate_builtin_write(FILE *output, AstExpression *ex) {
     return OK;
 }
 
-/// Generates code for Ifj.floor
-ErrorCode generate_builtin_floor(FILE *output, AstExpression *ex) {
-    // Push parameter
-    CG_ASSERT(generate_expression_evaluation(output, ex->params[0]) == OK);
-    if (ex->params[0]->surely_int) {
+/// Generates code for Ifj.floor, the parameter is on the top of the stack
+ErrorCode generate_builtin_floor(FILE *output, AstExprs *exprs, ExprId ex) {
+    if (EXPR_SURELY_INT(exprs, EXPR_CHILD(exprs, ex, 0))) {
         // We don't need to do anything if the argument is already an integer
         return OK;
     }
-    if (ex->params[0]->assumed_type == DT_NUM) {
+    if (EXPR_ASSUMED_TYPE(exprs, EXPR_CHILD(exprs, ex, 0)) == DT_NUM) {
         fprintf(output, "FLOAT2INTS\n"
                         "INT2FLOATS\n");
         return OK;
@@ -490,18 +570,11 @@ ErrorCode generate_builtin_floor(FILE *output, AstExpression *ex) {
     return OK;
 }
 
-/// Generates code for Ifj.length
-ErrorCode generate_builtin_length(FILE *output, AstExpression *ex) {
-    AstExpression *param = ex->params[0];
-    if (param->assumed_type == DT_STRING && param->val_known) {
-        fprintf(output, "PUSHS float@%a\n", (double)strlen(param->string_val->val));
-        return OK;
-    }
-    // Push parameter
-    CG_ASSERT(generate_expression_evaluation(output, ex->params[0]) == OK);
-
+/// Generates code for Ifj.length, the parameter is on the top of the stack
+ErrorCode generate_builtin_length(FILE *output, AstExprs *exprs, ExprId ex) {
+    ExprId param = EXPR_CHILD(exprs, ex, 0);
     fprintf(output, "POPS GF@&&inter1\n");
-    if (param->assumed_type != DT_STRING) {
+    if (EXPR_ASSUMED_TYPE(exprs, param) != DT_STRING) {
         generate_var_type_check(output, "GF@&&inter1", "string", 25);
     }
     fprintf(output, "STRLEN GF@&&inter2 GF@&&inter1\n"
@@ -510,42 +583,38 @@ ErrorCode generate_builtin_length(FILE *output, AstExpression *ex) {
     return OK;
 }
 
-/// Generates code for Ifj.substring
-ErrorCode generate_builtin_substring(FILE *output, AstExpression *ex) {
-    AstExpression *str = ex->params[0];
-    AstExpression *start = ex->params[1];
-    AstExpression *end = ex->params[2];
+/// Generates code for Ifj.substring, the parameters are on the top of the stack
+ErrorCode generate_builtin_substring(FILE *output, AstExprs *exprs, ExprId ex) {
+    ExprId str = EXPR_CHILD(exprs, ex, 0);
+    ExprId start = EXPR_CHILD(exprs, ex, 1);
+    ExprId end = EXPR_CHILD(exprs, ex, 2);
     // Type checks
-    CG_ASSERT(generate_expression_evaluation(output, str) == OK);
-    CG_ASSERT(generate_expression_evaluation(output, start) == OK);
-    CG_ASSERT(generate_expression_evaluation(output, end) == OK);
-
     fprintf(output, "POPS GF@&&inter3\n");
-    if (end->assumed_type == DT_UNKNOWN) {
+    if (EXPR_ASSUMED_TYPE(exprs, end) == DT_UNKNOWN) {
         generate_var_type_check(output, "GF@&&inter3", "float", 25);
-    } else if (end->assumed_type != DT_NUM) {
+    } else if (EXPR_ASSUMED_TYPE(exprs, end) != DT_NUM) {
         fprintf(output, "EXIT int@25\n"); // Shouldn't happen
     }
-    if (!start->surely_int) {
+    if (!EXPR_SURELY_INT(exprs, start)) {
         generate_var_int_check(output, "GF@&&inter3", 26);
     }
     fprintf(output, "FLOAT2INT GF@&&inter3 GF@&&inter3\n");
 
     fprintf(output, "POPS GF@&&inter2\n");
-    if (start->assumed_type == DT_UNKNOWN) {
+    if (EXPR_ASSUMED_TYPE(exprs, start) == DT_UNKNOWN) {
         generate_var_type_check(output, "GF@&&inter2", "float", 25);
-    } else if (start->assumed_type != DT_NUM) {
+    } else if (EXPR_ASSUMED_TYPE(exprs, start) != DT_NUM) {
         fprintf(output, "EXIT int@25\n"); // Shouldn't happen
     }
-    if (!start->surely_int) {
+    if (!EXPR_SURELY_INT(exprs, start)) {
         generate_var_int_check(output, "GF@&&inter2", 26);
     }
     fprintf(output, "FLOAT2INT GF@&&inter2 GF@&&inter2\n");
 
     fprintf(output, "POPS GF@&&inter1\n");
-    if (str->assumed_type == DT_UNKNOWN) {
+    if (EXPR_ASSUMED_TYPE(exprs, str) == DT_UNKNOWN) {
         generate_var_type_check(output, "GF@&&inter1", "string", 25);
-    } else if (str->assumed_type != DT_STRING) {
+    } else if (EXPR_ASSUMED_TYPE(exprs, str) != DT_STRING) {
         fprintf(output, "EXIT int@25\n"); // Shouldn't happen
     }
 
@@ -582,25 +651,21 @@ ErrorCode generate_builtin_substring(FILE *output, AstExpression *ex) {
     return OK;
 }
 
-/// Generates code for Ifj.strcmp
-ErrorCode generate_builtin_strcmp(FILE *output, AstExpression *ex) {
-    AstExpression *str1 = ex->params[0];
-    AstExpression *str2 = ex->params[1];
+/// Generates code for Ifj.strcmp, the parameters are on the top of the stack
+ErrorCode generate_builtin_strcmp(FILE *output, AstExprs *exprs, ExprId ex) {
+    ExprId str1 = EXPR_CHILD(exprs, ex, 0);
     // Type checks
-    CG_ASSERT(generate_expression_evaluation(output, str1) == OK);
-    CG_ASSERT(generate_expression_evaluation(output, str2) == OK);
-
     fprintf(output, "POPS GF@&&inter2\n");
-    if (str1->assumed_type == DT_UNKNOWN) {
+    if (EXPR_ASSUMED_TYPE(exprs, str1) == DT_UNKNOWN) {
         generate_var_type_check(output, "GF@&&inter2", "string", 25);
-    } else if (str1->assumed_type != DT_STRING) {
+    } else if (EXPR_ASSUMED_TYPE(exprs, str1) != DT_STRING) {
         fprintf(output, "EXIT int@25\n"); // Shouldn't happen
     }
 
     fprintf(output, "POPS GF@&&inter1\n");
-    if (str1->assumed_type == DT_UNKNOWN) {
+    if (EXPR_ASSUMED_TYPE(exprs, str1) == DT_UNKNOWN) {
         generate_var_type_check(output, "GF@&&inter1", "string", 25);
-    } else if (str1->assumed_type != DT_STRING) {
+    } else if (EXPR_ASSUMED_TYPE(exprs, str1) != DT_STRING) {
         fprintf(output, "EXIT int@25\n"); // Shouldn't happen
     }
 
@@ -642,66 +707,104 @@ ErrorCode generate_builtin_strcmp(FILE *output, AstExpression *ex) {
     return OK;
 }
 
-ErrorCode generate_builtin_function_call(FILE *output, AstExpression *ex) {
-    if (strcmp(ex->string_val->val, "write") == 0) {
-        CG_ASSERT(ex->child_count == 1);
-        generate_builtin_write(output, ex);
-        return OK;
-    }
-    else if (strcmp(ex->string_val->val, "read_str") == 0) {
-        CG_ASSERT(ex->child_count == 0);
-        fprintf(output, "READ GF@&&inter1 string\n"
-                        "PUSHS GF@&&inter1\n");
-        return OK;
+ErrorCode generate_builtin_function_call(FILE *output, AstExprs *exprs, EvalFrame *f, ExprId *next) {
+    ExprId ex = f->ex;
+    if (f->phase == 0) {
+        // Builtins without arguments or with a known result are generated right away,
+        // the others once their arguments are pushed
+        if (strcmp(EXPR_IDENT(exprs, ex)->val, "write") == 0) {
+            CG_ASSERT(EXPR_CHILD_COUNT(exprs, ex) == 1);
+            f->builtin = BI_WRITE;
+        }
+        else if (strcmp(EXPR_IDENT(exprs, ex)->val, "read_str") == 0) {
+            CG_ASSERT(EXPR_CHILD_COUNT(exprs, ex) == 0);
+            fprintf(output, "READ GF@&&inter1 string\n"
+                            "PUSHS GF@&&inter1\n");
+            return OK;
+        }
+        else if (strcmp(EXPR_IDENT(exprs, ex)->val, "read_num") == 0) {
+            CG_ASSERT(EXPR_CHILD_COUNT(exprs, ex) == 0);
+            fprintf(output, "READ GF@&&inter1 float\n"
+                            "PUSHS GF@&&inter1\n");
+            return OK;
+        }
+        else if (strcmp(EXPR_IDENT(exprs, ex)->val, "read_bool") == 0) {
+            CG_ASSERT(EXPR_CHILD_COUNT(exprs, ex) == 0);
+            fprintf(output, "READ GF@&&inter1 bool\n"
+                            "PUSHS GF@&&inter1\n");
+            return OK;
+        }
+        else if (strcmp(EXPR_IDENT(exprs, ex)->val, "floor") == 0) {
+            CG_ASSERT(EXPR_CHILD_COUNT(exprs, ex) == 1);
+            f->builtin = BI_FLOOR;
+        }
+        else if (strcmp(EXPR_IDENT(exprs, ex)->val, "str") == 0) {
+            CG_ASSERT(EXPR_CHILD_COUNT(exprs, ex) == 1);
+            f->builtin = BI_STR;
+        }
+        else if (strcmp(EXPR_IDENT(exprs, ex)->val, "length") == 0) {
+            CG_ASSERT(EXPR_CHILD_COUNT(exprs, ex) == 1);
+            ExprId param = EXPR_CHILD(exprs, ex, 0);
+            if (EXPR_ASSUMED_TYPE(exprs, param) == DT_STRING && EXPR_VAL_KNOWN(exprs, param)) {
+                fprintf(output, "PUSHS float@%a\n", (double)strlen(EXPR_STRING(exprs, param)->val));
+                return OK;
+            }
+            f->builtin = BI_LENGTH;
+        }
+        else if (strcmp(EXPR_IDENT(exprs, ex)->val, "substring") == 0) {
+            CG_ASSERT(EXPR_CHILD_COUNT(exprs, ex) == 3);
+            f->builtin = BI_SUBSTRING;
+        }
+        else if (strcmp(EXPR_IDENT(exprs, ex)->val, "strcmp") == 0) {
+            CG_ASSERT(EXPR_CHILD_COUNT(exprs, ex) == 2);
+            f->builtin = BI_STRCMP;
+        }
+        else if (strcmp(EXPR_IDENT(exprs, ex)->val, "ord") == 0) {
+            CG_ASSERT(EXPR_CHILD_COUNT(exprs, ex) == 2);
+            f->builtin = BI_ORD;
+        }
+        else if (strcmp(EXPR_IDENT(exprs, ex)->val, "chr") == 0) {
+            CG_ASSERT(EXPR_CHILD_COUNT(exprs, ex) == 1);
+            f->builtin = BI_CHR;
+        }
+        else {
+            return INTERNAL_ERROR;
+        }
     }
-    else if (strcmp(ex->string_val->val, "read_num") == 0) {
-        CG_ASSERT(ex->child_count == 0);
-        fprintf(output, "READ GF@&&inter1 float\n"
-                        "PUSHS GF@&&inter1\n");
-        return OK;
+
+    // Push parameters
+    if (f->phase < EXPR_CHILD_COUNT(exprs, ex)) {
+        return evaluate_child(f, next, EXPR_CHILD(exprs, ex, f->phase), f->phase + 1);
     }
-    else if (strcmp(ex->string_val->val, "read_bool") == 0) {
-        CG_ASSERT(ex->child_count == 0);
-        fprintf(output, "READ GF@&&inter1 bool\n"
-                        "PUSHS GF@&&inter1\n");
+
+    unsigned expr_id;
+    switch (f->builtin) {
+    case BI_WRITE:
+        generate_builtin_write(output, exprs, ex);
         return OK;
-    }
-    else if (strcmp(ex->string_val->val, "floor") == 0) {
-        CG_ASSERT(ex->child_count == 1);
-        return generate_builtin_floor(output, ex);
-    }
-    else if (strcmp(ex->string_val->val, "str") == 0) {
-        CG_ASSERT(ex->child_count == 1);
-        return generate_builtin_str(output, ex);
-    }
-    else if (strcmp(ex->string_val->val, "length") == 0) {
-        CG_ASSERT(ex->child_count == 1);
-        return generate_builtin_length(output, ex);
-    }
-    else if (strcmp(ex->string_val->val, "substring") == 0) {
-        CG_ASSERT(ex->child_count == 3);
-        return generate_builtin_substring(output, ex);
-    }
-    else if (strcmp(ex->string_val->val, "strcmp") == 0) {
-        CG_ASSERT(ex->child_count == 2);
-        return generate_builtin_strcmp(output, ex);
-    }
-    else if (strcmp(ex->string_val->val, "ord") == 0) {
-        CG_ASSERT(ex->child_count == 2);
-        CG_ASSERT(generate_expression_evaluation(output, ex->params[0]) == OK);
-        CG_ASSERT(generate_expression_evaluation(output, ex->params[1]) == OK);
-        unsigned expr_id = internal_names_cntr++;
+    case BI_FLOOR:
+        return generate_builtin_floor(output, exprs, ex);
+    case BI_STR:
+        return generate_builtin_str(output, exprs, ex);
+    case BI_LENGTH:
+        return generate_builtin_length(output, exprs, ex);
+    case BI_SUBSTRING:
+        return generate_builtin_substring(output, exprs, ex);
+    case BI_STRCMP:
+        return generate_builtin_strcmp(output, exprs, ex);
+    case BI_ORD:
+        expr_id = internal_names_cntr++;
         fprintf(output, "POPS GF@&&inter2\n"
                         "POPS GF@&&inter1\n");
-        if (ex->params[0]->assumed_type == DT_UNKNOWN) {
+        if (EXPR_ASSUMED_TYPE(exprs, EXPR_CHILD(exprs, ex, 0)) == DT_UNKNOWN) {
             generate_var_type_check(output, "GF@&&inter1", "string", 25);
-        } else if (ex->params[0]->assumed_type != DT_STRING) {
+        } else if (EXPR_ASSUMED_TYPE(exprs, EXPR_CHILD(exprs, ex, 0)) != DT_STRING) {
             fprintf(output, "EXIT int@25\n"); // Shouldn't happen
             return OK;
         }
-        if (ex->params[1]->assumed_type == DT_UNKNOWN) {
+        if (EXPR_ASSUMED_TYPE(exprs, EXPR_CHILD(exprs, ex, 1)) == DT_UNKNOWN) {
             generate_var_type_check(output, "GF@&&inter2", "float", 25);
-        } else if (ex->params[1]->assumed_type != DT_NUM) {
+        } else if (EXPR_ASSUMED_TYPE(exprs, EXPR_CHILD(exprs, ex, 1)) != DT_NUM) {
             fprintf(output, "EXIT int@25\n"); // Shouldn't happen
             return OK;
         }
@@ -727,15 +830,12 @@ ErrorCode generate_builtin_function_call(FILE *output, AstExpression *ex) {
                         "PUSHS float@0x0p+0\n"
                         "LABEL $&&ifj_ord_end%u\n",
                         expr_id, expr_id, expr_id, expr_id, expr_id);
-    }
-    else if (strcmp(ex->string_val->val, "chr") == 0) {
-        CG_ASSERT(ex->child_count == 1);
-        CG_ASSERT(generate_expression_evaluation(output, ex->params[0]) == OK);
-
+        return OK;
+    case BI_CHR:
         fprintf(output, "POPS GF@&&inter1\n");
-        if (ex->params[0]->assumed_type == DT_UNKNOWN) {
+        if (EXPR_ASSUMED_TYPE(exprs, EXPR_CHILD(exprs, ex, 0)) == DT_UNKNOWN) {
             generate_var_type_check(output, "GF@&&inter1", "float", 25);
-        } else if (ex->params[0]->assumed_type != DT_NUM) {
+        } else if (EXPR_ASSUMED_TYPE(exprs, EXPR_CHILD(exprs, ex, 0)) != DT_NUM) {
             fprintf(output, "EXIT int@25\n"); // Shouldn't happen
             return OK;
         }
@@ -743,48 +843,43 @@ ErrorCode generate_builtin_function_call(FILE *output, AstExpression *ex) {
         fprintf(output, "PUSHS GF@&&inter1\n"
                         "FLOAT2INTS\n"
                         "INT2CHARS\n");
+        return OK;
     }
-    else {
-        return INTERNAL_ERROR;
-    }
-    return OK;
+    return INTERNAL_ERROR;
 }
 
-/// Generates code for applying an arithmetic operation to two expressions of known Num types
-ErrorCode generate_arithmetic_with_known_type(FILE *output, AstExpression *ex, char *stack_op) {
-    // Left side
-    CG_ASSERT(generate_expression_evaluation(output, ex->params[0]) == OK);
-
-    // Right side
-    CG_ASSERT(generate_expression_evaluation(output, ex->params[1]) == OK);
-    fprintf(output, "%s\n", stack_op);
-    return OK;
-}
+ErrorCode generate_add_expression(FILE *output, AstExprs *exprs, EvalFrame *f, ExprId *next) {
+    ExprId ex = f->ex;
+    DataType left_type = EXPR_ASSUMED_TYPE(exprs, EXPR_CHILD(exprs, ex, 0));
+    DataType right_type = EXPR_ASSUMED_TYPE(exprs, EXPR_CHILD(exprs, ex, 1));
+    bool known_types = (left_type == DT_NUM && right_type == DT_NUM) ||
+                       (left_type == DT_STRING && right_type == DT_STRING);
+    if (f->phase == 0 && !known_types) {
+        if (left_type != DT_UNKNOWN && right_type != DT_UNKNOWN) {
+            // Should be caught during semantic checks
+            fprintf(output, "EXIT int@26\n");
+            return OK;
+        }
+        f->id = internal_names_cntr++;
+    }
+    // Push both operands
+    if (f->phase < 2) {
+        return evaluate_child(f, next, EXPR_CHILD(exprs, ex, f->phase), f->phase + 1);
+    }
 
-ErrorCode generate_add_expression(FILE *output, AstExpression *ex) {
-    DataType left_type = ex->params[0]->assumed_type;
-    DataType right_type = ex->params[1]->assumed_type;
     // Known data types
     if (left_type == DT_NUM && right_type == DT_NUM) {
-        return generate_arithmetic_with_known_type(output, ex, "ADDS");
+        fprintf(output, "ADDS\n");
+        return OK;
     }
     if (left_type == DT_STRING && right_type == DT_STRING) {
-        CG_ASSERT(generate_expression_evaluation(output, ex->params[0]) == OK);
-        CG_ASSERT(generate_expression_evaluation(output, ex->params[1]) == OK);
         fprintf(output, "POPS GF@&&inter2\n"
                         "POPS GF@&&inter1\n"
                         "CONCAT GF@&&inter3 GF@&&inter1 GF@&&inter2\n"
                         "PUSHS GF@&&inter3\n");
         return OK;
     }
-    if (left_type != DT_UNKNOWN && right_type != DT_UNKNOWN) {
-        // Should be caught during semantic checks
-        fprintf(output, "EXIT int@26\n");
-        return OK;
-    }
-    unsigned expr_id = internal_names_cntr++;
-    CG_ASSERT(generate_expression_evaluation(output, ex->params[0]) == OK);
-    CG_ASSERT(generate_expression_evaluation(output, ex->params[1]) == OK);
+    unsigned expr_id = f->id;
     // Unknown data types
     if (left_type == DT_STRING || right_type == DT_STRING) {
         // One is string -> check if other is string
@@ -875,17 +970,31 @@ void generate_string_iteration(FILE *output) {
                     expr_id, expr_id, expr_id, expr_id);
 }
 
-ErrorCode generate_mul_expression(FILE *output, AstExpression *ex) {
-    DataType left_type = ex->params[0]->assumed_type;
-    DataType right_type = ex->params[1]->assumed_type;
+ErrorCode generate_mul_expression(FILE *output, AstExprs *exprs, EvalFrame *f, ExprId *next) {
+    ExprId ex = f->ex;
+    DataType left_type = EXPR_ASSUMED_TYPE(exprs, EXPR_CHILD(exprs, ex, 0));
+    DataType right_type = EXPR_ASSUMED_TYPE(exprs, EXPR_CHILD(exprs, ex, 1));
+    if (f->phase == 0 && !(left_type == DT_NUM && right_type == DT_NUM)) {
+        f->id = internal_names_cntr++;
+        if (!(left_type == DT_STRING && right_type == DT_NUM) &&
+            left_type != DT_UNKNOWN && right_type != DT_UNKNOWN) {
+            // Should be caught during semantic checks
+            fprintf(output, "EXIT int@26\n");
+            return OK;
+        }
+    }
+    // Push both operands
+    if (f->phase < 2) {
+        return evaluate_child(f, next, EXPR_CHILD(exprs, ex, f->phase), f->phase + 1);
+    }
+
     // Known data types
     if (left_type == DT_NUM && right_type == DT_NUM) {
-        return generate_arithmetic_with_known_type(output, ex, "MULS");
+        fprintf(output, "MULS\n");
+        return OK;
     }
-    unsigned expr_id = internal_names_cntr++;
+    unsigned expr_id = f->id;
     if (left_type == DT_STRING && right_type == DT_NUM) {
-        CG_ASSERT(generate_expression_evaluation(output, ex->params[0]) == OK);
-        CG_ASSERT(generate_expression_evaluation(output, ex->params[1]) == OK);
         fprintf(output, "POPS GF@&&inter2\n"
                         "POPS GF@&&inter1\n");
         generate_var_int_check(output, "GF@&&inter2", 26);
@@ -893,14 +1002,7 @@ ErrorCode generate_mul_expression(FILE *output, AstExpression *ex) {
         fprintf(output, "PUSHS GF@&&inter3\n");
         return OK;
     }
-    if (left_type != DT_UNKNOWN && right_type != DT_UNKNOWN) {
-        // Should be caught during semantic checks
-        fprintf(output, "EXIT int@26\n");
-        return OK;
-    }
     // Unknown data types
-    CG_ASSERT(generate_expression_evaluation(output, ex->params[0]) == OK);
-    CG_ASSERT(generate_expression_evaluation(output, ex->params[1]) == OK);
     fprintf(output, "POPS GF@&&inter2\n"
                     "POPS GF@&&inter1\n");
     if (left_type == DT_UNKNOWN) {
@@ -942,20 +1044,25 @@ ErrorCode generate_mul_expression(FILE *output, AstExpression *ex) {
     return OK;
 }
 
-ErrorCode generate_binary_operator_with_floats(FILE *output, AstExpression *ex, char *stack_op) {
-    DataType left_type = ex->params[0]->assumed_type;
-    DataType right_type = ex->params[1]->assumed_type;
+ErrorCode generate_binary_operator_with_floats(FILE *output, AstExprs *exprs, EvalFrame *f, ExprId *next, char *stack_op) {
+    ExprId ex = f->ex;
+    DataType left_type = EXPR_ASSUMED_TYPE(exprs, EXPR_CHILD(exprs, ex, 0));
+    DataType right_type = EXPR_ASSUMED_TYPE(exprs, EXPR_CHILD(exprs, ex, 1));
 
     // Left side
-    CG_ASSERT(generate_expression_evaluation(output, ex->params[0]) == OK);
-    if (left_type == DT_UNKNOWN) {
-        // Check if left is float or int and convert to float
-        generate_stack_type_check(output, "float", 26);
+    if (f->phase == 0) {
+        return evaluate_child(f, next, EXPR_CHILD(exprs, ex, 0), 1);
     }
-    CG_ASSERT(left_type == DT_UNKNOWN || left_type == DT_NUM);
+    if (f->phase == 1) {
+        if (left_type == DT_UNKNOWN) {
+            // Check if left is float or int and convert to float
+            generate_stack_type_check(output, "float", 26);
+        }
+        CG_ASSERT(left_type == DT_UNKNOWN || left_type == DT_NUM);
 
-    // Right side
-    CG_ASSERT(generate_expression_evaluation(output, ex->params[1]) == OK);
+        // Right side
+        return evaluate_child(f, next, EXPR_CHILD(exprs, ex, 1), 2);
+    }
     if (right_type == DT_UNKNOWN) {
         // Check if right is float or int and convert to float
         generate_stack_type_check(output, "float", 26);
@@ -967,27 +1074,37 @@ ErrorCode generate_binary_operator_with_floats(FILE *output, AstExpression *ex,
     return OK;
 }
 
-ErrorCode generate_equals_expression(FILE *output, AstExpression *ex) {
-    DataType left_type = ex->params[0]->assumed_type;
-    DataType right_type = ex->params[1]->assumed_type;
+ErrorCode generate_equals_expression(FILE *output, AstExprs *exprs, EvalFrame *f, ExprId *next) {
+    ExprId ex = f->ex;
+    DataType left_type = EXPR_ASSUMED_TYPE(exprs, EXPR_CHILD(exprs, ex, 0));
+    DataType right_type = EXPR_ASSUMED_TYPE(exprs, EXPR_CHILD(exprs, ex, 1));
     // Both types known and not the same -> false
     if (left_type != right_type && left_type != DT_UNKNOWN && right_type != DT_UNKNOWN) {
-        if (has_fun_call(ex->params[0])) {
-            // We still have to evaluate the expression if it has a function call
-            generate_expression_evaluation(output, ex->params[0]);
-            fprintf(output, "POPS GF@&&inter1\n");
+        // We still have to evaluate the operands if they have a function call
+        if (f->phase == 0) {
+            f->evaluated = has_fun_call(exprs, EXPR_CHILD(exprs, ex, 0));
+            f->phase = 1;
+            if (f->evaluated) return evaluate_child(f, next, EXPR_CHILD(exprs, ex, 0), 1);
         }
-        if (has_fun_call(ex->params[1])) {
-            // We still have to evaluate the expression if it has a function call
-            generate_expression_evaluation(output, ex->params[1]);
+        if (f->phase == 1) {
+            if (f->evaluated) {
+                fprintf(output, "POPS GF@&&inter1\n");
+            }
+            f->evaluated = has_fun_call(exprs, EXPR_CHILD(exprs, ex, 1));
+            f->phase = 2;
+            if (f->evaluated) return evaluate_child(f, next, EXPR_CHILD(exprs, ex, 1), 2);
+        }
+        if (f->evaluated) {
             fprintf(output, "POPS GF@&&inter1\n");
         }
         fprintf(output, "PUSHS bool@false\n");
         return OK;
     }
 
-    CG_ASSERT(generate_expression_evaluation(output, ex->params[0]) == OK);
-    CG_ASSERT(generate_expression_evaluation(output, ex->params[1]) == OK);
+    // Push both operands
+    if (f->phase < 2) {
+        return evaluate_child(f, next, EXPR_CHILD(exprs, ex, f->phase), f->phase + 1);
+    }
 
     if (left_type == right_type && left_type != DT_UNKNOWN && right_type != DT_UNKNOWN) {
         fprintf(output, "EQS\n");
@@ -1032,22 +1149,22 @@ ErrorCode generate_equals_expression(FILE *output, AstExpression *ex) {
     return OK;
 }
 
-ErrorCode push_known_value(FILE *output, AstExpression *ex) {
+ErrorCode push_known_value(FILE *output, AstExprs *exprs, ExprId ex) {
     String *converted_string;
-    switch (ex->assumed_type) {
+    switch (EXPR_ASSUMED_TYPE(exprs, ex)) {
     case DT_NULL:
         fprintf(output, "PUSHS nil@nil\n");
         break;
     case DT_NUM:
-        fprintf(output, "PUSHS float@%a\n", ex->double_val);
+        fprintf(output, "PUSHS float@%a\n", EXPR_DOUBLE(exprs, ex));
         break;
     case DT_STRING:
-        CG_ASSERT(convert_string(ex->string_val->val, &converted_string) == OK);
+        CG_ASSERT(convert_string(EXPR_STRING(exprs, ex)->val, &converted_string) == OK);
         fprintf(output, "PUSHS string@%s\n", converted_string->val);
         str_free(&converted_string);
         break;
     case DT_BOOL:
-        fprintf(output, "PUSHS bool@%s\n", ex->bool_val ? "true" : "false");
+        fprintf(output, "PUSHS bool@%s\n", EXPR_BOOL(exprs, ex) ? "true" : "false");
         break;
     case DT_UNKNOWN:
     case DT_TYPE:
@@ -1056,105 +1173,153 @@ ErrorCode push_known_value(FILE *output, AstExpression *ex) {
     return OK;
 }
 
-ErrorCode generate_expression_evaluation(FILE *output, AstExpression *st) {
-    if (st->val_known) {
-        ErrorCode ec = push_known_value(output, st);
+/// Generates the code of an expression node up to its next child that has to be evaluated
+static ErrorCode generate_expression_step(FILE *output, AstExprs *exprs, EvalFrame *f, ExprId *next) {
+    ExprId st = f->ex;
+    if (f->phase == 0 && EXPR_VAL_KNOWN(exprs, st)) {
+        ErrorCode ec = push_known_value(output, exprs, st);
         if (ec == OK) return OK;
     }
     String *str; // Used for string literals
-    switch (st->type) {
+    switch (EXPR_TYPE(exprs, st)) {
     case EX_ID:
-        fprintf(output, "PUSHS LF@%s\n", st->string_val->val);
+        fprintf(output, "PUSHS LF@%s?%d\n", EXPR_IDENT(exprs, st)->val, EXPR_SLOT(exprs, st));
         return OK;
     case EX_GLOBAL_ID:
-        fprintf(output, "PUSHS GF@%s\n", st->string_val->val);
+        fprintf(output, "PUSHS GF@%s\n", EXPR_IDENT(exprs, st)->val);
         return OK;
     case EX_GETTER:
-        fprintf(output, "CALL $%s$0\n", st->string_val->val);
+        fprintf(output, "CALL $%s!$0\n", EXPR_IDENT(exprs, st)->val);
         return OK;
     case EX_FUN:
-        return generate_function_call(output, st);
+        return generate_function_call(output, exprs, f, next);
     case EX_DOUBLE:
-        fprintf(output, "PUSHS float@%a\n", st->double_val);
+        fprintf(output, "PUSHS float@%a\n", EXPR_DOUBLE(exprs, st));
         return OK;
     case EX_BOOL:
-        fprintf(output, "PUSHS bool@%s\n", st->bool_val ? "true" : "false");
+        fprintf(output, "PUSHS bool@%s\n", EXPR_BOOL(exprs, st) ? "true" : "false");
         return OK;
     case EX_NULL:
         fprintf(output, "PUSHS nil@nil\n");
         return OK;
     case EX_TERNARY:
-        return generate_ternary_expr(output, st);
+        return generate_ternary_expr(output, exprs, f, next);
     case EX_NOT:
-        CG_ASSERT(generate_expression_evaluation(output, st->params[0]) == OK);
+        if (f->phase == 0) {
+            return evaluate_child(f, next, EXPR_CHILD(exprs, st, 0), 1);
+        }
         fprintf(output, "NOTS\n");
         return OK;
     case EX_IS:
-        return generate_is_expr(output, st);
+        return generate_is_expr(output, exprs, f, next);
     case EX_STRING:
-        CG_ASSERT(convert_string(st->string_val->val, &str) == OK);
+        CG_ASSERT(convert_string(EXPR_STRING(exprs, st)->val, &str) == OK);
         fprintf(output, "PUSHS string@%s\n", str->val);
         str_free(&str);
         return OK;
     case EX_NEGATE:
-        fprintf(output, "PUSHS float@0x0p+0\n");
-        CG_ASSERT(generate_expression_evaluation(output, st->params[0]) == OK);
+        if (f->phase == 0) {
+            fprintf(output, "PUSHS float@0x0p+0\n");
+            return evaluate_child(f, next, EXPR_CHILD(exprs, st, 0), 1);
+        }
         fprintf(output, "SUBS\n");
         return OK;
     case EX_DATA_TYPE:
         fprintf(output, "EXIT int@26\n");
         return OK;
     case EX_BUILTIN_FUN:
-        CG_ASSERT(generate_builtin_function_call(output, st) == OK);
+        CG_ASSERT(generate_builtin_function_call(output, exprs, f, next) == OK);
         return OK;
     case EX_AND:
-        return generate_and_expr(output, st);
+        return generate_and_expr(output, exprs, f, next);
     case EX_OR:
-        return generate_or_expr(output, st);
+        return generate_or_expr(output, exprs, f, next);
     case EX_ADD:
-        return generate_add_expression(output, st);
+        return generate_add_expression(output, exprs, f, next);
     case EX_MUL:
-        return generate_mul_expression(output, st);
+        return generate_mul_expression(output, exprs, f, next);
     case EX_SUB:
-        return generate_binary_operator_with_floats(output, st, "SUBS");
+        return generate_binary_operator_with_floats(output, exprs, f, next, "SUBS");
     case EX_DIV:
-        return generate_binary_operator_with_floats(output, st, "DIVS");
+        return generate_binary_operator_with_floats(output, exprs, f, next, "DIVS");
     case EX_GREATER:
-        return generate_binary_operator_with_floats(output, st, "GTS");
+        return generate_binary_operator_with_floats(output, exprs, f, next, "GTS");
     case EX_LESS:
-        return generate_binary_operator_with_floats(output, st, "LTS");
+        return generate_binary_operator_with_floats(output, exprs, f, next, "LTS");
     case EX_GREATER_EQ:
-        return generate_binary_operator_with_floats(output, st, "LTS\nNOTS");
+        return generate_binary_operator_with_floats(output, exprs, f, next, "LTS\nNOTS");
     case EX_LESS_EQ:
-        return generate_binary_operator_with_floats(output, st, "GTS\nNOTS");
+        return generate_binary_operator_with_floats(output, exprs, f, next, "GTS\nNOTS");
     case EX_EQ:
-        return generate_equals_expression(output, st);
+        return generate_equals_expression(output, exprs, f, next);
     case EX_NOT_EQ:
-        CG_ASSERT(generate_equals_expression(output, st) == OK);
-        fprintf(stdout, "NOTS\n");
+        CG_ASSERT(generate_equals_expression(output, exprs, f, next) == OK);
+        if (*next == EXPR_NONE) {
+            fprintf(output, "NOTS\n");
+        }
         return OK;
     }
     return INTERNAL_ERROR;
 }
 
-ErrorCode generate_var_assignment(FILE *output, char *scope, AstVariable *st) {
-    if (st->expression == NULL) return OK;
-    if (st->expression->val_known && !has_fun_call(st->expression)) {
-        AstExpression *expr = st->expression;
+ErrorCode generate_expression_evaluation(FILE *output, AstExprs *exprs, ExprId st) {
+    // The nodes on the path from the root are kept on an explicit stack,
+    // each node is stepped again after every child it asked for
+    EvalFrame inline_frames[_CG_INLINE_DEPTH];
+    CgStack stack = cg_stack_init(inline_frames, sizeof(EvalFrame), _CG_INLINE_DEPTH);
+    ErrorCode ec = OK;
+
+    *(EvalFrame *)cg_push(&stack) = (EvalFrame){ .ex = st };
+    while (stack.count > 0) {
+        ExprId next = EXPR_NONE;
+        ec = generate_expression_step(output, exprs, (EvalFrame *)stack.frames + stack.count - 1, &next);
+        if (ec != OK) break;
+
+        if (next == EXPR_NONE) {
+            stack.count--;
+            continue;
+        }
+        EvalFrame *child = cg_push(&stack);
+        if (child == NULL) {
+            ec = INTERNAL_ERROR;
+            break;
+        }
+        *child = (EvalFrame){ .ex = next };
+    }
+
+    cg_stack_free(&stack);
+    return ec;
+}
+
+/// Prints the variable in the frame, local variables are suffixed with their frame slot
+static void print_variable(FILE *output, const char *frame, const Ident *name, int slot) {
+    if (slot == SLOT_NONE || strcmp(frame, "GF") == 0) {
+        fprintf(output, "%s@%s", frame, name->val);
+    } else {
+        fprintf(output, "%s@%s?%d", frame, name->val, slot);
+    }
+}
+
+ErrorCode generate_var_assignment(FILE *output, AstExprs *exprs, char *frame, AstVariable *st) {
+    if (st->expression == EXPR_NONE) return OK;
+    if (EXPR_VAL_KNOWN(exprs, st->expression) && !has_fun_call(exprs, st->expression)) {
+        ExprId expr = st->expression;
         String *str;
         // We can assign directly without pushing and poping
-        fprintf(output, "MOVE %s@%s ", scope, st->name->val);
-        switch (expr->assumed_type) {
+        fprintf(output, "MOVE ");
+        print_variable(output, frame, st->name, st->slot);
+        fprintf(output, " ");
+        switch (EXPR_ASSUMED_TYPE(exprs, expr)) {
         case DT_NUM:
-            fprintf(output, "float@%a", expr->double_val);
+            fprintf(output, "float@%a", EXPR_DOUBLE(exprs, expr));
             break;
         case DT_STRING:
-            convert_string(expr->string_val->val, &str);
+            convert_string(EXPR_STRING(exprs, expr)->val, &str);
             fprintf(output, "string@%s", str->val);
             str_free(&str);
             break;
         case DT_BOOL:
-            fprintf(output, "bool@%s", expr->bool_val ? "true" : "false");
+            fprintf(output, "bool@%s", EXPR_BOOL(exprs, expr) ? "true" : "false");
             break;
         default:
             fprintf(output, "nil@nil");
@@ -1164,21 +1329,23 @@ ErrorCode generate_var_assignment(FILE *output, char *scope, AstVariable *st) {
 
         return OK;
     }
-    CG_ASSERT(generate_expression_evaluation(output, st->expression) == OK);
-    fprintf(output, "POPS %s@%s\n", scope, st->name->val);
+    CG_ASSERT(generate_expression_evaluation(output, exprs, st->expression) == OK);
+    fprintf(output, "POPS ");
+    print_variable(output, frame, st->name, st->slot);
+    fprintf(output, "\n");
     return OK;
 }
 
-ErrorCode generate_setter_assignment(FILE *output, AstVariable *st) {
-    CG_ASSERT(generate_expression_evaluation(output, st->expression) == OK);
+ErrorCode generate_setter_assignment(FILE *output, AstExprs *exprs, AstVariable *st) {
+    CG_ASSERT(generate_expression_evaluation(output, exprs, st->expression) == OK);
     fprintf(output, "CALL $%s*$1\n"
                     "POPS GF@&&inter1\n", st->name->val);
     return OK;
 }
 
-ErrorCode generate_return_statement(FILE *output, AstExpression *expr) {
-    if (expr != NULL) {
-        CG_ASSERT(generate_expression_evaluation(output, expr) == OK);
+ErrorCode generate_return_statement(FILE *output, AstExprs *exprs, ExprId expr) {
+    if (expr != EXPR_NONE) {
+        CG_ASSERT(generate_expression_evaluation(output, exprs, expr) == OK);
     } else {
         fprintf(output, "PUSHS nil@nil\n");
     }
@@ -1186,30 +1353,25 @@ ErrorCode generate_return_statement(FILE *output, AstExpression *expr) {
     return OK;
 }
 
-ErrorCode generate_statement(FILE *output, AstStatement *st) {
+/// Generates code for a statement without nested blocks
+static ErrorCode generate_simple_statement(FILE *output, AstExprs *exprs, AstStatement *st) {
     switch (st->type) {
-    case ST_BLOCK:
-        return generate_compound_statement(output, st->block);
-    case ST_IF:
-        return generate_if_statement(output, st->if_st);
-    case ST_WHILE:
-        return generate_while_statement(output, st->while_st);
     case ST_RETURN:
-        return generate_return_statement(output, st->return_expr);
+        return generate_return_statement(output, exprs, st->return_expr);
     case ST_LOCAL_VAR:
-        if (st->local_var->expression == NULL) {
-            fprintf(output, "MOVE LF@%s nil@nil\n", st->local_var->name->val);
+        if (st->local_var->expression == EXPR_NONE) {
+            fprintf(output, "MOVE LF@%s?%d nil@nil\n", st->local_var->name->val, st->local_var->slot);
             return OK;
         } else {
-            return generate_var_assignment(output, "LF", st->local_var);
+            return generate_var_assignment(output, exprs, "LF", st->local_var);
         }
     case ST_GLOBAL_VAR:
-        return generate_var_assignment(output, "GF", st->global_var);
+        return generate_var_assignment(output, exprs, "GF", st->global_var);
     case ST_SETTER_CALL:
-        return generate_setter_assignment(output, st->setter_call);
+        return generate_setter_assignment(output, exprs, st->setter_call);
     case ST_EXPRESSION:
-        if (!has_fun_call(st->expression)) return OK;
-        CG_ASSERT(generate_expression_evaluation(output, st->expression) == OK);
+        if (!has_fun_call(exprs, st->expression)) return OK;
+        CG_ASSERT(generate_expression_evaluation(output, exprs, st->expression) == OK);
         fprintf(output, "POPS GF@&&inter1\n");
         return OK;
     default:
@@ -1219,36 +1381,231 @@ ErrorCode generate_statement(FILE *output, AstStatement *st) {
     return OK;
 }
 
+/// Fills a frame for a statement with nested blocks, returns false for other statements
+static bool statement_frame(AstStatement *st, StatementFrame *out) {
+    *out = (StatementFrame){ .type = st->type };
+    switch (st->type) {
+    case ST_BLOCK:
+        out->block = st->block;
+        return true;
+    case ST_IF:
+        out->if_st = st->if_st;
+        return true;
+    case ST_WHILE:
+        out->while_st = st->while_st;
+        return true;
+    default:
+        return false;
+    }
+}
+
+/// Generates the code of an if statement up to its next branch
+static void generate_if_step(FILE *output, AstExprs *exprs, StatementFrame *f, AstBlock **block) {
+    AstIfStatement *st = f->if_st;
+    if (f->phase == 0) {
+        f->id = internal_names_cntr++;
+        f->branches = generate_truth_assessment(output, exprs, st->condition, "$&&if_true", "$&&if_false", f->id);
+        f->phase = 1;
+        if (f->branches & B_TRUE) {
+            fprintf(output, "LABEL $&&if_true%u\n", f->id);
+            *block = st->true_branch;
+            return;
+        }
+    }
+    if (f->phase == 1) {
+        // Skip the else branch if it is generated
+        if ((f->branches & B_TRUE) && (f->branches & B_FALSE)) {
+            fprintf(output, "JUMP $&&if_end%u\n", f->id);
+        }
+        if (!(f->branches & B_FALSE)) {
+            fprintf(output, "LABEL $&&if_end%u\n", f->id);
+            return;
+        }
+        fprintf(output, "LABEL $&&if_false%u\n", f->id);
+        f->phase = 2;
+    }
+    // Generate else-if branches
+    for (;;) {
+        if (f->phase == 3) {
+            // Else-if body is done
+            fprintf(output, "JUMP $&&if_end%u\n"
+                            "LABEL $&&elif_false%u\n",
+                            f->id, f->elif_id);
+            f->index++;
+            f->phase = 2;
+        }
+        if (f->phase != 2 || f->index >= st->else_if_count) break;
+
+        AstElseIfStatement *elif = st->else_if_branches[f->index];
+        f->elif_id = internal_names_cntr++;
+        RequiredBranches b = generate_truth_assessment(output, exprs, elif->condition, "$&&elif_true", "$&&elif_false", f->elif_id);
+        if (b & B_TRUE) {
+            fprintf(output, "LABEL $&&elif_true%u\n", f->elif_id);
+            f->phase = 3;
+            *block = elif->body;
+            return;
+        }
+        fprintf(output, "LABEL $&&elif_false%u\n", f->elif_id);
+        f->index++;
+    }
+    // Else branch
+    if (f->phase == 2) {
+        f->phase = 4;
+        if (st->false_branch != NULL) {
+            *block = st->false_branch;
+            return;
+        }
+    }
+    fprintf(output, "LABEL $&&if_end%u\n", f->id);
+}
+
+/// Generates the code of a while cycle up to its body
+static void generate_while_step(FILE *output, AstExprs *exprs, StatementFrame *f, AstBlock **block) {
+    AstWhileStatement *st = f->while_st;
+    if (f->phase == 0) {
+        f->id = internal_names_cntr++;
+        fprintf(output, "LABEL $&&while_cond%u\n", f->id);
+        f->branches = generate_truth_assessment(output, exprs, st->condition, "$&&while_body", "$&&while_end", f->id);
+        f->phase = 1;
+        if (f->branches & B_TRUE) {
+            fprintf(output, "LABEL $&&while_body%u\n", f->id);
+            *block = st->body;
+            return;
+        }
+    }
+    if (f->branches & B_TRUE) {
+        fprintf(output, "JUMP $&&while_cond%u\n", f->id);
+    }
+    fprintf(output, "LABEL $&&while_end%u\n", f->id);
+}
+
+/// Generates code for a statement with nested blocks. The statements whose nested blocks are
+/// being generated are kept on an explicit stack, so deep nesting does not overflow the C stack
+static ErrorCode generate_nested_statement(FILE *output, AstExprs *exprs, StatementFrame root) {
+    StatementFrame inline_frames[_CG_INLINE_DEPTH];
+    CgStack stack = cg_stack_init(inline_frames, sizeof(StatementFrame), _CG_INLINE_DEPTH);
+    ErrorCode ec = OK;
+
+    *(StatementFrame *)cg_push(&stack) = root;
+    while (ec == OK && stack.count > 0) {
+        StatementFrame *top = (StatementFrame *)stack.frames + stack.count - 1;
+
+        if (top->in_block) {
+            if (top->pos < top->body->count) {
+                AstStatement *cur = &top->body->statements[top->pos++];
+
+                StatementFrame frame;
+                if (statement_frame(cur, &frame)) {
+                    StatementFrame *pushed = cg_push(&stack);
+                    if (pushed == NULL) {
+                        ec = INTERNAL_ERROR;
+                    } else {
+                        *pushed = frame;
+                    }
+                    continue;
+                }
+
+                if (generate_simple_statement(output, exprs, cur) != OK) {
+                    ec = INTERNAL_ERROR;
+                    continue;
+                }
+                DEBUG_WRITE(output, "#------------\n");
+                if (cur->type == ST_RETURN) {
+                    DEBUG_WRITE(output, "# SKIPPING DEAD CODE AFTER RETURN\n");
+                    top->pos = top->body->count;
+                }
+                continue;
+            }
+            DEBUG_WRITE(output, "#^ ^ ^ ^ ^ BLOCK ^ ^ ^ ^ ^\n");
+            top->in_block = false;
+        }
+
+        AstBlock *block = NULL;
+        switch (top->type) {
+        case ST_BLOCK:
+            if (top->phase == 0) {
+                top->phase = 1;
+                block = top->block;
+            }
+            break;
+        case ST_IF:
+            generate_if_step(output, exprs, top, &block);
+            break;
+        case ST_WHILE:
+            generate_while_step(output, exprs, top, &block);
+            break;
+        default:
+            ec = INTERNAL_ERROR;
+            continue;
+        }
+
+        if (block != NULL) {
+            DEBUG_WRITE(output, "#v v v v v BLOCK v v v v v\n");
+            top->body = block;
+            top->pos = 0;
+            top->in_block = true;
+            continue;
+        }
+        stack.count--;
+        if (stack.count > 0) {
+            // The statement was part of the block below it
+            DEBUG_WRITE(output, "#------------\n");
+        }
+    }
+
+    cg_stack_free(&stack);
+    return ec;
+}
+
+ErrorCode generate_compound_statement(FILE *output, AstExprs *exprs, AstBlock *st) {
+    return generate_nested_statement(output, exprs, (StatementFrame){ .type = ST_BLOCK, .block = st });
+}
+
+ErrorCode generate_if_statement(FILE *output, AstExprs *exprs, AstIfStatement *st) {
+    return generate_nested_statement(output, exprs, (StatementFrame){ .type = ST_IF, .if_st = st });
+}
+
+ErrorCode generate_while_statement(FILE *output, AstExprs *exprs, AstWhileStatement *st) {
+    return generate_nested_statement(output, exprs, (StatementFrame){ .type = ST_WHILE, .while_st = st });
+}
+
+ErrorCode generate_statement(FILE *output, AstExprs *exprs, AstStatement *st) {
+    StatementFrame frame;
+    if (statement_frame(st, &frame)) {
+        return generate_nested_statement(output, exprs, frame);
+    }
+    return generate_simple_statement(output, exprs, st);
+}
+
 void declare_global_var(SymtableItem *item, void *par) {
     if (item->type != SYM_GLOBAL_VAR) return;
 
     fprintf((FILE*)par, "DEFVAR GF@%s\n"
                         "MOVE GF@%s nil@nil\n",
-                        item->key, item->key);
+                        item->name->val, item->name->val);
 }
 
 void declare_local_var(SymtableItem *item, void *par) {
     if (item->type != SYM_VAR) return;
 
-    fprintf((FILE*)par, "DEFVAR LF@%s\n", item->key);
+    fprintf((FILE*)par, "DEFVAR LF@%s?%d\n", item->name->val, item->slot);
 }
 
 ErrorCode store_function_parameters(FILE *output, AstFunction *fun) {
     DEBUG_WRITE(output, "\n# Store parameters into variables\n");
     for (size_t i = fun->param_count; i > 0; i--) {
-        // We find the var in the symtable to get the name with the correct scope id
-        SymtableItem *var;
-        CG_ASSERT(find_local_var(fun->symtable, fun->param_names[i-1]->val, &var));
-        CG_ASSERT(var != NULL);
-        fprintf(output, "POPS LF@%s\n", var->key);
+        // The parameters are the first variables declared in the function, so they take the first slots
+        SymtableItem *var = symtable_var(fun->symtable, (int)(i - 1));
+        CG_ASSERT(var != NULL && var->name == fun->param_names[i-1]);
+        fprintf(output, "POPS LF@%s?%d\n", var->name->val, var->slot);
     }
     return OK;
 }
 
-ErrorCode define_function(FILE *output, AstFunction *fun) {
+ErrorCode define_function(FILE *output, AstExprs *exprs, AstFunction *fun, const char *suffix) {
     // Function label
-    DEBUG_WRITE(output, "\n\n################\n""# DEFINITION OF FUNCTION '%s' with %zu parameters\n################\n", fun->name->val, fun->param_count);
-    fprintf(output, "LABEL $%s$%zu\n", fun->name->val, fun->param_count);
+    DEBUG_WRITE(output, "\n\n################\n""# DEFINITION OF FUNCTION '%s%s' with %zu parameters\n################\n", fun->name->val, suffix, fun->param_count);
+    fprintf(output, "LABEL $%s%s$%zu\n", fun->name->val, suffix, fun->param_count);
 
     fprintf(output, "CREATEFRAME\n"
                     "PUSHFRAME\n");
@@ -1262,7 +1619,7 @@ ErrorCode define_function(FILE *output, AstFunction *fun) {
 
     // Generate code for statements
     DEBUG_WRITE(output, "\n# Function body\n");
-    generate_compound_statement(output, fun->body);
+    generate_compound_statement(output, exprs, fun->body);
 
     // Default return
     DEBUG_WRITE(output, "\n# Default return value\n");
@@ -1281,13 +1638,12 @@ void write_runtime(FILE *output) {
                     "EXIT int@0\n");
 }
 
-ErrorCode generate_code(FILE *output, AstStatement *root, Symtable *global_symtable) {
+void generate_prologue(FILE *output) {
     // IFJcode Header
     fprintf(output, ".IFJcode25\n");
 
-    // Declare global variables
-    DEBUG_WRITE(output, "\n\n# GLOBAL VARS DECLARATION\n");
     // Declares some compiler variables
+    DEBUG_WRITE(output, "\n\n# COMPILER VARS DECLARATION\n");
     fprintf(output, "DEFVAR GF@&&inter1\n"
                     "DEFVAR GF@&&inter2\n"
                     "DEFVAR GF@&&inter3\n"
@@ -1295,48 +1651,67 @@ ErrorCode generate_code(FILE *output, AstStatement *root, Symtable *global_symta
                     "DEFVAR GF@&&inter5\n"
                     "DEFVAR GF@&&inter6\n"
                     "DEFVAR GF@&&inter7\n");
+
+    // The global variables are declared after the definitions
+    fprintf(output, "JUMP $&&globals\n");
+}
+
+void generate_epilogue(FILE *output, Symtable *global_symtable) {
+    // Declare global variables
+    DEBUG_WRITE(output, "\n\n# GLOBAL VARS DECLARATION\n");
+    fprintf(output, "LABEL $&&globals\n");
     symtable_foreach(global_symtable, declare_global_var, output);
 
     // Runtime
     write_runtime(output);
+}
+
+ErrorCode generate_definition(FILE *output, AstExprs *exprs, AstStatement *definition) {
+    // We define some variables that we need to convert getters and setters into functions
+    // and generate the code for them the same way
+    AstGetter *g;
+    AstSetter *s;
+    AstFunction f;
+    const Ident *setter_par;
+    switch (definition->type) {
+        case ST_FUNCTION:
+            CG_ASSERT(define_function(output, exprs, definition->function, "") == OK);
+            break;
+        case ST_GETTER:
+            // Converting getter into a function
+            g = definition->getter;
+            f.name = g->name;
+            f.param_count = 0;
+            f.param_names = NULL;
+            f.body = g->body;
+            f.symtable = g->symtable;
+            CG_ASSERT(define_function(output, exprs, &f, "!") == OK);
+            break;
+        case ST_SETTER:
+            // Converting setter into a function
+            s = definition->setter;
+            f.name = s->name;
+            f.param_count = 1;
+            setter_par = s->param_name;
+            f.param_names = &setter_par;
+            f.body = s->body;
+            f.symtable = s->symtable;
+            CG_ASSERT(define_function(output, exprs, &f, "*") == OK);
+            break;
+        default:
+            return INTERNAL_ERROR;
+    }
+    return OK;
+}
+
+ErrorCode generate_code(FILE *output, AstExprs *exprs, AstStatement *root, Symtable *global_symtable) {
+    generate_prologue(output);
 
     // Defines functions
-    for (AstStatement *cur = root->next; cur->type != ST_END; cur = cur->next) {
-        // We define some variables that we need to convert getters and setters into functions
-        // and generate the code for them the same way
-        AstGetter *g;
-        AstSetter *s;
-        AstFunction f;
-        String *setter_par;
-        switch (cur->type) {
-            case ST_FUNCTION:
-                CG_ASSERT(define_function(output, cur->function) == OK);
-                break;
-            case ST_GETTER:
-                // Converting getter into a function
-                g = cur->getter;
-                f.name = g->name;
-                f.param_count = 0;
-                f.param_names = NULL;
-                f.body = g->body;
-                f.symtable = g->symtable;
-                CG_ASSERT(define_function(output, &f) == OK);
-                break;
-            case ST_SETTER:
-                // Converting setter into a function
-                s = cur->setter;
-                f.name = s->name;
-                f.param_count = 1;
-                setter_par = s->param_name;
-                f.param_names = &setter_par;
-                f.body = s->body;
-                f.symtable = s->symtable;
-                CG_ASSERT(define_function(output, &f) == OK);
-                break;
-            default:
-                return INTERNAL_ERROR;
-        }
+    for (size_t i = 0; i < root->block->count; i++) {
+        CG_ASSERT(generate_definition(output, exprs, &root->block->statements[i]) == OK);
     }
 
+    generate_epilogue(output, global_symtable);
     return OK;
 }
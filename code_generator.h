@@ -16,66 +16,84 @@
 #include "error.h"
 #include "symtable.h"
 
+/// Expression node whose code is being generated. The nodes on the path from the root are kept on
+/// an explicit stack and the generator of a node is a step function called again after every child
+/// it stores to next. The node is done when next is left EXPR_NONE
+typedef struct eval_frame {
+    /// The node
+    ExprId ex;
+    /// Step of the generation the node is at, 0 on the first call
+    unsigned phase;
+    /// Id for the unique names of the node
+    unsigned id;
+    /// Branches the truth assessment of the condition requires
+    unsigned char branches;
+    /// The operand being assessed was evaluated
+    bool evaluated;
+    /// Builtin function being called
+    unsigned char builtin;
+} EvalFrame;
+
 /// Generates code for a compound statement
-ErrorCode generate_compound_statement(FILE *output, AstBlock *st);
+ErrorCode generate_compound_statement(FILE *output, AstExprs *exprs, AstBlock *st);
 
 /// Generates code for an if statement
-ErrorCode generate_if_statement(FILE *output, AstIfStatement *st);
+ErrorCode generate_if_statement(FILE *output, AstExprs *exprs, AstIfStatement *st);
 
 /// Generates code for a while cycle
-ErrorCode generate_while_statement(FILE *output, AstWhileStatement *st);
+ErrorCode generate_while_statement(FILE *output, AstExprs *exprs, AstWhileStatement *st);
 
 /// Generates code for a function call
-ErrorCode generate_function_call(FILE *output, AstExpression *call);
+ErrorCode generate_function_call(FILE *output, AstExprs *exprs, EvalFrame *f, ExprId *next);
 
 /// Generates code for an AND expression ex
-ErrorCode generate_and_expr(FILE *output, AstExpression *ex);
+ErrorCode generate_and_expr(FILE *output, AstExprs *exprs, EvalFrame *f, ExprId *next);
 
 /// Generates code for an OR expression ex
-ErrorCode generate_or_expr(FILE *output, AstExpression *ex);
+ErrorCode generate_or_expr(FILE *output, AstExprs *exprs, EvalFrame *f, ExprId *next);
 
 /// Generates code for an is expression ex
-ErrorCode generate_is_expr(FILE *output, AstExpression *ex);
+ErrorCode generate_is_expr(FILE *output, AstExprs *exprs, EvalFrame *f, ExprId *next);
 
 /// Generates code for a ternary expression ex
-ErrorCode generate_ternary_expr(FILE *output, AstExpression *ex);
+ErrorCode generate_ternary_expr(FILE *output, AstExprs *exprs, EvalFrame *f, ExprId *next);
 
 /// Converts a given input string to the IFJcode25 literal format
 ErrorCode convert_string(char *input, String **out);
 
 /// Generates code for a builtin function call
-ErrorCode generate_builtin_function_call(FILE *output, AstExpression *ex);
+ErrorCode generate_builtin_function_call(FILE *output, AstExprs *exprs, EvalFrame *f, ExprId *next);
 
 /// Generates code for a + expression
-ErrorCode generate_add_expression(FILE *output, AstExpression *ex);
+ErrorCode generate_add_expression(FILE *output, AstExprs *exprs, EvalFrame *f, ExprId *next);
 
 /// Generates code for a * expression
-ErrorCode generate_mul_expression(FILE *output, AstExpression *ex);
+ErrorCode generate_mul_expression(FILE *output, AstExprs *exprs, EvalFrame *f, ExprId *next);
 
 /// Generates code for evaluating a binary operator which only accepts float on both sides
-ErrorCode generate_binary_operator_with_floats(FILE *output, AstExpression *ex, char *stack_op);
+ErrorCode generate_binary_operator_with_floats(FILE *output, AstExprs *exprs, EvalFrame *f, ExprId *next, char *stack_op);
 
 /// Generates code for a == expression
-ErrorCode generate_equals_expression(FILE *output, AstExpression *ex);
+ErrorCode generate_equals_expression(FILE *output, AstExprs *exprs, EvalFrame *f, ExprId *next);
 
 /// Generates code which will evaluate the given expression
 /// Leaves the resulting value at the top of the stack
-ErrorCode generate_expression_evaluation(FILE *output, AstExpression *st);
+ErrorCode generate_expression_evaluation(FILE *output, AstExprs *exprs, ExprId st);
 
 /// Generates code for local variable assignment
-ErrorCode generate_var_assignment(FILE *output, char *scope, AstVariable *st);
+ErrorCode generate_var_assignment(FILE *output, AstExprs *exprs, char *frame, AstVariable *st);
 
 /// Generates code for global variable assignment
 ErrorCode generate_global_assignment(FILE *output, AstVariable *st);
 
 /// Generates code for setter assignment
-ErrorCode generate_setter_assignment(FILE *output, AstVariable *st);
+ErrorCode generate_setter_assignment(FILE *output, AstExprs *exprs, AstVariable *st);
 
 /// Generates code for a return statement
-ErrorCode generate_return_statement(FILE *output, AstExpression *expr);
+ErrorCode generate_return_statement(FILE *output, AstExprs *exprs, ExprId expr);
 
 /// Generates code for a given statement
-ErrorCode generate_statement(FILE *output, AstStatement *st);
+ErrorCode generate_statement(FILE *output, AstExprs *exprs, AstStatement *st);
 
 /// Generates code for defining a global variable
 void declare_global_var(SymtableItem *item, void *par);
@@ -86,13 +104,24 @@ void declare_local_var(SymtableItem *item, void *par);
 // Stores function parameters into local variables
 ErrorCode store_function_parameters(FILE *output, AstFunction *fun);
 
-/// Generates code for function/getter/setter body
-ErrorCode define_function(FILE *output, AstFunction *fun);
+/// Generates code for function/getter/setter body, the suffix follows the name in the label,
+/// ! for getters and * for setters
+ErrorCode define_function(FILE *output, AstExprs *exprs, AstFunction *fun, const char *suffix);
 
 /// Writes code that calls the main function and handles the exit code
 void write_runtime(FILE *output);
 
+/// Writes the header and declares the compiler variables. The code jumps over the definitions
+/// that follow to the epilogue, so it can be written before the global variables are known
+void generate_prologue(FILE *output);
+
+/// Declares the global variables and writes the code calling main, after all the definitions
+void generate_epilogue(FILE *output, Symtable *global_symtable);
+
+/// Generates code for a static function, getter or setter
+ErrorCode generate_definition(FILE *output, AstExprs *exprs, AstStatement *definition);
+
 /// Generates code for the given AST
-ErrorCode generate_code(FILE *output, AstStatement *root, Symtable *global_symtable);
+ErrorCode generate_code(FILE *output, AstExprs *exprs, AstStatement *root, Symtable *global_symtable);
 
 #endif // !_CODE_GENERATOR_H_
@@ -12,81 +12,58 @@
 #include "ast.h"
 #include "error.h"
 #include "lexer.h"
+#include "precedence_table.h"
 #include "token.h"
-#include <math.h>
-
-
-/**
- * Precedence table for operators
- */
-char precedence_table[][20] = {
-{ '>', '>', '<', '<', '>', '>', '>', '>', '>', '>', '>', '>', '<', '<', '>', '>', '>', '>', '<', '>'}, //+
-{ '>', '>', '<', '<', '>', '>', '>', '>', '>', '>', '>', '>', '<', '<', '>', '>', '>', '>', '<', '>'}, //-
-{ '>', '>', '>', '>', '>', '>', '>', '>', '>', '>', '>', '>', '<', '<', '>', '>', '>', '>', '<', '>'}, //*
-{ '>', '>', '>', '>', '>', '>', '>', '>', '>', '>', '>', '>', '<', '<', '>', '>', '>', '>', '<', '>'}, ///
-{ '<', '<', '<', '<', '>', '>', '>', '>', '>', '>', '>', '>', '<', '<', '>', '>', '>', '>', '<', '>'}, //>
-{ '<', '<', '<', '<', '>', '>', '>', '>', '>', '>', '>', '>', '<', '<', '>', '>', '>', '>', '<', '>'}, //<
-{ '<', '<', '<', '<', '>', '>', '>', '>', '>', '>', '>', '>', '<', '<', '>', '>', '>', '>', '<', '>'}, //>=
-{ '<', '<', '<', '<', '>', '>', '>', '>', '>', '>', '>', '>', '<', '<', '>', '>', '>', '>', '<', '>'}, //<=
-{ '<', '<', '<', '<', '<', '<', '<', '<', '>', '>', '>', '>', '<', '<', '>', '<', '>', '>', '<', '>'}, //==
-{ '<', '<', '<', '<', '<', '<', '<', '<', '>', '>', '>', '>', '<', '<', '>', '<', '>', '>', '<', '>'}, //!=
-{ '<', '<', '<', '<', '<', '<', '<', '<', '<', '<', '>', '>', '<', '<', '>', '<', '>', '>', '<', '>'}, //&&
-{ '<', '<', '<', '<', '<', '<', '<', '<', '<', '<', '<', '>', '<', '<', '>', '<', '>', '>', '<', '>'}, //||
-{ '>', '>', '>', '>', '>', '>', '>', '>', '>', '>', '>', '>', ' ', ' ', '>', '>', '>', '>', '>', '>'}, //id
-{ '<', '<', '<', '<', '<', '<', '<', '<', '<', '<', '<', '<', '<', '<', '=', '<', '<', '<', '<', ' '}, //(
-{ '>', '>', '>', '>', '>', '>', '>', '>', '>', '>', '>', '>', ' ', ' ', '>', '>', '>', '>', ' ', '>'}, //)
-{ '<', '<', '<', '<', '<', '<', '<', '<', '>', '>', '>', '>', '<', '<', '>', '>', '>', '>', '<', '>'}, //is
-{ '<', '<', '<', '<', '<', '<', '<', '<', '<', '<', '<', '<', '<', '<', '>', '<', ' ', '=', '<', '>'}, //?
-{ '<', '<', '<', '<', '<', '<', '<', '<', '<', '<', '<', '<', '<', '<', '>', '<', '<', ' ', '<', '>'}, //:
-{ '>', '>', '>', '>', '>', '>', '>', '>', '>', '>', '>', '>', '<', '<', '>', '<', '>', '>', '<', '>'}, //!
-{ '<', '<', '<', '<', '<', '<', '<', '<', '<', '<', '<', '<', '<', '<', ' ', '<', '<', ' ', '<', ' '}  //$
-};
-
 
 /**
  * Calculates the index in the precedence table for a given token type
- * Returns the index as an integer
+ * Returns the index as an integer, -1 if the token cannot be a part of an expression
  */
 int calculate_table_idx(TokType type){
     switch (type)
     {
-    case TOK_OP_PLUS: return 0; // +
-    case TOK_OP_MINUS: return 1; // -
-    case TOK_OP_MULT: return 2; // *
-    case TOK_OP_DIV: return 3; // /
-    case TOK_OP_GREATER: return 4; // >
-    case TOK_OP_LESS: return 5; // <
-    case TOK_OP_GREATER_EQ: return 6; // >=
-    case TOK_OP_LESS_EQ: return 7; // <=
-    case TOK_OP_EQ: return 8; // ==
-    case TOK_OP_NOT_EQ: return 9; // !=
-    case TOK_OP_AND: return 10; // &&
-    case TOK_OP_OR: return 11; // ||
+    case TOK_OP_PLUS: return PREC_PLUS;
+    case TOK_OP_MINUS: return PREC_MINUS;
+    case TOK_OP_MULT: return PREC_MULT;
+    case TOK_OP_DIV: return PREC_DIV;
+    case TOK_OP_GREATER: return PREC_GREATER;
+    case TOK_OP_LESS: return PREC_LESS;
+    case TOK_OP_GREATER_EQ: return PREC_GREATER_EQ;
+    case TOK_OP_LESS_EQ: return PREC_LESS_EQ;
+    case TOK_OP_EQ: return PREC_EQ;
+    case TOK_OP_NOT_EQ: return PREC_NOT_EQ;
+    case TOK_OP_AND: return PREC_AND;
+    case TOK_OP_OR: return PREC_OR;
     case TOK_IDENTIFIER: case TOK_GLOBAL_VAR:
-    case TOK_LIT_NUM: case TOK_LIT_STRING:
+    case TOK_LIT_NUM: case TOK_LIT_INT: case TOK_LIT_STRING:
     case TOK_TYPE_NULL: case TOK_TYPE_NUM: case TOK_TYPE_STRING: case TOK_TYPE_BOOL:
     case TOK_KW_TRUE: case TOK_KW_FALSE: case TOK_KW_NULL:
     case TOK_KW_IFJ:
-        return 12; // operands
-    case TOK_LEFT_PAR: return 13; // (
-    case TOK_RIGHT_PAR: return 14; // )
-    case TOK_OP_IS: return 15; // is
-    case TOK_OP_QUESTION_MARK: return 16; // ?
-    case TOK_OP_COLON: return 17; // :
-    case TOK_OP_NOT: return 18; // !
-    case TOK_DOLLAR: return 19; // $
+        return PREC_OPERAND;
+    case TOK_LEFT_PAR: return PREC_LEFT_PAR;
+    case TOK_RIGHT_PAR: return PREC_RIGHT_PAR;
+    case TOK_OP_IS: return PREC_IS;
+    case TOK_OP_QUESTION_MARK: return PREC_QUESTION_MARK;
+    case TOK_OP_COLON: return PREC_COLON;
+    case TOK_OP_NOT: return PREC_NOT;
+    case TOK_DOLLAR: return PREC_DOLLAR;
     default:
         return -1;
         break;
     }
 }
 
-ErrorCode parse_expression(Lexer *lexer, AstExpression **out_expr) {
-    Stack *expr_stack;
-    Stack *op_stack;
+ErrorCode parse_expression(Lexer *lexer, AstExprs *exprs, ExprId *out_expr) {
+#ifdef EXPR_PRATT
+    return parse_expression_pratt(lexer, exprs, out_expr);
+#else
+    return parse_expression_table(lexer, exprs, out_expr);
+#endif
+}
 
-    expr_stack = stack_init();
-    op_stack = stack_init();
+ErrorCode parse_expression_table(Lexer *lexer, AstExprs *exprs, ExprId *out_expr) {
+    Stack *expr_stack = stack_init();
+    if (expr_stack == NULL) return INTERNAL_ERROR;
 
     Token token;
     token.type = TOK_DOLLAR;
@@ -97,13 +74,10 @@ ErrorCode parse_expression(Lexer *lexer, AstExpression **out_expr) {
     if(lexer_get_token(lexer, &token) != ERR_LEX_OK){
         // Read the first token
         stack_destroy(expr_stack);
-        stack_destroy(op_stack);
         return LEXICAL_ERROR;
     }
     while(1) {
-        stack_find_term(expr_stack, op_stack); // pops items until topmost terminal is found
-        stack_top(expr_stack, &stack_token); // topmost terminal is now in token
-        push_whole_stack(op_stack, expr_stack); // pushes back all popped items
+        stack_top_term(expr_stack, &stack_token); // the stack always holds at least the DOLLAR terminal
 
         // Checking if we have reached the end
         if((stack_token.type == TOK_DOLLAR && token.type == TOK_RIGHT_PAR)
@@ -116,7 +90,6 @@ ErrorCode parse_expression(Lexer *lexer, AstExpression **out_expr) {
         if (token.type == TOK_EOL) {
             if (lexer_get_token(lexer, &token) != ERR_LEX_OK) {
                 stack_destroy(expr_stack);
-                stack_destroy(op_stack);
                 return LEXICAL_ERROR;
             }
             continue;
@@ -134,7 +107,6 @@ ErrorCode parse_expression(Lexer *lexer, AstExpression **out_expr) {
         int row = calculate_table_idx(stack_token.type);
         if (col < 0 || row < 0) {
             stack_destroy(expr_stack);
-            stack_destroy(op_stack);
             return SYNTACTIC_ERROR;
         }
 
@@ -145,54 +117,47 @@ ErrorCode parse_expression(Lexer *lexer, AstExpression **out_expr) {
         switch (relation)
         {
         case '<':
-            result = shift(expr_stack, op_stack, token, lexer);
+            result = shift(exprs, expr_stack, token, lexer);
             if (result != OK) {
                 stack_destroy(expr_stack);
-                stack_destroy(op_stack);
                 return result;
             }
             if(last_used_token.type != TOK_DOLLAR){
                 if(lexer_get_token(lexer, &token) != ERR_LEX_OK){
                     stack_destroy(expr_stack);
-                    stack_destroy(op_stack);
                     return LEXICAL_ERROR;
                 } // read next token
             }
             break;
         case '>':
-            result = reduce(expr_stack, op_stack);
+            result = reduce(exprs, expr_stack, lexer);
             if (result != OK) {
                 stack_destroy(expr_stack);
-                stack_destroy(op_stack);
                 return result;
             }
             break;
         case '=':
             if (!stack_push(expr_stack, token)) {
                 stack_destroy(expr_stack);
-                stack_destroy(op_stack);
                 return INTERNAL_ERROR;
             }
             if(last_used_token.type != TOK_DOLLAR){
                 if(lexer_get_token(lexer, &token) != ERR_LEX_OK){
                     stack_destroy(expr_stack);
-                    stack_destroy(op_stack);
                     return LEXICAL_ERROR;
                 } // read next token
             }
             break;
         case ' ':
             stack_destroy(expr_stack);
-            stack_destroy(op_stack);
             return SYNTACTIC_ERROR;
         default:
             break;
         }
     }
 
-    if(expr_stack->top != 2 || !stack_empty(op_stack)){ // should contain only DOLLAR and E
+    if(expr_stack->top != 2){ // should contain only DOLLAR and E
         stack_destroy(expr_stack);
-        stack_destroy(op_stack);
         return SYNTACTIC_ERROR;
     }
 
@@ -200,7 +165,6 @@ ErrorCode parse_expression(Lexer *lexer, AstExpression **out_expr) {
     stack_pop(expr_stack);
     *out_expr = token.expr_val;
     stack_destroy(expr_stack);
-    stack_destroy(op_stack);
     return OK;
 }
 
@@ -211,123 +175,99 @@ bool eol_possible(Token token){
     return false;
 }
 
-ErrorCode shift(Stack *expr_stack, Stack *op_stack, Token token, Lexer *lexer) {
+ErrorCode shift(AstExprs *exprs, Stack *expr_stack, Token token, Lexer *lexer) {
     if (token.type == TOK_IDENTIFIER) {
         // Could be a function
         Token next_tok;
         if (lexer_get_token(lexer, &next_tok) != ERR_LEX_OK) return LEXICAL_ERROR;
         if (next_tok.type == TOK_LEFT_PAR) {
             // This, is a function!
-            ErrorCode ec = reduce_function_call(expr_stack, lexer, token.string_val);
-            if (ec != OK) {
-                token_free(&token);
-                token_free(&next_tok);
-            }
-            return ec;
+            return reduce_function_call(exprs, expr_stack, lexer, token.ident_val);
         } else {
             lexer_unget_token(lexer, &next_tok);
         }
     } else if (token.type == TOK_KW_IFJ) {
-        return reduce_buildtin_call(expr_stack, lexer);
-    }
-    if(stack_find_term(expr_stack, op_stack)){
-        Token less = { .type = TOK_PREC_OPEN };
-        stack_push(expr_stack, less); // inserts '<' after the topmost terminal
-        push_whole_stack(op_stack, expr_stack); // pushes back all popped items
-        stack_push(expr_stack, token); // pushes the current token onto the stack
-        return OK;
+        return reduce_buildtin_call(exprs, expr_stack, lexer);
     }
-    return INTERNAL_ERROR;
+    Token less = { .type = TOK_PREC_OPEN };
+    if (!stack_insert_after_term(expr_stack, less)) return INTERNAL_ERROR; // inserts '<' after the topmost terminal
+    if (!stack_push(expr_stack, token)) return INTERNAL_ERROR; // pushes the current token onto the stack
+    return OK;
 }
 
-ErrorCode reduce(Stack *expr_stack, Stack *op_stack) {
-    stack_find_term(expr_stack, op_stack);
+ErrorCode reduce(AstExprs *exprs, Stack *expr_stack, Lexer *lexer) {
     Token top_token;
-    stack_top(expr_stack, &top_token);
-    push_whole_stack(op_stack, expr_stack);
+    stack_top_term(expr_stack, &top_token);
 
     ErrorCode reduction_res = SYNTACTIC_ERROR;
     switch (top_token.type) {
         case TOK_OP_PLUS:
-            reduction_res = reduce_binary(expr_stack, TOK_OP_PLUS, EX_ADD);
+            reduction_res = reduce_binary(exprs, expr_stack, TOK_OP_PLUS, EX_ADD);
             break;
         case TOK_OP_MINUS:
-            reduction_res = reduce_binary(expr_stack, TOK_OP_MINUS, EX_SUB);
+            reduction_res = reduce_binary(exprs, expr_stack, TOK_OP_MINUS, EX_SUB);
             if (reduction_res != OK)
             {
-                reduction_res = reduce_unary_prefix_op(expr_stack, TOK_OP_MINUS, EX_NEGATE);
+                reduction_res = reduce_unary_prefix_op(exprs, expr_stack, TOK_OP_MINUS, EX_NEGATE);
             }
             break;
         case TOK_OP_MULT:
-            reduction_res = reduce_binary(expr_stack, TOK_OP_MULT, EX_MUL);
+            reduction_res = reduce_binary(exprs, expr_stack, TOK_OP_MULT, EX_MUL);
             break;
         case TOK_OP_DIV:
-            reduction_res = reduce_binary(expr_stack, TOK_OP_DIV, EX_DIV);
+            reduction_res = reduce_binary(exprs, expr_stack, TOK_OP_DIV, EX_DIV);
             break;
         case TOK_OP_GREATER:
-            reduction_res = reduce_binary(expr_stack, TOK_OP_GREATER, EX_GREATER);
+            reduction_res = reduce_binary(exprs, expr_stack, TOK_OP_GREATER, EX_GREATER);
             break;
         case TOK_OP_LESS:
-            reduction_res = reduce_binary(expr_stack, TOK_OP_LESS, EX_LESS);
+            reduction_res = reduce_binary(exprs, expr_stack, TOK_OP_LESS, EX_LESS);
             break;
         case TOK_OP_GREATER_EQ:
-            reduction_res = reduce_binary(expr_stack, TOK_OP_GREATER_EQ, EX_GREATER_EQ);
+            reduction_res = reduce_binary(exprs, expr_stack, TOK_OP_GREATER_EQ, EX_GREATER_EQ);
             break;
         case TOK_OP_LESS_EQ:
-            reduction_res = reduce_binary(expr_stack, TOK_OP_LESS_EQ, EX_LESS_EQ);
+            reduction_res = reduce_binary(exprs, expr_stack, TOK_OP_LESS_EQ, EX_LESS_EQ);
             break;
         case TOK_OP_EQ:
-            reduction_res = reduce_binary(expr_stack, TOK_OP_EQ, EX_EQ);
+            reduction_res = reduce_binary(exprs, expr_stack, TOK_OP_EQ, EX_EQ);
             break;
         case TOK_OP_NOT_EQ:
-            reduction_res = reduce_binary(expr_stack, TOK_OP_NOT_EQ, EX_NOT_EQ);
+            reduction_res = reduce_binary(exprs, expr_stack, TOK_OP_NOT_EQ, EX_NOT_EQ);
             break;
         case TOK_OP_AND:
-            reduction_res = reduce_binary(expr_stack, TOK_OP_AND, EX_AND);
+            reduction_res = reduce_binary(exprs, expr_stack, TOK_OP_AND, EX_AND);
             break;
         case TOK_OP_OR:
-            reduction_res = reduce_binary(expr_stack, TOK_OP_OR, EX_OR);
+            reduction_res = reduce_binary(exprs, expr_stack, TOK_OP_OR, EX_OR);
             break;
         case TOK_IDENTIFIER:
-            reduction_res = reduce_identifier(expr_stack, TOK_IDENTIFIER, EX_ID);
-            break;
         case TOK_GLOBAL_VAR:
-            reduction_res = reduce_identifier(expr_stack, TOK_GLOBAL_VAR, EX_GLOBAL_ID);
-            break;
         case TOK_LIT_NUM:
-            reduction_res = reduce_literal(expr_stack, TOK_LIT_NUM, EX_DOUBLE);
-            break;
+        case TOK_LIT_INT:
         case TOK_LIT_STRING:
-            reduction_res = reduce_literal(expr_stack, TOK_LIT_STRING, EX_STRING);
-            break;
         case TOK_KW_TRUE:
-            reduction_res = reduce_literal(expr_stack, TOK_KW_TRUE, EX_BOOL);
-            break;
         case TOK_KW_FALSE:
-            reduction_res = reduce_literal(expr_stack, TOK_KW_FALSE, EX_BOOL);
-            break;
         case TOK_KW_NULL:
-            reduction_res = reduce_literal(expr_stack, TOK_KW_NULL, EX_NULL);
+        case TOK_TYPE_NULL:
+        case TOK_TYPE_NUM:
+        case TOK_TYPE_STRING:
+        case TOK_TYPE_BOOL:
+            reduction_res = reduce_operand(exprs, expr_stack, lexer, top_token.type);
             break;
         case TOK_RIGHT_PAR:
             reduction_res = reduce_par(expr_stack);
             break;
         case TOK_OP_IS:
-            reduction_res = reduce_binary(expr_stack, TOK_OP_IS, EX_IS);
+            reduction_res = reduce_binary(exprs, expr_stack, TOK_OP_IS, EX_IS);
             break;
         case TOK_OP_QUESTION_MARK:
             break;
         case TOK_OP_COLON:
-            reduction_res = reduce_ternary(expr_stack);
+            reduction_res = reduce_ternary(exprs, expr_stack);
             break;
         case TOK_OP_NOT:
-            reduction_res = reduce_unary_prefix_op(expr_stack, TOK_OP_NOT, EX_NOT);
-            break;
-        case TOK_TYPE_NULL:
-        case TOK_TYPE_NUM:
-        case TOK_TYPE_STRING:
-        case TOK_TYPE_BOOL:
-            reduction_res = reduce_data_type(expr_stack, top_token.type);
+            reduction_res = reduce_unary_prefix_op(exprs, expr_stack, TOK_OP_NOT, EX_NOT);
             break;
         default:
             return SYNTACTIC_ERROR;
@@ -337,104 +277,52 @@ ErrorCode reduce(Stack *expr_stack, Stack *op_stack) {
 
 #define RULE_SIZE(rule) sizeof(rule) / sizeof(TokType)
 
-ErrorCode reduce_binary(Stack *expr_stack, TokType op_type, AstExprType expr_type) {
+ErrorCode reduce_binary(AstExprs *exprs, Stack *expr_stack, TokType op_type, AstExprType expr_type) {
     TokType rule[] = { TOK_PREC_OPEN, TOK_E, op_type, TOK_E };
     if (!stack_is_sequence_on_top(expr_stack, rule, RULE_SIZE(rule))) return SYNTACTIC_ERROR;
 
-    AstExpression *expr = ast_expr_create(expr_type, 2);
-    if (expr_stack == NULL) return INTERNAL_ERROR;
-
-    Token top;
-    // Pop right side
-    stack_top(expr_stack, &top);
-    stack_pop(expr_stack);
-    expr->params[1] = top.expr_val;
-    // Pop operator
-    stack_pop(expr_stack);
-    // Pop left side
-    stack_top(expr_stack, &top);
-    stack_pop(expr_stack);
-    expr->params[0] = top.expr_val;
-    // Pop <
-    stack_pop(expr_stack);
-
-    Token expr_tok = { .type = TOK_E, .expr_val = expr };
-    if (!stack_push(expr_stack, expr_tok)) return INTERNAL_ERROR;
-
-    return OK;
-}
-
-ErrorCode reduce_identifier(Stack *expr_stack, TokType id_type, AstExprType expr_type) {
-    TokType rule[] = { TOK_PREC_OPEN, id_type };
-    if (!stack_is_sequence_on_top(expr_stack, rule, RULE_SIZE(rule))) return SYNTACTIC_ERROR;
-
-    AstExpression *expr = ast_expr_create(expr_type, 0);
-    if (expr_stack == NULL) return INTERNAL_ERROR;
+    ExprId expr = ast_expr_create(exprs, expr_type, 2);
+    if (expr == EXPR_NONE) return INTERNAL_ERROR;
 
-    Token top;
-    stack_top(expr_stack, &top);
-    stack_pop(expr_stack); // Pop id
-    stack_pop(expr_stack); // Pop <
-    expr->string_val = top.string_val;
+    // Right and left side, the operator and < are between them
+    EXPR_CHILD(exprs, expr, 1) = stack_at(expr_stack, 0)->expr_val;
+    EXPR_CHILD(exprs, expr, 0) = stack_at(expr_stack, 2)->expr_val;
 
     Token expr_tok = { .type = TOK_E, .expr_val = expr };
-    if (!stack_push(expr_stack, expr_tok)) return INTERNAL_ERROR;
+    stack_reduce(expr_stack, RULE_SIZE(rule), expr_tok);
 
     return OK;
 }
 
-ErrorCode reduce_unary_prefix_op(Stack *expr_stack, TokType op_type, AstExprType expr_type) {
+ErrorCode reduce_unary_prefix_op(AstExprs *exprs, Stack *expr_stack, TokType op_type, AstExprType expr_type) {
     TokType rule[] = { TOK_PREC_OPEN, op_type, TOK_E };
     if (!stack_is_sequence_on_top(expr_stack, rule, RULE_SIZE(rule))) return SYNTACTIC_ERROR;
 
-    AstExpression *expr = ast_expr_create(expr_type, 1);
-    if (expr_stack == NULL) return INTERNAL_ERROR;
+    ExprId expr = ast_expr_create(exprs, expr_type, 1);
+    if (expr == EXPR_NONE) return INTERNAL_ERROR;
 
-    Token top;
-    // Pop right side
-    stack_top(expr_stack, &top);
-    stack_pop(expr_stack);
-    expr->params[0] = top.expr_val;
-    // Pop operator
-    stack_pop(expr_stack);
-    // Pop <
-    stack_pop(expr_stack);
+    EXPR_CHILD(exprs, expr, 0) = stack_at(expr_stack, 0)->expr_val;
 
     Token expr_tok = { .type = TOK_E, .expr_val = expr };
-    if (!stack_push(expr_stack, expr_tok)) return INTERNAL_ERROR;
+    stack_reduce(expr_stack, RULE_SIZE(rule), expr_tok);
 
     return OK;
 }
 
-ErrorCode reduce_ternary(Stack *expr_stack) {
+ErrorCode reduce_ternary(AstExprs *exprs, Stack *expr_stack) {
     TokType rule[] = { TOK_PREC_OPEN, TOK_E, TOK_OP_QUESTION_MARK, TOK_E, TOK_OP_COLON, TOK_E };
     if (!stack_is_sequence_on_top(expr_stack, rule, RULE_SIZE(rule))) return SYNTACTIC_ERROR;
 
-    AstExpression *expr = ast_expr_create(EX_TERNARY, 3);
-    if (expr_stack == NULL) return INTERNAL_ERROR;
+    ExprId expr = ast_expr_create(exprs, EX_TERNARY, 3);
+    if (expr == EXPR_NONE) return INTERNAL_ERROR;
 
-    Token top;
-    // Pop false expr
-    stack_top(expr_stack, &top);
-    stack_pop(expr_stack);
-    expr->params[2] = top.expr_val;
-    // Pop :
-    stack_pop(expr_stack);
-    // Pop true expr
-    stack_top(expr_stack, &top);
-    stack_pop(expr_stack);
-    expr->params[1] = top.expr_val;
-    // Pop ?
-    stack_pop(expr_stack);
-    // Pop condition expr
-    stack_top(expr_stack, &top);
-    stack_pop(expr_stack);
-    expr->params[0] = top.expr_val;
-    // Pop <
-    stack_pop(expr_stack);
+    // False, true and condition expr, separated by : and ?
+    EXPR_CHILD(exprs, expr, 2) = stack_at(expr_stack, 0)->expr_val;
+    EXPR_CHILD(exprs, expr, 1) = stack_at(expr_stack, 2)->expr_val;
+    EXPR_CHILD(exprs, expr, 0) = stack_at(expr_stack, 4)->expr_val;
 
     Token expr_tok = { .type = TOK_E, .expr_val = expr };
-    if (!stack_push(expr_stack, expr_tok)) return INTERNAL_ERROR;
+    stack_reduce(expr_stack, RULE_SIZE(rule), expr_tok);
 
     return OK;
 }
@@ -443,100 +331,88 @@ ErrorCode reduce_par(Stack *expr_stack) {
     TokType rule[] = { TOK_PREC_OPEN, TOK_LEFT_PAR, TOK_E, TOK_RIGHT_PAR };
     if (!stack_is_sequence_on_top(expr_stack, rule, RULE_SIZE(rule))) return SYNTACTIC_ERROR;
 
-    Token top;
-    // Pop )
-    stack_pop(expr_stack);
-    // Pop expr
-    stack_top(expr_stack, &top);
-    stack_pop(expr_stack);
-    // Pop (
-    stack_pop(expr_stack);
-    // Pop <
-    stack_pop(expr_stack);
-
-    // Push expr back
-    if (!stack_push(expr_stack, top)) return INTERNAL_ERROR;
+    // Only the expr between the parentheses stays
+    stack_reduce(expr_stack, RULE_SIZE(rule), *stack_at(expr_stack, 1));
 
     return OK;
 }
 
-ErrorCode reduce_literal(Stack *expr_stack, TokType lit_type, AstExprType expr_type) {
-    TokType rule[] = { TOK_PREC_OPEN, lit_type };
+ErrorCode reduce_operand(AstExprs *exprs, Stack *expr_stack, Lexer *lexer, TokType operand_type) {
+    TokType rule[] = { TOK_PREC_OPEN, operand_type };
     if (!stack_is_sequence_on_top(expr_stack, rule, RULE_SIZE(rule))) return SYNTACTIC_ERROR;
 
-    AstExpression *expr = ast_expr_create(expr_type, 0);
-    if (expr_stack == NULL) return INTERNAL_ERROR;
-
-    Token top;
-    // Pop literal
-    stack_top(expr_stack, &top);
-    stack_pop(expr_stack);
-    // Pop <
-    stack_pop(expr_stack);
-
-    switch (expr_type) {
-    case EX_STRING:
-        expr->string_val = top.string_val;
-        expr->assumed_type = DT_STRING;
-        break;
-    case EX_DOUBLE:
-        expr->double_val = top.double_val;
-        expr->assumed_type = DT_NUM;
-        expr->surely_int = floor(top.double_val) == top.double_val;
-        break;
-    case EX_BOOL:
-        expr->bool_val = top.type == TOK_KW_TRUE;
-        expr->assumed_type = DT_BOOL;
-        break;
-    case EX_NULL:
-        expr->assumed_type = DT_NULL;
-        break;
-    default:
-        break;
-    }
-    expr->val_known = true;
+    ExprId expr = create_operand_expr(lexer, exprs, stack_at(expr_stack, 0));
+    if (expr == EXPR_NONE) return INTERNAL_ERROR;
 
     Token expr_tok = { .type = TOK_E, .expr_val = expr };
-    if (!stack_push(expr_stack, expr_tok)) return INTERNAL_ERROR;
+    stack_reduce(expr_stack, RULE_SIZE(rule), expr_tok);
 
     return OK;
 }
 
-ErrorCode reduce_data_type(Stack *expr_stack, TokType data_type) {
-    TokType rule[] = { TOK_PREC_OPEN, data_type };
-    if (!stack_is_sequence_on_top(expr_stack, rule, RULE_SIZE(rule))) return SYNTACTIC_ERROR;
-
-    AstExpression *expr = ast_expr_create(EX_DATA_TYPE, 0);
-    if (expr_stack == NULL) return INTERNAL_ERROR;
-
-    Token top;
-    // Pop literal
-    stack_top(expr_stack, &top);
-    stack_pop(expr_stack);
-    // Pop <
-    stack_pop(expr_stack);
-
-    switch (top.type) {
+ExprId create_operand_expr(Lexer *lexer, AstExprs *exprs, const Token *token) {
+    ExprId expr;
+    switch (token->type) {
+    case TOK_IDENTIFIER:
+    case TOK_GLOBAL_VAR:
+        expr = ast_expr_create(exprs, token->type == TOK_IDENTIFIER ? EX_ID : EX_GLOBAL_ID, 0);
+        if (expr == EXPR_NONE) return EXPR_NONE;
+        EXPR_IDENT(exprs, expr) = token->ident_val;
+        return expr;
     case TOK_TYPE_NULL:
-        expr->data_type = DT_NULL; break;
     case TOK_TYPE_NUM:
-        expr->data_type = DT_NUM; break;
     case TOK_TYPE_STRING:
-        expr->data_type = DT_STRING; break;
     case TOK_TYPE_BOOL:
-        expr->data_type = DT_BOOL; break;
+        expr = ast_expr_create(exprs, EX_DATA_TYPE, 0);
+        if (expr == EXPR_NONE) return EXPR_NONE;
+        switch (token->type) {
+        case TOK_TYPE_NULL:
+            EXPR_DATA_TYPE(exprs, expr) = DT_NULL; break;
+        case TOK_TYPE_NUM:
+            EXPR_DATA_TYPE(exprs, expr) = DT_NUM; break;
+        case TOK_TYPE_STRING:
+            EXPR_DATA_TYPE(exprs, expr) = DT_STRING; break;
+        default:
+            EXPR_DATA_TYPE(exprs, expr) = DT_BOOL; break;
+        }
+        return expr;
+    case TOK_LIT_STRING:
+        expr = ast_expr_create(exprs, EX_STRING, 0);
+        if (expr == EXPR_NONE) return EXPR_NONE;
+        // The token only references the input, the AST gets its own copy
+        EXPR_STRING(exprs, expr) = ast_own_string(lexer_token_string(lexer, token));
+        if (EXPR_STRING(exprs, expr) == NULL) {
+            return EXPR_NONE;
+        }
+        EXPR_ASSUMED_TYPE(exprs, expr) = DT_STRING;
+        break;
+    case TOK_LIT_NUM:
+    case TOK_LIT_INT:
+        expr = ast_expr_create(exprs, EX_DOUBLE, 0);
+        if (expr == EXPR_NONE) return EXPR_NONE;
+        EXPR_DOUBLE(exprs, expr) = token->double_val;
+        EXPR_ASSUMED_TYPE(exprs, expr) = DT_NUM;
+        // The lexer already knows whether the literal is an integer
+        EXPR_SURELY_INT(exprs, expr) = token->type == TOK_LIT_INT;
+        break;
+    case TOK_KW_TRUE:
+    case TOK_KW_FALSE:
+        expr = ast_expr_create(exprs, EX_BOOL, 0);
+        if (expr == EXPR_NONE) return EXPR_NONE;
+        EXPR_BOOL(exprs, expr) = token->type == TOK_KW_TRUE;
+        EXPR_ASSUMED_TYPE(exprs, expr) = DT_BOOL;
+        break;
     default:
-        return SYNTACTIC_ERROR; // Shouldn't happen
+        expr = ast_expr_create(exprs, EX_NULL, 0);
+        if (expr == EXPR_NONE) return EXPR_NONE;
+        EXPR_ASSUMED_TYPE(exprs, expr) = DT_NULL;
         break;
     }
-
-    Token expr_tok = { .type = TOK_E, .expr_val = expr };
-    if (!stack_push(expr_stack, expr_tok)) return INTERNAL_ERROR;
-
-    return OK;
+    EXPR_VAL_KNOWN(exprs, expr) = true;
+    return expr;
 }
 
-ErrorCode reduce_function_call(Stack *expr_stack, Lexer *lexer, String *id) {
+ErrorCode reduce_function_call(AstExprs *exprs, Stack *expr_stack, Lexer *lexer, const Ident *id) {
     Token tok;
     do {
         if (lexer_get_token(lexer, &tok) != ERR_LEX_OK) return LEXICAL_ERROR;
@@ -544,9 +420,9 @@ ErrorCode reduce_function_call(Stack *expr_stack, Lexer *lexer, String *id) {
 
     if (tok.type == TOK_RIGHT_PAR) {
         // No parameters
-        AstExpression *fun_call = ast_expr_create(EX_FUN, 0);
-        if (fun_call == NULL) return INTERNAL_ERROR;
-        fun_call->string_val = id;
+        ExprId fun_call = ast_expr_create(exprs, EX_FUN, 0);
+        if (fun_call == EXPR_NONE) return INTERNAL_ERROR;
+        EXPR_IDENT(exprs, fun_call) = id;
         Token fun_call_tok = { .type = TOK_E, .expr_val = fun_call };
         if (!stack_push(expr_stack, fun_call_tok)) return INTERNAL_ERROR;
         return OK;
@@ -557,8 +433,8 @@ ErrorCode reduce_function_call(Stack *expr_stack, Lexer *lexer, String *id) {
 
     while (1) {
         // Parse parameter
-        AstExpression *expr;
-        ErrorCode par_res = parse_expression(lexer, &expr);
+        ExprId expr;
+        ErrorCode par_res = parse_expression_table(lexer, exprs, &expr);
         if (par_res != OK) return par_res;
         Token expr_token = { .type = TOK_E, .expr_val = expr };
         if (!stack_push(expr_stack, expr_token)) return INTERNAL_ERROR;
@@ -575,67 +451,55 @@ ErrorCode reduce_function_call(Stack *expr_stack, Lexer *lexer, String *id) {
         }
         // More parameters, next has to be a comma
         if (tok.type != TOK_COMMA){
-            token_free(&tok);
             return SYNTACTIC_ERROR;
         }
     }
 
-    AstExpression *fun_call = ast_expr_create(EX_FUN, param_cnt);
-    if (fun_call == NULL) return INTERNAL_ERROR;
-    fun_call->string_val = id;
+    ExprId fun_call = ast_expr_create(exprs, EX_FUN, param_cnt);
+    if (fun_call == EXPR_NONE) return INTERNAL_ERROR;
+    EXPR_IDENT(exprs, fun_call) = id;
 
-    // Adds params
-    for (unsigned i = 1; i <= param_cnt; i++) {
-        Token param_tok;
-        stack_top(expr_stack, &param_tok);
-        stack_pop(expr_stack);
-        fun_call->params[param_cnt - i] = param_tok.expr_val;
+    // Adds params, the last one is on the top
+    for (unsigned i = 0; i < param_cnt; i++) {
+        EXPR_CHILD(exprs, fun_call, param_cnt - 1 - i) = stack_at(expr_stack, i)->expr_val;
     }
 
     Token fun_call_tok = { .type = TOK_E, .expr_val = fun_call };
-    if (!stack_push(expr_stack, fun_call_tok)) return INTERNAL_ERROR;
+    stack_reduce(expr_stack, param_cnt, fun_call_tok);
 
     return OK;
 }
 
-ErrorCode reduce_buildtin_call(Stack *expr_stack, Lexer *lexer) {
+ErrorCode reduce_buildtin_call(AstExprs *exprs, Stack *expr_stack, Lexer *lexer) {
     // We already covered the 'Ifj' keyword
     // Now we cover the dot
     Token tok;
     if (lexer_get_token(lexer, &tok) != ERR_LEX_OK) return LEXICAL_ERROR;
     if (tok.type != TOK_OP_DOT) {
-        token_free(&tok);
         return SYNTACTIC_ERROR;
     }
-    token_free(&tok);
     // Now the id
     Token id;
     do {
         if (lexer_get_token(lexer, &id) != ERR_LEX_OK) return LEXICAL_ERROR;
     } while (id.type == TOK_EOL);
     if (id.type != TOK_IDENTIFIER) {
-        token_free(&id);
         return SYNTACTIC_ERROR;
     }
     // And (
     if (lexer_get_token(lexer, &tok) != ERR_LEX_OK) return LEXICAL_ERROR;
     if (tok.type != TOK_LEFT_PAR) {
-        token_free(&tok);
-        token_free(&id);
         return SYNTACTIC_ERROR;
     }
-    token_free(&tok);
 
     // This puts the function call to the top of the stack
-    ErrorCode res = reduce_function_call(expr_stack, lexer, id.string_val);
+    ErrorCode res = reduce_function_call(exprs, expr_stack, lexer, id.ident_val);
     if (res != OK) {
-        token_free(&id);
         return res;
     }
 
     // We have to change it's type to builtin
-    stack_top(expr_stack, &tok);
-    tok.expr_val->type = EX_BUILTIN_FUN;
+    EXPR_TYPE(exprs, stack_at(expr_stack, 0)->expr_val) = EX_BUILTIN_FUN;
 
     return OK;
 }
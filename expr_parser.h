@@ -14,9 +14,9 @@
 #include "error.h"
 #include "ast.h"
 
-ErrorCode reduce(Stack *expr_stack, Stack *op_stack);
+ErrorCode reduce(AstExprs *exprs, Stack *expr_stack, Lexer *lexer);
 
-ErrorCode shift(Stack *expr_stack, Stack *op_stack, Token token, Lexer *lexer);
+ErrorCode shift(AstExprs *exprs, Stack *expr_stack, Token token, Lexer *lexer);
 
 int calculate_table_idx(TokType type);
 
@@ -24,24 +24,33 @@ void add_to_stack(Stack *expr_stack, Token token);
 
 bool eol_possible(Token token);
 
-ErrorCode parse_expression(Lexer *lexer, AstExpression **out_expr);
+/// Parses an expression into the store with the engine chosen at build time, the precedence table
+/// one by default or the Pratt one if EXPR_PRATT is defined
+ErrorCode parse_expression(Lexer *lexer, AstExprs *exprs, ExprId *out_expr);
 
-bool eol_possible(Token token);
+/// Parses an expression by shifting and reducing on a stack driven by the precedence table
+ErrorCode parse_expression_table(Lexer *lexer, AstExprs *exprs, ExprId *out_expr);
+
+/// Parses an expression by precedence climbing with binding powers generated from the precedence table.
+/// Accepts the same grammar and builds the same AST as parse_expression_table. Syntax errors are still
+/// reported by parse_expression_table, see parse_expression_pratt
+ErrorCode parse_expression_pratt(Lexer *lexer, AstExprs *exprs, ExprId *out_expr);
 
-ErrorCode reduce_binary(Stack *expr_stack, TokType op_type, AstExprType expr_type);
+bool eol_possible(Token token);
 
-ErrorCode reduce_identifier(Stack *expr_stack, TokType id_type, AstExprType expr_type);
+ErrorCode reduce_binary(AstExprs *exprs, Stack *expr_stack, TokType op_type, AstExprType expr_type);
 
-ErrorCode reduce_unary_prefix_op(Stack *expr_stack, TokType op_type, AstExprType expr_type);
+ErrorCode reduce_unary_prefix_op(AstExprs *exprs, Stack *expr_stack, TokType op_type, AstExprType expr_type);
 
-ErrorCode reduce_ternary(Stack *expr_stack);
+ErrorCode reduce_ternary(AstExprs *exprs, Stack *expr_stack);
 
 ErrorCode reduce_par(Stack *expr_stack);
 
-ErrorCode reduce_literal(Stack *expr_stack, TokType lit_type, AstExprType expr_type);
+ErrorCode reduce_operand(AstExprs *exprs, Stack *expr_stack, Lexer *lexer, TokType operand_type);
 
-ErrorCode reduce_data_type(Stack *expr_stack, TokType data_type);
+/// Creates the leaf expression of an identifier, literal or data type token. Returns EXPR_NONE if allocation failed
+ExprId create_operand_expr(Lexer *lexer, AstExprs *exprs, const Token *token);
 
-ErrorCode reduce_function_call(Stack *expr_stack, Lexer *lexer, String *id);
+ErrorCode reduce_function_call(AstExprs *exprs, Stack *expr_stack, Lexer *lexer, const Ident *id);
 
-ErrorCode reduce_buildtin_call(Stack *expr_stack, Lexer *lexer);
+ErrorCode reduce_buildtin_call(AstExprs *exprs, Stack *expr_stack, Lexer *lexer);
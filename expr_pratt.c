@@ -0,0 +1,460 @@
+/*
+ * expr_pratt.c
+ * Implements a Pratt parser for expressions, an alternative to the precedence table engine
+ *
+ * IFJ project 2025
+ * FIT VUT
+ *
+ * Authors:
+ * Michal Šebesta (xsebesm00)
+ */
+#include "expr_parser.h"
+#include "ast.h"
+#include "binding_powers.h"
+#include "error.h"
+#include "lexer.h"
+#include "token.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Number of call arguments collected before falling back to malloc
+#define _ARGS_BUF_SIZE 16
+// Number of nested operands parsed before the frame stack moves to the heap
+#define _PRATT_INLINE_DEPTH 32
+
+/// State of the expression being parsed
+typedef struct pratt_parser {
+    Lexer *lexer;
+    /// Store the nodes of the expression are created in
+    AstExprs *exprs;
+    /// Last token read that was not an EOL, decides if the next EOL ends the expression.
+    /// Each argument of a call starts over and the call restores the one before it
+    Token last;
+} PrattParser;
+
+/// Expression types of the binary operators
+static const AstExprType binary_expr[PREC_TABLE_SIZE] = {
+    [PREC_PLUS] = EX_ADD,
+    [PREC_MINUS] = EX_SUB,
+    [PREC_MULT] = EX_MUL,
+    [PREC_DIV] = EX_DIV,
+    [PREC_GREATER] = EX_GREATER,
+    [PREC_LESS] = EX_LESS,
+    [PREC_GREATER_EQ] = EX_GREATER_EQ,
+    [PREC_LESS_EQ] = EX_LESS_EQ,
+    [PREC_EQ] = EX_EQ,
+    [PREC_NOT_EQ] = EX_NOT_EQ,
+    [PREC_AND] = EX_AND,
+    [PREC_OR] = EX_OR,
+    [PREC_IS] = EX_IS,
+};
+
+/// What a frame still waits for
+typedef enum pratt_state {
+    /// The left operand, which has not been read yet
+    PRATT_OPERAND,
+    /// The parenthesized or prefixed left operand parsed by the frame above
+    PRATT_WAIT_OPERAND,
+    /// Operators binding to the left operand in params[0]
+    PRATT_INFIX,
+    /// The right operand of op parsed by the frame above
+    PRATT_RIGHT,
+    /// The false branch of a ternary parsed by the frame above
+    PRATT_FALSE,
+    /// The next argument of the call, parsed by the frame above
+    PRATT_ARGUMENT,
+} PrattState;
+
+/// What is done to the value of a frame when it is complete
+typedef enum pratt_wrap {
+    PRATT_WRAP_NONE,
+    /// The closing parenthesis has to follow
+    PRATT_WRAP_PAREN,
+    PRATT_WRAP_NEGATE,
+    PRATT_WRAP_NOT,
+} PrattWrap;
+
+/// Operand on the right of ctx that is being parsed. The frames of the enclosing operands are kept on
+/// an explicit stack, so deeply nested parentheses, prefix operators, ternaries and calls do not overflow the C stack
+typedef struct pratt_frame {
+    int ctx;
+    /// Infix operator whose right operand is parsed by the frame above
+    int op;
+    PrattState state;
+    PrattWrap wrap;
+    /// Left operand, then the right one and the false branch of a ternary
+    ExprId params[3];
+    /// Call whose arguments are parsed by the frames above, they are stored in PrattArgs from arg_start
+    AstExprType call_type;
+    const Ident *call_id;
+    size_t arg_start;
+    /// Last token of the enclosing expression before the call
+    Token last;
+} PrattFrame;
+
+/// Stack of the frames, it starts in a buffer on the C stack and moves to the heap when that is full
+typedef struct pratt_stack {
+    PrattFrame *frames;
+    size_t count;
+    size_t capacity;
+    PrattFrame inline_frames[_PRATT_INLINE_DEPTH];
+} PrattStack;
+
+/// Arguments of the calls being parsed, those of a nested call follow the ones of the calls around it.
+/// It starts in a buffer on the C stack and moves to the heap when that is full
+typedef struct pratt_args {
+    ExprId *items;
+    size_t count;
+    size_t capacity;
+    ExprId inline_items[_ARGS_BUF_SIZE];
+} PrattArgs;
+
+/// Pushes a frame for the operand on the right of ctx, returns NULL if allocation failed
+static PrattFrame *pratt_push(PrattStack *stack, int ctx, PrattWrap wrap) {
+    if (stack->count == stack->capacity) {
+        size_t capacity = stack->capacity * 2;
+        PrattFrame *frames;
+        if (stack->frames == stack->inline_frames) {
+            frames = malloc(capacity * sizeof(PrattFrame));
+            if (frames != NULL) {
+                memcpy(frames, stack->frames, stack->count * sizeof(PrattFrame));
+            }
+        } else {
+            frames = realloc(stack->frames, capacity * sizeof(PrattFrame));
+        }
+        if (frames == NULL) {
+            return NULL;
+        }
+        stack->frames = frames;
+        stack->capacity = capacity;
+    }
+
+    PrattFrame *frame = &stack->frames[stack->count++];
+    *frame = (PrattFrame){ .ctx = ctx, .state = PRATT_OPERAND, .wrap = wrap };
+    return frame;
+}
+
+/// Appends an argument, returns false if allocation failed
+static bool pratt_push_arg(PrattArgs *args, ExprId arg) {
+    if (args->count == args->capacity) {
+        size_t capacity = args->capacity * 2;
+        ExprId *items;
+        if (args->items == args->inline_items) {
+            items = malloc(capacity * sizeof(ExprId));
+            if (items != NULL) {
+                memcpy(items, args->items, args->count * sizeof(ExprId));
+            }
+        } else {
+            items = realloc(args->items, capacity * sizeof(ExprId));
+        }
+        if (items == NULL) {
+            return false;
+        }
+        args->items = items;
+        args->capacity = capacity;
+    }
+
+    args->items[args->count++] = arg;
+    return true;
+}
+
+/// Reads the next token, skipping EOLs after operators the same way the table engine does.
+/// An EOL that ends the expression is returned
+static ErrorCode next_token(PrattParser *parser, Token *tok) {
+    while (1) {
+        if (lexer_get_token(parser->lexer, tok) != ERR_LEX_OK) return LEXICAL_ERROR;
+        if (tok->type != TOK_EOL) {
+            parser->last = *tok;
+            return OK;
+        }
+        if (!eol_possible(parser->last)) return OK;
+    }
+}
+
+/// Creates an expression node from the given children. The nodes of an expression that failed to parse
+/// are not freed, they belong to the AST like any other
+static ErrorCode create_node(AstExprs *exprs, AstExprType type, ExprId *params, size_t count, ExprId *out_expr) {
+    ExprId expr = ast_expr_create(exprs, type, count);
+    if (expr == EXPR_NONE) return INTERNAL_ERROR;
+    for (size_t i = 0; i < count; i++) EXPR_CHILD(exprs, expr, i) = params[i];
+    *out_expr = expr;
+    return OK;
+}
+
+/// Finishes the value of a complete frame, closes its parenthesis or applies its prefix operator
+static ErrorCode pratt_close(PrattParser *parser, PrattFrame *frame, ExprId *value) {
+    switch (frame->wrap) {
+    case PRATT_WRAP_PAREN: {
+        Token tok;
+        ErrorCode ec = next_token(parser, &tok);
+        if (ec == OK && tok.type != TOK_RIGHT_PAR) ec = SYNTACTIC_ERROR;
+        return ec;
+    }
+    case PRATT_WRAP_NEGATE:
+    case PRATT_WRAP_NOT:
+        return create_node(parser->exprs, frame->wrap == PRATT_WRAP_NEGATE ? EX_NEGATE : EX_NOT, value, 1, value);
+    default:
+        return OK;
+    }
+}
+
+/// Reads the token after a whole expression, only these can end it. The end of input is consumed
+static ErrorCode expect_end(PrattParser *parser) {
+    Token tok;
+    ErrorCode ec = next_token(parser, &tok);
+    if (ec != OK) return ec;
+    switch (tok.type) {
+    case TOK_DOLLAR:
+        return OK;
+    case TOK_RIGHT_PAR:
+    case TOK_COMMA:
+    case TOK_RIGHT_BRACE:
+    case TOK_EOL:
+        lexer_unget_token(parser->lexer, &tok);
+        return OK;
+    default:
+        return SYNTACTIC_ERROR;
+    }
+}
+
+/// Reads the next token that is not an EOL without touching the last token of the expression
+static ErrorCode next_raw_token(Lexer *lexer, Token *tok) {
+    do {
+        if (lexer_get_token(lexer, tok) != ERR_LEX_OK) return LEXICAL_ERROR;
+    } while (tok->type == TOK_EOL);
+    return OK;
+}
+
+/// Pushes the frame of the next argument of the call in the top frame, an argument is a whole expression
+static ErrorCode pratt_push_argument(PrattParser *parser, PrattStack *stack) {
+    parser->last = (Token){ .type = TOK_OP_PLUS };
+    if (pratt_push(stack, PREC_DOLLAR, PRATT_WRAP_NONE) == NULL) return INTERNAL_ERROR;
+    return OK;
+}
+
+/// Creates the node of a call from its arguments, same as reduce_function_call
+static ErrorCode pratt_close_call(PrattParser *parser, PrattFrame *frame, PrattArgs *args) {
+    parser->last = frame->last;
+    frame->state = PRATT_INFIX;
+    ErrorCode ec = create_node(parser->exprs, frame->call_type, &args->items[frame->arg_start], args->count - frame->arg_start, &frame->params[0]);
+    args->count = frame->arg_start;
+    if (ec == OK) EXPR_IDENT(parser->exprs, frame->params[0]) = frame->call_id;
+    return ec;
+}
+
+/// Starts the call in the top frame after its opening parenthesis
+static ErrorCode pratt_open_call(PrattParser *parser, PrattStack *stack, PrattArgs *args) {
+    PrattFrame *frame = &stack->frames[stack->count - 1];
+    frame->arg_start = args->count;
+    frame->last = parser->last;
+
+    Token tok;
+    ErrorCode ec = next_raw_token(parser->lexer, &tok);
+    if (ec != OK) return ec;
+    if (tok.type == TOK_RIGHT_PAR) return pratt_close_call(parser, frame, args);
+
+    lexer_unget_token(parser->lexer, &tok);
+    frame->state = PRATT_ARGUMENT;
+    return pratt_push_argument(parser, stack);
+}
+
+/// Stores the argument of the call in the top frame, then closes the call or starts the next argument
+static ErrorCode pratt_argument(PrattParser *parser, PrattStack *stack, PrattArgs *args, ExprId value) {
+    if (!pratt_push_arg(args, value)) return INTERNAL_ERROR;
+    ErrorCode ec = expect_end(parser);
+    if (ec != OK) return ec;
+
+    Token tok;
+    ec = next_raw_token(parser->lexer, &tok);
+    if (ec != OK) return ec;
+    if (tok.type == TOK_RIGHT_PAR) return pratt_close_call(parser, &stack->frames[stack->count - 1], args);
+    // More parameters, next has to be a comma
+    if (tok.type != TOK_COMMA) return SYNTACTIC_ERROR;
+    return pratt_push_argument(parser, stack);
+}
+
+/// Parses Ifj.name( after the Ifj keyword, same as reduce_buildtin_call
+static ErrorCode parse_builtin_name(Lexer *lexer, const Ident **out_id) {
+    Token tok;
+    if (lexer_get_token(lexer, &tok) != ERR_LEX_OK) return LEXICAL_ERROR;
+    if (tok.type != TOK_OP_DOT) return SYNTACTIC_ERROR;
+
+    Token id;
+    ErrorCode ec = next_raw_token(lexer, &id);
+    if (ec != OK) return ec;
+    if (id.type != TOK_IDENTIFIER) return SYNTACTIC_ERROR;
+
+    if (lexer_get_token(lexer, &tok) != ERR_LEX_OK) return LEXICAL_ERROR;
+    if (tok.type != TOK_LEFT_PAR) return SYNTACTIC_ERROR;
+
+    *out_id = id.ident_val;
+    return OK;
+}
+
+/// Parses an operand that starts with tok and is not parenthesized or prefixed into params[0] of the frame.
+/// A call is only started, its type and name are stored in the frame and is_call is set
+static ErrorCode parse_operand(PrattParser *parser, Token *tok, PrattFrame *frame, bool *is_call) {
+    *is_call = false;
+    switch (tok->type) {
+    case TOK_IDENTIFIER: {
+        // Could be a function
+        Token next_tok;
+        if (lexer_get_token(parser->lexer, &next_tok) != ERR_LEX_OK) return LEXICAL_ERROR;
+        if (next_tok.type == TOK_LEFT_PAR) {
+            frame->call_type = EX_FUN;
+            frame->call_id = tok->ident_val;
+            *is_call = true;
+            return OK;
+        }
+        lexer_unget_token(parser->lexer, &next_tok);
+        break;
+    }
+    case TOK_KW_IFJ:
+        frame->call_type = EX_BUILTIN_FUN;
+        *is_call = true;
+        return parse_builtin_name(parser->lexer, &frame->call_id);
+    default:
+        if (calculate_table_idx(tok->type) != PREC_OPERAND) return SYNTACTIC_ERROR;
+        break;
+    }
+
+    frame->params[0] = create_operand_expr(parser->lexer, parser->exprs, tok);
+    if (frame->params[0] == EXPR_NONE) return INTERNAL_ERROR;
+    return OK;
+}
+
+/// Parses an operand followed by all operators that belong to the operand on the right of ctx
+static ErrorCode parse_binary(PrattParser *parser, int ctx, ExprId *out_expr) {
+    PrattStack stack = { .frames = stack.inline_frames, .count = 0, .capacity = _PRATT_INLINE_DEPTH };
+    PrattArgs args = { .items = args.inline_items, .count = 0, .capacity = _ARGS_BUF_SIZE };
+    pratt_push(&stack, ctx, PRATT_WRAP_NONE);
+    ErrorCode ec = OK;
+
+    while (ec == OK) {
+        PrattFrame *top = &stack.frames[stack.count - 1];
+        Token tok;
+
+        if (top->state == PRATT_OPERAND) {
+            ec = next_token(parser, &tok);
+            if (ec != OK) break;
+
+            if (tok.type == TOK_LEFT_PAR || tok.type == TOK_OP_MINUS || tok.type == TOK_OP_NOT) {
+                int op = tok.type == TOK_LEFT_PAR ? PREC_LEFT_PAR : calculate_table_idx(tok.type);
+                // The table does not allow a prefix operator everywhere, a * -b is an error
+                if (tok.type != TOK_LEFT_PAR && !BINDS(top->ctx, op)) {
+                    ec = SYNTACTIC_ERROR;
+                    break;
+                }
+                PrattWrap wrap = tok.type == TOK_LEFT_PAR ? PRATT_WRAP_PAREN : tok.type == TOK_OP_MINUS ? PRATT_WRAP_NEGATE : PRATT_WRAP_NOT;
+                // The inner expression becomes the operand of this frame once it is parsed
+                top->state = PRATT_WAIT_OPERAND;
+                if (pratt_push(&stack, op, wrap) == NULL) ec = INTERNAL_ERROR;
+                continue;
+            }
+
+            bool is_call;
+            ec = parse_operand(parser, &tok, top, &is_call);
+            if (ec != OK) break;
+            if (is_call) {
+                ec = pratt_open_call(parser, &stack, &args);
+            } else {
+                top->state = PRATT_INFIX;
+            }
+            continue;
+        }
+
+        // The frame has its left operand, it takes the operators that bind to it
+        ec = next_token(parser, &tok);
+        if (ec != OK) break;
+
+        int op = calculate_table_idx(tok.type);
+        bool infix = (op >= PREC_PLUS && op <= PREC_OR) || op == PREC_IS || op == PREC_QUESTION_MARK;
+        if (infix && BINDS(top->ctx, op)) {
+            top->op = op;
+            top->state = PRATT_RIGHT;
+            if (pratt_push(&stack, op, PRATT_WRAP_NONE) == NULL) ec = INTERNAL_ERROR;
+            continue;
+        }
+
+        // The operand is complete, the token is up to the enclosing frame
+        lexer_unget_token(parser->lexer, &tok);
+        ExprId value = top->params[0];
+
+        // Hands the value over to the enclosing frames until one of them needs more tokens
+        while (ec == OK) {
+            top = &stack.frames[stack.count - 1];
+            ec = pratt_close(parser, top, &value);
+            if (ec != OK) break;
+            if (--stack.count == 0) {
+                *out_expr = value;
+                break;
+            }
+
+            PrattFrame *parent = top - 1;
+            if (parent->state == PRATT_WAIT_OPERAND) {
+                // Parenthesized or prefixed operand, it still takes the operators that bind to it
+                parent->params[0] = value;
+                parent->state = PRATT_INFIX;
+                break;
+            }
+            if (parent->state == PRATT_ARGUMENT) {
+                ec = pratt_argument(parser, &stack, &args, value);
+                break;
+            }
+            if (parent->state == PRATT_RIGHT && parent->op == PREC_QUESTION_MARK) {
+                // Ternary, the true branch has to be followed by the colon
+                parent->params[1] = value;
+                ec = next_token(parser, &tok);
+                if (ec == OK && tok.type != TOK_OP_COLON) ec = SYNTACTIC_ERROR;
+                if (ec != OK) break;
+                parent->state = PRATT_FALSE;
+                if (pratt_push(&stack, PREC_COLON, PRATT_WRAP_NONE) == NULL) ec = INTERNAL_ERROR;
+                break;
+            }
+
+            if (parent->state == PRATT_RIGHT) {
+                parent->params[1] = value;
+                ec = create_node(parser->exprs, binary_expr[parent->op], parent->params, 2, &parent->params[0]);
+            } else {
+                parent->params[2] = value;
+                ec = create_node(parser->exprs, EX_TERNARY, parent->params, 3, &parent->params[0]);
+            }
+            parent->state = PRATT_INFIX;
+            break;
+        }
+        if (ec == OK && stack.count == 0) break;
+    }
+
+    if (stack.frames != stack.inline_frames) {
+        free(stack.frames);
+    }
+    if (args.items != args.inline_items) {
+        free(args.items);
+    }
+    return ec;
+}
+
+/// Parses a whole expression, the arguments of calls included
+static ErrorCode parse_top(Lexer *lexer, AstExprs *exprs, ExprId *out_expr) {
+    PrattParser parser = { .lexer = lexer, .exprs = exprs, .last = { .type = TOK_OP_PLUS } };
+
+    ExprId expr;
+    ErrorCode ec = parse_binary(&parser, PREC_DOLLAR, &expr);
+    if (ec == OK) ec = expect_end(&parser);
+    if (ec != OK) return ec;
+    *out_expr = expr;
+    return OK;
+}
+
+ErrorCode parse_expression_pratt(Lexer *lexer, AstExprs *exprs, ExprId *out_expr) {
+    size_t start = lexer_mark(lexer);
+    ErrorCode ec = parse_top(lexer, exprs, out_expr);
+    if (ec != SYNTACTIC_ERROR) return ec;
+
+    // Temporary shim until the Pratt engine reports errors on its own. The table engine notices some
+    // errors only a few tokens later and a lexical error in between wins, so it parses the expression
+    // again to report the same error at the same position. Errors end the compilation, so this is cheap.
+    // `make pratt_test` checks that both builds compile every test the same
+    lexer_rewind(lexer, start);
+    return parse_expression_table(lexer, exprs, out_expr);
+}
@@ -0,0 +1,165 @@
+/*
+ * intern.c
+ * Implements the global identifier interning pool
+ *
+ * IFJ project 2025
+ * FIT VUT
+ *
+ * Authors:
+ * Michal Šebesta (xsebesm00)
+ */
+#include "intern.h"
+#include <stdalign.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Size of the buffer composed spellings are built in before falling back to malloc
+#define _COMPOSE_BUF_SIZE 128
+
+/// Block of memory the handles are carved from
+typedef struct intern_chunk {
+    struct intern_chunk *next;
+    size_t used;
+    size_t capacity;
+    alignas(Ident) char data[];
+} InternChunk;
+
+/// The pool itself, an open addressing table of handles
+static struct {
+    const Ident **slots;
+    size_t capacity;
+    size_t size;
+    InternChunk *chunks;
+} pool = { NULL, 0, 0, NULL };
+
+// djb2, kept identical to the symtable hash so item placement does not change
+static unsigned long hash_bytes(const char *str, size_t length) {
+    unsigned long hash = 5381;
+    for (size_t i = 0; i < length; i++) {
+        hash = ((hash << 5) + hash) + (unsigned char)str[i];
+    }
+    return hash;
+}
+
+// Returns the slot holding the spelling or the empty slot it would be inserted to
+static size_t find_slot(const char *str, size_t length, unsigned long hash) {
+    size_t mask = pool.capacity - 1;
+    size_t idx = hash & mask;
+    while (pool.slots[idx] != NULL) {
+        const Ident *id = pool.slots[idx];
+        if (id->hash == hash && id->length == length && memcmp(id->val, str, length) == 0) {
+            return idx;
+        }
+        idx = (idx + 1) & mask;
+    }
+    return idx;
+}
+
+static bool grow_slots(void) {
+    size_t new_capacity = pool.capacity == 0 ? _INTERN_INITIAL_CAPACITY : pool.capacity * 2;
+    const Ident **new_slots = calloc(new_capacity, sizeof(const Ident *));
+    if (new_slots == NULL) return false;
+
+    for (size_t i = 0; i < pool.capacity; i++) {
+        const Ident *id = pool.slots[i];
+        if (id == NULL) continue;
+        size_t idx = id->hash & (new_capacity - 1);
+        while (new_slots[idx] != NULL) idx = (idx + 1) & (new_capacity - 1);
+        new_slots[idx] = id;
+    }
+
+    free(pool.slots);
+    pool.slots = new_slots;
+    pool.capacity = new_capacity;
+    return true;
+}
+
+// Carves space for a handle with the given spelling length out of the current chunk
+static Ident *alloc_ident(size_t length) {
+    size_t size = sizeof(Ident) + length + 1;
+    size = (size + alignof(Ident) - 1) & ~(alignof(Ident) - 1);
+
+    InternChunk *chunk = pool.chunks;
+    if (chunk == NULL || chunk->capacity - chunk->used < size) {
+        size_t capacity = size > _INTERN_CHUNK_SIZE ? size : _INTERN_CHUNK_SIZE;
+        chunk = malloc(sizeof(InternChunk) + capacity);
+        if (chunk == NULL) return NULL;
+        chunk->used = 0;
+        chunk->capacity = capacity;
+        chunk->next = pool.chunks;
+        pool.chunks = chunk;
+    }
+
+    Ident *id = (Ident *)(chunk->data + chunk->used);
+    chunk->used += size;
+    return id;
+}
+
+static const Ident *intern_hashed(const char *str, size_t length, unsigned long hash, bool insert) {
+    if (pool.capacity == 0) {
+        if (!insert) return NULL;
+        if (!grow_slots()) return NULL;
+    }
+
+    size_t idx = find_slot(str, length, hash);
+    if (pool.slots[idx] != NULL) return pool.slots[idx];
+    if (!insert) return NULL;
+
+    // Grow when load factor > 0.7
+    if ((pool.size + 1) * 10 >= pool.capacity * 7) {
+        if (!grow_slots()) return NULL;
+        idx = find_slot(str, length, hash);
+    }
+
+    Ident *id = alloc_ident(length);
+    if (id == NULL) return NULL;
+    id->hash = hash;
+    id->length = (unsigned)length;
+    memcpy(id->val, str, length);
+    id->val[length] = '\0';
+
+    pool.slots[idx] = id;
+    pool.size++;
+    return id;
+}
+
+const Ident *intern(const char *str, size_t length) {
+    return intern_hashed(str, length, hash_bytes(str, length), true);
+}
+
+const Ident *intern_cstr(const char *str) {
+    return intern(str, strlen(str));
+}
+
+const Ident *intern_compose(const char *prefix, const Ident *base, const char *suffix, bool insert) {
+    size_t prefix_len = prefix == NULL ? 0 : strlen(prefix);
+    size_t suffix_len = suffix == NULL ? 0 : strlen(suffix);
+    size_t length = prefix_len + base->length + suffix_len;
+
+    char stack_buf[_COMPOSE_BUF_SIZE];
+    char *buf = stack_buf;
+    if (length > _COMPOSE_BUF_SIZE) {
+        buf = malloc(length);
+        if (buf == NULL) return NULL;
+    }
+
+    if (prefix_len > 0) memcpy(buf, prefix, prefix_len);
+    memcpy(buf + prefix_len, base->val, base->length);
+    if (suffix_len > 0) memcpy(buf + prefix_len + base->length, suffix, suffix_len);
+
+    const Ident *id = intern_hashed(buf, length, hash_bytes(buf, length), insert);
+    if (buf != stack_buf) free(buf);
+    return id;
+}
+
+void intern_free_all(void) {
+    while (pool.chunks != NULL) {
+        InternChunk *next = pool.chunks->next;
+        free(pool.chunks);
+        pool.chunks = next;
+    }
+    free(pool.slots);
+    pool.slots = NULL;
+    pool.capacity = 0;
+    pool.size = 0;
+}
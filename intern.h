@@ -0,0 +1,45 @@
+/*
+ * intern.h
+ * Defines the global identifier interning pool
+ *
+ * IFJ project 2025
+ * FIT VUT
+ *
+ * Authors:
+ * Michal Šebesta (xsebesm00)
+ */
+#ifndef _INTERN_H_
+#define _INTERN_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define _INTERN_INITIAL_CAPACITY 256
+#define _INTERN_CHUNK_SIZE 8192
+
+/// Canonical immutable spelling of an identifier. The pool holds exactly one per distinct spelling,
+/// so two handles are equal if and only if the pointers are equal
+typedef struct ident {
+    /// djb2 hash of the spelling, the same one the symtable places its items with
+    unsigned long hash;
+    /// Length of the spelling without the null terminator
+    unsigned length;
+    /// The spelling itself, null terminated
+    char val[];
+} Ident;
+
+/// Returns the handle of the given spelling, adding it to the pool if it is not there yet.
+/// Returns NULL if allocation failed
+const Ident *intern(const char *str, size_t length);
+
+/// Returns the handle of the given null terminated spelling. Returns NULL if allocation failed
+const Ident *intern_cstr(const char *str);
+
+/// Returns the handle of prefix + base + suffix, where prefix and suffix may be NULL.
+/// If insert is false and the spelling was never interned, returns NULL without adding it
+const Ident *intern_compose(const char *prefix, const Ident *base, const char *suffix, bool insert);
+
+/// Frees the pool together with every handle it gave out
+void intern_free_all(void);
+
+#endif // !_INTERN_H_
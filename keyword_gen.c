@@ -0,0 +1,129 @@
+/*
+ * keyword_gen.c
+ * Build-time generator of the collision-free keyword hash table used by the lexer
+ *
+ * IFJ project 2025
+ * FIT VUT
+ *
+ * Authors:
+ * Michal Šebesta (xsebesm00)
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+
+// Largest multiplier tried for each hashed component
+#define _MAX_MULTIPLIER 32
+// Largest table tried before giving up
+#define _MAX_TABLE_SIZE 1024
+
+static const struct {
+    const char *kw;
+    const char *type;
+} keywords[] = {
+    {"class", "TOK_KW_CLASS"},
+    {"if", "TOK_KW_IF"},
+    {"else", "TOK_KW_ELSE"},
+    {"is", "TOK_OP_IS"},
+    {"null", "TOK_KW_NULL"},
+    {"return", "TOK_KW_RETURN"},
+    {"var", "TOK_KW_VAR"},
+    {"while", "TOK_KW_WHILE"},
+    {"Ifj", "TOK_KW_IFJ"},
+    {"static", "TOK_KW_STATIC"},
+    {"import", "TOK_KW_IMPORT"},
+    {"for", "TOK_KW_FOR"},
+    {"Num", "TOK_TYPE_NUM"},
+    {"String", "TOK_TYPE_STRING"},
+    {"Bool", "TOK_TYPE_BOOL"},
+    {"Null", "TOK_TYPE_NULL"},
+    {"true", "TOK_KW_TRUE"},
+    {"false", "TOK_KW_FALSE"},
+    {"in", "TOK_KW_IN"},
+};
+
+#define KEYWORD_COUNT (sizeof(keywords) / sizeof(keywords[0]))
+
+/// Hash keyed on the length and the first and last character.
+/// Must match the KEYWORD_HASH macro written into the generated header
+static unsigned hash(const char *kw, unsigned mul_len, unsigned mul_first, unsigned mul_last, unsigned size) {
+    size_t len = strlen(kw);
+    return (len * mul_len + (unsigned char)kw[0] * mul_first + (unsigned char)kw[len - 1] * mul_last) & (size - 1);
+}
+
+/// Returns true if the given multipliers place every keyword into its own slot
+static bool is_collision_free(unsigned mul_len, unsigned mul_first, unsigned mul_last, unsigned size) {
+    bool used[_MAX_TABLE_SIZE] = { false };
+    for (size_t i = 0; i < KEYWORD_COUNT; i++) {
+        unsigned h = hash(keywords[i].kw, mul_len, mul_first, mul_last, size);
+        if (used[h]) return false;
+        used[h] = true;
+    }
+    return true;
+}
+
+/// Finds the smallest table and multipliers for which the hash has no collisions
+static bool find_parameters(unsigned *mul_len, unsigned *mul_first, unsigned *mul_last, unsigned *size) {
+    for (*size = 1; *size < KEYWORD_COUNT; *size *= 2);
+    for (; *size <= _MAX_TABLE_SIZE; *size *= 2) {
+        for (*mul_len = 0; *mul_len < _MAX_MULTIPLIER; (*mul_len)++) {
+            for (*mul_first = 1; *mul_first < _MAX_MULTIPLIER; (*mul_first)++) {
+                for (*mul_last = 0; *mul_last < _MAX_MULTIPLIER; (*mul_last)++) {
+                    if (is_collision_free(*mul_len, *mul_first, *mul_last, *size)) return true;
+                }
+            }
+        }
+    }
+    return false;
+}
+
+int main() {
+    unsigned mul_len, mul_first, mul_last, size;
+    if (!find_parameters(&mul_len, &mul_first, &mul_last, &size)) {
+        fprintf(stderr, "keyword_gen: no collision-free hash found\n");
+        return 1;
+    }
+
+    size_t min_len = strlen(keywords[0].kw);
+    size_t max_len = min_len;
+    for (size_t i = 1; i < KEYWORD_COUNT; i++) {
+        size_t len = strlen(keywords[i].kw);
+        if (len < min_len) min_len = len;
+        if (len > max_len) max_len = len;
+    }
+
+    printf("/*\n"
+           " * keyword_table.h\n"
+           " * Collision-free keyword hash table\n"
+           " * Generated by keyword_gen, do not edit\n"
+           " */\n"
+           "#ifndef _KEYWORD_TABLE_H_\n"
+           "#define _KEYWORD_TABLE_H_\n"
+           "\n"
+           "#include \"token.h\"\n"
+           "\n"
+           "#define KEYWORD_MIN_LEN %zu\n"
+           "#define KEYWORD_MAX_LEN %zu\n"
+           "#define KEYWORD_TABLE_SIZE %u\n"
+           "\n"
+           "/// Slot of the keyword table the given identifier could be in\n"
+           "#define KEYWORD_HASH(id, len) (((len) * %uu + (unsigned char)(id)[0] * %uu"
+           " + (unsigned char)(id)[(len) - 1] * %uu) & (KEYWORD_TABLE_SIZE - 1))\n"
+           "\n"
+           "static const struct {\n"
+           "    const char *kw;\n"
+           "    unsigned char len;\n"
+           "    TokType type;\n"
+           "} keyword_table[KEYWORD_TABLE_SIZE] = {\n",
+           min_len, max_len, size, mul_len, mul_first, mul_last);
+    for (unsigned slot = 0; slot < size; slot++) {
+        for (size_t i = 0; i < KEYWORD_COUNT; i++) {
+            if (hash(keywords[i].kw, mul_len, mul_first, mul_last, size) != slot) continue;
+            printf("    [%u] = {\"%s\", %zu, %s},\n", slot, keywords[i].kw, strlen(keywords[i].kw), keywords[i].type);
+        }
+    }
+    printf("};\n"
+           "\n"
+           "#endif // !_KEYWORD_TABLE_H_\n");
+    return 0;
+}
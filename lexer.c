@@ -8,14 +8,46 @@
  * Authors:
  * Michal Šebesta (xsebesm00)
  */
+#define _POSIX_C_SOURCE 200809L
 #include "lexer.h"
 #include "string.h"
 #include "token.h"
+#include "intern.h"
+#include "keyword_table.h"
 #include <ctype.h>
 #include <string.h>
 #include <stdio.h>
 #include <stdbool.h>
 #include <stdlib.h>
+#include <limits.h>
+#include <math.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <pthread.h>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define _INPUT_READ_CHUNK 4096
+#define _LIT_ARENA_INIT_SIZE 256
+#define _TOKENS_INIT_SIZE 256
+// Inputs are lexed in parallel only when every chunk would be at least this big
+#ifndef _LEX_MIN_CHUNK_SIZE
+#define _LEX_MIN_CHUNK_SIZE (1 << 20)
+#endif
+#define _LEX_MAX_THREADS 16
+// Tests define _LEX_THREADS together with a small _LEX_MIN_CHUNK_SIZE to force the chunked path
+// regardless of the number of processors
+// Number literals shorter than this are converted without allocating
+#define _NUM_BUF_SIZE 64
+// Number literals with fewer significant bits and a smaller exponent are converted exactly without strtod
+#define _NUM_FAST_MANTISSA_LIMIT (UINT64_C(1) << 53)
+#define _NUM_FAST_EXPONENT_LIMIT 1000
 
 typedef enum lex_fsm_state {
     S_START,
@@ -59,40 +91,320 @@ typedef enum lex_fsm_state {
     S_GLOBAL_VAR,
 } LexFsmState;
 
+/// Maps the input if it is a regular file we can map from its start
+static bool lexer_map_input(Lexer *lexer, FILE *input_stream) {
+    int fd = fileno(input_stream);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size <= 0) return false;
+    // Nothing may have been consumed from the stream yet
+    if (lseek(fd, 0, SEEK_CUR) != 0) return false;
+
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) return false;
+
+    lexer->src = data;
+    lexer->src_len = st.st_size;
+    lexer->src_mapped = true;
+    return true;
+}
+
+/// Reads the whole input stream into a heap buffer
+static bool lexer_read_input(Lexer *lexer, FILE *input_stream) {
+    size_t capacity = _INPUT_READ_CHUNK;
+    size_t length = 0;
+    char *data = malloc(capacity);
+    if (data == NULL) return false;
+
+    size_t read;
+    while ((read = fread(data + length, 1, capacity - length, input_stream)) > 0) {
+        length += read;
+        if (length < capacity) continue;
+        char *new_data = realloc(data, capacity * 2);
+        if (new_data == NULL) {
+            free(data);
+            return false;
+        }
+        data = new_data;
+        capacity *= 2;
+    }
+    if (ferror(input_stream)) {
+        free(data);
+        return false;
+    }
+
+    lexer->src = data;
+    lexer->src_len = length;
+    lexer->src_mapped = false;
+    return true;
+}
+
+/// Releases the in-memory copy of the input
+static void lexer_free_input(Lexer *lexer) {
+    if (lexer->src_mapped) {
+        munmap((void *)lexer->src, lexer->src_len);
+    } else {
+        free((void *)lexer->src);
+    }
+    lexer->src = NULL;
+    lexer->src_len = 0;
+}
+
 bool lexer_init(Lexer *lexer, FILE *input_stream) {
-    String *buf1 = str_init();
-    if (buf1 == NULL) { goto ERR_BUF1; }
-    String *buf2 = str_init();
-    if (buf2 == NULL) { goto ERR_BUF2; }
+    lexer->src_pos = 0;
+    if (!lexer_map_input(lexer, input_stream) && !lexer_read_input(lexer, input_stream)) {
+        return false;
+    }
+    // Token text offsets are 32-bit and the literal arena is never larger than the input
+    if (lexer->src_len > UINT_MAX / 2) {
+        lexer_free_input(lexer);
+        return false;
+    }
 
     lexer->file = input_stream;
-    lexer->pos_char = 0;
-    lexer->pos_line = 1;
-    lexer->last_char_was_newline = false;
-    lexer->buf1 = buf1;
-    lexer->buf2 = buf2;
-    lexer->no_ungot_tokens = 0;
+    lexer->newlines = NULL;
+    lexer->newline_count = 0;
+    lexer->lit_arena = NULL;
+    lexer->lit_arena_len = 0;
+    lexer->lit_arena_cap = 0;
+    lexer->tokens = NULL;
+    lexer->token_count = 0;
+    lexer->token_cap = 0;
+    lexer->cursor = 0;
+    lexer->furthest = 0;
+    lexer->lex_error = ERR_LEX_OK;
+    lexer->lex_error_pos = 0;
+    lexer->defer_intern = false;
+    lexer->static_count = 0;
 
     return true;
-
-ERR_BUF2:
-    str_free(&lexer->buf1);
-ERR_BUF1:
-    return false;
 }
 
 void lexer_free(Lexer *lexer) {
-    for (unsigned i = 0; i < lexer->no_ungot_tokens; i++) {
-        token_free(lexer->ungot_tokens + i);
-    }
-    str_free(&lexer->buf1);
-    str_free(&lexer->buf2);
+    // The stream holds only lexed tokens, which own nothing
+    free(lexer->tokens);
+    lexer->tokens = NULL;
+    free(lexer->lit_arena);
+    lexer->lit_arena = NULL;
+    free(lexer->newlines);
+    lexer->newlines = NULL;
+    lexer_free_input(lexer);
     lexer->file = NULL;
 }
 
-bool hex2int(char *hexStr, long *out) {
+const char *lexer_token_text(const Lexer *lexer, const Token *tok) {
+    if (tok->text.offset < lexer->src_len) {
+        return lexer->src + tok->text.offset;
+    }
+    return lexer->lit_arena + (tok->text.offset - lexer->src_len);
+}
+
+String *lexer_token_string(const Lexer *lexer, const Token *tok) {
+    String *str = str_init();
+    if (str == NULL) return NULL;
+
+    const char *text = lexer_token_text(lexer, tok);
+    // Strings are null terminated all the way to the generated code,
+    // so a \x00 escape sequence ends the literal
+    const char *end = memchr(text, '\0', tok->text.length);
+    unsigned length = end == NULL ? tok->text.length : (unsigned)(end - text);
+    if (!str_append_n(str, text, length)) {
+        str_free(&str);
+        return NULL;
+    }
+    return str;
+}
+
+/// Appends a character to the literal arena. Returns false if allocation failed
+static bool lit_arena_push(Lexer *lexer, char ch) {
+    if (lexer->lit_arena_len == lexer->lit_arena_cap) {
+        size_t new_cap = lexer->lit_arena_cap == 0 ? _LIT_ARENA_INIT_SIZE : lexer->lit_arena_cap * 2;
+        char *new_arena = realloc(lexer->lit_arena, new_cap);
+        if (new_arena == NULL) return false;
+        lexer->lit_arena = new_arena;
+        lexer->lit_arena_cap = new_cap;
+    }
+    lexer->lit_arena[lexer->lit_arena_len++] = ch;
+    return true;
+}
+
+/// Copies the already read part of a literal into the arena, so escape sequences can be decoded after it.
+/// Returns false if allocation failed
+static bool lit_arena_begin(Lexer *lexer, size_t start, size_t end) {
+    for (size_t i = start; i < end; i++) {
+        if (!lit_arena_push(lexer, lexer->src[i])) return false;
+    }
+    return true;
+}
+
+/// Whitespace skipped between tokens. The newline is not one of them, it is a token
+#define IS_BLANK(c) ((c) == ' ' || (c) == '\t' || (c) == '\v' || (c) == '\f' || (c) == '\r')
+
+/// Returns the offset of the first character at or after pos that is not blank, or len
+static size_t scan_blanks(const char *src, size_t pos, size_t len) {
+#ifdef __AVX2__
+    // The same test as the SSE2 one below on 32 bytes at a time, that one then handles the tail
+    const __m256i space32 = _mm256_set1_epi8(' ');
+    const __m256i newline32 = _mm256_set1_epi8('\n');
+    const __m256i below_tab32 = _mm256_set1_epi8('\t' - 1);
+    const __m256i above_cr32 = _mm256_set1_epi8('\r' + 1);
+    for (; pos + 32 <= len; pos += 32) {
+        __m256i block = _mm256_loadu_si256((const __m256i *)(src + pos));
+        __m256i control = _mm256_and_si256(_mm256_cmpgt_epi8(block, below_tab32), _mm256_cmpgt_epi8(above_cr32, block));
+        control = _mm256_andnot_si256(_mm256_cmpeq_epi8(block, newline32), control);
+        __m256i blank = _mm256_or_si256(control, _mm256_cmpeq_epi8(block, space32));
+        unsigned mask = ~(unsigned)_mm256_movemask_epi8(blank);
+        if (mask != 0) return pos + __builtin_ctz(mask);
+    }
+#endif
+#ifdef __SSE2__
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i newline = _mm_set1_epi8('\n');
+    const __m128i below_tab = _mm_set1_epi8('\t' - 1);
+    const __m128i above_cr = _mm_set1_epi8('\r' + 1);
+    for (; pos + 16 <= len; pos += 16) {
+        __m128i block = _mm_loadu_si128((const __m128i *)(src + pos));
+        // Blanks are the space and everything from '\t' to '\r' except the newline
+        __m128i control = _mm_and_si128(_mm_cmpgt_epi8(block, below_tab), _mm_cmplt_epi8(block, above_cr));
+        control = _mm_andnot_si128(_mm_cmpeq_epi8(block, newline), control);
+        __m128i blank = _mm_or_si128(control, _mm_cmpeq_epi8(block, space));
+        unsigned mask = ~(unsigned)_mm_movemask_epi8(blank) & 0xFFFF;
+        if (mask != 0) return pos + __builtin_ctz(mask);
+    }
+#endif
+    while (pos < len && IS_BLANK(src[pos])) pos++;
+    return pos;
+}
+
+/// Returns the offset of the first occurrence of a or b at or after pos, or len
+static size_t scan_for(const char *src, size_t pos, size_t len, char a, char b) {
+#ifdef __AVX2__
+    const __m256i va32 = _mm256_set1_epi8(a);
+    const __m256i vb32 = _mm256_set1_epi8(b);
+    for (; pos + 32 <= len; pos += 32) {
+        __m256i block = _mm256_loadu_si256((const __m256i *)(src + pos));
+        __m256i found = _mm256_or_si256(_mm256_cmpeq_epi8(block, va32), _mm256_cmpeq_epi8(block, vb32));
+        unsigned mask = (unsigned)_mm256_movemask_epi8(found);
+        if (mask != 0) return pos + __builtin_ctz(mask);
+    }
+#endif
+#ifdef __SSE2__
+    const __m128i va = _mm_set1_epi8(a);
+    const __m128i vb = _mm_set1_epi8(b);
+    for (; pos + 16 <= len; pos += 16) {
+        __m128i block = _mm_loadu_si128((const __m128i *)(src + pos));
+        __m128i found = _mm_or_si128(_mm_cmpeq_epi8(block, va), _mm_cmpeq_epi8(block, vb));
+        unsigned mask = (unsigned)_mm_movemask_epi8(found);
+        if (mask != 0) return pos + __builtin_ctz(mask);
+    }
+#endif
+    while (pos < len && src[pos] != a && src[pos] != b) pos++;
+    return pos;
+}
+
+/// Converts the decimal number literal in the given slice of the input. Returns false if allocation failed
+static bool convert_decimal(const char *text, size_t len, double *out) {
+    // strtod needs a terminated copy, the input itself is not terminated
+    char buf[_NUM_BUF_SIZE];
+    char *num = len < _NUM_BUF_SIZE ? buf : malloc(len + 1);
+    if (num == NULL) return false;
+    memcpy(num, text, len);
+    num[len] = '\0';
+    *out = strtod(num, NULL); // Should not fail
+    if (num != buf) free(num);
+    return true;
+}
+
+/// Exactly representable powers of ten
+static const double pow10_exact[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+/// Converts the decimal number literal in the given slice of the input, which the lexer already checked
+/// the format of. exact_int is set if the value is an integer. Returns false if allocation failed
+static bool parse_decimal(const char *text, size_t len, double *out, bool *exact_int) {
+    // The digits of the integer and fractional part together, as long as they fit into 53 bits
+    uint64_t mantissa = 0;
+    unsigned frac_digits = 0;
+    bool exact = true;
+    size_t i = 0;
+    for (; i < len && isdigit((unsigned char)text[i]); i++) {
+        mantissa = mantissa * 10 + (text[i] - '0');
+        if (mantissa >= _NUM_FAST_MANTISSA_LIMIT) exact = false;
+    }
+    if (i < len && text[i] == '.') {
+        for (i++; i < len && isdigit((unsigned char)text[i]); i++) {
+            mantissa = mantissa * 10 + (text[i] - '0');
+            frac_digits++;
+            if (mantissa >= _NUM_FAST_MANTISSA_LIMIT) exact = false;
+        }
+    }
+    int exponent = 0;
+    if (i < len) {
+        // The exponent
+        bool negative = false;
+        i++;
+        if (text[i] == '+' || text[i] == '-') negative = text[i++] == '-';
+        for (; i < len && exponent <= _NUM_FAST_EXPONENT_LIMIT; i++) {
+            exponent = exponent * 10 + (text[i] - '0');
+        }
+        if (exponent > _NUM_FAST_EXPONENT_LIMIT) exact = false;
+        if (negative) exponent = -exponent;
+    }
+
+    // The mantissa may have overflowed, but then exact is not set anymore
+    if (exact && mantissa == 0) {
+        *out = 0.0;
+        *exact_int = true;
+        return true;
+    }
+    exponent -= (int)frac_digits;
+    if (exact && exponent >= 0 && exponent <= 22) {
+        // Both operands are exact, so the single rounding of the product is the correct one
+        *out = (double)mantissa * pow10_exact[exponent];
+        *exact_int = true;
+        return true;
+    }
+    if (exact && exponent < 0 && exponent >= -22) {
+        *out = (double)mantissa / pow10_exact[-exponent];
+        // With the mantissa below 2^53 the quotient cannot round to an integer unless it is one
+        if (exponent < -19) {
+            *exact_int = false;
+        } else {
+            uint64_t divisor = 1;
+            for (int e = exponent; e < 0; e++) divisor *= 10;
+            *exact_int = mantissa % divisor == 0;
+        }
+        return true;
+    }
+
+    // Hard cases are left to strtod
+    if (!convert_decimal(text, len, out)) return false;
+    *exact_int = floor(*out) == *out;
+    return true;
+}
+
+/// Converts the hexadecimal digits of a number literal, which the lexer already checked
+static double parse_hex(const char *digits, size_t len) {
+    uint64_t val = 0;
+    size_t i = 0;
+    for (; i < len && val <= UINT64_MAX >> 4; i++) {
+        char c = digits[i];
+        val = val * 16 + (isdigit((unsigned char)c) ? c - '0' : (c | 0x20) - 'a' + 10);
+    }
+    double result = (double)val;
+    // Digits that do not fit into 64 bits only scale the value
+    for (; i < len; i++) {
+        char c = digits[i];
+        result = result * 16 + (isdigit((unsigned char)c) ? c - '0' : (c | 0x20) - 'a' + 10);
+    }
+    return result;
+}
+
+bool hex2int(const char *hexStr, size_t len, long *out) {
     int val = 0;
-    for (int i = 0; hexStr[i] != '\0'; i++) {
+    for (size_t i = 0; i < len; i++) {
         char c = tolower(hexStr[i]);
         val *= 16;
         if (isdigit(c)) {
@@ -109,86 +421,75 @@ bool hex2int(char *hexStr, long *out) {
     return true;
 }
 
-/// Returns true if the given string contains only whitespace characters
-bool is_just_whitespace(char *str) {
-    while (*str != '\0') {
-        if (!isspace(*str)) return false;
-        str++;
+/// Returns true if the given slice contains only whitespace characters
+bool is_just_whitespace(const char *str, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        if (!isspace((unsigned char)str[i])) return false;
     }
     return true;
 }
 
-/// Returns keyword tokType if the string is a keyword or TOK_IDENTIFIER
-TokType check_keyword(char* id) {
-    static struct {
-        char *kw;
-        TokType type;
-    } keywordTable[] = {
-        {"class", TOK_KW_CLASS},
-        {"if", TOK_KW_IF},
-        {"else", TOK_KW_ELSE},
-        {"is", TOK_OP_IS},
-        {"null", TOK_KW_NULL},
-        {"return", TOK_KW_RETURN},
-        {"var", TOK_KW_VAR},
-        {"while", TOK_KW_WHILE},
-        {"Ifj", TOK_KW_IFJ},
-        {"static", TOK_KW_STATIC},
-        {"import", TOK_KW_IMPORT},
-        {"for", TOK_KW_FOR},
-        {"Num", TOK_TYPE_NUM},
-        {"String", TOK_TYPE_STRING},
-        {"Bool", TOK_TYPE_BOOL},
-        {"Null", TOK_TYPE_NULL},
-        {"true", TOK_KW_TRUE},
-        {"false", TOK_KW_FALSE},
-        {"in", TOK_KW_IN},
-        {"", TOK_IDENTIFIER}, // End marker
-    };
-
-    for (int i = 0; keywordTable[i].kw[0] != '\0'; i++) {
-        if (strcmp(keywordTable[i].kw, id) != 0) continue;
-        // Found keyword
-        return keywordTable[i].type;
-    }
-
-    return TOK_IDENTIFIER;
+TokType check_keyword(const char *id, size_t len) {
+    if (len < KEYWORD_MIN_LEN || len > KEYWORD_MAX_LEN) return TOK_IDENTIFIER;
+    // The table is collision-free, so the only candidate is in this slot
+    unsigned slot = KEYWORD_HASH(id, len);
+    if (keyword_table[slot].len != len || memcmp(keyword_table[slot].kw, id, len) != 0) {
+        return TOK_IDENTIFIER;
+    }
+    return keyword_table[slot].type;
 }
 
 #define FOUND_TOK(token) {tok->type = token; found_tok=true; continue;}
 #define MOVE_STATE(s) {state = s; continue;}
-#define UNGET { ungetc(ch, lexer->file); lexer->pos_char--; lexer->last_char_was_newline = false; }
+#define NEXT_CHAR (lexer->src_pos < lexer->src_len ? (unsigned char)lexer->src[lexer->src_pos++] : EOF)
+#define UNGET lexer->src_pos--
+// Sets the token text to the given slice of the input
+#define SET_TEXT(start, end) { tok->text.offset = (unsigned)(start); tok->text.length = (unsigned)((end) - (start)); }
+// Appends a decoded character of a string literal. Only literals with escape sequences are copied
+#define LIT_APPEND(c) { if (lit_escaped && !lit_arena_push(lexer, (c))) return ERR_LEX_MALLOC; }
+// Switches the current string literal to being decoded into the arena
+#define LIT_BEGIN_ESCAPED { \
+    if (!lit_escaped) { \
+        lit_arena_start = lexer->lit_arena_len; \
+        if (!lit_arena_begin(lexer, lit_start, lexer->src_pos - 1)) return ERR_LEX_MALLOC; \
+        lit_escaped = true; \
+    } \
+}
+// Converts the decimal number literal that ends at the current position
+#define NUM_FOUND { \
+    bool exact_int; \
+    if (!parse_decimal(lexer->src + tok_start, lexer->src_pos - tok_start, &tok->double_val, &exact_int)) return ERR_LEX_MALLOC; \
+    FOUND_TOK(exact_int ? TOK_LIT_INT : TOK_LIT_NUM); \
+}
+// Appends the current line of a multiline literal, ending at end, to the literal
+#define ML_FLUSH(end) { if (ml_end == ml_start) ml_start = ml_line_start; ml_end = (end); ml_line_start = (end); }
 
 ErrLex lexer_read_token_from_file(Lexer *lexer, Token *tok) {
     LexFsmState state = S_START;
 
-    // Clears buffers
-    String *buf1 = lexer->buf1;
-    String *buf2 = lexer->buf2;
-    str_clear(buf1);
-    str_clear(buf2);
+    // Start of the token in the input
+    size_t tok_start = 0;
+    // Single line string literals. Their text is a slice of the input
+    // unless they contain escape sequences, then they are decoded into the arena
+    size_t lit_start = 0;
+    size_t lit_arena_start = 0;
+    bool lit_escaped = false;
+    // Multiline string literals. Their text is always a slice of the input,
+    // ml_line_start is the start of the line that was not appended yet
+    size_t ml_start = 0, ml_end = 0, ml_line_start = 0;
 
     unsigned comment_nest_level = 0;
 
     bool found_tok = false;
 
     int ch;
-    while (!found_tok && ((ch = fgetc(lexer->file)) != EOF)) {
-        // Increments position
-        if (lexer->last_char_was_newline) {
-            // We increment the line position AFTER reading the newline
-            lexer->pos_char = 0;
-            lexer->pos_line++;
-        }
-        lexer->pos_char++;
-        lexer->last_char_was_newline = ch == '\n';
-
+    while (!found_tok && ((ch = NEXT_CHAR) != EOF)) {
         // FSM
         switch (state) {
         case S_START:
             // Sets the token position at the start
-            tok->pos_char = lexer->pos_char;
-            tok->pos_line = lexer->pos_line;
+            tok_start = lexer->src_pos - 1;
+            tok->pos = (unsigned)tok_start;
             switch (ch) {
                 case '\n': FOUND_TOK(TOK_EOL);
                 case '(': FOUND_TOK(TOK_LEFT_PAR);
@@ -209,13 +510,17 @@ ErrLex lexer_read_token_from_file(Lexer *lexer, Token *tok) {
                 case '<': MOVE_STATE(S_LESS_THAN);
                 case '!': MOVE_STATE(S_EXCLAMATION);
                 case '=': MOVE_STATE(S_EQ);
-                case '"': MOVE_STATE(S_STR_START);
-                case '0': str_append_char(buf1, ch); MOVE_STATE(S_ZERO);
-                case '_': str_append_char(buf1, ch); MOVE_STATE(S_GLOBAL_VAR_START);
+                case '"': lit_start = lexer->src_pos; MOVE_STATE(S_STR_START);
+                case '0': MOVE_STATE(S_ZERO);
+                case '_': MOVE_STATE(S_GLOBAL_VAR_START);
+            }
+            if (isdigit(ch)) MOVE_STATE(S_INT_LIT);
+            if (isalpha(ch)) MOVE_STATE(S_IDENTIFIER);
+            if (IS_BLANK(ch)) {
+                // Skips the whole run of blanks at once
+                lexer->src_pos = scan_blanks(lexer->src, lexer->src_pos, lexer->src_len);
+                continue;
             }
-            if (isdigit(ch)) { str_append_char(buf1, ch); MOVE_STATE(S_INT_LIT); }
-            if (isalpha(ch)) { str_append_char(buf1, ch); MOVE_STATE(S_IDENTIFIER); }
-            if (isspace(ch)) continue;
             return ERR_LEX_UNEXPECTED_CHARACTER;
         case S_LESS_THAN:
             if (ch == '=') FOUND_TOK(TOK_OP_LESS_EQ);
@@ -240,10 +545,14 @@ ErrLex lexer_read_token_from_file(Lexer *lexer, Token *tok) {
             FOUND_TOK(TOK_OP_DIV);
         case S_COMMENT:
             if (ch == '\n') FOUND_TOK(TOK_EOL)
+            // Nothing but the newline matters, skips right before it
+            lexer->src_pos = scan_for(lexer->src, lexer->src_pos, lexer->src_len, '\n', '\n');
             continue;
         case S_MULTILINE_COMMENT:
             if (ch == '*') MOVE_STATE(S_MULTILINE_COMMENT_END);
             if (ch == '/') MOVE_STATE(S_MULTILINE_COMMENT_NEW_NEST_LEVEL);
+            // Only the comment delimiters matter, skips right before the next one
+            lexer->src_pos = scan_for(lexer->src, lexer->src_pos, lexer->src_len, '*', '/');
             continue;
         case S_MULTILINE_COMMENT_NEW_NEST_LEVEL:
             if (ch == '*') comment_nest_level++;
@@ -260,21 +569,22 @@ ErrLex lexer_read_token_from_file(Lexer *lexer, Token *tok) {
         case S_STR_START:
             if (ch == '"') MOVE_STATE(S_STR_EMPTY);
             if (ch == '\n') return ERR_LEX_NL_IN_STRING_LITERAL;
-            if (ch == '\\') MOVE_STATE(S_STR_ESCAPE);
+            if (ch == '\\') { LIT_BEGIN_ESCAPED; MOVE_STATE(S_STR_ESCAPE); }
             if (ch < 32) return ERR_LEX_INVALID_CHAR_IN_STRING;
-            str_append_char(buf1, ch);
             MOVE_STATE(S_STR_INSIDE);
         case S_STR_INSIDE:
             if (ch == '"') {
-                tok->string_val = str_init();
-                if (tok->string_val == NULL) return ERR_LEX_MALLOC;
-                str_append_string(tok->string_val, buf1->val);
+                if (lit_escaped) {
+                    SET_TEXT(lexer->src_len + lit_arena_start, lexer->src_len + lexer->lit_arena_len);
+                } else {
+                    SET_TEXT(lit_start, lexer->src_pos - 1);
+                }
                 FOUND_TOK(TOK_LIT_STRING);
             }
             if (ch == '\n') return ERR_LEX_NL_IN_STRING_LITERAL;
-            if (ch == '\\') MOVE_STATE(S_STR_ESCAPE);
+            if (ch == '\\') { LIT_BEGIN_ESCAPED; MOVE_STATE(S_STR_ESCAPE); }
             if (ch < 32) return ERR_LEX_INVALID_CHAR_IN_STRING;
-            str_append_char(buf1, ch);
+            LIT_APPEND(ch);
             continue;
         case S_STR_ESCAPE:
             if (ch == 'x') MOVE_STATE(S_STR_ESCAPE_CODE_1);
@@ -287,164 +597,140 @@ ErrLex lexer_read_token_from_file(Lexer *lexer, Token *tok) {
                 case '\\': escaped_char = '\\'; break;
             }
             if (escaped_char == 0) return ERR_LEX_STRING_UNEXPECTED_ESCAPE_SEQUENCE;
-            str_append_char(buf1, escaped_char);
+            LIT_APPEND(escaped_char);
             MOVE_STATE(S_STR_INSIDE);
         case S_STR_ESCAPE_CODE_1:
             // Filter invalid characters
             if ((ch < '0' || ch > '9') && (ch < 'a' || ch > 'f') && (ch < 'A' || ch > 'F')) {
                 return ERR_LEX_STRING_UNEXPECTED_ESCAPE_SEQUENCE;
             }
-            str_append_char(buf2, ch);
             MOVE_STATE(S_STR_ESCAPE_CODE_2);
-        case S_STR_ESCAPE_CODE_2:
-            str_append_char(buf2, ch);
+        case S_STR_ESCAPE_CODE_2: {
             long code;
-            if (!hex2int(buf2->val, &code)) return ERR_LEX_STRING_UNEXPECTED_ESCAPE_SEQUENCE;
-            str_clear(buf2);
-            str_append_char(buf1, code);
+            // Both digits of the code are the last two characters read
+            if (!hex2int(lexer->src + lexer->src_pos - 2, 2, &code)) return ERR_LEX_STRING_UNEXPECTED_ESCAPE_SEQUENCE;
+            LIT_APPEND(code);
             MOVE_STATE(S_STR_INSIDE);
+        }
         case S_STR_EMPTY:
-            if (ch == '"') MOVE_STATE(S_STR_MULTILINE_FIRST_LINE);
+            if (ch == '"') {
+                ml_line_start = ml_start = ml_end = lexer->src_pos;
+                MOVE_STATE(S_STR_MULTILINE_FIRST_LINE);
+            }
             UNGET;
-            tok->string_val = str_init();
-            if (tok->string_val == NULL) return ERR_LEX_MALLOC;
+            SET_TEXT(lit_start, lit_start);
             FOUND_TOK(TOK_LIT_STRING);
         case S_STR_MULTILINE_FIRST_LINE:
             if (ch == '\n') {
+                size_t newline = lexer->src_pos - 1;
                 // We don't append the first line if it just whitespace
-                if (!is_just_whitespace(buf2->val)) {
-                    str_append_string(buf1, buf2->val);
-                    str_clear(buf2);
-                    str_append_char(buf2, ch);
+                if (!is_just_whitespace(lexer->src + ml_line_start, newline - ml_line_start)) {
+                    ML_FLUSH(newline);
                     MOVE_STATE(S_STR_MULTILINE_INSIDE);
                 }
-                str_clear(buf2);
+                // Drops the newline too
+                ml_line_start = newline + 1;
                 MOVE_STATE(S_STR_MULTILINE_INSIDE);
             }
-            str_append_char(buf2, ch);
             // This will not return to the FIRST_LINE_STATE, but
             // it's fine because the state is here only to handle
             // empty first lines, which this will not be
             if (ch == '"') MOVE_STATE(S_STR_MULTILINE_END1);
             continue;
         case S_STR_MULTILINE_INSIDE:
-            if (ch == '\n') {
-                str_append_string(buf1, buf2->val);
-                str_clear(buf2);
-            }
-            str_append_char(buf2, ch);
+            if (ch == '\n') ML_FLUSH(lexer->src_pos - 1);
             if (ch == '"') MOVE_STATE(S_STR_MULTILINE_END1);
             continue;
         case S_STR_MULTILINE_END1:
-            if (ch == '\n') {
-                str_append_string(buf1, buf2->val);
-                str_clear(buf2);
-            }
-            str_append_char(buf2, ch);
+            if (ch == '\n') ML_FLUSH(lexer->src_pos - 1);
             if (ch == '"') MOVE_STATE(S_STR_MULTILINE_END2);
             MOVE_STATE(S_STR_MULTILINE_INSIDE);
         case S_STR_MULTILINE_END2:
             if (ch == '"') {
                 // End of literal
-                // Removes the two "" at the end
-                str_remove_last(buf2);
-                str_remove_last(buf2);
+                // The last line ends before the closing """
+                size_t line_end = lexer->src_pos - 3;
                 // We don't append the last line if it is just whitespace
                 // We append only if this is the only line
-                if (buf1->val[0] == '\0' || !is_just_whitespace(buf2->val)) {
-                    str_append_string(buf1, buf2->val);
+                if (ml_end == ml_start || !is_just_whitespace(lexer->src + ml_line_start, line_end - ml_line_start)) {
+                    ML_FLUSH(line_end);
                 }
-                tok->string_val = str_init();
-                if (tok->string_val == NULL) return ERR_LEX_MALLOC;
-                str_append_string(tok->string_val, buf1->val);
+                SET_TEXT(ml_start, ml_end);
                 FOUND_TOK(TOK_LIT_STRING);
             }
-            if (ch == '\n') {
-                str_append_string(buf1, buf2->val);
-                str_clear(buf2);
-            }
-            str_append_char(buf2, ch);
+            if (ch == '\n') ML_FLUSH(lexer->src_pos - 1);
             MOVE_STATE(S_STR_MULTILINE_INSIDE);
         case S_ZERO:
             if (ch == 'x') MOVE_STATE(S_INT_HEX_LIT);
             __attribute__ ((fallthrough));
         case S_INT_LIT:
-            str_append_char(buf1, ch);
             if (ch == 'e' || ch == 'E') MOVE_STATE(S_FLOAT_E);
             if (ch == '.') MOVE_STATE(S_FLOAT_DOT);
             if (isdigit(ch)) MOVE_STATE(S_INT_LIT);
             UNGET;
-            str_remove_last(buf1);
-            tok->double_val = strtod(buf1->val, NULL); // Should not fail
-            FOUND_TOK(TOK_LIT_NUM);
+            NUM_FOUND;
         case S_INT_HEX_LIT:
             if (isdigit(ch) || (ch >= 'a' && ch <= 'f') || (ch >= 'A' && ch <= 'F')) {
-                str_append_char(buf1, ch);
                 continue;
             }
             UNGET;
-            long val;
-            hex2int(buf1->val, &val); // Should not fail
-            tok->double_val = (double)val;
-            FOUND_TOK(TOK_LIT_NUM);
+            // Skips the 0x prefix
+            tok->double_val = parse_hex(lexer->src + tok_start + 2, lexer->src_pos - tok_start - 2);
+            FOUND_TOK(TOK_LIT_INT);
         case S_FLOAT_DOT:
             if (!isdigit(ch)) {
                 UNGET;
-                ungetc('.', lexer->file);
-                lexer->pos_char--;
-                lexer->last_char_was_newline = false;
-                tok->double_val = strtod(buf1->val, NULL); // Should not fail
-                FOUND_TOK(TOK_LIT_NUM);
+                UNGET; // Also returns the '.'
+                NUM_FOUND;
             }
-            str_append_char(buf1, ch);
             MOVE_STATE(S_FLOAT_DECIMAL);
         case S_FLOAT_E:
-            str_append_char(buf1, ch);
             if (ch == '+' || ch == '-') MOVE_STATE(S_FLOAT_E_SIGN);
             if (isdigit(ch)) MOVE_STATE(S_FLOAT_EXPONENT);
             return ERR_LEX_NUM_LIT_UNEXPECTED_CHARACTER;
         case S_FLOAT_E_SIGN:
-            str_append_char(buf1, ch);
             if (isdigit(ch)) MOVE_STATE(S_FLOAT_EXPONENT);
             return ERR_LEX_NUM_LIT_UNEXPECTED_CHARACTER;
         case S_FLOAT_DECIMAL:
-            if (ch == 'e' || ch == 'E') { str_append_char(buf1, 'e'); MOVE_STATE(S_FLOAT_E); }
+            if (ch == 'e' || ch == 'E') MOVE_STATE(S_FLOAT_E);
             __attribute__ ((fallthrough));
         case S_FLOAT_EXPONENT:
-            str_append_char(buf1, ch);
             if (isdigit(ch)) continue;
-            str_remove_last(buf1);
             UNGET;
-            tok->double_val = strtod(buf1->val, NULL); // Should not fail
-            FOUND_TOK(TOK_LIT_NUM);
+            NUM_FOUND;
         case S_IDENTIFIER:
             if (isalnum(ch) || ch == '_') {
-                str_append_char(buf1, ch);
                 continue;
             }
             UNGET;
-            TokType kwType = check_keyword(buf1->val);
+            TokType kwType = check_keyword(lexer->src + tok_start, lexer->src_pos - tok_start);
             if (kwType != TOK_IDENTIFIER) {
                 // Found keyword
                 FOUND_TOK(kwType);
             }
-            tok->string_val = str_init();
-            if (tok->string_val == NULL) return ERR_LEX_MALLOC;
-            str_append_string(tok->string_val, buf1->val);
+            if (lexer->defer_intern) {
+                // Interned later by the main thread
+                SET_TEXT(tok_start, lexer->src_pos);
+                FOUND_TOK(TOK_IDENTIFIER);
+            }
+            tok->ident_val = intern(lexer->src + tok_start, lexer->src_pos - tok_start);
+            if (tok->ident_val == NULL) return ERR_LEX_MALLOC;
             FOUND_TOK(TOK_IDENTIFIER);
         case S_GLOBAL_VAR_START:
-            str_append_char(buf1, ch);
             if (ch == '_') MOVE_STATE(S_GLOBAL_VAR);
             return ERR_LEX_EXPECTED_GLOBAL_VAR;
         case S_GLOBAL_VAR:
             if (isalnum(ch) || ch == '_') {
-                str_append_char(buf1, ch);
                 continue;
             }
             UNGET;
-            tok->string_val = str_init();
-            if (tok->string_val == NULL) return ERR_LEX_MALLOC;
-            str_append_string(tok->string_val, buf1->val);
+            if (lexer->defer_intern) {
+                // Interned later by the main thread
+                SET_TEXT(tok_start, lexer->src_pos);
+                FOUND_TOK(TOK_GLOBAL_VAR);
+            }
+            tok->ident_val = intern(lexer->src + tok_start, lexer->src_pos - tok_start);
+            if (tok->ident_val == NULL) return ERR_LEX_MALLOC;
             FOUND_TOK(TOK_GLOBAL_VAR);
         case S_AMPERSAND:
             if (ch == '&') FOUND_TOK(TOK_OP_AND);
@@ -474,20 +760,364 @@ ErrLex lexer_read_token_from_file(Lexer *lexer, Token *tok) {
     return ERR_LEX_UNKNOWN_ERR;
 }
 
-ErrLex lexer_get_token(Lexer *lexer, Token *tok) {
-    if (lexer->no_ungot_tokens > 0) {
-        *tok = lexer->ungot_tokens[--lexer->no_ungot_tokens];
-        return ERR_LEX_OK;
+/// Lexes from the current position to the end of the input into the token stream.
+/// Returns false if allocation failed
+static bool tokenize_sequential(Lexer *lexer) {
+    while (true) {
+        if (lexer->token_count == lexer->token_cap) {
+            size_t new_cap = lexer->token_cap == 0 ? _TOKENS_INIT_SIZE : lexer->token_cap * 2;
+            Token *new_tokens = realloc(lexer->tokens, new_cap * sizeof(Token));
+            if (new_tokens == NULL) return false;
+            lexer->tokens = new_tokens;
+            lexer->token_cap = new_cap;
+        }
+
+        Token *tok = lexer->tokens + lexer->token_count;
+        ErrLex err = lexer_read_token_from_file(lexer, tok);
+        if (err != ERR_LEX_OK) {
+            // The error is reported once the parser gets to it, so that errors before it take precedence
+            lexer->lex_error = err;
+            lexer->lex_error_pos = lexer->src_pos;
+            return true;
+        }
+        lexer->token_count++;
+        if (tok->type == TOK_DOLLAR) {
+            tok->pos = (unsigned)lexer->src_pos;
+            return true;
+        }
+    }
+}
+
+/// Finds where the input can be split into chunks that are lexed independently.
+/// A chunk starts right after a newline that is outside of literals and comments.
+/// Puts at most max_splits chunk starts into splits and returns their number
+static size_t find_split_points(const char *src, size_t len, size_t *splits, size_t max_splits) {
+    size_t chunk_size = len / (max_splits + 1);
+    size_t count = 0;
+    size_t target = chunk_size;
+    size_t pos = 0;
+    while (pos < len && count < max_splits) {
+        // Ordinary code up to the next literal or comment, any newline in it can be a split point
+        size_t next = scan_for(src, pos, len, '"', '/');
+        if (next > target) {
+            size_t newline = scan_for(src, pos > target ? pos : target, next, '\n', '\n');
+            if (newline < next && newline + 1 < len) {
+                splits[count++] = newline + 1;
+                target = newline + 1 + chunk_size;
+                pos = newline + 1;
+                continue;
+            }
+        }
+        if (next + 1 >= len) break;
+        pos = next + 1;
+
+        if (src[next] == '/') {
+            if (src[pos] == '/') {
+                // Line comment, ends with the newline which is a split point too
+                pos = scan_for(src, pos, len, '\n', '\n');
+            } else if (src[pos] == '*') {
+                unsigned nest_level = 1;
+                pos++;
+                while (nest_level > 0 && pos < len) {
+                    pos = scan_for(src, pos, len, '*', '/');
+                    if (pos + 1 >= len) {
+                        pos = len;
+                        break;
+                    }
+                    if (src[pos] == '/' && src[pos + 1] == '*') {
+                        nest_level++;
+                        pos += 2;
+                    } else if (src[pos] == '*' && src[pos + 1] == '/') {
+                        nest_level--;
+                        pos += 2;
+                    } else {
+                        pos++;
+                    }
+                }
+            }
+        } else if (pos + 1 < len && src[pos] == '"' && src[pos + 1] == '"') {
+            // Multiline string literal
+            pos += 2;
+            while (pos < len) {
+                pos = scan_for(src, pos, len, '"', '"');
+                if (pos + 2 < len && src[pos + 1] == '"' && src[pos + 2] == '"') {
+                    pos += 3;
+                    break;
+                }
+                pos++;
+            }
+        } else {
+            // Single line string literal, ends with a quote or a newline
+            while (pos < len) {
+                pos = scan_for(src, pos, len, '"', '\\');
+                if (pos >= len || src[pos] == '"') {
+                    pos++;
+                    break;
+                }
+                // Skips the escaped character
+                pos += 2;
+            }
+        }
+    }
+    return count;
+}
+
+/// Lexes the chunk it was given on a worker thread
+static void *tokenize_chunk(void *arg) {
+    Lexer *chunk = arg;
+    if (!tokenize_sequential(chunk)) chunk->lex_error = ERR_LEX_MALLOC;
+    return NULL;
+}
+
+/// Appends the tokens of a chunk to the token stream of the lexer, without the final TOK_DOLLAR
+/// unless it is the last chunk. Returns false if allocation failed
+static bool append_chunk(Lexer *lexer, Lexer *chunk, bool last) {
+    size_t count = last ? chunk->token_count : chunk->token_count - 1;
+    if (lexer->token_count + count > lexer->token_cap) {
+        size_t new_cap = lexer->token_count + count;
+        Token *new_tokens = realloc(lexer->tokens, new_cap * sizeof(Token));
+        if (new_tokens == NULL) return false;
+        lexer->tokens = new_tokens;
+        lexer->token_cap = new_cap;
+    }
+
+    // The literal arena of the chunk is appended to the one of the lexer
+    size_t arena_base = lexer->lit_arena_len;
+    if (arena_base + chunk->lit_arena_len > lexer->lit_arena_cap) {
+        size_t new_cap = arena_base + chunk->lit_arena_len;
+        char *new_arena = realloc(lexer->lit_arena, new_cap);
+        if (new_arena == NULL) return false;
+        lexer->lit_arena = new_arena;
+        lexer->lit_arena_cap = new_cap;
+    }
+    if (chunk->lit_arena_len > 0) memcpy(lexer->lit_arena + arena_base, chunk->lit_arena, chunk->lit_arena_len);
+    lexer->lit_arena_len += chunk->lit_arena_len;
+
+    for (size_t i = 0; i < count; i++) {
+        Token tok = chunk->tokens[i];
+        if (tok.type == TOK_LIT_STRING && tok.text.offset >= chunk->src_len) {
+            tok.text.offset = (unsigned)(tok.text.offset - chunk->src_len + lexer->src_len + arena_base);
+        } else if (tok.type == TOK_IDENTIFIER || tok.type == TOK_GLOBAL_VAR) {
+            tok.ident_val = intern(lexer->src + tok.text.offset, tok.text.length);
+            if (tok.ident_val == NULL) return false;
+        }
+        lexer->tokens[lexer->token_count++] = tok;
     }
-    return lexer_read_token_from_file(lexer, tok);
+    return true;
+}
+
+/// Lexes the input split into chunks on multiple threads. Returns false if it could not be done,
+/// because of a lexing error, a failed allocation or a chunk that did not end between tokens.
+/// The lexer is left untouched in that case, apart from identifiers added to the intern pool
+static bool tokenize_parallel(Lexer *lexer) {
+#ifdef _LEX_THREADS
+    long cpus = _LEX_THREADS;
+#else
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    size_t max_chunks = lexer->src_len / _LEX_MIN_CHUNK_SIZE;
+    if (cpus < (long)max_chunks) max_chunks = cpus < 1 ? 1 : (size_t)cpus;
+    if (max_chunks > _LEX_MAX_THREADS) max_chunks = _LEX_MAX_THREADS;
+    if (max_chunks < 2) return false;
+
+    size_t splits[_LEX_MAX_THREADS];
+    size_t split_count = find_split_points(lexer->src, lexer->src_len, splits, max_chunks - 1);
+    if (split_count == 0) return false;
+    size_t chunk_count = split_count + 1;
+
+    Lexer chunks[_LEX_MAX_THREADS];
+    pthread_t threads[_LEX_MAX_THREADS];
+    bool started[_LEX_MAX_THREADS] = { false };
+    for (size_t i = 0; i < chunk_count; i++) {
+        chunks[i] = *lexer;
+        chunks[i].file = NULL;
+        chunks[i].src_mapped = false;
+        chunks[i].src_pos = i == 0 ? 0 : splits[i - 1];
+        chunks[i].src_len = i == split_count ? lexer->src_len : splits[i];
+        chunks[i].newlines = NULL;
+        chunks[i].lit_arena = NULL;
+        chunks[i].lit_arena_len = chunks[i].lit_arena_cap = 0;
+        chunks[i].tokens = NULL;
+        chunks[i].token_count = chunks[i].token_cap = 0;
+        // The intern pool is not thread safe
+        chunks[i].defer_intern = true;
+    }
+
+    // The first chunk is lexed by this thread
+    for (size_t i = 1; i < chunk_count; i++) {
+        started[i] = pthread_create(threads + i, NULL, tokenize_chunk, chunks + i) == 0;
+        if (!started[i]) chunks[i].lex_error = ERR_LEX_UNKNOWN_ERR;
+    }
+    tokenize_chunk(chunks);
+    for (size_t i = 1; i < chunk_count; i++) {
+        if (started[i]) pthread_join(threads[i], NULL);
+    }
+
+    bool ok = true;
+    for (size_t i = 0; i < chunk_count; i++) {
+        if (chunks[i].lex_error != ERR_LEX_OK) ok = false;
+    }
+    for (size_t i = 0; ok && i < chunk_count; i++) {
+        ok = append_chunk(lexer, chunks + i, i == split_count);
+    }
+    for (size_t i = 0; i < chunk_count; i++) {
+        free(chunks[i].tokens);
+        free(chunks[i].lit_arena);
+    }
+
+    if (!ok) {
+        lexer->token_count = 0;
+        lexer->lit_arena_len = 0;
+        return false;
+    }
+    lexer->src_pos = lexer->src_len;
+    return true;
+}
+
+/// Counts the static definitions in the class body and the parameters and variables declared
+/// in each of them, so the symtables can be sized before they are filled
+static void count_declarations(Lexer *lexer) {
+    Token *definition = NULL;
+    size_t depth = 0;
+    bool in_params = false;
+    lexer->static_count = 0;
+    for (size_t i = 0; i < lexer->token_count; i++) {
+        Token *tok = lexer->tokens + i;
+        switch (tok->type) {
+            case TOK_LEFT_BRACE:
+                depth++;
+                break;
+            case TOK_RIGHT_BRACE:
+                if (depth > 0) depth--;
+                break;
+            case TOK_LEFT_PAR:
+                in_params = depth == 1 && definition != NULL;
+                break;
+            case TOK_RIGHT_PAR:
+                if (depth == 1) in_params = false;
+                break;
+            case TOK_KW_STATIC:
+                tok->local_count = 0;
+                if (depth == 1) {
+                    lexer->static_count++;
+                    definition = tok;
+                }
+                break;
+            case TOK_IDENTIFIER:
+                if (in_params) definition->local_count++;
+                break;
+            case TOK_KW_VAR:
+                if (depth > 1 && definition != NULL) definition->local_count++;
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+bool lexer_tokenize(Lexer *lexer) {
+    // Falls back to lexing sequentially, which also finds the lexing error if there is one
+    if (!tokenize_parallel(lexer) && !tokenize_sequential(lexer)) return false;
+    count_declarations(lexer);
+    return true;
+}
+
+/// Returns the token n places after the cursor or NULL if the stream ends with a lexing error before it.
+/// Past the end of the stream its final TOK_DOLLAR is returned
+static const Token *token_at(Lexer *lexer, size_t n) {
+    size_t idx = lexer->cursor + n;
+    if (idx + 1 > lexer->furthest) lexer->furthest = idx + 1;
+    if (idx < lexer->token_count) return lexer->tokens + idx;
+    if (lexer->lex_error != ERR_LEX_OK) return NULL;
+    return lexer->tokens + lexer->token_count - 1;
+}
+
+ErrLex lexer_get_token(Lexer *lexer, Token *tok) {
+    const Token *next = token_at(lexer, 0);
+    if (next == NULL) return lexer->lex_error;
+    *tok = *next;
+    lexer->cursor++;
+    return ERR_LEX_OK;
+}
+
+const Token *lexer_peek_token(Lexer *lexer, size_t n) {
+    return token_at(lexer, n);
 }
 
 bool lexer_unget_token(Lexer *lexer, Token *tok) {
-    if (lexer->no_ungot_tokens == MAX_UNGET_TOKENS) {
+    if (lexer->cursor == 0) {
         return false;
     }
-    lexer->ungot_tokens[lexer->no_ungot_tokens++] = *tok;
+    lexer->cursor--;
     tok->type = TOK_DOLLAR;
-    tok->string_val = NULL;
+    tok->expr_val = EXPR_NONE;
     return true;
 }
+
+size_t lexer_mark(const Lexer *lexer) {
+    return lexer->cursor;
+}
+
+void lexer_rewind(Lexer *lexer, size_t mark) {
+    lexer->cursor = mark;
+}
+
+/// Collects the offsets of all newlines in the input. Returns false if allocation failed
+static bool build_newline_index(Lexer *lexer) {
+    size_t count = 0;
+    for (size_t pos = scan_for(lexer->src, 0, lexer->src_len, '\n', '\n'); pos < lexer->src_len;
+         pos = scan_for(lexer->src, pos + 1, lexer->src_len, '\n', '\n')) {
+        count++;
+    }
+
+    // Always allocates at least one so that a built index is never NULL
+    lexer->newlines = malloc((count + 1) * sizeof(unsigned));
+    if (lexer->newlines == NULL) return false;
+    lexer->newline_count = 0;
+    for (size_t pos = scan_for(lexer->src, 0, lexer->src_len, '\n', '\n'); pos < lexer->src_len;
+         pos = scan_for(lexer->src, pos + 1, lexer->src_len, '\n', '\n')) {
+        lexer->newlines[lexer->newline_count++] = (unsigned)pos;
+    }
+    return true;
+}
+
+bool lexer_offset_position(Lexer *lexer, size_t offset, unsigned *line, unsigned *col) {
+    if (lexer->newlines == NULL && !build_newline_index(lexer)) return false;
+
+    // Number of newlines before the offset. A newline belongs to the line it ends
+    size_t lo = 0, hi = lexer->newline_count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (lexer->newlines[mid] < offset) lo = mid + 1;
+        else hi = mid;
+    }
+
+    *line = (unsigned)lo + 1;
+    *col = (unsigned)(lo == 0 ? offset + 1 : offset - lexer->newlines[lo - 1]);
+    return true;
+}
+
+bool lexer_current_position(Lexer *lexer, unsigned *line, unsigned *col) {
+    size_t end;
+    if (lexer->furthest > lexer->token_count && lexer->lex_error != ERR_LEX_OK) {
+        // The parser got to the lexing error
+        end = lexer->lex_error_pos;
+    } else if (lexer->furthest == 0) {
+        end = 0;
+    } else {
+        // Lexes the furthest token the parser looked at once more to find where it ends
+        size_t idx = lexer->furthest < lexer->token_count ? lexer->furthest : lexer->token_count;
+        Token tok;
+        lexer->src_pos = lexer->tokens[idx - 1].pos;
+        if (lexer_read_token_from_file(lexer, &tok) != ERR_LEX_OK) return false;
+        end = lexer->src_pos;
+    }
+
+    // Nothing was read yet
+    if (end == 0) {
+        *line = 1;
+        *col = 0;
+        return true;
+    }
+    return lexer_offset_position(lexer, end - 1, line, col);
+}
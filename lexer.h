@@ -15,24 +15,7 @@
 #include "token.h"
 #include <stdio.h>
 #include <stdbool.h>
-
-#define MAX_UNGET_TOKENS 10
-
-typedef struct lexer {
-    FILE* file;
-    // Current position in file. Used for friendlier error messages
-    unsigned pos_line;
-    unsigned pos_char;
-    bool last_char_was_newline; // Used for counting lines
-
-    // Buffers used for lexical analysis.
-    // Used only in get_token, put here so we don't have to create new ones on every call
-    String *buf1;
-    String *buf2;
-
-    Token ungot_tokens[MAX_UNGET_TOKENS];
-    unsigned no_ungot_tokens;
-} Lexer;
+#include <stddef.h>
 
 typedef enum lexer_status {
     ERR_LEX_OK,
@@ -49,16 +32,85 @@ typedef enum lexer_status {
     ERR_LEX_INVALID_CHAR_IN_STRING,
 } ErrLex; // Lexer? More like LexERR
 
-/// Opens the given file and prepares the given lexer structure. Returns false if something went wrong
+typedef struct lexer {
+    FILE* file;
+    // The whole input is held in memory. Regular files are mapped,
+    // other streams (pipes, terminals) are read into a heap buffer
+    const char *src;
+    size_t src_len;
+    size_t src_pos;
+    bool src_mapped;
+    // Offsets of all newlines in the input. Built only when a position is
+    // needed for an error message, so the lexing itself does not count lines
+    unsigned *newlines;
+    size_t newline_count;
+
+    // String literals with escape sequences decoded. Their tokens address
+    // the arena with text offsets starting at src_len
+    char *lit_arena;
+    size_t lit_arena_len;
+    size_t lit_arena_cap;
+
+    // The whole token stream, lexed up front by lexer_tokenize. If lexing failed,
+    // the stream ends before the failing token and lex_error holds the status
+    Token *tokens;
+    size_t token_count;
+    size_t token_cap;
+    size_t cursor;
+    // One past the furthest token the parser looked at, errors are reported there
+    size_t furthest;
+    ErrLex lex_error;
+    size_t lex_error_pos;
+    // Identifier tokens keep their text instead of being interned. Set for chunks lexed on worker threads
+    bool defer_intern;
+    // Number of static definitions in the class body, counted by lexer_tokenize
+    size_t static_count;
+} Lexer;
+
+/// Loads the whole input stream into memory and prepares the given lexer structure.
+/// Returns false if something went wrong
 bool lexer_init(Lexer *lexer, FILE *input_stream);
 
 /// Frees the inside of the given lexer structure
 void lexer_free(Lexer *lexer);
 
-/// Puts the next token into tok. Returns the status code
+/// Lexes the whole input into the token stream. Must be called before any token is read.
+/// Large inputs are split into chunks lexed on multiple threads. The static definitions are
+/// counted and each static keyword gets the number of locals declared in its definition.
+/// A lexing error is stored and returned by lexer_get_token once the cursor reaches it.
+/// Returns false if allocation failed
+bool lexer_tokenize(Lexer *lexer);
+
+/// Puts the token at the cursor into tok and moves the cursor forward. Returns the status code
 ErrLex lexer_get_token(Lexer *lexer, Token *tok);
 
-/// Ungets token, returns false if the ungot token stack overflowed
+/// Returns the token n places after the cursor without moving it, or NULL if lexing failed before it
+const Token *lexer_peek_token(Lexer *lexer, size_t n);
+
+/// Moves the cursor back over the last read token, which has to be the given one.
+/// Returns false if there is no token to go back over
 bool lexer_unget_token(Lexer *lexer, Token *tok);
 
+/// Returns the cursor position to go back to with lexer_rewind
+size_t lexer_mark(const Lexer *lexer);
+
+/// Moves the cursor back to a position returned by lexer_mark
+void lexer_rewind(Lexer *lexer, size_t mark);
+
+/// Returns the start of the text of a string literal token. The text is tok->text.length long and not null terminated
+const char *lexer_token_text(const Lexer *lexer, const Token *tok);
+
+/// Returns a new string with the text of a string literal token or NULL if allocation failed
+String *lexer_token_string(const Lexer *lexer, const Token *tok);
+
+/// Converts an offset in the input to a line and a column, both starting at 1.
+/// Returns false if allocation failed
+bool lexer_offset_position(Lexer *lexer, size_t offset, unsigned *line, unsigned *col);
+
+/// Puts the line and column of the last read character into line and col. Returns false if allocation failed
+bool lexer_current_position(Lexer *lexer, unsigned *line, unsigned *col);
+
+/// Returns the keyword token type of the given identifier, or TOK_IDENTIFIER if it is not a keyword
+TokType check_keyword(const char *id, size_t len);
+
 #endif // !_LEXER_H_
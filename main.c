@@ -12,6 +12,7 @@
 #include "ast.h"
 #include "code_generator.h"
 #include "error.h"
+#include "intern.h"
 #include "parser.h"
 #include "lexer.h"
 #include "optimizer.h"
@@ -40,47 +41,80 @@ void print_error_code(ErrorCode ec) {
     }
 }
 
+/// State of the streaming compilation, the definitions are written to the output as they are generated
+typedef struct {
+    FILE *output;
+    ErrorCode optimize_ec;
+    ErrorCode generate_ec;
+} StreamState;
+
+/// Optimizes a definition and generates its code as soon as the parser is done with it
+void compile_definition(AstExprs *exprs, AstStatement *definition, Symtable *globaltable, void *par) {
+    StreamState *state = par;
+    // Errors take precedence the same way as when the whole AST is optimized before generating any code
+    if (state->optimize_ec != OK) return;
+    state->optimize_ec = optimize_statement(exprs, definition, globaltable, NULL);
+    if (state->optimize_ec != OK || state->generate_ec != OK) return;
+    state->generate_ec = generate_definition(state->output, exprs, definition);
+}
+
+/// Frees everything that is left after the compilation
+void free_resources(AstExprs *exprs, Symtable *glob_symtable) {
+    ast_exprs_free(exprs);
+    symtable_free(glob_symtable);
+    intern_free_all();
+}
+
+/// Prints the error, the code written so far is incomplete and is not to be used
+void print_error(ErrorCode ec) {
+    fprintf(stderr, "error: ");
+    print_error_code(ec);
+    fprintf(stderr, "\n");
+}
+
 int main() {
     Lexer lexer;
     if (!lexer_init(&lexer, stdin)) return INTERNAL_ERROR;
+    if (!lexer_tokenize(&lexer)) {
+        lexer_free(&lexer);
+        return INTERNAL_ERROR;
+    }
 
-    AstStatement *ast_root = NULL;
+    // Each definition is optimized, generated, written and freed right after it is parsed, so the AST
+    // never holds more than one. The global variables are declared by the epilogue once all are known
+    StreamState state = { stdout, OK, OK };
+    AstExprs exprs;
+    ast_exprs_init(&exprs);
     Symtable *glob_symtable = NULL;
-    ErrorCode ec = parse(&lexer, &ast_root, &glob_symtable);
+    generate_prologue(state.output);
+    ErrorCode ec = parse_streaming(&lexer, &exprs, &glob_symtable, compile_definition, &state);
 
+    // The position is looked up in the input, so it has to be done before the lexer is freed
+    unsigned err_line = 0, err_col = 0;
+    if (ec != OK) lexer_current_position(&lexer, &err_line, &err_col);
     lexer_free(&lexer);
     if (ec != OK) {
-        fprintf(stderr, "error at %d:%d: ", lexer.pos_line, lexer.pos_char);
+        fprintf(stderr, "error at %u:%u: ", err_line, err_col);
         print_error_code(ec);
         fprintf(stderr, "\n");
-        ast_free(ast_root);
-        symtable_free(glob_symtable);
+        free_resources(&exprs, glob_symtable);
         return ec;
     }
 
-    //ast_print(ast_root);
-
-    ec = optimize_ast(ast_root, glob_symtable);
+    ec = state.optimize_ec != OK ? state.optimize_ec : state.generate_ec;
     if (ec != OK) {
-        fprintf(stderr, "error: ");
-        print_error_code(ec);
-        fprintf(stderr, "\n");
-        ast_free(ast_root);
-        symtable_free(glob_symtable);
+        print_error(ec);
+        free_resources(&exprs, glob_symtable);
         return ec;
     }
 
-    ec = generate_code(stdout, ast_root, glob_symtable);
-    if (ec != OK) {
-        fprintf(stderr, "error: ");
-        print_error_code(ec);
-        fprintf(stderr, "\n");
-        ast_free(ast_root);
-        symtable_free(glob_symtable);
-        return ec;
+    generate_epilogue(state.output, glob_symtable);
+    if (fflush(state.output) != 0) {
+        print_error(INTERNAL_ERROR);
+        free_resources(&exprs, glob_symtable);
+        return INTERNAL_ERROR;
     }
 
-    ast_free(ast_root);
-    symtable_free(glob_symtable);
+    free_resources(&exprs, glob_symtable);
     return 0;
 }
@@ -15,10 +15,11 @@
 #include "string.h"
 #include <math.h>
 #include <stddef.h>
+#include <stdlib.h>
 #include <string.h>
 
-void update_symtable_value(SymtableItem *item, AstExpression *expr) {
-    if (item == NULL || expr == NULL) {
+void update_symtable_value(AstExprs *exprs, SymtableItem *item, ExprId expr) {
+    if (item == NULL || expr == EXPR_NONE) {
         return;
     }
 
@@ -29,22 +30,22 @@ void update_symtable_value(SymtableItem *item, AstExpression *expr) {
     // Default values
     item->data_type = DT_UNKNOWN;
     item->data_type_known = false;
-    if (expr->assumed_type == DT_UNKNOWN || !expr->val_known) return;
+    if (EXPR_ASSUMED_TYPE(exprs, expr) == DT_UNKNOWN || !EXPR_VAL_KNOWN(exprs, expr)) return;
 
     item->data_type_known = true;
-    item->data_type = expr->assumed_type;
+    item->data_type = EXPR_ASSUMED_TYPE(exprs, expr);
 
-    switch (expr->assumed_type) {
+    switch (EXPR_ASSUMED_TYPE(exprs, expr)) {
         case DT_NUM:
-            item->double_val = expr->double_val;
+            item->double_val = EXPR_DOUBLE(exprs, expr);
             break;
         case DT_BOOL:
-            item->bool_val = expr->bool_val;
+            item->bool_val = EXPR_BOOL(exprs, expr);
             break;
         case DT_STRING:
             item->string_val = str_init();
-            if (item->string_val != NULL && expr->string_val != NULL) {
-                str_append_string(item->string_val, expr->string_val->val);
+            if (item->string_val != NULL && EXPR_STRING(exprs, expr) != NULL) {
+                str_append_n(item->string_val, EXPR_STRING(exprs, expr)->val, EXPR_STRING(exprs, expr)->length);
             }
             break;
         case DT_NULL:
@@ -71,23 +72,12 @@ void clear_symtable_values(Symtable *st) {
     symtable_foreach(st, clear_symtable_item_value, NULL);
 }
 
-ErrorCode optimize_expression(AstExpression *expr, Symtable *globaltable, Symtable *localtable) {
-    if (expr == NULL) {
-        return INTERNAL_ERROR;
-    }
-
-    // First optimize all child expressions
-    for (size_t i = 0; i < expr->child_count; i++) {
-        ErrorCode ec = optimize_expression(expr->params[i], globaltable, localtable);
-        if (ec != OK) {
-            return ec;
-        }
-    }
-
+// Evaluates a single expression node if possible, its children are already optimized
+static ErrorCode optimize_node(AstExprs *exprs, ExprId expr, Symtable *globaltable, Symtable *localtable) {
     // Try to evaluate the expression if all operands are known
     bool all_known = true;
-    for (size_t i = 0; i < expr->child_count; i++) {
-        if (!expr->params[i]->val_known) {
+    for (size_t i = 0; i < EXPR_CHILD_COUNT(exprs, expr); i++) {
+        if (!EXPR_VAL_KNOWN(exprs, EXPR_CHILD(exprs, expr, i))) {
             all_known = false;
             break;
         }
@@ -98,206 +88,197 @@ ErrorCode optimize_expression(AstExpression *expr, Symtable *globaltable, Symtab
     }
 
     // Evaluate based on expression type
-    switch (expr->type) {
+    switch (EXPR_TYPE(exprs, expr)) {
         // Binary arithmetic operations
         case EX_ADD:
-            if (expr->child_count == 2) {
-                AstExpression *left = expr->params[0];
-                AstExpression *right = expr->params[1];
+            if (EXPR_CHILD_COUNT(exprs, expr) == 2) {
+                ExprId left = EXPR_CHILD(exprs, expr, 0);
+                ExprId right = EXPR_CHILD(exprs, expr, 1);
                 
-                if (left->assumed_type == DT_NUM && right->assumed_type == DT_NUM) {
-                    expr->val_known = true;
-                    expr->assumed_type = DT_NUM;
-                    expr->double_val = left->double_val + right->double_val;
-                } else if (left->assumed_type == DT_STRING && right->assumed_type == DT_STRING) {
-                    expr->val_known = true;
-                    if (expr->assumed_type == DT_STRING && expr->string_val != NULL) {
-                        str_free(&expr->string_val);
-                    }
-                    expr->assumed_type = DT_STRING;
-                    expr->string_val = str_init();
-                    if (expr->string_val != NULL) {
-                        str_append_string(expr->string_val, left->string_val->val);
-                        str_append_string(expr->string_val, right->string_val->val);
+                if (EXPR_ASSUMED_TYPE(exprs, left) == DT_NUM && EXPR_ASSUMED_TYPE(exprs, right) == DT_NUM) {
+                    EXPR_VAL_KNOWN(exprs, expr) = true;
+                    EXPR_ASSUMED_TYPE(exprs, expr) = DT_NUM;
+                    EXPR_DOUBLE(exprs, expr) = EXPR_DOUBLE(exprs, left) + EXPR_DOUBLE(exprs, right);
+                } else if (EXPR_ASSUMED_TYPE(exprs, left) == DT_STRING && EXPR_ASSUMED_TYPE(exprs, right) == DT_STRING) {
+                    EXPR_VAL_KNOWN(exprs, expr) = true;
+                    EXPR_ASSUMED_TYPE(exprs, expr) = DT_STRING;
+                    EXPR_STRING(exprs, expr) = ast_own_string(str_init());
+                    if (EXPR_STRING(exprs, expr) != NULL) {
+                        str_append_n(EXPR_STRING(exprs, expr), EXPR_STRING(exprs, left)->val, EXPR_STRING(exprs, left)->length);
+                        str_append_n(EXPR_STRING(exprs, expr), EXPR_STRING(exprs, right)->val, EXPR_STRING(exprs, right)->length);
                     }
                 }
             }
             break;
 
         case EX_SUB:
-            if (expr->child_count == 2 && expr->params[0]->assumed_type == DT_NUM && expr->params[1]->assumed_type == DT_NUM) {
-                expr->val_known = true;
-                expr->assumed_type = DT_NUM;
-                expr->double_val = expr->params[0]->double_val - expr->params[1]->double_val;
+            if (EXPR_CHILD_COUNT(exprs, expr) == 2 && EXPR_ASSUMED_TYPE(exprs, EXPR_CHILD(exprs, expr, 0)) == DT_NUM && EXPR_ASSUMED_TYPE(exprs, EXPR_CHILD(exprs, expr, 1)) == DT_NUM) {
+                EXPR_VAL_KNOWN(exprs, expr) = true;
+                EXPR_ASSUMED_TYPE(exprs, expr) = DT_NUM;
+                EXPR_DOUBLE(exprs, expr) = EXPR_DOUBLE(exprs, EXPR_CHILD(exprs, expr, 0)) - EXPR_DOUBLE(exprs, EXPR_CHILD(exprs, expr, 1));
             }
             break;
 
         case EX_MUL:
-            if (expr->child_count == 2 && expr->params[0]->assumed_type == DT_NUM && expr->params[1]->assumed_type == DT_NUM) {
-                expr->val_known = true;
-                expr->assumed_type = DT_NUM;
-                expr->double_val = expr->params[0]->double_val * expr->params[1]->double_val;
-            } else if (expr->child_count == 2 && expr->params[0]->assumed_type == DT_STRING && expr->params[1]->assumed_type == DT_NUM) {
-                expr->val_known = true;
-                if (expr->assumed_type == DT_STRING && expr->string_val != NULL) {
-                    str_free(&expr->string_val);
-                }
-                expr->assumed_type = DT_STRING;
-                expr->string_val = str_init();
-                if (expr->string_val != NULL) {
-                    int repeat_count = (int)expr->params[1]->double_val;
+            if (EXPR_CHILD_COUNT(exprs, expr) == 2 && EXPR_ASSUMED_TYPE(exprs, EXPR_CHILD(exprs, expr, 0)) == DT_NUM && EXPR_ASSUMED_TYPE(exprs, EXPR_CHILD(exprs, expr, 1)) == DT_NUM) {
+                EXPR_VAL_KNOWN(exprs, expr) = true;
+                EXPR_ASSUMED_TYPE(exprs, expr) = DT_NUM;
+                EXPR_DOUBLE(exprs, expr) = EXPR_DOUBLE(exprs, EXPR_CHILD(exprs, expr, 0)) * EXPR_DOUBLE(exprs, EXPR_CHILD(exprs, expr, 1));
+            } else if (EXPR_CHILD_COUNT(exprs, expr) == 2 && EXPR_ASSUMED_TYPE(exprs, EXPR_CHILD(exprs, expr, 0)) == DT_STRING && EXPR_ASSUMED_TYPE(exprs, EXPR_CHILD(exprs, expr, 1)) == DT_NUM) {
+                EXPR_VAL_KNOWN(exprs, expr) = true;
+                EXPR_ASSUMED_TYPE(exprs, expr) = DT_STRING;
+                EXPR_STRING(exprs, expr) = ast_own_string(str_init());
+                if (EXPR_STRING(exprs, expr) != NULL) {
+                    int repeat_count = (int)EXPR_DOUBLE(exprs, EXPR_CHILD(exprs, expr, 1));
+                    if (repeat_count > 0) {
+                        str_reserve(EXPR_STRING(exprs, expr), EXPR_STRING(exprs, EXPR_CHILD(exprs, expr, 0))->length * repeat_count);
+                    }
                     for (int i = 0; i < repeat_count; i++) {
-                        str_append_string(expr->string_val, expr->params[0]->string_val->val);
+                        str_append_n(EXPR_STRING(exprs, expr), EXPR_STRING(exprs, EXPR_CHILD(exprs, expr, 0))->val, EXPR_STRING(exprs, EXPR_CHILD(exprs, expr, 0))->length);
                     }
                 }
             }
             break;
 
         case EX_DIV:
-            if (expr->child_count == 2 && expr->params[0]->assumed_type == DT_NUM && expr->params[1]->assumed_type == DT_NUM && expr->params[1]->double_val != 0.0) {
-                expr->val_known = true;
-                expr->assumed_type = DT_NUM;
-                expr->double_val = expr->params[0]->double_val / expr->params[1]->double_val;
+            if (EXPR_CHILD_COUNT(exprs, expr) == 2 && EXPR_ASSUMED_TYPE(exprs, EXPR_CHILD(exprs, expr, 0)) == DT_NUM && EXPR_ASSUMED_TYPE(exprs, EXPR_CHILD(exprs, expr, 1)) == DT_NUM && EXPR_DOUBLE(exprs, EXPR_CHILD(exprs, expr, 1)) != 0.0) {
+                EXPR_VAL_KNOWN(exprs, expr) = true;
+                EXPR_ASSUMED_TYPE(exprs, expr) = DT_NUM;
+                EXPR_DOUBLE(exprs, expr) = EXPR_DOUBLE(exprs, EXPR_CHILD(exprs, expr, 0)) / EXPR_DOUBLE(exprs, EXPR_CHILD(exprs, expr, 1));
             }
             break;
 
         // Unary operations
         case EX_NEGATE:
-            if (expr->child_count == 1 && expr->params[0]->assumed_type == DT_NUM) {
-                expr->val_known = true;
-                expr->assumed_type = DT_NUM;
-                expr->double_val = -expr->params[0]->double_val;
+            if (EXPR_CHILD_COUNT(exprs, expr) == 1 && EXPR_ASSUMED_TYPE(exprs, EXPR_CHILD(exprs, expr, 0)) == DT_NUM) {
+                EXPR_VAL_KNOWN(exprs, expr) = true;
+                EXPR_ASSUMED_TYPE(exprs, expr) = DT_NUM;
+                EXPR_DOUBLE(exprs, expr) = -EXPR_DOUBLE(exprs, EXPR_CHILD(exprs, expr, 0));
             }
             break;
 
         case EX_NOT:
-            if (expr->child_count == 1 && expr->params[0]->assumed_type == DT_BOOL) {
-                expr->val_known = true;
-                expr->assumed_type = DT_BOOL;
-                expr->bool_val = !expr->params[0]->bool_val;
+            if (EXPR_CHILD_COUNT(exprs, expr) == 1 && EXPR_ASSUMED_TYPE(exprs, EXPR_CHILD(exprs, expr, 0)) == DT_BOOL) {
+                EXPR_VAL_KNOWN(exprs, expr) = true;
+                EXPR_ASSUMED_TYPE(exprs, expr) = DT_BOOL;
+                EXPR_BOOL(exprs, expr) = !EXPR_BOOL(exprs, EXPR_CHILD(exprs, expr, 0));
             }
             break;
 
         // Comparison operations
         case EX_GREATER:
-            if (expr->child_count == 2 && expr->params[0]->assumed_type == DT_NUM && expr->params[1]->assumed_type == DT_NUM) {
-                expr->val_known = true;
-                expr->assumed_type = DT_BOOL;
-                expr->bool_val = expr->params[0]->double_val > expr->params[1]->double_val;
+            if (EXPR_CHILD_COUNT(exprs, expr) == 2 && EXPR_ASSUMED_TYPE(exprs, EXPR_CHILD(exprs, expr, 0)) == DT_NUM && EXPR_ASSUMED_TYPE(exprs, EXPR_CHILD(exprs, expr, 1)) == DT_NUM) {
+                EXPR_VAL_KNOWN(exprs, expr) = true;
+                EXPR_ASSUMED_TYPE(exprs, expr) = DT_BOOL;
+                EXPR_BOOL(exprs, expr) = EXPR_DOUBLE(exprs, EXPR_CHILD(exprs, expr, 0)) > EXPR_DOUBLE(exprs, EXPR_CHILD(exprs, expr, 1));
             }
             break;
 
         case EX_LESS:
-            if (expr->child_count == 2 && expr->params[0]->assumed_type == DT_NUM && expr->params[1]->assumed_type == DT_NUM) {
-                expr->val_known = true;
-                expr->assumed_type = DT_BOOL;
-                expr->bool_val = expr->params[0]->double_val < expr->params[1]->double_val;
+            if (EXPR_CHILD_COUNT(exprs, expr) == 2 && EXPR_ASSUMED_TYPE(exprs, EXPR_CHILD(exprs, expr, 0)) == DT_NUM && EXPR_ASSUMED_TYPE(exprs, EXPR_CHILD(exprs, expr, 1)) == DT_NUM) {
+                EXPR_VAL_KNOWN(exprs, expr) = true;
+                EXPR_ASSUMED_TYPE(exprs, expr) = DT_BOOL;
+                EXPR_BOOL(exprs, expr) = EXPR_DOUBLE(exprs, EXPR_CHILD(exprs, expr, 0)) < EXPR_DOUBLE(exprs, EXPR_CHILD(exprs, expr, 1));
             }
             break;
 
         case EX_GREATER_EQ:
-            if (expr->child_count == 2 && expr->params[0]->assumed_type == DT_NUM && expr->params[1]->assumed_type == DT_NUM) {
-                expr->val_known = true;
-                expr->assumed_type = DT_BOOL;
-                expr->bool_val = expr->params[0]->double_val >= expr->params[1]->double_val;
+            if (EXPR_CHILD_COUNT(exprs, expr) == 2 && EXPR_ASSUMED_TYPE(exprs, EXPR_CHILD(exprs, expr, 0)) == DT_NUM && EXPR_ASSUMED_TYPE(exprs, EXPR_CHILD(exprs, expr, 1)) == DT_NUM) {
+                EXPR_VAL_KNOWN(exprs, expr) = true;
+                EXPR_ASSUMED_TYPE(exprs, expr) = DT_BOOL;
+                EXPR_BOOL(exprs, expr) = EXPR_DOUBLE(exprs, EXPR_CHILD(exprs, expr, 0)) >= EXPR_DOUBLE(exprs, EXPR_CHILD(exprs, expr, 1));
             }
             break;
 
         case EX_LESS_EQ:
-            if (expr->child_count == 2 && expr->params[0]->assumed_type == DT_NUM && expr->params[1]->assumed_type == DT_NUM) {
-                expr->val_known = true;
-                expr->assumed_type = DT_BOOL;
-                expr->bool_val = expr->params[0]->double_val <= expr->params[1]->double_val;
+            if (EXPR_CHILD_COUNT(exprs, expr) == 2 && EXPR_ASSUMED_TYPE(exprs, EXPR_CHILD(exprs, expr, 0)) == DT_NUM && EXPR_ASSUMED_TYPE(exprs, EXPR_CHILD(exprs, expr, 1)) == DT_NUM) {
+                EXPR_VAL_KNOWN(exprs, expr) = true;
+                EXPR_ASSUMED_TYPE(exprs, expr) = DT_BOOL;
+                EXPR_BOOL(exprs, expr) = EXPR_DOUBLE(exprs, EXPR_CHILD(exprs, expr, 0)) <= EXPR_DOUBLE(exprs, EXPR_CHILD(exprs, expr, 1));
             }
             break;
 
         case EX_EQ:
-            if (expr->child_count == 2 && expr->params[0]->assumed_type == expr->params[1]->assumed_type) {
-                expr->val_known = true;
-                expr->assumed_type = DT_BOOL;
+            if (EXPR_CHILD_COUNT(exprs, expr) == 2 && EXPR_ASSUMED_TYPE(exprs, EXPR_CHILD(exprs, expr, 0)) == EXPR_ASSUMED_TYPE(exprs, EXPR_CHILD(exprs, expr, 1))) {
+                EXPR_VAL_KNOWN(exprs, expr) = true;
+                EXPR_ASSUMED_TYPE(exprs, expr) = DT_BOOL;
                 
-                if (expr->params[0]->assumed_type == DT_NUM) {
-                    expr->bool_val = expr->params[0]->double_val == expr->params[1]->double_val;
-                } else if (expr->params[0]->assumed_type == DT_BOOL) {
-                    expr->bool_val = expr->params[0]->bool_val == expr->params[1]->bool_val;
-                } else if (expr->params[0]->assumed_type == DT_STRING) {
-                    expr->bool_val = strcmp(expr->params[0]->string_val->val, expr->params[1]->string_val->val) == 0;
-                } else if (expr->params[0]->assumed_type == DT_NULL) {
-                    expr->bool_val = true;
+                if (EXPR_ASSUMED_TYPE(exprs, EXPR_CHILD(exprs, expr, 0)) == DT_NUM) {
+                    EXPR_BOOL(exprs, expr) = EXPR_DOUBLE(exprs, EXPR_CHILD(exprs, expr, 0)) == EXPR_DOUBLE(exprs, EXPR_CHILD(exprs, expr, 1));
+                } else if (EXPR_ASSUMED_TYPE(exprs, EXPR_CHILD(exprs, expr, 0)) == DT_BOOL) {
+                    EXPR_BOOL(exprs, expr) = EXPR_BOOL(exprs, EXPR_CHILD(exprs, expr, 0)) == EXPR_BOOL(exprs, EXPR_CHILD(exprs, expr, 1));
+                } else if (EXPR_ASSUMED_TYPE(exprs, EXPR_CHILD(exprs, expr, 0)) == DT_STRING) {
+                    EXPR_BOOL(exprs, expr) = strcmp(EXPR_STRING(exprs, EXPR_CHILD(exprs, expr, 0))->val, EXPR_STRING(exprs, EXPR_CHILD(exprs, expr, 1))->val) == 0;
+                } else if (EXPR_ASSUMED_TYPE(exprs, EXPR_CHILD(exprs, expr, 0)) == DT_NULL) {
+                    EXPR_BOOL(exprs, expr) = true;
                 }
             }
             break;
 
         case EX_NOT_EQ:
-            if (expr->child_count == 2 && expr->params[0]->assumed_type == expr->params[1]->assumed_type) {
-                expr->val_known = true;
-                expr->assumed_type = DT_BOOL;
+            if (EXPR_CHILD_COUNT(exprs, expr) == 2 && EXPR_ASSUMED_TYPE(exprs, EXPR_CHILD(exprs, expr, 0)) == EXPR_ASSUMED_TYPE(exprs, EXPR_CHILD(exprs, expr, 1))) {
+                EXPR_VAL_KNOWN(exprs, expr) = true;
+                EXPR_ASSUMED_TYPE(exprs, expr) = DT_BOOL;
                 
-                if (expr->params[0]->assumed_type == DT_NUM) {
-                    expr->bool_val = expr->params[0]->double_val != expr->params[1]->double_val;
-                } else if (expr->params[0]->assumed_type == DT_BOOL) {
-                    expr->bool_val = expr->params[0]->bool_val != expr->params[1]->bool_val;
-                } else if (expr->params[0]->assumed_type == DT_STRING) {
-                    expr->bool_val = strcmp(expr->params[0]->string_val->val, expr->params[1]->string_val->val) != 0;
-                } else if (expr->params[0]->assumed_type == DT_NULL) {
-                    expr->bool_val = false;
+                if (EXPR_ASSUMED_TYPE(exprs, EXPR_CHILD(exprs, expr, 0)) == DT_NUM) {
+                    EXPR_BOOL(exprs, expr) = EXPR_DOUBLE(exprs, EXPR_CHILD(exprs, expr, 0)) != EXPR_DOUBLE(exprs, EXPR_CHILD(exprs, expr, 1));
+                } else if (EXPR_ASSUMED_TYPE(exprs, EXPR_CHILD(exprs, expr, 0)) == DT_BOOL) {
+                    EXPR_BOOL(exprs, expr) = EXPR_BOOL(exprs, EXPR_CHILD(exprs, expr, 0)) != EXPR_BOOL(exprs, EXPR_CHILD(exprs, expr, 1));
+                } else if (EXPR_ASSUMED_TYPE(exprs, EXPR_CHILD(exprs, expr, 0)) == DT_STRING) {
+                    EXPR_BOOL(exprs, expr) = strcmp(EXPR_STRING(exprs, EXPR_CHILD(exprs, expr, 0))->val, EXPR_STRING(exprs, EXPR_CHILD(exprs, expr, 1))->val) != 0;
+                } else if (EXPR_ASSUMED_TYPE(exprs, EXPR_CHILD(exprs, expr, 0)) == DT_NULL) {
+                    EXPR_BOOL(exprs, expr) = false;
                 }
             }
             break;
 
         // Logical operations
         case EX_AND:
-            if (expr->child_count == 2 && expr->params[0]->assumed_type == DT_BOOL && expr->params[1]->assumed_type == DT_BOOL) {
-                expr->val_known = true;
-                expr->assumed_type = DT_BOOL;
-                expr->bool_val = expr->params[0]->bool_val && expr->params[1]->bool_val;
+            if (EXPR_CHILD_COUNT(exprs, expr) == 2 && EXPR_ASSUMED_TYPE(exprs, EXPR_CHILD(exprs, expr, 0)) == DT_BOOL && EXPR_ASSUMED_TYPE(exprs, EXPR_CHILD(exprs, expr, 1)) == DT_BOOL) {
+                EXPR_VAL_KNOWN(exprs, expr) = true;
+                EXPR_ASSUMED_TYPE(exprs, expr) = DT_BOOL;
+                EXPR_BOOL(exprs, expr) = EXPR_BOOL(exprs, EXPR_CHILD(exprs, expr, 0)) && EXPR_BOOL(exprs, EXPR_CHILD(exprs, expr, 1));
             }
             break;
 
         case EX_OR:
-            if (expr->child_count == 2 && expr->params[0]->assumed_type == DT_BOOL && expr->params[1]->assumed_type == DT_BOOL) {
-                expr->val_known = true;
-                expr->assumed_type = DT_BOOL;
-                expr->bool_val = expr->params[0]->bool_val || expr->params[1]->bool_val;
+            if (EXPR_CHILD_COUNT(exprs, expr) == 2 && EXPR_ASSUMED_TYPE(exprs, EXPR_CHILD(exprs, expr, 0)) == DT_BOOL && EXPR_ASSUMED_TYPE(exprs, EXPR_CHILD(exprs, expr, 1)) == DT_BOOL) {
+                EXPR_VAL_KNOWN(exprs, expr) = true;
+                EXPR_ASSUMED_TYPE(exprs, expr) = DT_BOOL;
+                EXPR_BOOL(exprs, expr) = EXPR_BOOL(exprs, EXPR_CHILD(exprs, expr, 0)) || EXPR_BOOL(exprs, EXPR_CHILD(exprs, expr, 1));
             }
             break;
 
         // Ternary operator
         case EX_TERNARY:
-            if (expr->child_count == 3 && expr->params[0]->assumed_type == DT_BOOL) {
+            if (EXPR_CHILD_COUNT(exprs, expr) == 3 && EXPR_ASSUMED_TYPE(exprs, EXPR_CHILD(exprs, expr, 0)) == DT_BOOL) {
                 // Pick the branch based on condition
-                if (expr->params[0]->bool_val) {
+                if (EXPR_BOOL(exprs, EXPR_CHILD(exprs, expr, 0))) {
                     // Copy true branch result
-                    expr->val_known = expr->params[1]->val_known;
-                    expr->assumed_type = expr->params[1]->assumed_type;
-                    if (expr->params[1]->assumed_type == DT_NUM) {
-                        expr->double_val = expr->params[1]->double_val;
-                    } else if (expr->params[1]->assumed_type == DT_BOOL) {
-                        expr->bool_val = expr->params[1]->bool_val;
-                    } else if (expr->params[1]->assumed_type == DT_STRING) {
-                        if (expr->assumed_type == DT_STRING && expr->string_val != NULL) {
-                            str_free(&expr->string_val);
-                        }
-                        expr->string_val = str_init();
-                        if (expr->string_val != NULL) {
-                            str_append_string(expr->string_val, expr->params[1]->string_val->val);
+                    EXPR_VAL_KNOWN(exprs, expr) = EXPR_VAL_KNOWN(exprs, EXPR_CHILD(exprs, expr, 1));
+                    EXPR_ASSUMED_TYPE(exprs, expr) = EXPR_ASSUMED_TYPE(exprs, EXPR_CHILD(exprs, expr, 1));
+                    if (EXPR_ASSUMED_TYPE(exprs, EXPR_CHILD(exprs, expr, 1)) == DT_NUM) {
+                        EXPR_DOUBLE(exprs, expr) = EXPR_DOUBLE(exprs, EXPR_CHILD(exprs, expr, 1));
+                    } else if (EXPR_ASSUMED_TYPE(exprs, EXPR_CHILD(exprs, expr, 1)) == DT_BOOL) {
+                        EXPR_BOOL(exprs, expr) = EXPR_BOOL(exprs, EXPR_CHILD(exprs, expr, 1));
+                    } else if (EXPR_ASSUMED_TYPE(exprs, EXPR_CHILD(exprs, expr, 1)) == DT_STRING) {
+                        EXPR_STRING(exprs, expr) = ast_own_string(str_init());
+                        if (EXPR_STRING(exprs, expr) != NULL) {
+                            str_append_n(EXPR_STRING(exprs, expr), EXPR_STRING(exprs, EXPR_CHILD(exprs, expr, 1))->val, EXPR_STRING(exprs, EXPR_CHILD(exprs, expr, 1))->length);
                         }
                     }
                 } else {
                     // Copy false branch result
-                    expr->val_known = expr->params[2]->val_known;
-                    expr->assumed_type = expr->params[2]->assumed_type;
-                    if (expr->params[2]->assumed_type == DT_NUM) {
-                        expr->double_val = expr->params[2]->double_val;
-                    } else if (expr->params[2]->assumed_type == DT_BOOL) {
-                        expr->bool_val = expr->params[2]->bool_val;
-                    } else if (expr->params[2]->assumed_type == DT_STRING) {
-                        if (expr->assumed_type == DT_STRING && expr->string_val != NULL) {
-                            str_free(&expr->string_val);
-                        }
-                        expr->string_val = str_init();
-                        if (expr->string_val != NULL) {
-                            str_append_string(expr->string_val, expr->params[2]->string_val->val);
+                    EXPR_VAL_KNOWN(exprs, expr) = EXPR_VAL_KNOWN(exprs, EXPR_CHILD(exprs, expr, 2));
+                    EXPR_ASSUMED_TYPE(exprs, expr) = EXPR_ASSUMED_TYPE(exprs, EXPR_CHILD(exprs, expr, 2));
+                    if (EXPR_ASSUMED_TYPE(exprs, EXPR_CHILD(exprs, expr, 2)) == DT_NUM) {
+                        EXPR_DOUBLE(exprs, expr) = EXPR_DOUBLE(exprs, EXPR_CHILD(exprs, expr, 2));
+                    } else if (EXPR_ASSUMED_TYPE(exprs, EXPR_CHILD(exprs, expr, 2)) == DT_BOOL) {
+                        EXPR_BOOL(exprs, expr) = EXPR_BOOL(exprs, EXPR_CHILD(exprs, expr, 2));
+                    } else if (EXPR_ASSUMED_TYPE(exprs, EXPR_CHILD(exprs, expr, 2)) == DT_STRING) {
+                        EXPR_STRING(exprs, expr) = ast_own_string(str_init());
+                        if (EXPR_STRING(exprs, expr) != NULL) {
+                            str_append_n(EXPR_STRING(exprs, expr), EXPR_STRING(exprs, EXPR_CHILD(exprs, expr, 2))->val, EXPR_STRING(exprs, EXPR_CHILD(exprs, expr, 2))->length);
                         }
                     }
                 }
@@ -306,39 +287,37 @@ ErrorCode optimize_expression(AstExpression *expr, Symtable *globaltable, Symtab
 
         // Variable lookup
         case EX_ID:
-            if (expr->string_val != NULL) {
+            if (EXPR_IDENT(exprs, expr) != NULL) {
                 SymtableItem *item = NULL;
-                if ((item = symtable_find(localtable, expr->string_val->val)) != NULL) {
+                if ((item = symtable_var(localtable, EXPR_SLOT(exprs, expr))) != NULL) {
                     // We always have to set the data type to unknown if it is unknown
                     // in the symtable because it could have been reset due to side effects
                     if (item->data_type == DT_UNKNOWN) {
-                        expr->assumed_type = DT_UNKNOWN;
+                        EXPR_ASSUMED_TYPE(exprs, expr) = DT_UNKNOWN;
                         break;
                     }
                     if (item->data_type_known) {
-                        expr->val_known = true;
-                        expr->assumed_type = item->data_type;
-                        
-                        str_free(&expr->string_val);
+                        EXPR_VAL_KNOWN(exprs, expr) = true;
+                        EXPR_ASSUMED_TYPE(exprs, expr) = item->data_type;
                         
                         switch (item->data_type) {
                             case DT_NUM:
-                                expr->type = EX_DOUBLE;
-                                expr->double_val = item->double_val;
+                                EXPR_TYPE(exprs, expr) = EX_DOUBLE;
+                                EXPR_DOUBLE(exprs, expr) = item->double_val;
                                 break;
                             case DT_BOOL:
-                                expr->type = EX_BOOL;
-                                expr->bool_val = item->bool_val;
+                                EXPR_TYPE(exprs, expr) = EX_BOOL;
+                                EXPR_BOOL(exprs, expr) = item->bool_val;
                                 break;
                             case DT_STRING:
-                                expr->type = EX_STRING;
-                                expr->string_val = str_init();
-                                if (expr->string_val != NULL && item->string_val != NULL) {
-                                    str_append_string(expr->string_val, item->string_val->val);
+                                EXPR_TYPE(exprs, expr) = EX_STRING;
+                                EXPR_STRING(exprs, expr) = ast_own_string(str_init());
+                                if (EXPR_STRING(exprs, expr) != NULL && item->string_val != NULL) {
+                                    str_append_n(EXPR_STRING(exprs, expr), item->string_val->val, item->string_val->length);
                                 }
                                 break;
                             case DT_NULL:
-                                expr->type = EX_NULL;
+                                EXPR_TYPE(exprs, expr) = EX_NULL;
                                 break;
                             default:
                                 break;
@@ -349,39 +328,37 @@ ErrorCode optimize_expression(AstExpression *expr, Symtable *globaltable, Symtab
             break;
 
         case EX_GLOBAL_ID:
-            if (expr->string_val != NULL) {
+            if (EXPR_IDENT(exprs, expr) != NULL) {
                 SymtableItem *item = NULL;
-                if (symtable_contains_global_var(globaltable, expr->string_val->val, &item) && item != NULL) {
+                if ((item = symtable_var(globaltable, EXPR_SLOT(exprs, expr))) != NULL) {
                     // We always have to set the data type to unknown if it is unknown
                     // in the symtable because it could have been reset due to side effects
                     if (item->data_type == DT_UNKNOWN) {
-                        expr->assumed_type = DT_UNKNOWN;
+                        EXPR_ASSUMED_TYPE(exprs, expr) = DT_UNKNOWN;
                         break;
                     }
                     if (item->data_type_known) {
-                        expr->val_known = true;
-                        expr->assumed_type = item->data_type;
-                        
-                        str_free(&expr->string_val);
+                        EXPR_VAL_KNOWN(exprs, expr) = true;
+                        EXPR_ASSUMED_TYPE(exprs, expr) = item->data_type;
                         
                         switch (item->data_type) {
                             case DT_NUM:
-                                expr->type = EX_DOUBLE;
-                                expr->double_val = item->double_val;
+                                EXPR_TYPE(exprs, expr) = EX_DOUBLE;
+                                EXPR_DOUBLE(exprs, expr) = item->double_val;
                                 break;
                             case DT_BOOL:
-                                expr->type = EX_BOOL;
-                                expr->bool_val = item->bool_val;
+                                EXPR_TYPE(exprs, expr) = EX_BOOL;
+                                EXPR_BOOL(exprs, expr) = item->bool_val;
                                 break;
                             case DT_STRING:
-                                expr->type = EX_STRING;
-                                expr->string_val = str_init();
-                                if (expr->string_val != NULL && item->string_val != NULL) {
-                                    str_append_string(expr->string_val, item->string_val->val);
+                                EXPR_TYPE(exprs, expr) = EX_STRING;
+                                EXPR_STRING(exprs, expr) = ast_own_string(str_init());
+                                if (EXPR_STRING(exprs, expr) != NULL && item->string_val != NULL) {
+                                    str_append_n(EXPR_STRING(exprs, expr), item->string_val->val, item->string_val->length);
                                 }
                                 break;
                             case DT_NULL:
-                                expr->type = EX_NULL;
+                                EXPR_TYPE(exprs, expr) = EX_NULL;
                                 break;
                             default:
                                 break;
@@ -397,92 +374,83 @@ ErrorCode optimize_expression(AstExpression *expr, Symtable *globaltable, Symtab
             clear_symtable_values(globaltable);
             break;
         case EX_BUILTIN_FUN:
-            if (strcmp(expr->string_val->val, "floor") == 0) {
-                if (expr->params[0]->assumed_type != DT_NUM) return SEM_TYPE_COMPAT;
-                str_free(&expr->string_val);
-                expr->val_known = true;
-                expr->assumed_type = DT_NUM;
-                expr->surely_int = true;
-                expr->double_val = floor(expr->params[0]->double_val);
+            if (strcmp(EXPR_IDENT(exprs, expr)->val, "floor") == 0) {
+                if (EXPR_ASSUMED_TYPE(exprs, EXPR_CHILD(exprs, expr, 0)) != DT_NUM) return SEM_TYPE_COMPAT;
+                EXPR_VAL_KNOWN(exprs, expr) = true;
+                EXPR_ASSUMED_TYPE(exprs, expr) = DT_NUM;
+                EXPR_SURELY_INT(exprs, expr) = true;
+                EXPR_DOUBLE(exprs, expr) = floor(EXPR_DOUBLE(exprs, EXPR_CHILD(exprs, expr, 0)));
                 break;
             }
-            if (strcmp(expr->string_val->val, "length") == 0) {
-                if (expr->params[0]->assumed_type != DT_STRING) return SEM_TYPE_COMPAT;
-                str_free(&expr->string_val);
-                expr->assumed_type = DT_NUM;
-                expr->val_known = true;
-                expr->double_val = (double)expr->params[0]->string_val->length;
+            if (strcmp(EXPR_IDENT(exprs, expr)->val, "length") == 0) {
+                if (EXPR_ASSUMED_TYPE(exprs, EXPR_CHILD(exprs, expr, 0)) != DT_STRING) return SEM_TYPE_COMPAT;
+                EXPR_ASSUMED_TYPE(exprs, expr) = DT_NUM;
+                EXPR_VAL_KNOWN(exprs, expr) = true;
+                EXPR_DOUBLE(exprs, expr) = (double)EXPR_STRING(exprs, EXPR_CHILD(exprs, expr, 0))->length;
                 break;
             }
-            if (strcmp(expr->string_val->val, "substring") == 0) {
-                if (expr->params[0]->assumed_type != DT_STRING) return SEM_TYPE_COMPAT;
-                if (expr->params[1]->assumed_type != DT_NUM) return SEM_TYPE_COMPAT;
-                if (!expr->params[1]->surely_int) break;
-                if (expr->params[2]->assumed_type != DT_NUM) return SEM_TYPE_COMPAT;
-                if (!expr->params[2]->surely_int) break;
-                int start = (int)expr->params[1]->double_val;
-                int end = (int)expr->params[2]->double_val;
-                char *str = expr->params[0]->string_val->val;
-                int len = expr->params[0]->string_val->length;
+            if (strcmp(EXPR_IDENT(exprs, expr)->val, "substring") == 0) {
+                if (EXPR_ASSUMED_TYPE(exprs, EXPR_CHILD(exprs, expr, 0)) != DT_STRING) return SEM_TYPE_COMPAT;
+                if (EXPR_ASSUMED_TYPE(exprs, EXPR_CHILD(exprs, expr, 1)) != DT_NUM) return SEM_TYPE_COMPAT;
+                if (!EXPR_SURELY_INT(exprs, EXPR_CHILD(exprs, expr, 1))) break;
+                if (EXPR_ASSUMED_TYPE(exprs, EXPR_CHILD(exprs, expr, 2)) != DT_NUM) return SEM_TYPE_COMPAT;
+                if (!EXPR_SURELY_INT(exprs, EXPR_CHILD(exprs, expr, 2))) break;
+                int start = (int)EXPR_DOUBLE(exprs, EXPR_CHILD(exprs, expr, 1));
+                int end = (int)EXPR_DOUBLE(exprs, EXPR_CHILD(exprs, expr, 2));
+                char *str = EXPR_STRING(exprs, EXPR_CHILD(exprs, expr, 0))->val;
+                int len = EXPR_STRING(exprs, EXPR_CHILD(exprs, expr, 0))->length;
                 if (start < 0 || end < 0 || start > end || start >= len || end > len) {
-                    expr->assumed_type = DT_NULL;
+                    EXPR_ASSUMED_TYPE(exprs, expr) = DT_NULL;
                     break;
                 }
-                String *res = str_init();
+                String *res = ast_own_string(str_init());
                 if (res == NULL) return INTERNAL_ERROR;
-                for (int i = start; i < end; i++) {
-                    if (!str_append_char(res, str[i])) {
-                        return INTERNAL_ERROR;
-                        str_free(&res);
-                    }
-                }
-                // Clear function name
-                str_free(&expr->string_val);
-                expr->string_val = res;
+                if (!str_append_n(res, str + start, end - start)) return INTERNAL_ERROR;
+                // Replaces the function name
+                EXPR_STRING(exprs, expr) = res;
 
-                expr->val_known = true;
-                expr->assumed_type = DT_STRING;
+                EXPR_VAL_KNOWN(exprs, expr) = true;
+                EXPR_ASSUMED_TYPE(exprs, expr) = DT_STRING;
                 break;
             }
-            if (strcmp(expr->string_val->val, "strcmp") == 0) {
-                if (expr->params[0]->assumed_type != DT_STRING) return SEM_TYPE_COMPAT;
-                if (expr->params[1]->assumed_type != DT_STRING) return SEM_TYPE_COMPAT;
-                str_free(&expr->string_val);
-                expr->assumed_type = DT_NUM;
-                expr->val_known = true;
-                int res = strcmp(expr->params[0]->string_val->val, expr->params[1]->string_val->val);
-                expr->double_val = res > 0 ? 1 :
+            if (strcmp(EXPR_IDENT(exprs, expr)->val, "strcmp") == 0) {
+                if (EXPR_ASSUMED_TYPE(exprs, EXPR_CHILD(exprs, expr, 0)) != DT_STRING) return SEM_TYPE_COMPAT;
+                if (EXPR_ASSUMED_TYPE(exprs, EXPR_CHILD(exprs, expr, 1)) != DT_STRING) return SEM_TYPE_COMPAT;
+                EXPR_ASSUMED_TYPE(exprs, expr) = DT_NUM;
+                EXPR_VAL_KNOWN(exprs, expr) = true;
+                int res = strcmp(EXPR_STRING(exprs, EXPR_CHILD(exprs, expr, 0))->val, EXPR_STRING(exprs, EXPR_CHILD(exprs, expr, 1))->val);
+                EXPR_DOUBLE(exprs, expr) = res > 0 ? 1 :
                                    res < 0 ? -1 :
                                    0;
                 break;
             }
-            if (strcmp(expr->string_val->val, "ord") == 0) {
-                if (expr->params[0]->assumed_type != DT_STRING) return SEM_TYPE_COMPAT;
-                if (expr->params[1]->assumed_type != DT_NUM) return SEM_TYPE_COMPAT;
-                if (!expr->params[1]->surely_int) break;
-                char *str = expr->params[0]->string_val->val;
-                int index = (int)expr->params[1]->double_val;
-                str_free(&expr->string_val);
-                expr->val_known = true;
-                expr->assumed_type = DT_NUM;
+            if (strcmp(EXPR_IDENT(exprs, expr)->val, "ord") == 0) {
+                if (EXPR_ASSUMED_TYPE(exprs, EXPR_CHILD(exprs, expr, 0)) != DT_STRING) return SEM_TYPE_COMPAT;
+                if (EXPR_ASSUMED_TYPE(exprs, EXPR_CHILD(exprs, expr, 1)) != DT_NUM) return SEM_TYPE_COMPAT;
+                if (!EXPR_SURELY_INT(exprs, EXPR_CHILD(exprs, expr, 1))) break;
+                char *str = EXPR_STRING(exprs, EXPR_CHILD(exprs, expr, 0))->val;
+                int index = (int)EXPR_DOUBLE(exprs, EXPR_CHILD(exprs, expr, 1));
+                EXPR_VAL_KNOWN(exprs, expr) = true;
+                EXPR_ASSUMED_TYPE(exprs, expr) = DT_NUM;
                 if (index >= (int)strlen(str) || index < 0) {
                     // Out of bound index
-                    expr->double_val = 0.0;
+                    EXPR_DOUBLE(exprs, expr) = 0.0;
                 } else {
-                    expr->double_val = (double)(unsigned char)str[index];
+                    EXPR_DOUBLE(exprs, expr) = (double)(unsigned char)str[index];
                 }
                 break;
             }
-            if (strcmp(expr->string_val->val, "chr") == 0) {
-                if (expr->params[0]->assumed_type != DT_NUM) return SEM_TYPE_COMPAT;
-                if (!expr->params[0]->surely_int) break;
-                int num = (int)expr->params[0]->double_val;
+            if (strcmp(EXPR_IDENT(exprs, expr)->val, "chr") == 0) {
+                if (EXPR_ASSUMED_TYPE(exprs, EXPR_CHILD(exprs, expr, 0)) != DT_NUM) return SEM_TYPE_COMPAT;
+                if (!EXPR_SURELY_INT(exprs, EXPR_CHILD(exprs, expr, 0))) break;
+                int num = (int)EXPR_DOUBLE(exprs, EXPR_CHILD(exprs, expr, 0));
                 if (num < 0 || num > 255) break;
-                expr->val_known = true;
-                expr->assumed_type = DT_STRING;
-                // Clear function name
-                str_clear(expr->string_val);
-                if (!str_append_char(expr->string_val, (char)num)) return INTERNAL_ERROR;
+                EXPR_VAL_KNOWN(exprs, expr) = true;
+                EXPR_ASSUMED_TYPE(exprs, expr) = DT_STRING;
+                // Replaces the function name
+                EXPR_STRING(exprs, expr) = ast_own_string(str_init());
+                if (EXPR_STRING(exprs, expr) == NULL) return INTERNAL_ERROR;
+                if (!str_append_char(EXPR_STRING(exprs, expr), (char)num)) return INTERNAL_ERROR;
                 break;
             }
             break;
@@ -490,198 +458,375 @@ ErrorCode optimize_expression(AstExpression *expr, Symtable *globaltable, Symtab
             break;
     }
 
-    if (expr->val_known && expr->assumed_type == DT_NUM) {
+    if (EXPR_VAL_KNOWN(exprs, expr) && EXPR_ASSUMED_TYPE(exprs, expr) == DT_NUM) {
         // We check if the known value is an integer
-        expr->surely_int = ceil(expr->double_val) == expr->double_val;
+        EXPR_SURELY_INT(exprs, expr) = ceil(EXPR_DOUBLE(exprs, expr)) == EXPR_DOUBLE(exprs, expr);
     }
 
     return OK;
 }
 
-ErrorCode optimize_block(AstBlock *block, Symtable *globaltable, Symtable *localtable) {
-    if (block == NULL) {
-        return OK;
+ErrorCode optimize_expression(AstExprs *exprs, ExprId expr, Symtable *globaltable, Symtable *localtable) {
+    if (expr == EXPR_NONE) {
+        return INTERNAL_ERROR;
     }
 
-    AstStatement *stmt = block->statements;
-    while (stmt != NULL && stmt->type != ST_END) {
-        ErrorCode ec = optimize_statement(stmt, globaltable, localtable);
-        if (ec != OK) {
-            return ec;
+    // Every node is optimized after all of its children, the walk keeps the path on the heap
+    // so deep expressions do not overflow the C stack
+    ErrorCode ec = OK;
+    AstWalk walk;
+    AstWalkFrame step;
+    ast_walk_init(&walk, exprs, expr);
+    while (ec == OK && ast_walk_next(&walk, &step)) {
+        if (step.done == EXPR_CHILD_COUNT(exprs, step.expr)) {
+            ec = optimize_node(exprs, step.expr, globaltable, localtable);
         }
-        stmt = stmt->next;
     }
-
-    return OK;
-}
-
-ErrorCode optimize_root(AstStatement *statement, Symtable *globaltable, Symtable *localtable) {
-    if (statement == NULL) {
-        return OK;
+    if (walk.failed) {
+        ec = INTERNAL_ERROR;
     }
+    ast_walk_free(&walk);
+    return ec;
+}
 
-    AstStatement *stmt = statement;
-    while (stmt != NULL && stmt->type != ST_END) {
-        ErrorCode ec = optimize_statement(stmt, globaltable, localtable);
-        if (ec != OK) {
-            return ec;
+#define _OPT_INLINE_DEPTH 32
+
+// Statement with nested blocks that is being optimized, the frames of the enclosing statements are
+// kept on an explicit stack so deeply nested blocks do not overflow the C stack
+typedef struct opt_frame {
+    // Statement owning the frame, NULL for a plain block
+    AstStatement *statement;
+    // Nested block being optimized and the position of its next statement
+    AstBlock *block;
+    size_t pos;
+    // Symtable for the local variables of the nested block
+    Symtable *localtable;
+    // Part of the statement to optimize next
+    unsigned phase;
+    // Else-if branch to optimize next
+    size_t index;
+} OptFrame;
+
+// Stack of the frames, it starts in a buffer on the C stack and moves to the heap when that is full
+typedef struct opt_stack {
+    OptFrame *frames;
+    size_t count;
+    size_t capacity;
+    OptFrame inline_frames[_OPT_INLINE_DEPTH];
+} OptStack;
+
+// Pushes a frame for the statement to the stack, returns NULL if allocation failed
+static OptFrame *opt_push(OptStack *stack, AstStatement *statement, AstBlock *block, Symtable *localtable) {
+    if (stack->count == stack->capacity) {
+        size_t capacity = stack->capacity * 2;
+        OptFrame *frames;
+        if (stack->frames == stack->inline_frames) {
+            frames = malloc(capacity * sizeof(OptFrame));
+            if (frames != NULL) {
+                memcpy(frames, stack->frames, stack->count * sizeof(OptFrame));
+            }
+        } else {
+            frames = realloc(stack->frames, capacity * sizeof(OptFrame));
         }
-        stmt = stmt->next;
+        if (frames == NULL) {
+            return NULL;
+        }
+        stack->frames = frames;
+        stack->capacity = capacity;
     }
 
-    return OK;
+    OptFrame *frame = &stack->frames[stack->count++];
+    *frame = (OptFrame){ .statement = statement, .block = block, .localtable = localtable };
+    return frame;
 }
 
-ErrorCode optimize_statement(AstStatement *statement, Symtable *globaltable, Symtable *localtable) {
-    if (statement == NULL) {
-        return OK;
+// True for statements that contain nested blocks
+static bool opt_is_compound(AstStatement *statement) {
+    switch (statement->type) {
+        case ST_IF:
+        case ST_WHILE:
+        case ST_BLOCK:
+        case ST_FUNCTION:
+        case ST_GETTER:
+        case ST_SETTER:
+        case ST_ROOT:
+            return true;
+        default:
+            return false;
     }
+}
 
+// Optimizes a statement without nested blocks
+static ErrorCode optimize_simple_statement(AstExprs *exprs, AstStatement *statement, Symtable *globaltable, Symtable *localtable) {
     ErrorCode ec = OK;
-    AstExpression *cond;
     SymtableItem *item;
 
     switch (statement->type) {
         case ST_LOCAL_VAR:
-            if (statement->local_var == NULL || statement->local_var->expression == NULL) break;
+            if (statement->local_var == NULL || statement->local_var->expression == EXPR_NONE) break;
 
-            ec = optimize_expression(statement->local_var->expression, globaltable, localtable);
+            ec = optimize_expression(exprs, statement->local_var->expression, globaltable, localtable);
             if (ec != OK) return ec;
 
             // Update symtable with known value
             item = NULL;
-            if ((item = symtable_find(localtable, statement->local_var->name->val)) == NULL) break;
-            update_symtable_value(item, statement->local_var->expression);
+            if ((item = symtable_var(localtable, statement->local_var->slot)) == NULL) break;
+            update_symtable_value(exprs, item, statement->local_var->expression);
             break;
 
         case ST_GLOBAL_VAR:
-            if (statement->global_var == NULL && statement->global_var->expression == NULL) break;
-            ec = optimize_expression(statement->global_var->expression, globaltable, localtable);
+            if (statement->global_var == NULL && statement->global_var->expression == EXPR_NONE) break;
+            ec = optimize_expression(exprs, statement->global_var->expression, globaltable, localtable);
             if (ec != OK) return ec;
 
             // Update symtable with known value
             item = NULL;
-            if (symtable_contains_global_var(globaltable, statement->global_var->name->val, &item) && item == NULL) break;
-            update_symtable_value(item, statement->global_var->expression);
+            if ((item = symtable_var(globaltable, statement->global_var->slot)) == NULL) break;
+            update_symtable_value(exprs, item, statement->global_var->expression);
             break;
 
         case ST_SETTER_CALL:
-            if (statement->setter_call != NULL && statement->setter_call->expression != NULL) {
-                ec = optimize_expression(statement->setter_call->expression, globaltable, localtable);
+            if (statement->setter_call != NULL && statement->setter_call->expression != EXPR_NONE) {
+                ec = optimize_expression(exprs, statement->setter_call->expression, globaltable, localtable);
             }
             // Setter could have side effects on global variables, so we have to clear their values
             clear_symtable_values(globaltable);
             break;
 
         case ST_RETURN:
-            if (statement->return_expr != NULL) {
-                ec = optimize_expression(statement->return_expr, globaltable, localtable);
+            if (statement->return_expr != EXPR_NONE) {
+                ec = optimize_expression(exprs, statement->return_expr, globaltable, localtable);
             }
             break;
 
-        case ST_IF:
-            if (statement->if_st == NULL) break;
+        case ST_EXPRESSION:
+            if (statement->expression != EXPR_NONE) {
+                ec = optimize_expression(exprs, statement->expression, globaltable, localtable);
+            }
+            break;
 
-            cond = statement->if_st->condition;
-            ec = optimize_expression(cond, globaltable, localtable);
-            if (ec != OK) return ec;
+        default:
+            break;
+    }
 
-            // We only optimize this branch if it can execute
-            ec = optimize_block(statement->if_st->true_branch, globaltable, localtable);
-            if (ec != OK) return ec;
-            // Clear symtable values because it could have side effects
-            clear_symtable_values(localtable);
-            clear_symtable_values(globaltable);
+    return ec;
+}
 
-            // Optimize else-if branches
-            for (size_t i = 0; i < statement->if_st->else_if_count; i++) {
-                if (statement->if_st->else_if_branches[i] != NULL) {
-                    ec = optimize_expression(statement->if_st->else_if_branches[i]->condition, globaltable, localtable);
-                    if (ec != OK) return ec;
+// Optimizes the parts of a compound statement up to its next nested block. Sets enter to true and
+// frame->block to the block when it should be optimized next, enter stays false when the statement is done
+static ErrorCode optimize_compound_step(AstExprs *exprs, OptFrame *frame, Symtable *globaltable, bool *enter) {
+    AstStatement *statement = frame->statement;
+    Symtable *localtable = frame->localtable;
+    ErrorCode ec;
+    ExprId cond;
 
-                    ec = optimize_block(statement->if_st->else_if_branches[i]->body, globaltable, localtable);
-                    if (ec != OK) return ec;
+    *enter = false;
+    if (statement == NULL) {
+        // A plain block is done once its statements are
+        return OK;
+    }
 
-                    clear_symtable_values(localtable);
-                    clear_symtable_values(globaltable);
-                }
-            }
+    switch (statement->type) {
+        case ST_IF:
+            if (statement->if_st == NULL) break;
+            cond = statement->if_st->condition;
 
-            // Optimize false branch
-            if (statement->if_st->false_branch != NULL &&
-                (cond->assumed_type == DT_UNKNOWN || !cond->val_known || !cond->bool_val)) {
-                // We only optimize this branch if it can execute
-                ec = optimize_block(statement->if_st->false_branch, globaltable, localtable);
-                if (cond->assumed_type == DT_UNKNOWN || !cond->val_known) {
-                    // If we aren't sure that this branch will execute, we have to clear
-                    // symtable values because it could have side effects
-                    clear_symtable_values(localtable);
-                    clear_symtable_values(globaltable);
+            for (;;) {
+                switch (frame->phase) {
+                    case 0:
+                        ec = optimize_expression(exprs, cond, globaltable, localtable);
+                        if (ec != OK) return ec;
+
+                        // We only optimize this branch if it can execute
+                        frame->block = statement->if_st->true_branch;
+                        frame->phase = 1;
+                        *enter = true;
+                        return OK;
+
+                    case 1:
+                        // Clear symtable values because it could have side effects
+                        clear_symtable_values(localtable);
+                        clear_symtable_values(globaltable);
+                        frame->phase = 2;
+                        break;
+
+                    case 2:
+                        // Optimize else-if branches
+                        if (frame->index >= statement->if_st->else_if_count) {
+                            frame->phase = 4;
+                            break;
+                        }
+                        if (statement->if_st->else_if_branches[frame->index] == NULL) {
+                            frame->index++;
+                            break;
+                        }
+                        ec = optimize_expression(exprs, statement->if_st->else_if_branches[frame->index]->condition, globaltable, localtable);
+                        if (ec != OK) return ec;
+
+                        frame->block = statement->if_st->else_if_branches[frame->index]->body;
+                        frame->phase = 3;
+                        *enter = true;
+                        return OK;
+
+                    case 3:
+                        clear_symtable_values(localtable);
+                        clear_symtable_values(globaltable);
+                        frame->index++;
+                        frame->phase = 2;
+                        break;
+
+                    case 4:
+                        // Optimize false branch
+                        if (statement->if_st->false_branch != NULL &&
+                            (EXPR_ASSUMED_TYPE(exprs, cond) == DT_UNKNOWN || !EXPR_VAL_KNOWN(exprs, cond) || !EXPR_BOOL(exprs, cond))) {
+                            // We only optimize this branch if it can execute
+                            frame->block = statement->if_st->false_branch;
+                            frame->phase = 5;
+                            *enter = true;
+                        }
+                        return OK;
+
+                    default:
+                        if (EXPR_ASSUMED_TYPE(exprs, cond) == DT_UNKNOWN || !EXPR_VAL_KNOWN(exprs, cond)) {
+                            // If we aren't sure that this branch will execute, we have to clear
+                            // symtable values because it could have side effects
+                            clear_symtable_values(localtable);
+                            clear_symtable_values(globaltable);
+                        }
+                        return OK;
                 }
             }
-            break;
 
         case ST_WHILE:
             if (statement->while_st == NULL) break;
 
-            clear_symtable_values(localtable);
-            clear_symtable_values(globaltable);
-            cond = statement->while_st->condition;
+            if (frame->phase == 0) {
+                clear_symtable_values(localtable);
+                clear_symtable_values(globaltable);
 
-            ec = optimize_expression(cond, globaltable, localtable);
-            if (ec != OK) return ec;
-            ec = optimize_block(statement->while_st->body, globaltable, localtable);
-            if (ec != OK) return ec;
+                ec = optimize_expression(exprs, statement->while_st->condition, globaltable, localtable);
+                if (ec != OK) return ec;
 
+                frame->block = statement->while_st->body;
+                frame->phase = 1;
+                *enter = true;
+                return OK;
+            }
             clear_symtable_values(localtable);
             clear_symtable_values(globaltable);
-
             break;
-            
+
         case ST_BLOCK:
-            if (statement->block != NULL) {
-                ec = optimize_block(statement->block, globaltable, localtable);
+            if (frame->phase == 0) {
+                frame->block = statement->block;
+                frame->phase = 1;
+                *enter = true;
             }
             break;
 
         case ST_FUNCTION:
-            if (statement->function != NULL && statement->function->body != NULL) {
-                ec = optimize_block(statement->function->body, globaltable, statement->function->symtable);
-                clear_symtable_values(globaltable);
+        case ST_GETTER:
+        case ST_SETTER:
+            if (frame->phase == 0) {
+                AstBlock *body = NULL;
+                if (statement->type == ST_FUNCTION && statement->function != NULL) {
+                    body = statement->function->body;
+                    frame->localtable = statement->function->symtable;
+                } else if (statement->type == ST_GETTER && statement->getter != NULL) {
+                    body = statement->getter->body;
+                    frame->localtable = statement->getter->symtable;
+                } else if (statement->type == ST_SETTER && statement->setter != NULL) {
+                    body = statement->setter->body;
+                    frame->localtable = statement->setter->symtable;
+                }
+                if (body == NULL) break;
+
+                frame->block = body;
+                frame->phase = 1;
+                *enter = true;
+                return OK;
             }
+            clear_symtable_values(globaltable);
             break;
 
-        case ST_GETTER:
-            if (statement->getter != NULL && statement->getter->body != NULL) {
-                ec = optimize_block(statement->getter->body, globaltable, statement->getter->symtable);
-                clear_symtable_values(globaltable);
+        case ST_ROOT:
+            if (frame->phase == 0) {
+                frame->block = statement->block;
+                frame->phase = 1;
+                *enter = true;
             }
             break;
 
-        case ST_SETTER:
-            if (statement->setter != NULL && statement->setter->body != NULL) {
-                ec = optimize_block(statement->setter->body, globaltable, statement->setter->symtable);
-                clear_symtable_values(globaltable);
-            }
+        default:
             break;
+    }
 
-        case ST_EXPRESSION:
-            if (statement->expression != NULL) {
-                ec = optimize_expression(statement->expression, globaltable, localtable);
+    return OK;
+}
+
+// Optimizes the statements of the block and the compound statement that starts the stack
+static ErrorCode optimize_nested(AstExprs *exprs, AstStatement *statement, AstBlock *block, Symtable *globaltable, Symtable *localtable) {
+    OptStack stack = { .frames = stack.inline_frames, .count = 0, .capacity = _OPT_INLINE_DEPTH };
+    ErrorCode ec = OK;
+    opt_push(&stack, statement, block, localtable);
+
+    while (ec == OK && stack.count > 0) {
+        OptFrame *top = &stack.frames[stack.count - 1];
+
+        if (top->block != NULL && top->pos < top->block->count) {
+            AstStatement *stmt = &top->block->statements[top->pos++];
+
+            if (!opt_is_compound(stmt)) {
+                ec = optimize_simple_statement(exprs, stmt, globaltable, top->localtable);
+            } else if (opt_push(&stack, stmt, NULL, top->localtable) == NULL) {
+                ec = INTERNAL_ERROR;
             }
-            break;
+            continue;
+        }
 
-        case ST_ROOT:
-            ec = optimize_root(statement->next, globaltable, localtable);
-            break;
-        case ST_END:
-            break;
+        bool enter;
+        ec = optimize_compound_step(exprs, top, globaltable, &enter);
+        if (enter) {
+            top->pos = 0;
+        } else {
+            stack.count--;
+        }
     }
 
+    if (stack.frames != stack.inline_frames) {
+        free(stack.frames);
+    }
     return ec;
 }
 
-ErrorCode optimize_ast(AstStatement *root, Symtable *globaltable) {
+ErrorCode optimize_block(AstExprs *exprs, AstBlock *block, Symtable *globaltable, Symtable *localtable) {
+    if (block == NULL) {
+        return OK;
+    }
+
+    return optimize_nested(exprs, NULL, block, globaltable, localtable);
+}
+
+ErrorCode optimize_root(AstExprs *exprs, AstBlock *definitions, Symtable *globaltable, Symtable *localtable) {
+    if (definitions == NULL) {
+        return OK;
+    }
+
+    return optimize_nested(exprs, NULL, definitions, globaltable, localtable);
+}
+
+ErrorCode optimize_statement(AstExprs *exprs, AstStatement *statement, Symtable *globaltable, Symtable *localtable) {
+    if (statement == NULL) {
+        return OK;
+    }
+
+    if (!opt_is_compound(statement)) {
+        return optimize_simple_statement(exprs, statement, globaltable, localtable);
+    }
+    return optimize_nested(exprs, statement, NULL, globaltable, localtable);
+}
+
+ErrorCode optimize_ast(AstExprs *exprs, AstStatement *root, Symtable *globaltable) {
     if (root == NULL) {
         return INTERNAL_ERROR;
     }
@@ -690,7 +835,7 @@ ErrorCode optimize_ast(AstStatement *root, Symtable *globaltable) {
         return INTERNAL_ERROR;
     }
 
-    ErrorCode ec = optimize_statement(root, globaltable, NULL);
+    ErrorCode ec = optimize_statement(exprs, root, globaltable, NULL);
     return ec;
 }
 
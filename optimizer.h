@@ -16,22 +16,22 @@
 #include "symtable.h"
 
 /// Optimizes the given AST
-ErrorCode optimize_ast(AstStatement *root, Symtable *globaltable);
+ErrorCode optimize_ast(AstExprs *exprs, AstStatement *root, Symtable *globaltable);
 
 /// Optimizes a given expression (evaluates if possible)
-ErrorCode optimize_expression(AstExpression *expr, Symtable *globaltable, Symtable *localtable);
+ErrorCode optimize_expression(AstExprs *exprs, ExprId expr, Symtable *globaltable, Symtable *localtable);
 
 /// Optimizes a single statement
-ErrorCode optimize_statement(AstStatement *statement, Symtable *globaltable, Symtable *localtable);
+ErrorCode optimize_statement(AstExprs *exprs, AstStatement *statement, Symtable *globaltable, Symtable *localtable);
 
 /// Optimizes a block of statements
-ErrorCode optimize_block(AstBlock *block, Symtable *globaltable, Symtable *localtable);
+ErrorCode optimize_block(AstExprs *exprs, AstBlock *block, Symtable *globaltable, Symtable *localtable);
 
-/// Optimizes a root level statement list
-ErrorCode optimize_root(AstStatement *statement, Symtable *globaltable, Symtable *localtable);
+/// Optimizes the root level block of definitions
+ErrorCode optimize_root(AstExprs *exprs, AstBlock *definitions, Symtable *globaltable, Symtable *localtable);
 
 /// Updates symtable item with known value from expression
-void update_symtable_value(SymtableItem *item, AstExpression *expr);
+void update_symtable_value(AstExprs *exprs, SymtableItem *item, ExprId expr);
 
 /// Clears a known value from a symtable item
 void clear_symtable_item_value(SymtableItem *it, void* par);
@@ -16,21 +16,14 @@
 #include <string.h>
 #include <math.h>
 
-/// Macro for returning with token free
-#define RETURN_CODE(code, token) do { \
-    token_free(&token); \
-    return code; \
-} while(0)
-
 /// Macro for initializing token
 #define INIT_TOKEN(token, tok_type) do { \
     (token).type = (tok_type); \
-    (token).string_val = NULL; \
+    (token).expr_val = EXPR_NONE; \
 } while(0)
 
 /// Macro for checking token
 #define CHECK_TOKEN(lexer, token) do { \
-    token_free(&token); \
     if(lexer_get_token(lexer, &token) != ERR_LEX_OK) { \
         return LEXICAL_ERROR; \
     } \
@@ -38,7 +31,6 @@
 
 /// Macro for checking token while skipping newlines
 #define CHECK_TOKEN_SKIP_NEWLINE(lexer, token) do { \
-    token_free(&token); \
     do { \
         if(lexer_get_token(lexer, &token) != ERR_LEX_OK ) { \
             return LEXICAL_ERROR; \
@@ -52,7 +44,7 @@
     if (symtable_contains_function(symtable, name, pcount, &existing_item)) { \
         if (existing_item != NULL && existing_item->is_defined) { \
             param_list_free(params); \
-            RETURN_CODE(SEM_REDEFINITION, error_token); \
+            return SEM_REDEFINITION; \
         } \
         if (existing_item != NULL && !existing_item->is_defined) { \
             existing_item->is_defined = 1; \
@@ -62,7 +54,7 @@
         SymtableItem *new_item = symtable_add_function(symtable, name, pcount, 1); \
         if (new_item == NULL) { \
             param_list_free(params); \
-            RETURN_CODE(INTERNAL_ERROR, error_token); \
+            return INTERNAL_ERROR; \
         } \
     } \
 } while(0)
@@ -70,30 +62,49 @@
 /// Macro for adding variable to symbol table with redefinition check
 #define ADD_VARIABLE(symtable, name, error_token, type) do { \
     if (contains_var_at_current_scope(symtable, name)) { \
-        RETURN_CODE(SEM_REDEFINITION, error_token); \
+        return SEM_REDEFINITION; \
     } \
     SymtableItem *new_item = add_var_at_current_scope(symtable, name, type); \
     if (new_item == NULL) { \
-        RETURN_CODE(INTERNAL_ERROR, error_token); \
+        return INTERNAL_ERROR; \
     } \
     new_item->is_defined = 1; \
 } while(0)
 
-/// Macro for adding global variable to symbol table with redefinition check
-#define ADD_GLOBAL_VARIABLE(symtable, name, error_token, type) do { \
-    SymtableItem *existing_item = NULL; \
-    if (!symtable_contains_global_var(symtable, name, &existing_item)) { \
-        SymtableItem *new_item = symtable_add_global_var(symtable, name, type, 1); \
-        if (new_item == NULL) { \
-            RETURN_CODE(INTERNAL_ERROR, error_token); \
+/// Macro for adding global variable to symbol table with redefinition check, out_item is set to the variable
+#define ADD_GLOBAL_VARIABLE(symtable, name, error_token, type, out_item) do { \
+    if (!symtable_contains_global_var(symtable, name, &(out_item))) { \
+        (out_item) = symtable_add_global_var(symtable, name, type, 1); \
+        if ((out_item) == NULL) { \
+            return INTERNAL_ERROR; \
         } \
     } \
 } while(0)
 
+/// Number of nested bodies checked before the frame stack moves to the heap
+#define _BODY_INLINE_DEPTH 32
+
+/// Body whose statements are being checked. The frames of the enclosing bodies are kept on an
+/// explicit stack, so deeply nested blocks do not overflow the C stack
+typedef struct body_frame {
+    AstBlock *block;
+    /// Block, if or while statement the body belongs to, NULL for the body check_body was called for
+    AstStatement *statement;
+    bool known;
+} BodyFrame;
+
+/// Stack of the frames, it starts in a buffer on the C stack and moves to the heap when that is full
+typedef struct body_stack {
+    BodyFrame *frames;
+    size_t count;
+    size_t capacity;
+    BodyFrame inline_frames[_BODY_INLINE_DEPTH];
+} BodyStack;
+
 /// Helper for adding getter to symbol table with redefinition check
-ErrorCode add_getter_helper(Symtable *symtable, char *name) {
+ErrorCode add_getter_helper(Symtable *symtable, const Ident *name) {
     SymtableItem *existing_item = NULL;
-    if (symtable_contains_getter(symtable, (char *)name, &existing_item)) {
+    if (symtable_contains_getter(symtable, name, &existing_item)) {
         if (existing_item != NULL && existing_item->is_defined) {
             return SEM_REDEFINITION;
         }
@@ -104,7 +115,7 @@ ErrorCode add_getter_helper(Symtable *symtable, char *name) {
         }
         return OK;
     } else {
-        SymtableItem *new_item = symtable_add_getter(symtable, (char *)name, 1);
+        SymtableItem *new_item = symtable_add_getter(symtable, name, 1);
         if (new_item == NULL) {
             return INTERNAL_ERROR;
         }
@@ -113,9 +124,9 @@ ErrorCode add_getter_helper(Symtable *symtable, char *name) {
 }
 
 /// Helper for adding setter to symbol table with redefinition check
-ErrorCode add_setter_helper(Symtable *symtable, char *name) {
+ErrorCode add_setter_helper(Symtable *symtable, const Ident *name) {
     SymtableItem *existing_item = NULL;
-    if (symtable_contains_setter(symtable, (char *)name, &existing_item)) {
+    if (symtable_contains_setter(symtable, name, &existing_item)) {
         if (existing_item != NULL && existing_item->is_defined) {
             return SEM_REDEFINITION;
         }
@@ -126,7 +137,7 @@ ErrorCode add_setter_helper(Symtable *symtable, char *name) {
         }
         return OK;
     } else {
-        SymtableItem *new_item = symtable_add_setter(symtable, (char *)name, 1);
+        SymtableItem *new_item = symtable_add_setter(symtable, name, 1);
         if (new_item == NULL) {
             return INTERNAL_ERROR;
         }
@@ -135,7 +146,7 @@ ErrorCode add_setter_helper(Symtable *symtable, char *name) {
 }
 
 /// Helper function for checking variable expression - checks if variable exists
-ErrorCode check_variable_expression(Symtable *localtable, Symtable *globaltable, char *name, DataType expr_type, AstStatementType *type_out) {
+ErrorCode check_variable_expression(Symtable *localtable, Symtable *globaltable, const Ident *name, DataType expr_type, AstStatementType *type_out, int *slot_out) {
     SymtableItem *local_var = NULL;
     if (!find_local_var(localtable, name, &local_var)) {
         return INTERNAL_ERROR;
@@ -151,9 +162,11 @@ ErrorCode check_variable_expression(Symtable *localtable, Symtable *globaltable,
             symtable_increment_undefined_items_counter(globaltable);
         }
         *type_out = ST_SETTER;
+        *slot_out = SLOT_NONE;
     } else {
         local_var->data_type = expr_type;
         *type_out = ST_LOCAL_VAR;
+        *slot_out = local_var->slot;
     }
 
     return OK;
@@ -168,7 +181,7 @@ ParamList *param_list_init() {
     
     list->capacity = 4; // Initial capacity
     list->count = 0;
-    list->names = malloc(list->capacity * sizeof(String *));
+    list->names = malloc(list->capacity * sizeof(const Ident *));
     if (list->names == NULL) {
         free(list);
         return NULL;
@@ -177,8 +190,8 @@ ParamList *param_list_init() {
     return list;
 }
 
-/// Adds a parameter name to the list (creates a copy of the string)
-bool param_list_add(ParamList *list, const char *name) {
+/// Adds a parameter name to the list
+bool param_list_add(ParamList *list, const Ident *name) {
     if (list == NULL || name == NULL) {
         return false;
     }
@@ -186,78 +199,64 @@ bool param_list_add(ParamList *list, const char *name) {
     // Resize array if needed
     if (list->count >= list->capacity) {
         list->capacity *= 2;
-        String **new_names = realloc(list->names, list->capacity * sizeof(String *));
+        const Ident **new_names = realloc(list->names, list->capacity * sizeof(const Ident *));
         if (new_names == NULL) {
             return false;
         }
         list->names = new_names;
     }
     
-    // Copy parameter name
-    list->names[list->count] = str_init();
-    if (list->names[list->count] == NULL) {
-        return false;
-    }
-    
-    if (!str_append_string(list->names[list->count], name)) {
-        str_free(&list->names[list->count]);
-        return false;
-    }
-    
-    list->count++;
+    list->names[list->count++] = name;
     return true;
 }
 
-/// Frees the parameter list and all its strings
+/// Frees the parameter list, the names themselves are interned
 void param_list_free(ParamList *list) {
     if (list == NULL) {
         return;
     }
     
-    if (list->names != NULL) {
-        for (size_t i = 0; i < list->count; i++) {
-            str_free(&list->names[i]);
-        }
-        free(list->names);
-    }
+    free(list->names);
 
     free(list);
 }
 
+/// Number of builtin functions added by add_builtin_functions
+#define _BUILTIN_FUNCTION_COUNT 11
+
 /// Adds all builtin functions to the symbol table
-/// Format: #function_name$param_count
 /// Returns true if all functions were successfully added, false otherwise
 bool add_builtin_functions(Symtable *symtab) {
     // I/O functions
-    if (add_builtin_function(symtab, "#read_str", 0, DT_UNKNOWN, NULL) == NULL) return false; // Ifj.read_str() -> String | Null
-    if (add_builtin_function(symtab, "#read_num", 0, DT_UNKNOWN, NULL) == NULL) return false; // Ifj.read_num() -> Num | Null
-    if (add_builtin_function(symtab, "#read_bool", 0, DT_UNKNOWN, NULL) == NULL) return false; // Ifj.read_bool() -> Bool | Null
+    if (add_builtin_function(symtab, "read_str", 0, DT_UNKNOWN, NULL) == NULL) return false; // Ifj.read_str() -> String | Null
+    if (add_builtin_function(symtab, "read_num", 0, DT_UNKNOWN, NULL) == NULL) return false; // Ifj.read_num() -> Num | Null
+    if (add_builtin_function(symtab, "read_bool", 0, DT_UNKNOWN, NULL) == NULL) return false; // Ifj.read_bool() -> Bool | Null
     
     DataType write_params[] = {DT_UNKNOWN};  // term can be any type
-    if (add_builtin_function(symtab, "#write", 1, DT_NULL, write_params) == NULL) return false; // Ifj.write(term) -> Null
+    if (add_builtin_function(symtab, "write", 1, DT_NULL, write_params) == NULL) return false; // Ifj.write(term) -> Null
 
     // Conversion functions
     DataType floor_params[] = {DT_NUM};
-    if (add_builtin_function(symtab, "#floor", 1, DT_NUM, floor_params) == NULL) return false; // Ifj.floor(Num) -> Num
+    if (add_builtin_function(symtab, "floor", 1, DT_NUM, floor_params) == NULL) return false; // Ifj.floor(Num) -> Num
     
     DataType str_params[] = {DT_UNKNOWN};  // term can be any type
-    if (add_builtin_function(symtab, "#str", 1, DT_STRING, str_params) == NULL) return false; // Ifj.str(term) -> String
+    if (add_builtin_function(symtab, "str", 1, DT_STRING, str_params) == NULL) return false; // Ifj.str(term) -> String
 
     // String functions
     DataType length_params[] = {DT_STRING};
-    if (add_builtin_function(symtab, "#length", 1, DT_NUM, length_params) == NULL) return false; // Ifj.length(String) -> Num
+    if (add_builtin_function(symtab, "length", 1, DT_NUM, length_params) == NULL) return false; // Ifj.length(String) -> Num
     
     DataType substring_params[] = {DT_STRING, DT_NUM, DT_NUM};
-    if (add_builtin_function(symtab, "#substring", 3, DT_UNKNOWN, substring_params) == NULL) return false; // Ifj.substring(String, Num, Num) -> String | Null
+    if (add_builtin_function(symtab, "substring", 3, DT_UNKNOWN, substring_params) == NULL) return false; // Ifj.substring(String, Num, Num) -> String | Null
     
     DataType strcmp_params[] = {DT_STRING, DT_STRING};
-    if (add_builtin_function(symtab, "#strcmp", 2, DT_NUM, strcmp_params) == NULL) return false; // Ifj.strcmp(String, String) -> Num
+    if (add_builtin_function(symtab, "strcmp", 2, DT_NUM, strcmp_params) == NULL) return false; // Ifj.strcmp(String, String) -> Num
     
     DataType ord_params[] = {DT_STRING, DT_NUM};
-    if (add_builtin_function(symtab, "#ord", 2, DT_NUM, ord_params) == NULL) return false; // Ifj.ord(String, Num) -> Num
+    if (add_builtin_function(symtab, "ord", 2, DT_NUM, ord_params) == NULL) return false; // Ifj.ord(String, Num) -> Num
     
     DataType chr_params[] = {DT_NUM};
-    if (add_builtin_function(symtab, "#chr", 1, DT_STRING, chr_params) == NULL) return false; // Ifj.chr(Num) -> String
+    if (add_builtin_function(symtab, "chr", 1, DT_STRING, chr_params) == NULL) return false; // Ifj.chr(Num) -> String
 
     return true;
 }
@@ -270,64 +269,64 @@ ErrorCode check_prologue(Lexer *lexer) {
 
     CHECK_TOKEN_SKIP_NEWLINE(lexer, token);
     if (token.type != TOK_KW_IMPORT)
-        RETURN_CODE(SYNTACTIC_ERROR, token);
+        return SYNTACTIC_ERROR;
 
     CHECK_TOKEN_SKIP_NEWLINE(lexer, token);
-    if (token.type != TOK_LIT_STRING || strcmp(token.string_val->val, "ifj25"))
-        RETURN_CODE(SYNTACTIC_ERROR, token);
+    if (token.type != TOK_LIT_STRING || token.text.length != 5 || memcmp(lexer_token_text(lexer, &token), "ifj25", 5))
+        return SYNTACTIC_ERROR;
 
     CHECK_TOKEN(lexer, token);
     if (token.type != TOK_KW_FOR)
-        RETURN_CODE(SYNTACTIC_ERROR, token);
+        return SYNTACTIC_ERROR;
 
     CHECK_TOKEN_SKIP_NEWLINE(lexer, token);
     if (token.type != TOK_KW_IFJ)
-        RETURN_CODE(SYNTACTIC_ERROR, token);
+        return SYNTACTIC_ERROR;
 
     CHECK_TOKEN(lexer, token);
     if (token.type != TOK_EOL)
-        RETURN_CODE(SYNTACTIC_ERROR, token);
+        return SYNTACTIC_ERROR;
 
-    RETURN_CODE(OK, token);
+    return OK;
 }
 
 /// Checks class Program { ... }
-ErrorCode check_class_program(Lexer *lexer, Symtable *symtable, AstStatement *statement) {
+ErrorCode check_class_program(Lexer *lexer, AstExprs *exprs, Symtable *symtable, AstBlock *block, DefinitionHandler handler, void *handler_par) {
     Token token;
     INIT_TOKEN(token, TOK_KW_CLASS);
 
     CHECK_TOKEN_SKIP_NEWLINE(lexer, token);
     if (token.type != TOK_KW_CLASS)
-        RETURN_CODE(SYNTACTIC_ERROR, token);
+        return SYNTACTIC_ERROR;
 
     CHECK_TOKEN_SKIP_NEWLINE(lexer, token);
-    if (token.type != TOK_IDENTIFIER || strcmp(token.string_val->val, "Program"))
-        RETURN_CODE(SYNTACTIC_ERROR, token);
+    if (token.type != TOK_IDENTIFIER || strcmp(token.ident_val->val, "Program"))
+        return SYNTACTIC_ERROR;
 
     CHECK_TOKEN(lexer, token);
     if (token.type != TOK_LEFT_BRACE)
-        RETURN_CODE(SYNTACTIC_ERROR, token);
+        return SYNTACTIC_ERROR;
 
     // Check class body
-    ErrorCode ec = check_class_body(lexer, symtable, statement);
+    ErrorCode ec = check_class_body(lexer, exprs, symtable, block, handler, handler_par);
     if (ec != OK) {
-        RETURN_CODE(ec, token);
+        return ec;
     }
 
     CHECK_TOKEN_SKIP_NEWLINE(lexer, token);
     if (token.type != TOK_RIGHT_BRACE)
-        RETURN_CODE(SYNTACTIC_ERROR, token);
+        return SYNTACTIC_ERROR;
 
     // Check for end of file
     CHECK_TOKEN_SKIP_NEWLINE(lexer, token);
     if (token.type != TOK_DOLLAR)
-        RETURN_CODE(SYNTACTIC_ERROR, token);
+        return SYNTACTIC_ERROR;
 
-    RETURN_CODE(OK, token);
+    return OK;
 }
 
 /// Checks the body of a class
-ErrorCode check_class_body(Lexer *lexer, Symtable *symtable, AstStatement *statement) {
+ErrorCode check_class_body(Lexer *lexer, AstExprs *exprs, Symtable *symtable, AstBlock *block, DefinitionHandler handler, void *handler_par) {
     Token token;
     INIT_TOKEN(token, TOK_IDENTIFIER);
     
@@ -346,47 +345,56 @@ ErrorCode check_class_body(Lexer *lexer, Symtable *symtable, AstStatement *state
         ErrorCode ec;
         // Check for statics
         if (token.type == TOK_KW_STATIC) {
-            ec = check_statics(lexer, symtable, statement);
+            // The block must not grow after the mark, it would be freed with the definition
+            if (!ast_block_reserve(block, 1)) {
+                return INTERNAL_ERROR;
+            }
+            AstMark mark = ast_mark(exprs);
+            ec = check_statics(lexer, exprs, symtable, block, token.local_count);
             if (ec != OK) {
-                RETURN_CODE(ec, token);
+                return ec;
+            }
+            if (handler != NULL) {
+                // The definition is handed over as soon as it is checked and then freed,
+                // everything it allocated is after the mark
+                handler(exprs, &block->statements[block->count - 1], symtable, handler_par);
+                ast_block_release_last(exprs, block, mark);
             }
-            statement = statement->next;
         } else {
-            RETURN_CODE(SYNTACTIC_ERROR, token);
+            return SYNTACTIC_ERROR;
         }
     }
 }
 
 /// Checks the global variable declaration
-ErrorCode check_global_var(Lexer *lexer, Symtable *globaltable, Symtable *localtable, String *var_name, AstStatement *statement) {
+ErrorCode check_global_var(Lexer *lexer, AstExprs *exprs, Symtable *globaltable, Symtable *localtable, const Ident *var_name, AstBlock *block) {
     Token token;
     INIT_TOKEN(token, TOK_GLOBAL_VAR);    // Add variable to symbol table with redefinition check
     
-    AstExpression *expr = NULL;
+    ExprId expr = EXPR_NONE;
     CHECK_TOKEN(lexer, token);
     if (token.type == TOK_OP_ASSIGN) {
         // Parse assignment expression
-        ErrorCode ec = parse_expression(lexer, &expr);
+        ErrorCode ec = parse_expression(lexer, exprs, &expr);
         if (ec != OK) {
-            RETURN_CODE(ec, token);
+            return ec;
         }
 
         DataType expr_type;
         // Check expression type compatibility
-        ec = semantic_check_expression(expr, globaltable, localtable, &expr_type);
+        ec = semantic_check_expression(exprs, expr, globaltable, localtable, &expr_type);
         if (ec != OK) {
-            ast_expr_free(expr);
-            RETURN_CODE(ec, token);
-        }
-
-        // Add global variable to AST
-        if (ast_add_global_var(statement, var_name->val, expr) == false) {
-            ast_expr_free(expr);
-            RETURN_CODE(INTERNAL_ERROR, token);
+            return ec;
         }
 
         // Add variable to symbol table with redefinition check
-        ADD_GLOBAL_VARIABLE(globaltable, var_name->val, token, DT_UNKNOWN);
+        SymtableItem *global_var;
+        ADD_GLOBAL_VARIABLE(globaltable, var_name, token, DT_UNKNOWN, global_var);
+
+        // Add global variable to AST, bound to its slot
+        if (ast_add_global_var(block, var_name, global_var->slot, expr) == NULL) {
+            return INTERNAL_ERROR;
+        }
 
         CHECK_TOKEN(lexer, token);
     } else {
@@ -396,22 +404,20 @@ ErrorCode check_global_var(Lexer *lexer, Symtable *globaltable, Symtable *localt
         }
 
         // Parse assignment expression
-        ErrorCode ec = parse_expression(lexer, &expr);
+        ErrorCode ec = parse_expression(lexer, exprs, &expr);
         if (ec != OK) {
             return ec;
         }
 
         DataType expr_type;
         // Check expression type compatibility
-        ec = semantic_check_expression(expr, globaltable, localtable, &expr_type);
+        ec = semantic_check_expression(exprs, expr, globaltable, localtable, &expr_type);
         if (ec != OK) {
-            ast_expr_free(expr);
             return ec;
         }
 
         // Add global variable to AST
-        if (ast_add_inline_expression(statement, expr) == false) {
-            ast_expr_free(expr);
+        if (ast_add_inline_expression(block, expr) == NULL) {
             return INTERNAL_ERROR;
         }
 
@@ -422,86 +428,84 @@ ErrorCode check_global_var(Lexer *lexer, Symtable *globaltable, Symtable *localt
     }
 
     if (token.type != TOK_EOL) {
-        RETURN_CODE(SYNTACTIC_ERROR, token);
+        return SYNTACTIC_ERROR;
     }
 
-    RETURN_CODE(OK, token);
+    return OK;
 }
 
 /// Checks statics (static functions and variables)
-ErrorCode check_statics(Lexer *lexer, Symtable *symtable, AstStatement *statement) {
+ErrorCode check_statics(Lexer *lexer, AstExprs *exprs, Symtable *symtable, AstBlock *block, size_t local_count) {
     Token identifier;
     INIT_TOKEN(identifier, TOK_IDENTIFIER);
 
     CHECK_TOKEN(lexer, identifier);
     if (identifier.type != TOK_IDENTIFIER)
-        RETURN_CODE(SYNTACTIC_ERROR, identifier);
+        return SYNTACTIC_ERROR;
 
     // Create new local symbol table for the static function/setter/getter
-    Symtable *new_symtable = symtable_init();
+    Symtable *new_symtable = symtable_init_with_capacity(local_count);
     if (new_symtable == NULL) {
-        RETURN_CODE(INTERNAL_ERROR, identifier);
+        return INTERNAL_ERROR;
     }
 
     Token token;
     INIT_TOKEN(token, TOK_OP_ASSIGN);
     CHECK_TOKEN(lexer, token);
-    
+
+    // The symtable belongs to the AST once the definition is added to the block
+    size_t definitions = block->count;
+
     // Setter: static identifier = (val) { ... }
     if (token.type == TOK_OP_ASSIGN) {
-        ErrorCode ec = checks_setter(lexer, symtable, new_symtable, identifier, statement);
+        ErrorCode ec = checks_setter(lexer, exprs, symtable, new_symtable, identifier, block);
         if (ec != OK) {
-            if (statement->type != ST_SETTER || statement->setter->symtable != new_symtable) {
+            if (block->count == definitions) {
                 // We have to free the local symtable if it is not in the ast yet
                 symtable_free(new_symtable);
             }
-            token_free(&identifier);
-            RETURN_CODE(ec, token);
+            return ec;
         }
     }
     // Getter: static identifier { ... }
     else if (token.type == TOK_LEFT_BRACE) {
-        ErrorCode ec = check_getter(lexer, symtable, new_symtable, identifier, statement);
+        ErrorCode ec = check_getter(lexer, exprs, symtable, new_symtable, identifier, block);
         if (ec != OK) {
-            if (statement->type != ST_GETTER || statement->getter->symtable != new_symtable) {
+            if (block->count == definitions) {
                 // We have to free the local symtable if it is not in the ast yet
                 symtable_free(new_symtable);
             }
-            token_free(&identifier);
-            RETURN_CODE(ec, token);
+            return ec;
         }
     }
     // Function: static identifier(...) { ... }
     else if (token.type == TOK_LEFT_PAR) {
-        ErrorCode ec = check_function(lexer, symtable, new_symtable, identifier, statement);
+        ErrorCode ec = check_function(lexer, exprs, symtable, new_symtable, identifier, block);
         if (ec != OK) {
-            if (statement->type != ST_FUNCTION || statement->function->symtable != new_symtable) {
+            if (block->count == definitions) {
                 // We have to free the local symtable if it is not in the ast yet
                 symtable_free(new_symtable);
             }
-            token_free(&identifier);
-            RETURN_CODE(ec, token);
+            return ec;
         }
     }
     else {
         // Unexpected token after identifier
-        token_free(&identifier);
         symtable_free(new_symtable);
-        RETURN_CODE(SYNTACTIC_ERROR, token);
+        return SYNTACTIC_ERROR;
     }
     
-    token_free(&identifier);
 
-    RETURN_CODE(OK, token);
+    return OK;
 }
 
 /// Checks Setter: static identifier = (val) { ... }
-ErrorCode checks_setter(Lexer *lexer, Symtable *globaltable, Symtable *localtable, Token identifier, AstStatement *statement) {
+ErrorCode checks_setter(Lexer *lexer, AstExprs *exprs, Symtable *globaltable, Symtable *localtable, Token identifier, AstBlock *block) {
     // Enters new scope for the setter
     enter_scope(localtable);
 
     // Add setter to symbol table with redefinition check
-    ErrorCode ec = add_setter_helper(globaltable, identifier.string_val->val);
+    ErrorCode ec = add_setter_helper(globaltable, identifier.ident_val);
     if (ec != OK) {
         return ec;
     }
@@ -511,7 +515,7 @@ ErrorCode checks_setter(Lexer *lexer, Symtable *globaltable, Symtable *localtabl
 
     CHECK_TOKEN(lexer, token);
     if (token.type != TOK_LEFT_PAR) {
-        RETURN_CODE(SYNTACTIC_ERROR, token);
+        return SYNTACTIC_ERROR;
     }
 
     Token param_name;
@@ -519,57 +523,57 @@ ErrorCode checks_setter(Lexer *lexer, Symtable *globaltable, Symtable *localtabl
 
     CHECK_TOKEN(lexer, param_name);
     if (param_name.type != TOK_IDENTIFIER) {
-        RETURN_CODE(SYNTACTIC_ERROR, param_name);
+        return SYNTACTIC_ERROR;
     }
 
     // Insert parameter into local symbol table
-    if (add_var_at_current_scope(localtable, param_name.string_val->val, DT_UNKNOWN) == NULL) {
-        RETURN_CODE(INTERNAL_ERROR, param_name);
+    if (add_var_at_current_scope(localtable, param_name.ident_val, DT_UNKNOWN) == NULL) {
+        return INTERNAL_ERROR;
     }
 
     CHECK_TOKEN(lexer, token);
     if (token.type != TOK_RIGHT_PAR) {
-        RETURN_CODE(SYNTACTIC_ERROR, token);
+        return SYNTACTIC_ERROR;
     }
 
     CHECK_TOKEN(lexer, token);
     if (token.type != TOK_LEFT_BRACE) {
-        RETURN_CODE(SYNTACTIC_ERROR, token);
+        return SYNTACTIC_ERROR;
     }
 
     // Add setter parameter to AST
-    if (ast_add_setter(statement, identifier.string_val->val, param_name.string_val->val, localtable) == false) {
-        RETURN_CODE(INTERNAL_ERROR, param_name);
+    AstStatement *statement = ast_add_setter(block, identifier.ident_val, param_name.ident_val, localtable);
+    if (statement == NULL) {
+        return INTERNAL_ERROR;
     }
 
-    token_free(&param_name);
 
-    ec = check_body(lexer, globaltable, localtable, true, statement->setter->body->statements);
+    ec = check_body(lexer, exprs, globaltable, localtable, true, statement->setter->body);
     if (ec != OK) {
-        RETURN_CODE(ec, token);
+        return ec;
     }
 
     CHECK_TOKEN_SKIP_NEWLINE(lexer, token);
     if (token.type != TOK_RIGHT_BRACE) {
-        RETURN_CODE(SYNTACTIC_ERROR, token);
+        return SYNTACTIC_ERROR;
     }
 
     CHECK_TOKEN(lexer, token);
     if (token.type != TOK_EOL) {
-        RETURN_CODE(SYNTACTIC_ERROR, token);
+        return SYNTACTIC_ERROR;
     }
 
     // We leave the last scope so we can find arguments
 
-    RETURN_CODE(OK, token);
+    return OK;
 }
 
 /// Checks Getter: static identifier { ... }
-ErrorCode check_getter(Lexer *lexer, Symtable *globaltable, Symtable *localtable, Token identifier, AstStatement *statement) {
+ErrorCode check_getter(Lexer *lexer, AstExprs *exprs, Symtable *globaltable, Symtable *localtable, Token identifier, AstBlock *block) {
     // Enters new scope for the getter
     enter_scope(localtable);
 
-    ErrorCode ec = add_getter_helper(globaltable, identifier.string_val->val);
+    ErrorCode ec = add_getter_helper(globaltable, identifier.ident_val);
     if (ec != OK) {
         return ec;
     }
@@ -578,33 +582,34 @@ ErrorCode check_getter(Lexer *lexer, Symtable *globaltable, Symtable *localtable
     INIT_TOKEN(token, TOK_LEFT_BRACE);
 
     // Add getter to AST
-    if (ast_add_getter(statement, identifier.string_val->val, localtable) == false) {
-        RETURN_CODE(INTERNAL_ERROR, identifier);
+    AstStatement *statement = ast_add_getter(block, identifier.ident_val, localtable);
+    if (statement == NULL) {
+        return INTERNAL_ERROR;
     }
 
     // Check getter body
-    ec = check_body(lexer, globaltable, localtable, true, statement->getter->body->statements);
+    ec = check_body(lexer, exprs, globaltable, localtable, true, statement->getter->body);
     if (ec != OK) {
-        RETURN_CODE(ec, token);
+        return ec;
     }
 
     CHECK_TOKEN_SKIP_NEWLINE(lexer, token);
     if (token.type != TOK_RIGHT_BRACE) {
-        RETURN_CODE(SYNTACTIC_ERROR, token);
+        return SYNTACTIC_ERROR;
     }
 
     CHECK_TOKEN(lexer, token);
     if (token.type != TOK_EOL) {
-        RETURN_CODE(SYNTACTIC_ERROR, token);
+        return SYNTACTIC_ERROR;
     }
 
     // We leave the last scope so we can find arguments
 
-    RETURN_CODE(OK, token);
+    return OK;
 }
 
 /// Checks Function: static identifier(...) { ... }
-ErrorCode check_function(Lexer *lexer, Symtable *globaltable, Symtable *localtable, Token identifier, AstStatement *statement) {
+ErrorCode check_function(Lexer *lexer, AstExprs *exprs, Symtable *globaltable, Symtable *localtable, Token identifier, AstBlock *block) {
     // Enters new scope for the function
     enter_scope(localtable);
 
@@ -614,7 +619,7 @@ ErrorCode check_function(Lexer *lexer, Symtable *globaltable, Symtable *localtab
     // Initialize parameter list
     ParamList *params = param_list_init();
     if (params == NULL) {
-        RETURN_CODE(INTERNAL_ERROR, token);
+        return INTERNAL_ERROR;
     }
 
     // Parse function parameters
@@ -622,7 +627,7 @@ ErrorCode check_function(Lexer *lexer, Symtable *globaltable, Symtable *localtab
         CHECK_TOKEN_SKIP_NEWLINE(lexer, token);
         if (token.type != TOK_IDENTIFIER && token.type != TOK_RIGHT_PAR) {
             param_list_free(params);
-            RETURN_CODE(SYNTACTIC_ERROR, token);
+            return SYNTACTIC_ERROR;
         }
 
         if (token.type == TOK_RIGHT_PAR) {
@@ -630,21 +635,21 @@ ErrorCode check_function(Lexer *lexer, Symtable *globaltable, Symtable *localtab
         }
 
         // Add parameter name to list
-        if (!param_list_add(params, token.string_val->val)) {
+        if (!param_list_add(params, token.ident_val)) {
             param_list_free(params);
-            RETURN_CODE(INTERNAL_ERROR, token);
+            return INTERNAL_ERROR;
         }
 
         // Check for parameter redefinition in local symbol table
-        if (contains_var_at_current_scope(localtable, token.string_val->val)) {
+        if (contains_var_at_current_scope(localtable, token.ident_val)) {
             param_list_free(params);
-            RETURN_CODE(SEM_REDEFINITION, token);
+            return SEM_REDEFINITION;
         }
 
         // Insert parameter into local symbol table
-        if (add_var_at_current_scope(localtable, token.string_val->val, DT_UNKNOWN) == NULL) {
+        if (add_var_at_current_scope(localtable, token.ident_val, DT_UNKNOWN) == NULL) {
             param_list_free(params);
-            RETURN_CODE(INTERNAL_ERROR, token);
+            return INTERNAL_ERROR;
         }
 
         CHECK_TOKEN(lexer, token);
@@ -654,208 +659,246 @@ ErrorCode check_function(Lexer *lexer, Symtable *globaltable, Symtable *localtab
 
         if (token.type != TOK_COMMA) {
             param_list_free(params);
-            RETURN_CODE(SYNTACTIC_ERROR, token);
+            return SYNTACTIC_ERROR;
         }
     }
 
     // Add function to global symbol table
-    ADD_FUNCTION(globaltable, identifier.string_val->val, params->count, token, params);
+    ADD_FUNCTION(globaltable, identifier.ident_val, params->count, token, params);
 
     CHECK_TOKEN(lexer, token);
     if (token.type != TOK_LEFT_BRACE) {
         param_list_free(params);
-        RETURN_CODE(SYNTACTIC_ERROR, token);
+        return SYNTACTIC_ERROR;
     }
 
     CHECK_TOKEN(lexer, token);
     if (token.type != TOK_EOL) {
         param_list_free(params);
-        RETURN_CODE(SYNTACTIC_ERROR, token);
+        return SYNTACTIC_ERROR;
     }
 
-    // Add function to AST (transfers ownership of param names to AST)
-    if (!ast_add_function(statement, identifier.string_val->val, params->count, localtable, params->names)) {
+    // Add function to AST, it copies the param names
+    AstStatement *statement = ast_add_function(block, identifier.ident_val, params->count, localtable, params->names);
+    if (statement == NULL) {
         param_list_free(params);
-        RETURN_CODE(INTERNAL_ERROR, token);
+        return INTERNAL_ERROR;
     }
-
-    // Free only the ParamList structure, not the names (AST owns them now)
-    free(params);
+    param_list_free(params);
 
     // Check function body
-    ErrorCode ec = check_body(lexer, globaltable, localtable, true, statement->function->body->statements);
+    ErrorCode ec = check_body(lexer, exprs, globaltable, localtable, true, statement->function->body);
     if (ec != OK) {
-        RETURN_CODE(ec, token);
+        return ec;
     }
 
     CHECK_TOKEN_SKIP_NEWLINE(lexer, token);
     if (token.type != TOK_RIGHT_BRACE) {
-        RETURN_CODE(SYNTACTIC_ERROR, token);
+        return SYNTACTIC_ERROR;
     }
 
     CHECK_TOKEN(lexer, token);
     if (token.type != TOK_EOL) {
-        RETURN_CODE(SYNTACTIC_ERROR, token);
+        return SYNTACTIC_ERROR;
     }
 
     // We leave the last scope so we can find arguments
 
-    RETURN_CODE(OK, token);
+    return OK;
 }
 
-/// Checks body
-ErrorCode check_body(Lexer *lexer, Symtable *globaltable, Symtable *localtable, bool known, AstStatement *statement) {
+/// Checks a statement of the body in the frame. A closing brace is returned back and reported in closed.
+/// If the statement opens a nested body, its frame is put into opened
+static ErrorCode check_statement(Lexer *lexer, AstExprs *exprs, Symtable *globaltable, Symtable *localtable, const BodyFrame *frame, BodyFrame *opened, bool *closed) {
     Token token;
     INIT_TOKEN(token, TOK_IDENTIFIER);
+    AstBlock *block = frame->block;
+    bool known = frame->known;
 
-    while (true) {
-        CHECK_TOKEN_SKIP_NEWLINE(lexer, token);
+    CHECK_TOKEN_SKIP_NEWLINE(lexer, token);
 
-        // If we encounter a right brace, end of function body
-        if (token.type == TOK_RIGHT_BRACE) {
-            // Return token back for parent function
-            if (!lexer_unget_token(lexer, &token)) {
-                return INTERNAL_ERROR;
-            }
-            return OK;
+    // If we encounter a right brace, end of the body
+    if (token.type == TOK_RIGHT_BRACE) {
+        // Return token back for the statement that opened the body
+        if (!lexer_unget_token(lexer, &token)) {
+            return INTERNAL_ERROR;
         }
+        *closed = true;
+        return OK;
+    }
 
-        ErrorCode ec;
-        // Analyze statement based on the first token
-        switch (token.type) {
-            case TOK_GLOBAL_VAR:
-                ec = check_global_var(lexer, globaltable, localtable, token.string_val, statement);
-                if (ec != OK) {
-                    token_free(&token);
-                    return ec;
-                }
-                token_free(&token);
-                statement = statement->next;
-                break;
+    ErrorCode ec;
+    // Analyze statement based on the first token
+    switch (token.type) {
+        case TOK_GLOBAL_VAR:
+            return check_global_var(lexer, exprs, globaltable, localtable, token.ident_val, block);
 
-            case TOK_KW_VAR:
-                ec = check_local_var(lexer, globaltable, localtable, known, statement);
-                if (ec != OK) {
-                    RETURN_CODE(ec, token);
-                }
-                statement = statement->next;
-                break;
+        case TOK_KW_VAR:
+            return check_local_var(lexer, exprs, globaltable, localtable, known, block);
 
-            case TOK_IDENTIFIER:
-                ec = check_assignment_or_function_call(lexer, globaltable, localtable, &token, known, statement);
-                if (ec != OK) {
-                    RETURN_CODE(ec, token);
-                }
-                statement = statement->next;
-                break;
+        case TOK_IDENTIFIER:
+            return check_assignment_or_function_call(lexer, exprs, globaltable, localtable, &token, known, block);
 
-            case TOK_KW_IF:
-                ec = check_if_statement(lexer, globaltable, localtable, statement);
-                if (ec != OK) {
-                    RETURN_CODE(ec, token);
-                }
-                statement = statement->next;
-                break;
+        case TOK_KW_IF:
+            ec = check_if_statement(lexer, exprs, globaltable, localtable, block, &opened->statement);
+            if (ec != OK) {
+                return ec;
+            }
+            *opened = (BodyFrame){ .block = opened->statement->if_st->true_branch, .statement = opened->statement, .known = false };
+            return OK;
 
-            case TOK_KW_WHILE:
-                ec = check_while_statement(lexer, globaltable, localtable, statement);
-                if (ec != OK) {
-                    RETURN_CODE(ec, token);
-                }
-                statement = statement->next;
-                break;
+        case TOK_KW_WHILE:
+            ec = check_while_statement(lexer, exprs, globaltable, localtable, block, &opened->statement);
+            if (ec != OK) {
+                return ec;
+            }
+            *opened = (BodyFrame){ .block = opened->statement->while_st->body, .statement = opened->statement, .known = false };
+            return OK;
 
-            case TOK_KW_RETURN:
-                ec = check_return_statement(lexer, globaltable, localtable, statement);
-                if (ec != OK) {
-                    RETURN_CODE(ec, token);
-                }
-                statement = statement->next;
-                break;
+        case TOK_KW_RETURN:
+            return check_return_statement(lexer, exprs, globaltable, localtable, block);
 
-            case TOK_LEFT_BRACE:
-                // New scope
-                enter_scope(localtable);
+        case TOK_LEFT_BRACE: {
+            // New scope
+            enter_scope(localtable);
 
-                // Add block to AST
-                if (ast_add_block(statement) == false) {
-                    RETURN_CODE(INTERNAL_ERROR, token);
-                }
+            // Add block to AST
+            AstStatement *inner = ast_add_block(block);
+            if (inner == NULL) {
+                return INTERNAL_ERROR;
+            }
+            *opened = (BodyFrame){ .block = inner->block, .statement = inner, .known = known };
+            return OK;
+        }
 
-                // Check block body
-                ec = check_body(lexer, globaltable, localtable, known, statement->block->statements);
-                if (ec != OK) {
-                    RETURN_CODE(ec, token);
-                }
+        default: {
+            // Unget token for expression parsing
+            if (!lexer_unget_token(lexer, &token)) {
+                return INTERNAL_ERROR;
+            }
 
-                CHECK_TOKEN_SKIP_NEWLINE(lexer, token);
-                if (token.type != TOK_RIGHT_BRACE) {
-                    RETURN_CODE(SYNTACTIC_ERROR, token);
-                }
+            ExprId expr;
+            ec = parse_expression(lexer, exprs, &expr);
+            if (ec != OK) {
+                return ec;
+            }
 
-                CHECK_TOKEN(lexer, token);
-                if (token.type != TOK_EOL) {
-                    RETURN_CODE(SYNTACTIC_ERROR, token);
-                }
+            // Analyze expression type compatibility
+            DataType expr_type;
+            ec = semantic_check_expression(exprs, expr, globaltable, localtable, &expr_type);
+            if (ec != OK) {
+                return ec;
+            }
 
-                // Exit scope
-                exit_scope(localtable);
+            // Add expression statement to AST
+            if (ast_add_inline_expression(block, expr) == NULL) {
+                return INTERNAL_ERROR;
+            }
 
-                statement = statement->next;
+            Token new_token;
+            INIT_TOKEN(new_token, TOK_IDENTIFIER);
+            CHECK_TOKEN(lexer, new_token);
 
-                break;
+            if (new_token.type != TOK_EOL) {
+                return SYNTACTIC_ERROR;
+            }
+            return OK;
+        }
+    }
+}
 
-            default: {
-                // Unget token for expression parsing
-                if (!lexer_unget_token(lexer, &token)) {
-                    return INTERNAL_ERROR;
-                }
+/// Checks the end of the nested body in the frame, which is at its closing brace. If the statement
+/// continues with another body, its frame is put into opened
+static ErrorCode close_body(Lexer *lexer, AstExprs *exprs, Symtable *globaltable, Symtable *localtable, const BodyFrame *frame, BodyFrame *opened) {
+    if (frame->statement->type == ST_IF) {
+        AstBlock *branch = NULL;
+        ErrorCode ec = check_if_branch_end(lexer, exprs, globaltable, localtable, frame->statement, &branch);
+        if (ec == OK && branch != NULL) {
+            *opened = (BodyFrame){ .block = branch, .statement = frame->statement, .known = false };
+        }
+        return ec;
+    }
 
-                AstExpression *expr;
-                ec = parse_expression(lexer, &expr);
-                if (ec != OK) {
-                    return ec;
-                }
+    // Exit scope of the block or the while body
+    exit_scope(localtable);
 
-                // Analyze expression type compatibility
-                DataType expr_type;
-                ec = semantic_check_expression(expr, globaltable, localtable, &expr_type);
-                if (ec != OK) {
-                    ast_expr_free(expr);
-                    return ec;
-                }
+    Token token;
+    INIT_TOKEN(token, TOK_RIGHT_BRACE);
+    CHECK_TOKEN_SKIP_NEWLINE(lexer, token);
+    if (token.type != TOK_RIGHT_BRACE) {
+        return SYNTACTIC_ERROR;
+    }
 
-                // Add expression statement to AST
-                if (ast_add_inline_expression(statement, expr) == false) {
-                    ast_expr_free(expr);
-                    return INTERNAL_ERROR;
-                }
+    CHECK_TOKEN(lexer, token);
+    if (token.type != TOK_EOL) {
+        return SYNTACTIC_ERROR;
+    }
+    return OK;
+}
 
-                Token new_token;
-                INIT_TOKEN(new_token, TOK_IDENTIFIER);
-                CHECK_TOKEN(lexer, new_token);
+// Pushes the frame to the stack, returns NULL if allocation failed
+static BodyFrame *body_push(BodyStack *stack, BodyFrame frame) {
+    if (stack->count == stack->capacity) {
+        size_t capacity = stack->capacity * 2;
+        BodyFrame *frames;
+        if (stack->frames == stack->inline_frames) {
+            frames = malloc(capacity * sizeof(BodyFrame));
+            if (frames != NULL) {
+                memcpy(frames, stack->frames, stack->count * sizeof(BodyFrame));
+            }
+        } else {
+            frames = realloc(stack->frames, capacity * sizeof(BodyFrame));
+        }
+        if (frames == NULL) {
+            return NULL;
+        }
+        stack->frames = frames;
+        stack->capacity = capacity;
+    }
 
-                if (new_token.type != TOK_EOL) {
-                    RETURN_CODE(SYNTACTIC_ERROR, new_token);
-                }
+    stack->frames[stack->count] = frame;
+    return &stack->frames[stack->count++];
+}
 
-                token_free(&new_token);
+/// Checks body
+ErrorCode check_body(Lexer *lexer, AstExprs *exprs, Symtable *globaltable, Symtable *localtable, bool known, AstBlock *block) {
+    BodyStack stack = { .frames = stack.inline_frames, .count = 0, .capacity = _BODY_INLINE_DEPTH };
+    body_push(&stack, (BodyFrame){ .block = block, .statement = NULL, .known = known });
+    ErrorCode ec = OK;
 
+    while (ec == OK) {
+        BodyFrame top = stack.frames[stack.count - 1];
+        BodyFrame opened = { .block = NULL };
+        bool closed = false;
 
-                statement = statement->next;
+        ec = check_statement(lexer, exprs, globaltable, localtable, &top, &opened, &closed);
+        if (ec == OK && closed) {
+            // The closing brace of the body itself is left for the caller
+            if (stack.count == 1) {
+                break;
             }
+            stack.count--;
+            ec = close_body(lexer, exprs, globaltable, localtable, &top, &opened);
         }
+        if (ec == OK && opened.block != NULL && body_push(&stack, opened) == NULL) {
+            ec = INTERNAL_ERROR;
+        }
+    }
+
+    if (stack.frames != stack.inline_frames) {
+        free(stack.frames);
     }
+    return ec;
 }
 
 /// Checks local variable declaration
-ErrorCode check_local_var(Lexer *lexer, Symtable *globaltable, Symtable *localtable, bool known, AstStatement *statement) {
+ErrorCode check_local_var(Lexer *lexer, AstExprs *exprs, Symtable *globaltable, Symtable *localtable, bool known, AstBlock *block) {
     Token identifier;
     INIT_TOKEN(identifier, TOK_IDENTIFIER);
 
     CHECK_TOKEN(lexer, identifier);
     if (identifier.type != TOK_IDENTIFIER) {
-        RETURN_CODE(SYNTACTIC_ERROR, identifier);
+        return SYNTACTIC_ERROR;
     }
 
     // Check if is assigned
@@ -865,62 +908,52 @@ ErrorCode check_local_var(Lexer *lexer, Symtable *globaltable, Symtable *localta
 
     CHECK_TOKEN(lexer, token);
     // Parse assignment expression
-    AstExpression *expr = NULL;
+    ExprId expr = EXPR_NONE;
 
     if (token.type == TOK_OP_ASSIGN) {
-        ErrorCode ec = parse_expression(lexer, &expr);
+        ErrorCode ec = parse_expression(lexer, exprs, &expr);
         if (ec != OK) {
-            token_free(&identifier);
-            RETURN_CODE(ec, token);
+            return ec;
         }
 
         // Check expression type compatibility
-        ec = semantic_check_expression(expr, globaltable, localtable, &expr_type);
+        ec = semantic_check_expression(exprs, expr, globaltable, localtable, &expr_type);
         if (ec != OK) {
-            ast_expr_free(expr);
-            token_free(&identifier);
-            RETURN_CODE(ec, token);
+            return ec;
         }
 
         CHECK_TOKEN(lexer, token);
     }
 
     if (token.type != TOK_EOL) {
-        if (expr) ast_expr_free(expr);
-        token_free(&identifier);
-        RETURN_CODE(SYNTACTIC_ERROR, token);
+        return SYNTACTIC_ERROR;
     }
 
     // Add variable to symbol table with redefinition check
     if (known) {
-        ADD_VARIABLE(localtable, identifier.string_val->val, identifier, expr_type);
+        ADD_VARIABLE(localtable, identifier.ident_val, identifier, expr_type);
     } else {
-        ADD_VARIABLE(localtable, identifier.string_val->val, identifier, DT_UNKNOWN);
+        ADD_VARIABLE(localtable, identifier.ident_val, identifier, DT_UNKNOWN);
     }
 
-    // Finds the variable to get its key to put into the AST
+    // Finds the variable to get its slot to put into the AST
     SymtableItem *it;
-    if (find_local_var(localtable, identifier.string_val->val, &it) == false) {
-        if (expr) ast_expr_free(expr);
-        token_free(&identifier);
-        RETURN_CODE(INTERNAL_ERROR, token);
+    if (find_local_var(localtable, identifier.ident_val, &it) == false || it == NULL) {
+        return INTERNAL_ERROR;
     }
 
     // Add local variable to AST
-    if (ast_add_local_var(statement, it->key, expr) == false) {
-        if (expr) ast_expr_free(expr);
-        token_free(&identifier);
-        RETURN_CODE(INTERNAL_ERROR, token);
+    if (ast_add_local_var(block, identifier.ident_val, it->slot, expr) == NULL) {
+        return INTERNAL_ERROR;
     }
 
     // Clean up identifier token
-    token_free(&identifier);
 
-    RETURN_CODE(OK, token);
+    return OK;
 }
 
 /// Checks assignment or function call
-ErrorCode check_assignment_or_function_call(Lexer *lexer, Symtable *globaltable, Symtable *localtable, Token *identifier, bool known, AstStatement *statement) {
+ErrorCode check_assignment_or_function_call(Lexer *lexer, AstExprs *exprs, Symtable *globaltable, Symtable *localtable, Token *identifier, bool known, AstBlock *block) {
     Token token;
     INIT_TOKEN(token, TOK_OP_ASSIGN);
 
@@ -928,51 +961,41 @@ ErrorCode check_assignment_or_function_call(Lexer *lexer, Symtable *globaltable,
     if (token.type == TOK_OP_ASSIGN) {
         // Find variable in symbol tables
         // Parse assignment expression
-        AstExpression *expr;
-        ErrorCode ec = parse_expression(lexer, &expr);
+        ExprId expr;
+        ErrorCode ec = parse_expression(lexer, exprs, &expr);
         if (ec != OK) {
-            RETURN_CODE(ec, token);
+            return ec;
         }
 
         // Check expression type compatibility
         DataType expr_type;
-        ec = semantic_check_expression(expr, globaltable, localtable, &expr_type);
+        ec = semantic_check_expression(exprs, expr, globaltable, localtable, &expr_type);
         if (ec != OK) {
-            ast_expr_free(expr);
-            RETURN_CODE(ec, token);
+            return ec;
         }
 
         // Check variable existence and update its type if necessary
         ErrorCode evc;
         AstStatementType stmt_type;
+        int slot;
         if (known) {
-            evc = check_variable_expression(localtable, globaltable, identifier->string_val->val, expr_type, &stmt_type);
+            evc = check_variable_expression(localtable, globaltable, identifier->ident_val, expr_type, &stmt_type, &slot);
         } else {
-            evc = check_variable_expression(localtable, globaltable, identifier->string_val->val, DT_UNKNOWN, &stmt_type);
+            evc = check_variable_expression(localtable, globaltable, identifier->ident_val, DT_UNKNOWN, &stmt_type, &slot);
         }
         if (evc != OK) {
-            ast_expr_free(expr);
-            RETURN_CODE(evc, *identifier);
+            return evc;
         }
 
         if (stmt_type == ST_SETTER) {
             // Add setter call to AST
-            if (ast_add_setter_call(statement, identifier->string_val->val, expr) == false) {
-                ast_expr_free(expr);
-                RETURN_CODE(INTERNAL_ERROR, token);
+            if (ast_add_setter_call(block, identifier->ident_val, expr) == NULL) {
+                return INTERNAL_ERROR;
             }
         } else {
-            // Add assignment to AST
-            // We get the name from symtable to include the scope
-            SymtableItem *si;
-            bool r = find_local_var(localtable, identifier->string_val->val, &si);
-            if (r == false || si == NULL) {
-                ast_expr_free(expr);
-                RETURN_CODE(INTERNAL_ERROR, token);
-            }
-            if (ast_add_local_var(statement, si->key, expr) == false) {
-                ast_expr_free(expr);
-                RETURN_CODE(INTERNAL_ERROR, token);
+            // Add assignment to AST, bound to the slot of the variable
+            if (ast_add_local_var(block, identifier->ident_val, slot, expr) == NULL) {
+                return INTERNAL_ERROR;
             }
         }
 
@@ -988,23 +1011,21 @@ ErrorCode check_assignment_or_function_call(Lexer *lexer, Symtable *globaltable,
         }
         
         // Parse function call expression
-        AstExpression *expr;
-        ErrorCode ec = parse_expression(lexer, &expr);
+        ExprId expr;
+        ErrorCode ec = parse_expression(lexer, exprs, &expr);
         if (ec != OK) {
             return ec;
         }
 
         // Check expression type compatibility
         DataType expr_type;
-        ec = semantic_check_expression(expr, globaltable, localtable, &expr_type);
+        ec = semantic_check_expression(exprs, expr, globaltable, localtable, &expr_type);
         if (ec != OK) {
-            ast_expr_free(expr);
             return ec;
         }
 
         // Add expression statement to AST
-        if (ast_add_inline_expression(statement, expr) == false) {
-            ast_expr_free(expr);
+        if (ast_add_inline_expression(block, expr) == NULL) {
             return INTERNAL_ERROR;
         }
 
@@ -1015,171 +1036,128 @@ ErrorCode check_assignment_or_function_call(Lexer *lexer, Symtable *globaltable,
     }
 
     if (token.type != TOK_EOL) {
-        RETURN_CODE(SYNTACTIC_ERROR, token);
+        return SYNTACTIC_ERROR;
     }
 
-    RETURN_CODE(OK, token);
+    return OK;
 }
 
-/// Checks if statement
-ErrorCode check_if_statement(Lexer *lexer, Symtable *globaltable, Symtable *localtable, AstStatement *statement) {
+/// Checks ( condition ) { EOL that opens the body of if, else-if and while statements
+static ErrorCode check_condition_head(Lexer *lexer, AstExprs *exprs, Symtable *globaltable, Symtable *localtable, ExprId *out_expr) {
     Token token;
-    INIT_TOKEN(token, TOK_KW_IF);
+    INIT_TOKEN(token, TOK_LEFT_PAR);
 
     CHECK_TOKEN(lexer, token);
     if (token.type != TOK_LEFT_PAR) {
-        RETURN_CODE(SYNTACTIC_ERROR, token);
+        return SYNTACTIC_ERROR;
     }
 
     // Parse condition expression
-    AstExpression *expr;
-    ErrorCode ec = parse_expression(lexer, &expr);
+    ErrorCode ec = parse_expression(lexer, exprs, out_expr);
     if (ec != OK) {
-        RETURN_CODE(ec, token);
+        return ec;
     }
 
     // Check expression type compatibility
     DataType expr_type;
-    ec = semantic_check_expression(expr, globaltable, localtable, &expr_type);
+    ec = semantic_check_expression(exprs, *out_expr, globaltable, localtable, &expr_type);
     if (ec != OK) {
-        ast_expr_free(expr);
-        RETURN_CODE(ec, token);
+        return ec;
     }
 
     CHECK_TOKEN(lexer, token);
     if (token.type != TOK_RIGHT_PAR) {
-        ast_expr_free(expr);
-        RETURN_CODE(SYNTACTIC_ERROR, token);
+        return SYNTACTIC_ERROR;
     }
 
     CHECK_TOKEN(lexer, token);
     if (token.type != TOK_LEFT_BRACE) {
-        ast_expr_free(expr);
-        RETURN_CODE(SYNTACTIC_ERROR, token);
+        return SYNTACTIC_ERROR;
     }
 
     CHECK_TOKEN(lexer, token);
     if (token.type != TOK_EOL) {
-        ast_expr_free(expr);
-        RETURN_CODE(SYNTACTIC_ERROR, token);
+        return SYNTACTIC_ERROR;
+    }
+    return OK;
+}
+
+/// Checks if statement up to its true branch
+ErrorCode check_if_statement(Lexer *lexer, AstExprs *exprs, Symtable *globaltable, Symtable *localtable, AstBlock *block, AstStatement **out_statement) {
+    ExprId expr;
+    ErrorCode ec = check_condition_head(lexer, exprs, globaltable, localtable, &expr);
+    if (ec != OK) {
+        return ec;
     }
 
     // Enter new scope for if body
     enter_scope(localtable);
 
     // Add if statement to AST
-    if (ast_add_if_statement(statement, expr) == false) {
-        ast_expr_free(expr);
-        RETURN_CODE(INTERNAL_ERROR, token);
+    *out_statement = ast_add_if_statement(block, expr);
+    if (*out_statement == NULL) {
+        return INTERNAL_ERROR;
     }
+    return OK;
+}
 
-    ec = check_body(lexer, globaltable, localtable, false, statement->if_st->true_branch->statements);
-    if (ec != OK) {
-        RETURN_CODE(ec, token);
-    }
+/// Checks the end of a branch of the if statement and the head of the next one
+ErrorCode check_if_branch_end(Lexer *lexer, AstExprs *exprs, Symtable *globaltable, Symtable *localtable, AstStatement *statement, AstBlock **out_branch) {
+    Token token;
+    INIT_TOKEN(token, TOK_RIGHT_BRACE);
 
-    // Exit scope for if body
+    // Exit scope for the branch body
     exit_scope(localtable);
 
     CHECK_TOKEN_SKIP_NEWLINE(lexer, token);
     if (token.type != TOK_RIGHT_BRACE) {
-        RETURN_CODE(SYNTACTIC_ERROR, token);
+        return SYNTACTIC_ERROR;
     }
 
-    Token else_if_token1;
-    INIT_TOKEN(else_if_token1, TOK_KW_ELSE);
-
-    Token else_if_token2;
-    INIT_TOKEN(else_if_token2, TOK_KW_IF);
-
-    CHECK_TOKEN(lexer, else_if_token1);
-    CHECK_TOKEN(lexer, else_if_token2);
-
-    while (else_if_token1.type == TOK_KW_ELSE && else_if_token2.type == TOK_KW_IF) {
-        CHECK_TOKEN(lexer, token);
-        if (token.type != TOK_LEFT_PAR) {
-            RETURN_CODE(SYNTACTIC_ERROR, token);
+    // The else branch is the last one
+    bool was_else = statement->if_st->false_branch != NULL;
+    if (!was_else) {
+        // Else-if branches are recognized by looking two tokens ahead
+        const Token *else_if_token1 = lexer_peek_token(lexer, 0);
+        const Token *else_if_token2 = lexer_peek_token(lexer, 1);
+        if (else_if_token1 == NULL || else_if_token2 == NULL) {
+            return LEXICAL_ERROR;
         }
 
-        // Parse condition expression
-        AstExpression *expr;
-        ErrorCode ec = parse_expression(lexer, &expr);
-        if (ec != OK) {
-            RETURN_CODE(ec, token);
-        }
+        if (else_if_token1->type == TOK_KW_ELSE && else_if_token2->type == TOK_KW_IF) {
+            // Skips the else and if
+            CHECK_TOKEN(lexer, token);
+            CHECK_TOKEN(lexer, token);
 
-        // Check expression type compatibility
-        DataType expr_type;
-        ec = semantic_check_expression(expr, globaltable, localtable, &expr_type);
-        if (ec != OK) {
-            ast_expr_free(expr);
-            RETURN_CODE(ec, token);
-        }
-
-        CHECK_TOKEN(lexer, token);
-        if (token.type != TOK_RIGHT_PAR) {
-            ast_expr_free(expr);
-            RETURN_CODE(SYNTACTIC_ERROR, token);
-        }
-
-        CHECK_TOKEN(lexer, token);
-        if (token.type != TOK_LEFT_BRACE) {
-            ast_expr_free(expr);
-            RETURN_CODE(SYNTACTIC_ERROR, token);
-        }
-
-        CHECK_TOKEN(lexer, token);
-        if (token.type != TOK_EOL) {
-            ast_expr_free(expr);
-            RETURN_CODE(SYNTACTIC_ERROR, token);
-        }
-
-        // Enter new scope for else-if body
-        enter_scope(localtable);
-
-        // Create else-if branch in AST
-        if (ast_add_else_if_branch(statement, expr) == false) {
-            RETURN_CODE(INTERNAL_ERROR, token);
-        }
-
-        // Check else-if body
-        size_t branch_index = statement->if_st->else_if_count - 1;
-        ec = check_body(lexer, globaltable, localtable, false, statement->if_st->else_if_branches[branch_index]->body->statements);
-        if (ec != OK) {
-            RETURN_CODE(ec, token);
-        }
+            ExprId expr;
+            ErrorCode ec = check_condition_head(lexer, exprs, globaltable, localtable, &expr);
+            if (ec != OK) {
+                return ec;
+            }
 
-        // Exit scope for else-if body
-        exit_scope(localtable);
+            // Enter new scope for else-if body
+            enter_scope(localtable);
 
-        CHECK_TOKEN_SKIP_NEWLINE(lexer, token);
-        if (token.type != TOK_RIGHT_BRACE) {
-            RETURN_CODE(SYNTACTIC_ERROR, token);
+            // Create else-if branch in AST
+            if (ast_add_else_if_branch(statement, expr) == false) {
+                return INTERNAL_ERROR;
+            }
+            *out_branch = statement->if_st->else_if_branches[statement->if_st->else_if_count - 1]->body;
+            return OK;
         }
-
-        CHECK_TOKEN(lexer, else_if_token1);
-        CHECK_TOKEN(lexer, else_if_token2);
-    }
-
-    // Unget last read tokens which are not else-if
-    if (!lexer_unget_token(lexer, &else_if_token2)) {
-        return INTERNAL_ERROR;
-    }
-    if (!lexer_unget_token(lexer, &else_if_token1)) {
-        return INTERNAL_ERROR;
     }
 
-    // Optional else part
     CHECK_TOKEN(lexer, token);
-    if (token.type == TOK_KW_ELSE) {
+    if (!was_else && token.type == TOK_KW_ELSE) {
+        // Optional else part
         CHECK_TOKEN(lexer, token);
         if (token.type != TOK_LEFT_BRACE) {
-            RETURN_CODE(SYNTACTIC_ERROR, token);
+            return SYNTACTIC_ERROR;
         }
 
         CHECK_TOKEN(lexer, token);
         if (token.type != TOK_EOL) {
-            RETURN_CODE(SYNTACTIC_ERROR, token);
+            return SYNTACTIC_ERROR;
         }
 
         // Enter new scope for else body
@@ -1187,145 +1165,73 @@ ErrorCode check_if_statement(Lexer *lexer, Symtable *globaltable, Symtable *loca
 
         // Create else body in AST
         if (ast_add_else_branch(statement) == false) {
-            RETURN_CODE(INTERNAL_ERROR, token);
-        }
-
-        // Check else body
-        ec = check_body(lexer, globaltable, localtable, false, statement->if_st->false_branch->statements);
-        if (ec != OK) {
-            RETURN_CODE(ec, token);
-        }
-
-        // Exit scope for else body
-        exit_scope(localtable);
-
-        CHECK_TOKEN_SKIP_NEWLINE(lexer, token);
-        if (token.type != TOK_RIGHT_BRACE) {
-            RETURN_CODE(SYNTACTIC_ERROR, token);
+            return INTERNAL_ERROR;
         }
-
-        CHECK_TOKEN(lexer, token);
+        *out_branch = statement->if_st->false_branch;
+        return OK;
     }
 
     if (token.type != TOK_EOL) {
-        RETURN_CODE(SYNTACTIC_ERROR, token);
+        return SYNTACTIC_ERROR;
     }
 
-    RETURN_CODE(OK, token);
+    return OK;
 }
 
-/// Checks while statement
-ErrorCode check_while_statement(Lexer *lexer, Symtable *globaltable, Symtable *localtable, AstStatement *statement) {
-    Token token;
-    INIT_TOKEN(token, TOK_KW_WHILE);
-
-    CHECK_TOKEN(lexer, token);
-    if (token.type != TOK_LEFT_PAR) {
-        RETURN_CODE(SYNTACTIC_ERROR, token);
-    }
-
-    // Parse condition expression
-    AstExpression *expr;
-    ErrorCode ec = parse_expression(lexer, &expr);
-    if (ec != OK) {
-        RETURN_CODE(ec, token);
-    }
-
-    // Check expression type compatibility
-    DataType expr_type;
-    ec = semantic_check_expression(expr, globaltable, localtable, &expr_type);
+/// Checks while statement up to its body
+ErrorCode check_while_statement(Lexer *lexer, AstExprs *exprs, Symtable *globaltable, Symtable *localtable, AstBlock *block, AstStatement **out_statement) {
+    ExprId expr;
+    ErrorCode ec = check_condition_head(lexer, exprs, globaltable, localtable, &expr);
     if (ec != OK) {
-        ast_expr_free(expr);
-        RETURN_CODE(ec, token);
-    }
-
-    CHECK_TOKEN(lexer, token);
-    if (token.type != TOK_RIGHT_PAR) {
-        ast_expr_free(expr);
-        RETURN_CODE(SYNTACTIC_ERROR, token);
-    }
-
-    CHECK_TOKEN(lexer, token);
-    if (token.type != TOK_LEFT_BRACE) {
-        ast_expr_free(expr);
-        RETURN_CODE(SYNTACTIC_ERROR, token);
-    }
-
-    CHECK_TOKEN(lexer, token);
-    if (token.type != TOK_EOL) {
-        ast_expr_free(expr);
-        RETURN_CODE(SYNTACTIC_ERROR, token);
+        return ec;
     }
 
     // Enter new scope for while body
     enter_scope(localtable);
 
     // Add while statement to AST
-    if (ast_add_while_statement(statement, expr) == false) {
-        ast_expr_free(expr);
-        RETURN_CODE(INTERNAL_ERROR, token);
-    }
-
-    // Check while body
-    ec = check_body(lexer, globaltable, localtable, false, statement->while_st->body->statements);
-    if (ec != OK) {
-        RETURN_CODE(ec, token);
-    }
-
-    // Exit scope for while body
-    exit_scope(localtable);
-
-    CHECK_TOKEN_SKIP_NEWLINE(lexer, token);
-    if (token.type != TOK_RIGHT_BRACE) {
-        RETURN_CODE(SYNTACTIC_ERROR, token);
-    }
-
-    CHECK_TOKEN(lexer, token);
-    
-    if (token.type != TOK_EOL) {
-        RETURN_CODE(SYNTACTIC_ERROR, token);
+    *out_statement = ast_add_while_statement(block, expr);
+    if (*out_statement == NULL) {
+        return INTERNAL_ERROR;
     }
-
-    RETURN_CODE(OK, token);
+    return OK;
 }
 
 /// Checks return statement
-ErrorCode check_return_statement(Lexer *lexer, Symtable *globaltable, Symtable *localtable, AstStatement *statement) {
+ErrorCode check_return_statement(Lexer *lexer, AstExprs *exprs, Symtable *globaltable, Symtable *localtable, AstBlock *block) {
     Token token;
     INIT_TOKEN(token, TOK_KW_RETURN);
 
     CHECK_TOKEN(lexer, token);
     if (token.type == TOK_EOL) {
         // Add return statement to AST
-        if (ast_add_return_statement(statement, NULL) == false) {
-            RETURN_CODE(INTERNAL_ERROR, token);
+        if (ast_add_return_statement(block, EXPR_NONE) == NULL) {
+            return INTERNAL_ERROR;
         }
 
-        RETURN_CODE(OK, token);
+        return OK;
     }
 
     if (!lexer_unget_token(lexer, &token)) {
-        RETURN_CODE(INTERNAL_ERROR, token);
+        return INTERNAL_ERROR;
     }
 
     // Parse return expression
-    AstExpression *expr;
-    ErrorCode ec = parse_expression(lexer, &expr);
+    ExprId expr;
+    ErrorCode ec = parse_expression(lexer, exprs, &expr);
     if (ec != OK) {
         return ec;
     }
 
     // Check expression type compatibility
     DataType expr_type;
-    ec = semantic_check_expression(expr, globaltable, localtable, &expr_type);
+    ec = semantic_check_expression(exprs, expr, globaltable, localtable, &expr_type);
     if (ec != OK) {
-        ast_expr_free(expr);
         return ec;
     }
 
     // Add return statement to AST
-    if (ast_add_return_statement(statement, expr) == false) {
-        ast_expr_free(expr);
+    if (ast_add_return_statement(block, expr) == NULL) {
         return INTERNAL_ERROR;
     }
 
@@ -1334,57 +1240,87 @@ ErrorCode check_return_statement(Lexer *lexer, Symtable *globaltable, Symtable *
 
     CHECK_TOKEN(lexer, new_token);
     if (new_token.type != TOK_EOL) {
-        RETURN_CODE(SYNTACTIC_ERROR, new_token);
+        return SYNTACTIC_ERROR;
     }
 
-    RETURN_CODE(OK, new_token);
+    return OK;
 }
 
-/// Semantic analysis of expression - checks definitions and type compatibility
-/// Returns error code and inferred type through out_type parameter
-ErrorCode semantic_check_expression(AstExpression *expr, Symtable *globaltable, Symtable *localtable, DataType *out_type) {
-    if (expr == NULL) {
-        if (out_type != NULL) {
-            *out_type = DT_UNKNOWN;
+/// Checks done when a call is reached, before its arguments are checked
+static ErrorCode semantic_check_call(AstExprs *exprs, ExprId expr, Symtable *globaltable) {
+    if (EXPR_TYPE(exprs, expr) == EX_FUN) {
+        // Check function existence
+        SymtableItem *function_item = NULL;
+        if (!symtable_contains_function(globaltable, EXPR_IDENT(exprs, expr), EXPR_CHILD_COUNT(exprs, expr), &function_item)) {
+            // Create new function entry
+            SymtableItem *new_function = symtable_add_function(globaltable, EXPR_IDENT(exprs, expr), EXPR_CHILD_COUNT(exprs, expr), 0);
+            if (new_function == NULL) {
+                return INTERNAL_ERROR;
+            }
+            symtable_increment_undefined_items_counter(globaltable);
         }
-        return OK;
+    } else if (EXPR_TYPE(exprs, expr) == EX_BUILTIN_FUN) {
+        SymtableItem *builtin_item = NULL;
+        if (!symtable_contains_builtin_function(globaltable, EXPR_IDENT(exprs, expr), &builtin_item)) {
+            return SEM_UNDEFINED;
+        }
+
+        // Check if child count matches builtin definition
+        if (builtin_item->param_count != EXPR_CHILD_COUNT(exprs, expr)) {
+            return SEM_BAD_PARAMS;
+        }
+    }
+    return OK;
+}
+
+/// Checks the type of a builtin function argument right after the argument itself was checked
+static ErrorCode semantic_check_builtin_argument(AstExprs *exprs, ExprId expr, size_t i, Symtable *globaltable) {
+    SymtableItem *builtin_item = NULL;
+    if (!symtable_contains_builtin_function(globaltable, EXPR_IDENT(exprs, expr), &builtin_item)) {
+        return SEM_UNDEFINED;
     }
 
+    // Check parameter type compatibility
+    DataType arg_type = EXPR_ASSUMED_TYPE(exprs, EXPR_CHILD(exprs, expr, i));
+    DataType expected_type = builtin_item->param_types[i];
+    if (expected_type != DT_UNKNOWN && arg_type != DT_UNKNOWN && expected_type != arg_type && !(expected_type == DT_NUM && arg_type == DT_NUM)) {
+        return SEM_BAD_PARAMS;
+    }
+    return OK;
+}
+
+/// Semantic analysis of a single expression node whose children were already checked,
+/// their types are taken from their assumed types
+static ErrorCode semantic_check_node(AstExprs *exprs, ExprId expr, Symtable *globaltable, Symtable *localtable) {
     // Result type
     DataType result_type = DT_UNKNOWN;
-    ErrorCode ec = OK;
 
-    switch (expr->type) {
+    switch (EXPR_TYPE(exprs, expr)) {
         case EX_ID: {
             SymtableItem *local_var = NULL;
-            if (!find_local_var(localtable, expr->string_val->val, &local_var)) {
+            if (!find_local_var(localtable, EXPR_IDENT(exprs, expr), &local_var)) {
                 return INTERNAL_ERROR;
             }
 
             if (local_var != NULL) {
                 result_type = local_var->data_type;
-                // Replace name in expression to match the name in symtable
-                str_clear(expr->string_val);
-                str_append_string(expr->string_val, local_var->key);
+                // Bind the identifier to the slot of the variable
+                EXPR_SLOT(exprs, expr) = local_var->slot;
 
                 break;
             } 
 
             // Change expression type to a getter
-            expr->type = EX_GETTER;
+            EXPR_TYPE(exprs, expr) = EX_GETTER;
 
             SymtableItem *getter_item = NULL;
-            if (symtable_contains_getter(globaltable, expr->string_val->val, &getter_item)) {
-                // Change to getter name
-                str_clear(expr->string_val);
-                str_append_string(expr->string_val, getter_item->key);
-
+            if (symtable_contains_getter(globaltable, EXPR_IDENT(exprs, expr), &getter_item)) {
                 result_type = DT_UNKNOWN; // Getter return type is unknown
                 break;
             }
 
             // Create new getter entry
-            SymtableItem *new_getter = symtable_add_getter(globaltable, expr->string_val->val, 0);
+            SymtableItem *new_getter = symtable_add_getter(globaltable, EXPR_IDENT(exprs, expr), 0);
             if (new_getter == NULL) {
                 return INTERNAL_ERROR;
             }
@@ -1392,82 +1328,43 @@ ErrorCode semantic_check_expression(AstExpression *expr, Symtable *globaltable,
             symtable_increment_undefined_items_counter(globaltable);
             result_type = DT_UNKNOWN;
 
-            // Change to getter name
-            str_clear(expr->string_val);
-            str_append_string(expr->string_val, new_getter->key);
-
             break;
         }
 
         case EX_GLOBAL_ID: {
             SymtableItem *global_var = NULL;
-            if (!symtable_contains_global_var(globaltable, expr->string_val->val, &global_var)) {
+            if (!symtable_contains_global_var(globaltable, EXPR_IDENT(exprs, expr), &global_var)) {
                 // Create new global variable entry
-                SymtableItem *new_global_var = symtable_add_global_var(globaltable, expr->string_val->val, DT_UNKNOWN, 1);
-                if (new_global_var == NULL) {
+                global_var = symtable_add_global_var(globaltable, EXPR_IDENT(exprs, expr), DT_UNKNOWN, 1);
+                if (global_var == NULL) {
                     return INTERNAL_ERROR;
                 }
-
-                result_type = DT_UNKNOWN;
-
-                break;
-            }
-
-            if (global_var != NULL) {
-                result_type = global_var->data_type;
-                break;
             }
 
+            result_type = global_var->data_type;
+            // Bind the identifier to the slot of the variable
+            EXPR_SLOT(exprs, expr) = global_var->slot;
             break;
         }
 
-        case EX_FUN: {
-            // Check function existence
-            SymtableItem *function_item = NULL;
-            if (!symtable_contains_function(globaltable, expr->string_val->val, expr->child_count, &function_item)) {
-                // Create new function entry
-                SymtableItem *new_function = symtable_add_function(globaltable, expr->string_val->val, expr->child_count, 0);
-                if (new_function == NULL) {
-                    return INTERNAL_ERROR;
-                }
-                symtable_increment_undefined_items_counter(globaltable);
-            }
-
-            // Check argument expressions
-            for (size_t i = 0; i < expr->child_count; i++) {
-                DataType arg_type;
-                ec = semantic_check_expression(expr->params[i], globaltable, localtable, &arg_type);
-                if (ec != OK) {
-                    return ec;
-                }
-            }
-
+        case EX_FUN:
+            // The function was registered when the call was reached
             result_type = DT_UNKNOWN; // Function return type is unknown
             break;
-        }
 
         case EX_ADD:
         case EX_SUB:
         case EX_MUL:
         case EX_DIV:
-            if (expr->child_count != 2) {
+            if (EXPR_CHILD_COUNT(exprs, expr) != 2) {
                 return INTERNAL_ERROR;
             }
 
-            DataType left_type;
-            ec = semantic_check_expression(expr->params[0], globaltable, localtable, &left_type);
-            if (ec != OK) {
-                return ec;
-            }
-
-            DataType right_type;
-            ec = semantic_check_expression(expr->params[1], globaltable, localtable, &right_type);
-            if (ec != OK) {
-                return ec;
-            }
+            DataType left_type = EXPR_ASSUMED_TYPE(exprs, EXPR_CHILD(exprs, expr, 0));
+            DataType right_type = EXPR_ASSUMED_TYPE(exprs, EXPR_CHILD(exprs, expr, 1));
 
             // We first cover / and -
-            if (expr->type == EX_SUB || expr->type == EX_DIV) {
+            if (EXPR_TYPE(exprs, expr) == EX_SUB || EXPR_TYPE(exprs, expr) == EX_DIV) {
                 result_type = DT_NUM;
                 // Both sides can only be unknown or num
                 if ((left_type != DT_UNKNOWN && left_type != DT_NUM) ||
@@ -1484,7 +1381,7 @@ ErrorCode semantic_check_expression(AstExpression *expr, Symtable *globaltable,
                 break;
             }
 
-            if (expr->type == EX_ADD) {
+            if (EXPR_TYPE(exprs, expr) == EX_ADD) {
                 // One known
                 if (left_type == DT_UNKNOWN || right_type == DT_UNKNOWN) {
                     if (left_type == DT_STRING || right_type == DT_STRING) {
@@ -1507,14 +1404,14 @@ ErrorCode semantic_check_expression(AstExpression *expr, Symtable *globaltable,
                 break;
             }
 
-            if (expr->type == EX_MUL) {
+            if (EXPR_TYPE(exprs, expr) == EX_MUL) {
                 // Left can only be string/num/unknown and right can only be num/unknown
                 if ((left_type != DT_STRING && left_type != DT_NUM && left_type != DT_UNKNOWN) ||
                     (right_type != DT_NUM && right_type != DT_UNKNOWN)) {
                     return SEM_TYPE_COMPAT;
                 }
-                if (left_type == DT_STRING && right_type == DT_NUM && expr->params[1]->val_known) {
-                    double val = expr->params[1]->double_val;
+                if (left_type == DT_STRING && right_type == DT_NUM && EXPR_VAL_KNOWN(exprs, EXPR_CHILD(exprs, expr, 1))) {
+                    double val = EXPR_DOUBLE(exprs, EXPR_CHILD(exprs, expr, 1));
                     // If we are doing string iteration and the right side isn't an integer, we can thrown an error
                     if (floor(val) != val) {
                         return SEM_TYPE_COMPAT;
@@ -1540,23 +1437,12 @@ ErrorCode semantic_check_expression(AstExpression *expr, Symtable *globaltable,
     case EX_GREATER:
     case EX_LESS_EQ:
     case EX_GREATER_EQ: {
-        if (expr->child_count != 2) {
+        if (EXPR_CHILD_COUNT(exprs, expr) != 2) {
             return INTERNAL_ERROR;
         }
 
-        DataType left_type;
-        // Check left expression
-        ec = semantic_check_expression(expr->params[0], globaltable, localtable, &left_type);
-        if (ec != OK) {
-            return ec;
-        }
-
-        DataType right_type;
-        // Check right expression
-        ec = semantic_check_expression(expr->params[1], globaltable, localtable, &right_type);
-        if (ec != OK) {
-            return ec;
-        }
+        DataType left_type = EXPR_ASSUMED_TYPE(exprs, EXPR_CHILD(exprs, expr, 0));
+        DataType right_type = EXPR_ASSUMED_TYPE(exprs, EXPR_CHILD(exprs, expr, 1));
 
         if (left_type == DT_STRING || right_type == DT_STRING) {
             return SEM_TYPE_COMPAT;
@@ -1589,71 +1475,31 @@ ErrorCode semantic_check_expression(AstExpression *expr, Symtable *globaltable,
 
     case EX_EQ:
     case EX_NOT_EQ: {
-        if (expr->child_count != 2) {
+        if (EXPR_CHILD_COUNT(exprs, expr) != 2) {
             return INTERNAL_ERROR;
         }
 
-        DataType left_type;
-        // Check left expression
-        ec = semantic_check_expression(expr->params[0], globaltable, localtable, &left_type);
-        if (ec != OK) {
-            return ec;
-        }
-
-        DataType right_type;
-        // Check right expression
-        ec = semantic_check_expression(expr->params[1], globaltable, localtable, &right_type);
-        if (ec != OK) {
-            return ec;
-        }
-
+        // Values of any types can be compared
         result_type = DT_BOOL;
         break;
     }
 
     case EX_AND:
     case EX_OR: {
-        if (expr->child_count != 2) {
+        if (EXPR_CHILD_COUNT(exprs, expr) != 2) {
             return INTERNAL_ERROR;
         }
 
-        DataType left_type;
-        // Check left expression
-        ec = semantic_check_expression(expr->params[0], globaltable, localtable, &left_type);
-        if (ec != OK) {
-            return ec;
-        } 
-        DataType right_type;
-        // Check right expression
-        ec = semantic_check_expression(expr->params[1], globaltable, localtable, &right_type);
-        if (ec != OK) {
-            return ec;
-        }
-
         result_type = DT_BOOL;
         break;
-
-        return SEM_TYPE_COMPAT;
     }
 
     case EX_IS: {
-        if (expr->child_count != 2) {
+        if (EXPR_CHILD_COUNT(exprs, expr) != 2) {
             return INTERNAL_ERROR;
         }
 
-        DataType left_type;
-        // Check left expression
-        ec = semantic_check_expression(expr->params[0], globaltable, localtable, &left_type);
-        if (ec != OK) {
-            return ec;
-        } 
-
-        DataType right_type;
-        // Check right expression
-        ec = semantic_check_expression(expr->params[1], globaltable, localtable, &right_type);
-        if (ec != OK) {
-            return ec;
-        }
+        DataType right_type = EXPR_ASSUMED_TYPE(exprs, EXPR_CHILD(exprs, expr, 1));
 
         if (right_type == DT_TYPE) {
             result_type = DT_BOOL;
@@ -1664,30 +1510,12 @@ ErrorCode semantic_check_expression(AstExpression *expr, Symtable *globaltable,
     }
 
     case EX_TERNARY: {
-        if (expr->child_count != 3) {
+        if (EXPR_CHILD_COUNT(exprs, expr) != 3) {
             return INTERNAL_ERROR;
         }
 
-        DataType cond_type;
-        // Check condition expression
-        ec = semantic_check_expression(expr->params[0], globaltable, localtable, &cond_type);
-        if (ec != OK) {
-            return ec;
-        }
-
-        DataType true_type;
-        // Check true branch expression
-        ec = semantic_check_expression(expr->params[1], globaltable, localtable, &true_type);
-        if (ec != OK) {
-            return ec;
-        }
-
-        DataType false_type;
-        // Check false branch expression
-        ec = semantic_check_expression(expr->params[2], globaltable, localtable, &false_type);
-        if (ec != OK) {
-            return ec;
-        }
+        DataType true_type = EXPR_ASSUMED_TYPE(exprs, EXPR_CHILD(exprs, expr, 1));
+        DataType false_type = EXPR_ASSUMED_TYPE(exprs, EXPR_CHILD(exprs, expr, 2));
 
         if (true_type == false_type) {
             result_type = true_type;
@@ -1708,21 +1536,13 @@ ErrorCode semantic_check_expression(AstExpression *expr, Symtable *globaltable,
     }
 
     case EX_NOT:
-        if (expr->child_count != 1) {
+        if (EXPR_CHILD_COUNT(exprs, expr) != 1) {
             return INTERNAL_ERROR;
         }
 
-        DataType child_type;
-        ec = semantic_check_expression(expr->params[0], globaltable, localtable, &child_type);
-        if (ec != OK) {
-            return ec;
-        }
-
         result_type = DT_BOOL;
         break;
 
-        return SEM_TYPE_COMPAT;
-
     case EX_DOUBLE:
         result_type = DT_NUM;
         break;
@@ -1740,15 +1560,11 @@ ErrorCode semantic_check_expression(AstExpression *expr, Symtable *globaltable,
         break;
 
     case EX_NEGATE: {
-        if (expr->child_count != 1) {
+        if (EXPR_CHILD_COUNT(exprs, expr) != 1) {
             return INTERNAL_ERROR;
         }
 
-        DataType child_type;
-        ec = semantic_check_expression(expr->params[0], globaltable, localtable, &child_type);
-        if (ec != OK) {
-            return ec;
-        }
+        DataType child_type = EXPR_ASSUMED_TYPE(exprs, EXPR_CHILD(exprs, expr, 0));
 
         if (child_type == DT_NUM) {
             result_type = child_type;
@@ -1768,32 +1584,12 @@ ErrorCode semantic_check_expression(AstExpression *expr, Symtable *globaltable,
         break;
 
     case EX_BUILTIN_FUN: {
+        // The builtin and its arguments were checked when they were reached
         SymtableItem *builtin_item = NULL;
-        if (!symtable_contains_builtin_function(globaltable, expr->string_val->val, &builtin_item)) {
+        if (!symtable_contains_builtin_function(globaltable, EXPR_IDENT(exprs, expr), &builtin_item)) {
             return SEM_UNDEFINED;
         }
 
-        // Check if child count matches builtin definition
-        if (builtin_item->param_count != expr->child_count) {
-            return SEM_BAD_PARAMS;
-        }
-
-        // Check argument expressions
-        for (size_t i = 0; i < expr->child_count; i++) {
-            DataType arg_type;
-            ec = semantic_check_expression(expr->params[i], globaltable, localtable, &arg_type);
-            if (ec != OK) {
-                return ec;
-            }
-
-            // Check parameter type compatibility
-            DataType expected_type = builtin_item->param_types[i];
-            if (expected_type != DT_UNKNOWN && arg_type != DT_UNKNOWN && expected_type != arg_type && !(expected_type == DT_NUM && arg_type == DT_NUM)) {
-                return SEM_BAD_PARAMS;
-            }
-        }
-
-
         result_type = builtin_item->data_type;
         break;
     }
@@ -1803,21 +1599,60 @@ ErrorCode semantic_check_expression(AstExpression *expr, Symtable *globaltable,
     }
 
     // Set assumed type in expression
-    expr->assumed_type = result_type;
-    if (out_type != NULL) {
-        *out_type = result_type;
+    EXPR_ASSUMED_TYPE(exprs, expr) = result_type;
+
+    return OK;
+}
+
+/// Semantic analysis of expression - checks definitions and type compatibility
+/// Returns error code and inferred type through out_type parameter
+ErrorCode semantic_check_expression(AstExprs *exprs, ExprId expr, Symtable *globaltable, Symtable *localtable, DataType *out_type) {
+    if (expr == EXPR_NONE) {
+        if (out_type != NULL) {
+            *out_type = DT_UNKNOWN;
+        }
+        return OK;
     }
 
+    // The children are checked before their parent with an explicit stack, so deep expressions
+    // do not overflow the C stack. Calls are also visited before and between their arguments
+    ErrorCode ec = OK;
+    AstWalk walk;
+    AstWalkFrame step;
+    ast_walk_init(&walk, exprs, expr);
+    while (ec == OK && ast_walk_next(&walk, &step)) {
+        if (step.done == 0) {
+            ec = semantic_check_call(exprs, step.expr, globaltable);
+        } else if (EXPR_TYPE(exprs, step.expr) == EX_BUILTIN_FUN) {
+            ec = semantic_check_builtin_argument(exprs, step.expr, step.done - 1, globaltable);
+        }
+        if (ec == OK && step.done == EXPR_CHILD_COUNT(exprs, step.expr)) {
+            ec = semantic_check_node(exprs, step.expr, globaltable, localtable);
+        }
+    }
+    if (walk.failed) {
+        ec = INTERNAL_ERROR;
+    }
+    ast_walk_free(&walk);
+    if (ec != OK) {
+        return ec;
+    }
+
+    if (out_type != NULL) {
+        *out_type = EXPR_ASSUMED_TYPE(exprs, expr);
+    }
     return OK;
 }
 
-ErrorCode parse(Lexer *lexer, AstStatement **out_root, Symtable **out_global_symtable) {
+/// Parses the whole program, passing the definitions to the handler if there is one
+static ErrorCode parse_program(Lexer *lexer, AstExprs *exprs, AstStatement **out_root, Symtable **out_global_symtable, DefinitionHandler handler, void *handler_par) {
     AstStatement *root = ast_statement_init();
     if (root == NULL) {
         return INTERNAL_ERROR;
     }
 
-    Symtable *symtable = symtable_init();
+    // The global symtable holds the builtins and the static definitions, the global variables are added as they come
+    Symtable *symtable = symtable_init_with_capacity(_BUILTIN_FUNCTION_COUNT + lexer->static_count);
     if (symtable == NULL) {
         ast_free(root);
         return INTERNAL_ERROR;
@@ -1839,7 +1674,7 @@ ErrorCode parse(Lexer *lexer, AstStatement **out_root, Symtable **out_global_sym
     }
 
     // Parse class and function definitions
-    ec = check_class_program(lexer, symtable, (root)->next);
+    ec = check_class_program(lexer, exprs, symtable, root->block, handler, handler_par);
     if (ec != OK) {
         symtable_free(symtable);
         ast_free(root);
@@ -1854,8 +1689,14 @@ ErrorCode parse(Lexer *lexer, AstStatement **out_root, Symtable **out_global_sym
     }
 
     // Check if there is main function
+    const Ident *main_name = intern_cstr("main");
+    if (main_name == NULL) {
+        symtable_free(symtable);
+        ast_free(root);
+        return INTERNAL_ERROR;
+    }
     SymtableItem *main_function = NULL;
-    if (!symtable_contains_function(symtable, "main", 0, &main_function)) {
+    if (!symtable_contains_function(symtable, main_name, 0, &main_function)) {
         symtable_free(symtable);
         ast_free(root);
         return SEM_UNDEFINED;
@@ -1866,3 +1707,15 @@ ErrorCode parse(Lexer *lexer, AstStatement **out_root, Symtable **out_global_sym
 
     return OK;
 }
+
+ErrorCode parse(Lexer *lexer, AstExprs *exprs, AstStatement **out_root, Symtable **out_global_symtable) {
+    return parse_program(lexer, exprs, out_root, out_global_symtable, NULL, NULL);
+}
+
+ErrorCode parse_streaming(Lexer *lexer, AstExprs *exprs, Symtable **out_global_symtable, DefinitionHandler handler, void *handler_par) {
+    AstStatement *root = NULL;
+    ErrorCode ec = parse_program(lexer, exprs, &root, out_global_symtable, handler, handler_par);
+    // Only the empty statement list is left
+    ast_free(root);
+    return ec;
+}
@@ -18,8 +18,15 @@
 #include "ast.h"
 #include <stdbool.h>
 
-/// Main parsing function
-ErrorCode parse(Lexer *lexer, AstStatement **out_root, Symtable **out_global_symtable);
+/// Receives a static function, getter or setter right after it was checked. The definition is freed after the call
+typedef void (*DefinitionHandler)(AstExprs *exprs, AstStatement *definition, Symtable *globaltable, void *par);
+
+/// Main parsing function, the expressions of the AST are created in exprs
+ErrorCode parse(Lexer *lexer, AstExprs *exprs, AstStatement **out_root, Symtable **out_global_symtable);
+
+/// Parses the program without keeping the AST, every definition is passed to the handler instead.
+/// The handler is called even if the program turns out to be incorrect later
+ErrorCode parse_streaming(Lexer *lexer, AstExprs *exprs, Symtable **out_global_symtable, DefinitionHandler handler, void *handler_par);
 
 /// Adds all builtin functions to the symbol table
 bool add_builtin_functions(Symtable *symtab);
@@ -27,60 +34,67 @@ bool add_builtin_functions(Symtable *symtab);
 /// Checks prologue of the program (import "ifj25" for Ifj)
 ErrorCode check_prologue(Lexer *lexer);
 
-/// Checks class Program { ... }
-ErrorCode check_class_program(Lexer *lexer, Symtable *symtable, AstStatement *statement);
+/// Checks class Program { ... }. Passes the definitions to the handler if it is not NULL
+ErrorCode check_class_program(Lexer *lexer, AstExprs *exprs, Symtable *symtable, AstBlock *block, DefinitionHandler handler, void *handler_par);
 
-/// Checks the body of a class
-ErrorCode check_class_body(Lexer *lexer, Symtable *symtable, AstStatement *statement);
+/// Checks the body of a class. Passes the definitions to the handler if it is not NULL
+ErrorCode check_class_body(Lexer *lexer, AstExprs *exprs, Symtable *symtable, AstBlock *block, DefinitionHandler handler, void *handler_par);
 
 /// Checks the global variable declaration
-ErrorCode check_global_var(Lexer *lexer, Symtable *globaltable, Symtable *localtable, String *var_name, AstStatement *statement);
+ErrorCode check_global_var(Lexer *lexer, AstExprs *exprs, Symtable *globaltable, Symtable *localtable, const Ident *var_name, AstBlock *block);
 
-/// Checks statics (static functions, getters, and setters)
-ErrorCode check_statics(Lexer *lexer, Symtable *symtable, AstStatement *statement);
+/// Checks statics (static functions, getters, and setters). The local symtable is sized for
+/// local_count parameters and variables, as counted by the lexer
+ErrorCode check_statics(Lexer *lexer, AstExprs *exprs, Symtable *symtable, AstBlock *block, size_t local_count);
 
 /// Checks Setter: static identifier = (val) { ... }
-ErrorCode checks_setter(Lexer *lexer, Symtable *globaltable, Symtable *localtable, Token identifier, AstStatement *statement);
+ErrorCode checks_setter(Lexer *lexer, AstExprs *exprs, Symtable *globaltable, Symtable *localtable, Token identifier, AstBlock *block);
 
 /// Checks Getter: static identifier { ... }
-ErrorCode check_getter(Lexer *lexer, Symtable *globaltable, Symtable *localtable, Token identifier, AstStatement *statement);
+ErrorCode check_getter(Lexer *lexer, AstExprs *exprs, Symtable *globaltable, Symtable *localtable, Token identifier, AstBlock *block);
 
 /// Checks Function: static identifier(...) { ... }
-ErrorCode check_function(Lexer *lexer, Symtable *globaltable, Symtable *localtable, Token identifier, AstStatement *statement);
+ErrorCode check_function(Lexer *lexer, AstExprs *exprs, Symtable *globaltable, Symtable *localtable, Token identifier, AstBlock *block);
 
-/// Checks function body
-ErrorCode check_body(Lexer *lexer, Symtable *globaltable, Symtable *localtable, bool known, AstStatement *statement);
+/// Checks function body, the nested blocks included, up to its closing brace
+ErrorCode check_body(Lexer *lexer, AstExprs *exprs, Symtable *globaltable, Symtable *localtable, bool known, AstBlock *block);
 
 /// Checks local variable declaration
-ErrorCode check_local_var(Lexer *lexer, Symtable *globaltable, Symtable *localtable, bool known, AstStatement *statement);
+ErrorCode check_local_var(Lexer *lexer, AstExprs *exprs, Symtable *globaltable, Symtable *localtable, bool known, AstBlock *block);
 
 /// Checks assignment or function call
-ErrorCode check_assignment_or_function_call(Lexer *lexer, Symtable *globaltable, Symtable *localtable, Token *identifier, bool known, AstStatement *statement);
+ErrorCode check_assignment_or_function_call(Lexer *lexer, AstExprs *exprs, Symtable *globaltable, Symtable *localtable, Token *identifier, bool known, AstBlock *block);
+
+/// Checks if statement up to its true branch, which is left open in a new scope for check_body.
+/// The statement is put into out_statement
+ErrorCode check_if_statement(Lexer *lexer, AstExprs *exprs, Symtable *globaltable, Symtable *localtable, AstBlock *block, AstStatement **out_statement);
 
-/// Checks if statement
-ErrorCode check_if_statement(Lexer *lexer, Symtable *globaltable, Symtable *localtable, AstStatement *statement);
+/// Checks the closing brace of a branch of the if statement and exits its scope. The next else-if or
+/// else branch is opened in a new scope and put into out_branch, which is left as it is after the last branch
+ErrorCode check_if_branch_end(Lexer *lexer, AstExprs *exprs, Symtable *globaltable, Symtable *localtable, AstStatement *statement, AstBlock **out_branch);
 
-/// Checks while statement
-ErrorCode check_while_statement(Lexer *lexer, Symtable *globaltable, Symtable *localtable, AstStatement *statement);
+/// Checks while statement up to its body, which is left open in a new scope for check_body.
+/// The statement is put into out_statement
+ErrorCode check_while_statement(Lexer *lexer, AstExprs *exprs, Symtable *globaltable, Symtable *localtable, AstBlock *block, AstStatement **out_statement);
 
 /// Checks return statement
-ErrorCode check_return_statement(Lexer *lexer, Symtable *globaltable, Symtable *localtable, AstStatement *statement);
+ErrorCode check_return_statement(Lexer *lexer, AstExprs *exprs, Symtable *globaltable, Symtable *localtable, AstBlock *block);
 
 /// Helper for adding getter to symbol table with redefinition check
-ErrorCode add_getter_helper(Symtable *symtable, char *name);
+ErrorCode add_getter_helper(Symtable *symtable, const Ident *name);
 
 /// Helper for adding setter to symbol table with redefinition check
-ErrorCode add_setter_helper(Symtable *symtable, char *name);
+ErrorCode add_setter_helper(Symtable *symtable, const Ident *name);
 
-/// Checks variable expression: if a local variable exists set its type
-ErrorCode check_variable_expression(Symtable *localtable, Symtable *globaltable, char *name, DataType expr_type, AstStatementType *type_out);
+/// Checks variable expression: if a local variable exists set its type and put its slot into slot_out
+ErrorCode check_variable_expression(Symtable *localtable, Symtable *globaltable, const Ident *name, DataType expr_type, AstStatementType *type_out, int *slot_out);
 
 /// Semantic analysis of expression - checks definitions and type compatibility
-ErrorCode semantic_check_expression(AstExpression *expr, Symtable *globaltable, Symtable *localtable, DataType *out_type);
+ErrorCode semantic_check_expression(AstExprs *exprs, ExprId expr, Symtable *globaltable, Symtable *localtable, DataType *out_type);
 
 // Helper structure for managing function parameters
 typedef struct {
-    String **names;
+    const Ident **names;
     size_t count;
     size_t capacity;
 } ParamList;
@@ -88,10 +102,10 @@ typedef struct {
 /// Initializes a parameter list
 ParamList *param_list_init();
 
-/// Adds a parameter name to the list (creates a copy of the string)
-bool param_list_add(ParamList *list, const char *name);
+/// Adds a parameter name to the list
+bool param_list_add(ParamList *list, const Ident *name);
 
-/// Frees the parameter list and all its strings
+/// Frees the parameter list, the names themselves are interned
 void param_list_free(ParamList *list);
 
 #endif
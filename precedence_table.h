@@ -0,0 +1,66 @@
+/*
+ * precedence_table.h
+ * Defines the operator precedence table shared by the expression parser and binding_gen
+ *
+ * IFJ project 2025
+ * FIT VUT
+ *
+ * Authors:
+ * Vojtěch Borýsek (xborysv00)
+ */
+#ifndef _PRECEDENCE_TABLE_H_
+#define _PRECEDENCE_TABLE_H_
+
+/// Rows and columns of the precedence table
+typedef enum prec_idx {
+    PREC_PLUS, // +
+    PREC_MINUS, // -, both binary and unary
+    PREC_MULT, // *
+    PREC_DIV, // /
+    PREC_GREATER, // >
+    PREC_LESS, // <
+    PREC_GREATER_EQ, // >=
+    PREC_LESS_EQ, // <=
+    PREC_EQ, // ==
+    PREC_NOT_EQ, // !=
+    PREC_AND, // &&
+    PREC_OR, // ||
+    PREC_OPERAND, // identifiers, literals, data types and calls
+    PREC_LEFT_PAR, // (
+    PREC_RIGHT_PAR, // )
+    PREC_IS, // is
+    PREC_QUESTION_MARK, // ?
+    PREC_COLON, // :
+    PREC_NOT, // !
+    PREC_DOLLAR, // $
+    PREC_TABLE_SIZE
+} PrecIdx;
+
+/**
+ * Precedence table for operators
+ * Rows are indexed by the topmost terminal on the stack, columns by the incoming token
+ */
+static const char precedence_table[PREC_TABLE_SIZE][PREC_TABLE_SIZE] = {
+{ '>', '>', '<', '<', '>', '>', '>', '>', '>', '>', '>', '>', '<', '<', '>', '>', '>', '>', '<', '>'}, //+
+{ '>', '>', '<', '<', '>', '>', '>', '>', '>', '>', '>', '>', '<', '<', '>', '>', '>', '>', '<', '>'}, //-
+{ '>', '>', '>', '>', '>', '>', '>', '>', '>', '>', '>', '>', '<', '<', '>', '>', '>', '>', '<', '>'}, //*
+{ '>', '>', '>', '>', '>', '>', '>', '>', '>', '>', '>', '>', '<', '<', '>', '>', '>', '>', '<', '>'}, ///
+{ '<', '<', '<', '<', '>', '>', '>', '>', '>', '>', '>', '>', '<', '<', '>', '>', '>', '>', '<', '>'}, //>
+{ '<', '<', '<', '<', '>', '>', '>', '>', '>', '>', '>', '>', '<', '<', '>', '>', '>', '>', '<', '>'}, //<
+{ '<', '<', '<', '<', '>', '>', '>', '>', '>', '>', '>', '>', '<', '<', '>', '>', '>', '>', '<', '>'}, //>=
+{ '<', '<', '<', '<', '>', '>', '>', '>', '>', '>', '>', '>', '<', '<', '>', '>', '>', '>', '<', '>'}, //<=
+{ '<', '<', '<', '<', '<', '<', '<', '<', '>', '>', '>', '>', '<', '<', '>', '<', '>', '>', '<', '>'}, //==
+{ '<', '<', '<', '<', '<', '<', '<', '<', '>', '>', '>', '>', '<', '<', '>', '<', '>', '>', '<', '>'}, //!=
+{ '<', '<', '<', '<', '<', '<', '<', '<', '<', '<', '>', '>', '<', '<', '>', '<', '>', '>', '<', '>'}, //&&
+{ '<', '<', '<', '<', '<', '<', '<', '<', '<', '<', '<', '>', '<', '<', '>', '<', '>', '>', '<', '>'}, //||
+{ '>', '>', '>', '>', '>', '>', '>', '>', '>', '>', '>', '>', ' ', ' ', '>', '>', '>', '>', '>', '>'}, //id
+{ '<', '<', '<', '<', '<', '<', '<', '<', '<', '<', '<', '<', '<', '<', '=', '<', '<', '<', '<', ' '}, //(
+{ '>', '>', '>', '>', '>', '>', '>', '>', '>', '>', '>', '>', ' ', ' ', '>', '>', '>', '>', ' ', '>'}, //)
+{ '<', '<', '<', '<', '<', '<', '<', '<', '>', '>', '>', '>', '<', '<', '>', '>', '>', '>', '<', '>'}, //is
+{ '<', '<', '<', '<', '<', '<', '<', '<', '<', '<', '<', '<', '<', '<', '>', '<', ' ', '=', '<', '>'}, //?
+{ '<', '<', '<', '<', '<', '<', '<', '<', '<', '<', '<', '<', '<', '<', '>', '<', '<', ' ', '<', '>'}, //:
+{ '>', '>', '>', '>', '>', '>', '>', '>', '>', '>', '>', '>', '<', '<', '>', '<', '>', '>', '<', '>'}, //!
+{ '<', '<', '<', '<', '<', '<', '<', '<', '<', '<', '<', '<', '<', '<', ' ', '<', '<', ' ', '<', ' '}  //$
+};
+
+#endif // !_PRECEDENCE_TABLE_H_
@@ -10,9 +10,13 @@
  */
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "stack.h"
 #include "token.h"
 
+/// E and < are the only non-terminals
+#define IS_TERM(type) ((type) != TOK_E && (type) != TOK_PREC_OPEN)
+
 Stack *stack_init() {
     Stack *stack = malloc(sizeof(Stack));
     if (stack == NULL) {
@@ -20,8 +24,12 @@ Stack *stack_init() {
     }
     stack->capacity = STACK_INITIAL_CAPACITY;
     stack->top = 0;
+    stack->term = STACK_NO_TERM;
     stack->items = malloc(stack->capacity * sizeof(Token));
-    if (stack->items == NULL) {
+    stack->prev_term = malloc(stack->capacity * sizeof(size_t));
+    if (stack->items == NULL || stack->prev_term == NULL) {
+        free(stack->items);
+        free(stack->prev_term);
         free(stack);
         return NULL;
     }
@@ -29,10 +37,8 @@ Stack *stack_init() {
 }
 
 void stack_destroy(Stack *stack) {
-    for (unsigned i = 0; i < stack->top; i++) {
-        token_free(stack->items + i);
-    }
     free(stack->items);
+    free(stack->prev_term);
     free(stack);
 }
 
@@ -40,17 +46,35 @@ bool stack_empty(Stack *stack) {
     return stack->top == 0;
 }
 
+/// Makes room for one more item. Returns false if memory allocation fails
+static bool stack_reserve(Stack *stack) {
+    if (stack->top < stack->capacity) {
+        return true;
+    }
+    size_t new_capacity = stack->capacity * 2;
+    Token *new_items = realloc(stack->items, new_capacity * sizeof(Token));
+    if (new_items == NULL) {
+        return false;
+    }
+    stack->items = new_items;
+    size_t *new_prev_term = realloc(stack->prev_term, new_capacity * sizeof(size_t));
+    if (new_prev_term == NULL) {
+        return false;
+    }
+    stack->prev_term = new_prev_term;
+    stack->capacity = new_capacity;
+    return true;
+}
+
 bool stack_push(Stack *stack, Token item) {
-    if (stack->top >= stack->capacity) {
-        size_t new_capacity = stack->capacity * 2;
-        Token *new_items = realloc(stack->items, new_capacity * sizeof(Token));
-        if (new_items == NULL) {
-            return false;
-        }
-        stack->items = new_items;
-        stack->capacity = new_capacity;
+    if (!stack_reserve(stack)) {
+        return false;
     }
 
+    if (IS_TERM(item.type)) {
+        stack->prev_term[stack->top] = stack->term;
+        stack->term = stack->top;
+    }
     stack->items[stack->top] = item;
     stack->top++;
 
@@ -62,6 +86,9 @@ bool stack_pop(Stack *stack) {
         return false;
     }
     stack->top--;
+    if (stack->top == stack->term) {
+        stack->term = stack->prev_term[stack->top];
+    }
     return true;
 }
 
@@ -74,47 +101,38 @@ bool stack_top(Stack *stack, Token *out_item) {
     return true;
 }
 
-bool stack_find_type(Stack *stack, Stack *out_stack, TokType type) {
-    for (size_t i = stack->top; i > 0; i--) {
-        Token temp;
-        stack_top(stack, &temp);
-        if (temp.type != type) {
-            stack_pop(stack);
-            stack_push(out_stack, temp);
-        }
-        else if (temp.type == type) {
-            return true;
-        }
+Token *stack_at(Stack *stack, size_t depth) {
+    return stack->items + stack->top - 1 - depth;
+}
+
+bool stack_top_term(Stack *stack, Token *out_item) {
+    if (stack->term == STACK_NO_TERM) {
+        return false;
     }
-    return false;
+
+    *out_item = stack->items[stack->term];
+    return true;
 }
 
-bool stack_find_term(Stack *stack, Stack *out_stack) {
-    for (size_t i = stack->top; i > 0; i--) {
-        Token temp;
-        stack_top(stack, &temp);
-        if (temp.type == TOK_E || temp.type == TOK_PREC_OPEN) {
-            stack_pop(stack);
-            stack_push(out_stack, temp);
-        }
-        else {
-            return true; // found terminal, currently on top of the stack
-        }
+bool stack_insert_after_term(Stack *stack, Token item) {
+    if (stack->term == STACK_NO_TERM || !stack_reserve(stack)) {
+        return false;
     }
-    return false;
+
+    // Only non-terminals are above the topmost terminal, so there are no terminal indices to update
+    size_t pos = stack->term + 1;
+    memmove(stack->items + pos + 1, stack->items + pos, (stack->top - pos) * sizeof(Token));
+    stack->items[pos] = item;
+    stack->top++;
+    return true;
 }
 
-bool push_whole_stack(Stack *src, Stack *dst) {
-    for (size_t i = src->top; i > 0; i--) {
-        if(stack_empty(src)){
-            return true;
-        }
-        Token temp;
-        stack_top(src, &temp);
-        stack_push(dst, temp);
-        stack_pop(src);
+void stack_reduce(Stack *stack, size_t count, Token item) {
+    for (size_t i = 0; i < count; i++) {
+        stack_pop(stack);
     }
-    return false;
+    // Popping made room, so this cannot fail
+    stack_push(stack, item);
 }
 
 bool stack_is_sequence_on_top(Stack *stack, TokType rule[], size_t rule_size) {
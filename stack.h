@@ -10,13 +10,21 @@
  */
 #include "token.h"
 
+#include <stdint.h>
+
 #define STACK_INITIAL_CAPACITY 32
+#define STACK_NO_TERM SIZE_MAX
 
 
 typedef struct stack {
     size_t capacity;
     size_t top;
     Token *items;
+    // For every terminal, the index of the terminal below it, so that
+    // the topmost terminal is known right away even after it is popped
+    size_t *prev_term;
+    // Index of the topmost terminal, STACK_NO_TERM if there is none
+    size_t term;
 } Stack;
 
 Stack *stack_init();
@@ -46,23 +54,27 @@ bool stack_pop(Stack *stack);
 bool stack_top(Stack *stack, Token *out_item);
 
 /**
- * Searches for a specific token type in stack
- * It pops items from the original stack and pushes them onto out_stack until it finds the type
- * If found, it returns true and the searched type is on the top of the stack, otherwise false
+ * Returns the item depth places below the top of the stack, 0 being the top itself
+ * The item stays on the stack and can be modified in place
+ */
+Token *stack_at(Stack *stack, size_t depth);
+
+/**
+ * Retrieves the topmost terminal of the stack, E and < are not terminals
+ * Returns true if successful, false if there is no terminal
  */
-bool stack_find_type(Stack *stack, Stack *out_stack, TokType type);
+bool stack_top_term(Stack *stack, Token *out_item);
 
 /**
- * Searches for the topmost terminal in the stack
- * It pops items from the original stack and pushes them onto out_stack until it finds a terminal
- * If found, it returns true and the terminal is on the top of the stack, otherwise false
+ * Inserts a non-terminal right above the topmost terminal
+ * Returns true if successful, false if memory allocation fails or there is no terminal
  */
-bool stack_find_term(Stack *stack, Stack *out_stack);
+bool stack_insert_after_term(Stack *stack, Token item);
 
 /**
- * Pushes all items from src stack to dst stack
- * Returns true if successful, false otherwise
+ * Replaces the count items on the top of the stack with the given one
+ * The stack has to hold at least count items and count has to be at least 1
  */
-bool push_whole_stack(Stack *src, Stack *dst);
+void stack_reduce(Stack *stack, size_t count, Token item);
 
 bool stack_is_sequence_on_top(Stack *stack, TokType rule[], size_t rule_size);
@@ -19,58 +19,79 @@ String *str_init() {
         return NULL;
     }
 
-    str->val = (char *)malloc(_STRING_INIT_SIZE * sizeof(char));
-    if (str->val == NULL) {
-        free(str);
-        return NULL;
-    }
-
-    str->capacity = _STRING_INIT_SIZE;
+    str->val = str->short_val;
+    str->capacity = _STRING_SHORT_SIZE;
     str->length = 0;
     str->val[0] = '\0';
     
     return str;
 }
 
-bool str_append_string(String *str, const char *str_to_append) {
-    if (str == NULL || str_to_append == NULL) {
+bool str_reserve(String *str, unsigned length) {
+    if (str == NULL) {
         return false;
     }
-
-    unsigned append_length = strlen(str_to_append);
-    if (append_length == 0) {
+    if (length + 1 <= str->capacity) {
         return true;
     }
 
-    while (str->length + append_length + 1 > str->capacity) {
-        unsigned new_capacity = str->capacity * _STRING_SCALE_FACTOR;
-        char *new_val = (char *)realloc(str->val, new_capacity * sizeof(char));
-        if (new_val == NULL) {
-            return false;
+    unsigned new_capacity = str->capacity;
+    while (length + 1 > new_capacity) {
+        new_capacity *= _STRING_SCALE_FACTOR;
+    }
+
+    // The inline buffer cannot be reallocated, its contents are moved to the heap
+    char *new_val;
+    if (str->val == str->short_val) {
+        new_val = (char *)malloc(new_capacity * sizeof(char));
+        if (new_val != NULL) {
+            memcpy(new_val, str->val, str->length + 1);
         }
-        str->val = new_val;
-        str->capacity = new_capacity;
+    } else {
+        new_val = (char *)realloc(str->val, new_capacity * sizeof(char));
+    }
+    if (new_val == NULL) {
+        return false;
+    }
+    str->val = new_val;
+    str->capacity = new_capacity;
+
+    return true;
+}
+
+bool str_append_n(String *str, const char *str_to_append, unsigned len) {
+    if (str == NULL || str_to_append == NULL) {
+        return false;
+    }
+    if (len == 0) {
+        return true;
     }
 
-    strcpy(str->val + str->length, str_to_append);
-    str->length += append_length;
+    if (!str_reserve(str, str->length + len)) {
+        return false;
+    }
+
+    memcpy(str->val + str->length, str_to_append, len);
+    str->length += len;
+    str->val[str->length] = '\0';
 
     return true;
 }
 
+bool str_append_string(String *str, const char *str_to_append) {
+    if (str_to_append == NULL) {
+        return false;
+    }
+    return str_append_n(str, str_to_append, strlen(str_to_append));
+}
+
 bool str_append_char(String *str, char ch) {
     if (str == NULL) {
         return false;
     }
 
-    if (str->length + 2 > str->capacity) {
-        unsigned new_capacity = str->capacity * _STRING_SCALE_FACTOR;
-        char *new_val = (char *)realloc(str->val, new_capacity * sizeof(char));
-        if (new_val == NULL) {
-            return false;
-        }
-        str->val = new_val;
-        str->capacity = new_capacity;
+    if (str->length + 2 > str->capacity && !str_reserve(str, str->length + 1)) {
+        return false;
     }
 
     str->val[str->length] = ch;
@@ -93,7 +114,9 @@ void str_remove_last(String *str) {
 
 void str_free(String **str) {
     if (str != NULL && *str != NULL) {
-        free((*str)->val);
+        if ((*str)->val != (*str)->short_val) {
+            free((*str)->val);
+        }
         free(*str);
         *str = NULL;
     }
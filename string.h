@@ -11,22 +11,32 @@
 #ifndef _STRING_H_
 #define _STRING_H_
 
-#define _STRING_INIT_SIZE 32
+#define _STRING_SHORT_SIZE 24
 #define _STRING_SCALE_FACTOR 2
 
 #include <stdbool.h>
 
+/// Short contents are kept inline in the structure, so a string can never be copied by value
 typedef struct string {
+    /// Points to short_val until the string outgrows it, then to a heap buffer
     char *val;
     /// Capacity allocated at *val
     unsigned capacity;
     /// Current length of the string without the null terminator
     unsigned length;
+    char short_val[_STRING_SHORT_SIZE];
 } String;
 
 /// Creates a new string structure and returns a pointer to it or NULL if allocation failed
 String *str_init();
 
+/// Makes room for a string of length characters, so appending up to it does not reallocate.
+/// Returns true if the operation was successfull
+bool str_reserve(String *str, unsigned length);
+
+/// Appends len characters of a given string to a string. Returns true if the operation was successfull
+bool str_append_n(String *str, const char *str_to_append, unsigned len);
+
 /// Appends a given string to a string. Returns true if the operation was successfull
 bool str_append_string(String *str, const char *str_to_append);
 
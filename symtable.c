@@ -12,59 +12,172 @@
  */
 #include "symtable.h"
 #include "ast.h"
+#include "intern.h"
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <unistd.h>
 
-enum { SLOT_EMPTY = 0, SLOT_OCCUPIED = 1, SLOT_DELETED = 2 };
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Control bytes of an empty and of a deleted slot, the byte of a full slot holds 7 bits of its hash.
+// Only the free ones have the high bit set
+#define CTRL_EMPTY 0x80
+#define CTRL_DELETED 0xFE
+
+// Bit i is set if slot i of the group matches
+typedef uint32_t GroupMask;
+
+// Returns the slots of the group starting at ctrl whose control byte is byte
+static inline GroupMask group_match(const unsigned char *ctrl, unsigned char byte) {
+#ifdef __SSE2__
+    __m128i group = _mm_loadu_si128((const __m128i *)ctrl);
+    return (GroupMask)_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8((char)byte)));
+#else
+    GroupMask mask = 0;
+    for (unsigned i = 0; i < ST_GROUP_WIDTH; i++) {
+        mask |= (GroupMask)(ctrl[i] == byte) << i;
+    }
+    return mask;
+#endif
+}
+
+// Returns the empty and deleted slots of the group starting at ctrl
+static inline GroupMask group_match_free(const unsigned char *ctrl) {
+#ifdef __SSE2__
+    return (GroupMask)_mm_movemask_epi8(_mm_loadu_si128((const __m128i *)ctrl));
+#else
+    GroupMask mask = 0;
+    for (unsigned i = 0; i < ST_GROUP_WIDTH; i++) {
+        mask |= (GroupMask)(ctrl[i] >> 7) << i;
+    }
+    return mask;
+#endif
+}
+
+// Spreads the bits of the item hash, the top 7 bits go to the control byte and the rest picks the group
+static inline uint64_t mix_hash(unsigned long hash) {
+    uint64_t h = (uint64_t)hash * 0x9E3779B97F4A7C15u;
+    return h ^ (h >> 32);
+}
+
+static inline unsigned char hash_ctrl(uint64_t h) {
+    return (unsigned char)(h >> 57);
+}
 
-// Simple djb2 hash function for strings
-static unsigned long hash_str(const char *str) {
-    unsigned long hash = 5381;
-    int c;
-    while ((c = (unsigned char)*str++) != 0) {
-        hash = ((hash << 5) + hash) + c;
+// Sets the control byte of the slot, the first group is mirrored after the last slot,
+// so a group starting at any slot can be loaded at once
+static inline void set_ctrl(Symtable *st, size_t idx, unsigned char byte) {
+    st->ctrl[idx] = byte;
+    if (idx < ST_GROUP_WIDTH - 1) {
+        st->ctrl[st->capacity + idx] = byte;
+    }
+}
+
+// Allocates the slots and control bytes for capacity items, all of them empty
+static bool table_alloc(Symtable *st, size_t capacity) {
+    st->index = malloc(sizeof(uint32_t) * capacity);
+    if (!st->index) return false;
+    st->ctrl = malloc(capacity + ST_GROUP_WIDTH - 1);
+    if (!st->ctrl) {
+        free(st->index);
+        return false;
+    }
+    memset(st->ctrl, CTRL_EMPTY, capacity + ST_GROUP_WIDTH - 1);
+    st->capacity = capacity;
+    st->deleted = 0;
+    return true;
+}
+
+// Returns the first empty or deleted slot on the probe sequence of the hash
+static size_t find_free(Symtable *st, uint64_t h) {
+    size_t mask = st->capacity - 1;
+    size_t pos = (size_t)h & mask;
+    for (size_t stride = ST_GROUP_WIDTH;; stride += ST_GROUP_WIDTH) {
+        GroupMask free_slots = group_match_free(st->ctrl + pos);
+        if (free_slots) {
+            return (pos + __builtin_ctz(free_slots)) & mask;
+        }
+        // Triangular steps visit every group, because the capacity is a power of two
+        pos = (pos + stride) & mask;
     }
-    return hash;
 }
 
-// Allocate and initialize state array
-static int *state_alloc(size_t count) {
-    int *s = malloc(sizeof(int) * count);
-    if (!s) return NULL;
-    for (size_t i = 0; i < count; ++i) s[i] = SLOT_EMPTY;
-    return s;
+// Returns the number of parameters that is part of the key, only functions are told apart by it
+static inline size_t key_arity(SymType type, size_t arity) {
+    return type == SYM_FUNCTION ? arity : 0;
+}
+
+// Returns the hash of the key made of the type, the name and the arity
+static inline unsigned long key_hash(SymType type, const Ident *name, size_t arity) {
+    return name->hash ^ ((unsigned long)(key_arity(type, arity) << 3 | type) * 0x100000001B3u);
+}
+
+// Fills the item with the defaults for a symbol with the key
+static void init_item(SymtableItem *item, SymType type, const Ident *name, size_t arity, unsigned long hash) {
+    item->name = name;
+    item->type = type;
+    item->param_count = arity;
+    item->hash = hash;
+    item->slot = SLOT_NONE;
+    item->scope = 0;
+    item->data_type = DT_UNKNOWN;
+    item->is_defined = true;
+    item->param_types = NULL;
+    item->data_type_known = false;
+    item->string_val = NULL;
+}
+
+// Frees what the item owns
+static void free_item(SymtableItem *it) {
+    if (it->param_types) {
+        free(it->param_types);
+    }
+    if (it->data_type_known && it->data_type == DT_STRING) {
+        str_free(&it->string_val);
+    }
 }
 
 Symtable *symtable_init(void) {
+    return symtable_init_with_capacity(0);
+}
+
+Symtable *symtable_init_with_capacity(size_t count) {
     Symtable *st = malloc(sizeof(Symtable));
     if (!st) return NULL;
 
-    st->capacity = INITIAL_CAPACITY;
-    st->size = 0;
-
-    st->data = malloc(sizeof(SymtableItem) * st->capacity);
-    if (!st->data) {
-        free(st);
-        return NULL;
+    // Rehashing starts once more than 7/8 of the slots are taken
+    size_t capacity = INITIAL_CAPACITY;
+    while (count * 8 > capacity * 7) {
+        capacity *= 2;
     }
-    st->state = state_alloc(st->capacity);
-    if (!st->state) {
-        free(st->data);
+    size_t item_capacity = count > ST_ITEMS_INITIAL_CAPACITY ? count : ST_ITEMS_INITIAL_CAPACITY;
+
+    st->size = 0;
+    if (!table_alloc(st, capacity)) {
         free(st);
         return NULL;
     }
 
-    st->scope_stack = malloc(sizeof(int) * ST_SCOPE_STACK_INITIAL_CAPACITY);
-    if (st->scope_stack == NULL) {
-        free(st->state);
-        free(st->data);
+    st->items = malloc(sizeof(SymtableItem) * item_capacity);
+    st->scope_stack = malloc(sizeof(size_t) * ST_SCOPE_STACK_INITIAL_CAPACITY);
+    if (st->items == NULL || st->scope_stack == NULL) {
+        free(st->items);
+        free(st->scope_stack);
+        free(st->ctrl);
+        free(st->index);
         free(st);
         return NULL;
     }
+    st->count = 0;
+    st->item_capacity = item_capacity;
     st->scope_stack_count = 0;
     st->scope_stack_capacity = ST_SCOPE_STACK_INITIAL_CAPACITY;
+    st->undo = NULL;
+    st->undo_count = 0;
+    st->undo_capacity = 0;
     st->undefined_items_counter = 0;
     
     return st;
@@ -72,159 +185,164 @@ Symtable *symtable_init(void) {
 
 void symtable_free(Symtable *st) {
     if (!st) return;
-    // Free all keys
-    for (size_t i = 0; i < st->capacity; ++i) {
-        if (st->state[i] == SLOT_OCCUPIED && st->data[i].key) {
-            SymtableItem it = st->data[i];
-            free(it.key);
-            str_free(&it.name);
-            if (it.param_types) {
-                free(it.param_types);
-            }
-            if (it.data_type_known && it.data_type == DT_STRING) {
-                str_free(&it.string_val);
-            }
-        }
+    // Free what the items own
+    for (size_t i = 0; i < st->count; ++i) {
+        free_item(&st->items[i]);
     }
-    free(st->data);
-    free(st->state);
+    free(st->items);
+    free(st->index);
+    free(st->ctrl);
+    free(st->undo);
     free(st->scope_stack);
     free(st);
 }
 
-// Rehash symtable to new capacity
+// Rehash symtable to new capacity, the slots are placed by the stored hashes of their items and deleted slots are dropped
 static bool symtable_rehash(Symtable *st, size_t new_capacity) {
-    SymtableItem *old_data = st->data;
-    int *old_state = st->state;
+    uint32_t *old_index = st->index;
+    unsigned char *old_ctrl = st->ctrl;
     size_t old_cap = st->capacity;
+    size_t old_deleted = st->deleted;
 
-    SymtableItem *new_data = malloc(sizeof(SymtableItem) * new_capacity);
-    if (!new_data) return false;
-    int *new_state = state_alloc(new_capacity);
-    if (!new_state) {
-        free(new_data);
+    if (!table_alloc(st, new_capacity)) {
+        st->index = old_index;
+        st->ctrl = old_ctrl;
+        st->capacity = old_cap;
+        st->deleted = old_deleted;
         return false;
     }
 
-    // Move occupied items to new table
-    for (size_t i = 0; i < new_capacity; ++i) new_state[i] = SLOT_EMPTY;
+    // Move full slots to new table, the items stay where they are
     for (size_t i = 0; i < old_cap; ++i) {
-        if (old_state[i] == SLOT_OCCUPIED) {
-            unsigned long h = hash_str(old_data[i].key);
-            size_t probe = (size_t)(h % new_capacity);
-            while (new_state[probe] == SLOT_OCCUPIED) {
-                probe = (probe + 1) % new_capacity;
+        if (old_ctrl[i] < CTRL_EMPTY) {
+            uint64_t h = mix_hash(st->items[old_index[i]].hash);
+            size_t idx = find_free(st, h);
+            st->index[idx] = old_index[i];
+            set_ctrl(st, idx, hash_ctrl(h));
+        }
+    }
+
+    free(old_index);
+    free(old_ctrl);
+    return true;
+}
+
+// Returns the slot of the item with the key or the capacity if there is none, hash is the hash of the key
+static size_t find_pos(Symtable *st, SymType type, const Ident *name, size_t arity, unsigned long hash) {
+    arity = key_arity(type, arity);
+
+    uint64_t h = mix_hash(hash);
+    unsigned char byte = hash_ctrl(h);
+    size_t mask = st->capacity - 1;
+    size_t pos = (size_t)h & mask;
+
+    for (size_t stride = ST_GROUP_WIDTH;; stride += ST_GROUP_WIDTH) {
+        const unsigned char *group = st->ctrl + pos;
+        for (GroupMask match = group_match(group, byte); match; match &= match - 1) {
+            size_t idx = (pos + __builtin_ctz(match)) & mask;
+            SymtableItem *it = &st->items[st->index[idx]];
+            if (it->name == name && it->type == type && key_arity(type, it->param_count) == arity) {
+                return idx;
             }
-            new_data[probe] = old_data[i];
-            new_state[probe] = SLOT_OCCUPIED;
         }
+        // An empty slot ends the probe sequence, the item would have been placed there
+        if (group_match(group, CTRL_EMPTY)) {
+            return st->capacity;
+        }
+        pos = (pos + stride) & mask;
     }
+}
 
-    free(old_data);
-    free(old_state);
+// Finds the item with the key, hash is the hash of the key
+static SymtableItem *find_key(Symtable *st, SymType type, const Ident *name, size_t arity, unsigned long hash) {
+    if (!st || !name) return NULL;
+    size_t pos = find_pos(st, type, name, arity, hash);
+    return pos == st->capacity ? NULL : &st->items[st->index[pos]];
+}
 
-    st->data = new_data;
-    st->state = new_state;
-    st->capacity = new_capacity;
+// Makes room for another element in the array of elements of the given size
+static bool reserve_one(void **array, size_t *count, size_t *capacity, size_t size, size_t initial_capacity) {
+    if (*count < *capacity) return true;
+    size_t new_capacity = *capacity == 0 ? initial_capacity : *capacity * 2;
+    void *new_array = realloc(*array, new_capacity * size);
+    if (new_array == NULL) return false;
+    *array = new_array;
+    *capacity = new_capacity;
     return true;
 }
 
-SymtableItem *symtable_find(Symtable *st, const char *key) {
-    if (!st || !key) return NULL;
-    if (st->capacity == 0) return NULL;
-
-    unsigned long h = hash_str(key);
-    size_t cap = st->capacity;
-    size_t probe = (size_t)(h % cap);
+// Points a free slot on the probe sequence of the hash to the item at item_idx
+static bool place_slot(Symtable *st, unsigned long hash, size_t item_idx) {
+    // Rehash when more than 7/8 of the slots are taken, the table only grows if
+    // the full slots take more than half of that, otherwise deleted slots are reclaimed
+    if ((st->size + st->deleted + 1) * 8 > st->capacity * 7) {
+        size_t newcap = (st->size + 1) * 16 > st->capacity * 7 ? st->capacity * 2 : st->capacity;
+        if (!symtable_rehash(st, newcap)) return false;
+    }
 
-    for (size_t i = 0; i < cap; ++i) {
-        size_t idx = (probe + i) % cap;
-        int s = st->state[idx];
-        if (s == SLOT_EMPTY) return NULL; // not found, and no further possible
-        if (s == SLOT_OCCUPIED && strcmp(st->data[idx].key, key) == 0) {
-            return &st->data[idx];
-        }
-        // continue on deleted or occupied-but-not-equal
+    uint64_t h = mix_hash(hash);
+    size_t idx = find_free(st, h);
+    if (st->ctrl[idx] == CTRL_DELETED) {
+        st->deleted--;
     }
-    return NULL;
+    set_ctrl(st, idx, hash_ctrl(h));
+    st->index[idx] = (uint32_t)item_idx;
+    st->size++;
+    return true;
+}
+
+SymtableItem *symtable_find(Symtable *st, SymType type, const Ident *name, size_t arity) {
+    if (!name) return NULL;
+    return find_key(st, type, name, arity, key_hash(type, name, arity));
 }
 
-bool symtable_contains(Symtable *st, const char *key) {
-    return symtable_find(st, key) != NULL;
+bool symtable_contains(Symtable *st, SymType type, const Ident *name, size_t arity) {
+    return symtable_find(st, type, name, arity) != NULL;
 }
 
-SymtableItem *symtable_insert(Symtable *st, const char *key) {
-    if (!st || !key) return NULL;
+// Inserts an item with the key, hash is the hash of the key
+static SymtableItem *insert_key(Symtable *st, SymType type, const Ident *name, size_t arity, unsigned long hash) {
+    if (!st || !name) return NULL;
 
     // Prevent duplicates
-    if (symtable_contains(st, key)) return NULL;
+    if (find_key(st, type, name, arity, hash) != NULL) return NULL;
 
-    // Grow when load factor > 0.7
-    if ((st->size + 1) * 10 >= st->capacity * 7) {
-        size_t newcap = st->capacity * 2;
-        if (!symtable_rehash(st, newcap)) return NULL;
+    if (!reserve_one((void **)&st->items, &st->count, &st->item_capacity, sizeof(SymtableItem), ST_ITEMS_INITIAL_CAPACITY) ||
+        !place_slot(st, hash, st->count)) {
+        return NULL;
     }
 
-    unsigned long h = hash_str(key);
-    size_t cap = st->capacity;
-    size_t probe = (size_t)(h % cap);
-    ssize_t first_deleted = -1;
-
-    for (size_t i = 0; i < cap; ++i) {
-        size_t idx = (probe + i) % cap;
-        int s = st->state[idx];
-        if (s == SLOT_OCCUPIED) {
-            if (strcmp(st->data[idx].key, key) == 0) {
-                return NULL; // Should not happen due to earlier check, checks duplicates
-            }
-            continue;
-        }
-        if (s == SLOT_DELETED) {
-            if (first_deleted == -1) first_deleted = (ssize_t)idx;
-            continue;
-        }
-        // s == SLOT_EMPTY -> found insertion point
-        size_t use_idx = (first_deleted != -1) ? (size_t)first_deleted : idx;
-        // Allocate and copy the key
-        st->data[use_idx].key = malloc(strlen(key) + 1);
-        if (!st->data[use_idx].key) return NULL;
-        strcpy(st->data[use_idx].key, key);
-        st->data[use_idx].name = str_init();
-        if (!st->data[use_idx].name) return NULL;
-        str_append_string(st->data[use_idx].name, key);
-        st->data[use_idx].data_type = DT_UNKNOWN;
-        st->data[use_idx].is_defined = true;
-        st->data[use_idx].type = SYM_VAR;
-        st->data[use_idx].param_types = NULL;
-        st->data[use_idx].data_type_known = false;
-        st->data[use_idx].string_val = NULL;
-        st->state[use_idx] = SLOT_OCCUPIED;
-        st->size++;
-        return &st->data[use_idx];
-    }
+    SymtableItem *item = &st->items[st->count++];
+    init_item(item, type, name, arity, hash);
+    return item;
+}
+
+// Frees the slot, the item it points to stays in the item array
+static void erase_slot(Symtable *st, size_t idx) {
+    set_ctrl(st, idx, CTRL_DELETED);
+    st->size--;
+    st->deleted++;
+}
 
-    // Table full, should not happen due to rehashing
-    return NULL;
+SymtableItem *symtable_insert(Symtable *st, SymType type, const Ident *name, size_t arity) {
+    if (!name) return NULL;
+    return insert_key(st, type, name, arity, key_hash(type, name, arity));
 }
 
 void symtable_foreach(Symtable *st, void (*fun)(SymtableItem*, void*), void *par) {
-    for (unsigned i = 0; i < st->capacity; i++) {
-        if (st->state[i] != SLOT_OCCUPIED) continue;
-        fun(st->data + i, par);
+    for (size_t i = 0; i < st->count; i++) {
+        fun(st->items + i, par);
     }
 }
 
-// Global counter for scope ids, so every scope has a unique id
-int scope_id_counter = 0;
-
 bool enter_scope(Symtable *st) {
     if (st->scope_stack_count == st->scope_stack_capacity) {
         st->scope_stack_capacity <<= 1;
-        int *new_st = realloc(st->scope_stack, sizeof(int) * st->scope_stack_capacity);
+        size_t *new_st = realloc(st->scope_stack, sizeof(size_t) * st->scope_stack_capacity);
         if (new_st == NULL) return false;
         st->scope_stack = new_st;
     }
-    st->scope_stack[st->scope_stack_count++] = scope_id_counter++;
+    st->scope_stack[st->scope_stack_count++] = st->undo_count;
     return true;
 }
 
@@ -232,291 +350,148 @@ void exit_scope(Symtable *st) {
     if (st->scope_stack_count == 0){
         return;
     }
-    st->scope_stack_count--;
+    size_t mark = st->scope_stack[--st->scope_stack_count];
+
+    // Rolls back the bindings made in the scope, the variables themselves stay in the item array
+    while (st->undo_count > mark) {
+        SymtableUndo *undo = &st->undo[--st->undo_count];
+        size_t pos = find_pos(st, SYM_VAR, undo->name, 0, key_hash(SYM_VAR, undo->name, 0));
+        if (pos == st->capacity) continue;
+        if (undo->prev_slot == SLOT_NONE) {
+            erase_slot(st, pos);
+        } else {
+            st->index[pos] = (uint32_t)undo->prev_slot;
+        }
+    }
 }
 
 int current_scope(Symtable *st) {
-    return st->scope_stack[st->scope_stack_count - 1];
-}
-
-bool append_scope_id(String *s, int scope) {
-    // Converts buffer id to string
-    char buf[64];
-    int written = snprintf(buf, 64, "%d", scope);
-    if (written >= 64) return false;
-    str_append_string(s, buf);
-    return true;
+    return (int)st->scope_stack_count;
 }
 
-bool find_local_var(Symtable *st, char *var_name, SymtableItem **out_item) {
+bool find_local_var(Symtable *st, const Ident *var_name, SymtableItem **out_item) {
     if (st == NULL) {
         return true;
     }
 
-    // Assumes format var_name?scope_id
-    String *s = str_init();
-    if (s == NULL) return false;
-    
-    for (int i = st->scope_stack_count - 1; i >= 0; i--) {
-        // Constructs symtable name
-        str_clear(s);
-        str_append_string(s, var_name);
-        str_append_char(s, '?');
-        if (!append_scope_id(s, st->scope_stack[i])) {
-            str_free(&s);
-            return false;
-        }
-
-        SymtableItem *it = symtable_find(st, s->val);
-        if (it != NULL) {
-            *out_item = it;
-            str_free(&s);
-            return true;
-        }
-    }
-    
-    // Not found
-    *out_item = NULL;
-    str_free(&s);
+    // Only the variables visible in the open scopes have slots in the table, so one probe finds the innermost one
+    *out_item = symtable_find(st, SYM_VAR, var_name, 0);
     return true;
 }
 
-SymtableItem *add_var_at_current_scope(Symtable *st, char *var_name, DataType data_type) {
-    // Assumes format var_name?scope_id
-    String *s = str_init();
-    if (s == NULL) return NULL;
-    
-    // Constructs symtable name
-    str_append_string(s, var_name);
-    str_append_char(s, '?');
-    if (!append_scope_id(s, current_scope(st))) {
-        str_free(&s);
+SymtableItem *symtable_var(Symtable *st, int slot) {
+    if (!st || slot < 0 || (size_t)slot >= st->count || st->items[slot].slot != slot) return NULL;
+    return &st->items[slot];
+}
+
+SymtableItem *add_var_at_current_scope(Symtable *st, const Ident *var_name, DataType data_type) {
+    if (!reserve_one((void **)&st->items, &st->count, &st->item_capacity, sizeof(SymtableItem), ST_ITEMS_INITIAL_CAPACITY) ||
+        !reserve_one((void **)&st->undo, &st->undo_count, &st->undo_capacity, sizeof(SymtableUndo), ST_UNDO_INITIAL_CAPACITY)) {
         return NULL;
     }
-    
-    SymtableItem *result = symtable_insert(st, s->val);
-    str_free(&s);
-    if (result == NULL) {
+
+    int scope = current_scope(st);
+    int slot = (int)st->count;
+    unsigned long hash = key_hash(SYM_VAR, var_name, 0);
+    size_t pos = find_pos(st, SYM_VAR, var_name, 0, hash);
+    if (pos == st->capacity) {
+        if (!place_slot(st, hash, (size_t)slot)) return NULL;
+        st->undo[st->undo_count++] = (SymtableUndo){ .name = var_name, .prev_slot = SLOT_NONE };
+    } else if (st->items[st->index[pos]].scope == scope) {
+        // Already declared in this scope
         return NULL;
+    } else {
+        // Shadows a variable of an enclosing scope until this scope is exited
+        st->undo[st->undo_count++] = (SymtableUndo){ .name = var_name, .prev_slot = (int)st->index[pos] };
+        st->index[pos] = (uint32_t)slot;
     }
 
-    str_clear(result->name);
-    str_append_string(result->name, var_name);
+    SymtableItem *result = &st->items[st->count++];
+    init_item(result, SYM_VAR, var_name, 0, hash);
+    result->slot = slot;
+    result->scope = scope;
     result->data_type = data_type;
     return result;
 }
 
-bool contains_var_at_current_scope(Symtable *st, char *var_name) {
-    // Assumes format var_name?scope_id
-    String *s = str_init();
-    if (s == NULL) return false;
-    
-    // Constructs symtable name
-    str_append_string(s, var_name);
-    str_append_char(s, '?');
-    if (!append_scope_id(s, current_scope(st))) {
-        str_free(&s);
-        return false;
-    }
-    
-    bool result = symtable_contains(st, s->val);
-    str_free(&s);
-    return result;
+bool contains_var_at_current_scope(Symtable *st, const Ident *var_name) {
+    SymtableItem *var = symtable_find(st, SYM_VAR, var_name, 0);
+    return var != NULL && var->scope == current_scope(st);
 }
 
-SymtableItem *symtable_add_getter(Symtable *st, char *var_name, bool is_defined) {
-    // Assumes format var_name!
-    String *s = str_init();
-    if (s == NULL) return NULL;
-
-    // Constructs symtable name
-    str_append_string(s, var_name);
-    str_append_char(s, '!');
-
-    SymtableItem *result = symtable_insert(st, s->val);
-    str_free(&s);
+// Stores the item or NULL to out_item if it is not NULL, returns true if there is an item
+static bool found(SymtableItem *item, SymtableItem **out_item) {
+    if (out_item) {
+        *out_item = item;
+    }
+    return item != NULL;
+}
 
+SymtableItem *symtable_add_getter(Symtable *st, const Ident *var_name, bool is_defined) {
+    SymtableItem *result = symtable_insert(st, SYM_GETTER, var_name, 0);
     if (result == NULL)
         return NULL;
 
-    str_clear(result->name);
-    str_append_string(result->name, var_name);
     result->is_defined = is_defined;
-    result->param_count = 0;
-    result->type = SYM_GETTER;
-
     return result;
 }
 
-bool symtable_contains_getter(Symtable *st, char *var_name, SymtableItem **out_item) {
-    // Assumes format var_name!
-    String *s = str_init();
-    if (s == NULL) return false;
-
-    // Constructs symtable name
-    str_append_string(s, var_name);
-    str_append_char(s, '!');
-
-    bool result = symtable_contains(st, s->val);
-
-    if (out_item) {
-        *out_item = symtable_find(st, s->val);
-    }
-
-    str_free(&s);
-    
-    return result;
+bool symtable_contains_getter(Symtable *st, const Ident *var_name, SymtableItem **out_item) {
+    return found(symtable_find(st, SYM_GETTER, var_name, 0), out_item);
 }
 
-SymtableItem *symtable_add_setter(Symtable *st, char *var_name, bool is_defined) {
-    // Assumes format var_name*
-    String *s = str_init();
-    if (s == NULL) return NULL;
-
-    // Constructs symtable name
-    str_append_string(s, var_name);
-    str_append_char(s, '*');
-
-    SymtableItem *result = symtable_insert(st, s->val);
-    str_free(&s);
-
+SymtableItem *symtable_add_setter(Symtable *st, const Ident *var_name, bool is_defined) {
+    SymtableItem *result = symtable_insert(st, SYM_SETTER, var_name, 1);
     if (result == NULL)
         return NULL;
 
-    str_clear(result->name);
-    str_append_string(result->name, var_name);
     result->is_defined = is_defined;
-    result->param_count = 1;
-    result->type = SYM_SETTER;
-
     return result;
 }
 
-bool symtable_contains_setter(Symtable *st, char *var_name, SymtableItem **out_item) {
-    // Assumes format var_name*
-    String *s = str_init();
-    if (s == NULL) return false;
-
-    // Constructs symtable name
-    str_append_string(s, var_name);
-    str_append_char(s, '*');
-
-    bool result = symtable_contains(st, s->val);
-
-    if (out_item) {
-        *out_item = symtable_find(st, s->val);
-    }
-
-    str_free(&s);
-
-    return result;
+bool symtable_contains_setter(Symtable *st, const Ident *var_name, SymtableItem **out_item) {
+    return found(symtable_find(st, SYM_SETTER, var_name, 1), out_item);
 }
 
-SymtableItem *symtable_add_function(Symtable *st, char *var_name, int param_count, bool is_defined) {
-    // Assumes format var_name$param_count
-    String *s = str_init();
-    if (s == NULL) return NULL;
-
-    // Constructs symtable name
-    str_append_string(s, var_name);
-    str_append_char(s, '$');
-
-    // Append param count
-    char buf[64];
-    int written = snprintf(buf, 64, "%d", param_count);
-    if (written >= 64) {
-        str_free(&s);
-        return NULL;
-    }
-    str_append_string(s, buf);
-
-    SymtableItem *result = symtable_insert(st, s->val);
-    str_free(&s);
-
+SymtableItem *symtable_add_function(Symtable *st, const Ident *var_name, int param_count, bool is_defined) {
+    SymtableItem *result = symtable_insert(st, SYM_FUNCTION, var_name, (size_t)param_count);
     if (result == NULL)
         return NULL;
 
-    str_clear(result->name);
-    str_append_string(result->name, var_name);
     result->is_defined = is_defined;
-    result->param_count = (size_t)param_count;
-    result->type = SYM_FUNCTION;
     return result;
 }
 
-bool symtable_contains_function(Symtable *st, char *var_name, int param_count, SymtableItem **out_item) {
-    // Assumes format var_name$param_count
-    String *s = str_init();
-    if (s == NULL) return false;
-
-    // Constructs symtable name
-    str_append_string(s, var_name);
-    str_append_char(s, '$');
-
-    // Append param count
-    char buf[64];
-    int written = snprintf(buf, 64, "%d", param_count);
-    if (written >= 64) {
-        str_free(&s);
-        return false;
-    }
-    str_append_string(s, buf);
-
-    bool result = symtable_contains(st, s->val);
-    if (out_item) {
-        *out_item = symtable_find(st, s->val);
-    }
-
-    str_free(&s);
-    return result;
+bool symtable_contains_function(Symtable *st, const Ident *var_name, int param_count, SymtableItem **out_item) {
+    return found(symtable_find(st, SYM_FUNCTION, var_name, (size_t)param_count), out_item);
 }
 
-SymtableItem *symtable_add_global_var(Symtable *st, char *var_name, DataType data_type, bool is_defined) {
-    SymtableItem *result = symtable_insert(st, var_name);
+SymtableItem *symtable_add_global_var(Symtable *st, const Ident *var_name, DataType data_type, bool is_defined) {
+    SymtableItem *result = symtable_insert(st, SYM_GLOBAL_VAR, var_name, 0);
     if (result == NULL) {
         return NULL;
     }
 
-    str_clear(result->name);
-    str_append_string(result->name, var_name);
+    // Bound identifiers find the variable by its slot
+    result->slot = (int)(result - st->items);
     result->data_type = data_type;
     result->is_defined = is_defined;
-    result->type = SYM_GLOBAL_VAR;
     return result;
 }
 
-bool symtable_contains_global_var(Symtable *st, char *var_name, SymtableItem **out_item) {
-    SymtableItem *item = symtable_find(st, var_name);
-    if (item != NULL && item->type == SYM_GLOBAL_VAR) {
-        if (out_item) {
-            *out_item = item;
-        }
-        return true;
-    }
-    if (out_item) {
-        *out_item = NULL;
-    }
-    return false;
+bool symtable_contains_global_var(Symtable *st, const Ident *var_name, SymtableItem **out_item) {
+    return found(symtable_find(st, SYM_GLOBAL_VAR, var_name, 0), out_item);
 }
 
 SymtableItem *add_builtin_function(Symtable *symtab, const char *name, int param_count, DataType return_type, DataType *param_types) {
-    // Constructs symtable name
-    String *s = str_init();
-    if (s == NULL) return NULL;
-
-    str_append_string(s, name);
-
-    SymtableItem *result = symtable_insert(symtab, s->val);
-    str_free(&s);
+    const Ident *key = intern_cstr(name);
+    if (key == NULL) return NULL;
 
+    SymtableItem *result = symtable_insert(symtab, SYM_BUILTIN, key, (size_t)param_count);
     if (result == NULL)
         return NULL;
 
-    str_clear(result->name);
-    str_append_string(result->name, name);
     result->is_defined = true;
-    result->param_count = (size_t)param_count;
-    result->type = SYM_FUNCTION;
     result->data_type = return_type;
 
     // Copy parameter types if provided
@@ -535,21 +510,9 @@ SymtableItem *add_builtin_function(Symtable *symtab, const char *name, int param
     return result;
 }
 
-bool symtable_contains_builtin_function(Symtable *st, const char *name, SymtableItem **out_item) {
-    // Constructs symtable name
-    String *s = str_init();
-    if (s == NULL) return false;
-
-    str_append_char(s, '#');
-    str_append_string(s, name);
-
-    bool result = symtable_contains(st, s->val);
-    if (out_item) {
-        *out_item = symtable_find(st, s->val);
-    }
-
-    str_free(&s);
-    return result;
+bool symtable_contains_builtin_function(Symtable *st, const Ident *name, SymtableItem **out_item) {
+    // Builtins are not overloaded, the number of parameters is checked by the caller
+    return found(symtable_find(st, SYM_BUILTIN, name, 0), out_item);
 }
 
 void symtable_increment_undefined_items_counter(Symtable *st) {
@@ -15,12 +15,21 @@
 
 #include "string.h"
 #include "ast.h"
+#include "intern.h"
 #include <stddef.h>
+#include <stdint.h>
 #include <stdbool.h>
 #include <stdlib.h>
 
+/// Initial number of slots, a power of two of at least ST_GROUP_WIDTH
 #define INITIAL_CAPACITY 16
+/// Initial number of items, the item array grows independently of the slots
+#define ST_ITEMS_INITIAL_CAPACITY 16
+/// Number of control bytes probed at once
+#define ST_GROUP_WIDTH 16
 #define ST_SCOPE_STACK_INITIAL_CAPACITY 16
+/// Initial number of undo log entries, the log is allocated with the first local variable
+#define ST_UNDO_INITIAL_CAPACITY 16
 
 typedef enum sym_type {
     SYM_GLOBAL_VAR,
@@ -28,11 +37,20 @@ typedef enum sym_type {
     SYM_GETTER,
     SYM_SETTER,
     SYM_VAR,
+    SYM_BUILTIN,
 } SymType;
 
+/// The items are keyed by their type, name and, for functions, their number of parameters
 typedef struct symtable_item {
-    char *key;
-    String *name;
+    /// Interned name of the symbol
+    const Ident *name;
+    /// Hash of the key the item is placed by
+    unsigned long hash;
+    /// Slot of a variable, which is its index in the item array and the frame slot of a local variable.
+    /// SLOT_NONE for the other symbols
+    int slot;
+    /// Depth of the scope a local variable is declared in
+    int scope;
     SymType type;
     size_t param_count;
     bool is_defined;
@@ -50,13 +68,28 @@ typedef struct symtable_item {
     };
 } SymtableItem;
 
+/// Entry of the undo log, restores the binding of the name when its scope is exited
+typedef struct symtable_undo {
+    const Ident *name;
+    /// Frame slot of the variable the name was bound to before, SLOT_NONE if it was not bound
+    int prev_slot;
+} SymtableUndo;
+
 typedef struct symtable {
-    SymtableItem *data; /* array of slots */
-    int *state;        /* 0 = empty, 1 = occupied, 2 = deleted */
-    size_t size;        /* number of stored items */
-    size_t capacity;    /* slots count */
-    // Scope stack
-    int *scope_stack;
+    SymtableItem *items; /* items in insertion order, they are never removed */
+    size_t count;       /* number of items */
+    size_t item_capacity;
+    uint32_t *index;    /* index of the item in each full slot */
+    unsigned char *ctrl; /* control byte per slot, empty, deleted or 7 bits of the hash, the first group is repeated at the end */
+    size_t size;        /* number of full slots */
+    size_t deleted;     /* number of deleted slots */
+    size_t capacity;    /* slots count, a power of two */
+    // Undo log of the bindings made in the open scopes
+    SymtableUndo *undo;
+    size_t undo_count;
+    size_t undo_capacity;
+    // Scope stack, the length of the undo log when each scope was entered
+    size_t *scope_stack;
     size_t scope_stack_count;
     size_t scope_stack_capacity;
     // Undefined items counter
@@ -66,71 +99,77 @@ typedef struct symtable {
 /// Creates a new symtable
 Symtable *symtable_init(void);
 
+/// Creates a new symtable with room for count items, it does not rehash until they are inserted
+Symtable *symtable_init_with_capacity(size_t count);
+
 /// Frees a symtable
 void symtable_free(Symtable *st);
 
-/// Finds an item in the symtable with the key. Returns a pointer to the item or NULL if it is not in the symtable.
-SymtableItem *symtable_find(Symtable *st, const char *key);
+/// Finds an item in the symtable with the key, arity is only part of the key of functions.
+/// Returns a pointer to the item or NULL if it is not in the symtable.
+SymtableItem *symtable_find(Symtable *st, SymType type, const Ident *name, size_t arity);
 
 /// Returns true if the symtable contains an item with the given key
-bool symtable_contains(Symtable *st, const char *key);
+bool symtable_contains(Symtable *st, SymType type, const Ident *name, size_t arity);
 
-/// Inserts an item in the symtable with the key. Returns a pointer to the new item or NULL if it is not created.
-SymtableItem *symtable_insert(Symtable *st, const char *key);
+/// Inserts an item in the symtable with the key, arity is stored as its parameter count.
+/// Returns a pointer to the new item or NULL if it is not created.
+SymtableItem *symtable_insert(Symtable *st, SymType type, const Ident *name, size_t arity);
 
-/// Executes fun for each item in the symtable and passes par to it as a parameter
+/// Executes fun for each item in the symtable in insertion order and passes par to it as a parameter.
+/// Local variables of the exited scopes are visited too
 void symtable_foreach(Symtable *st, void (*fun)(SymtableItem*, void*), void *par);
 
 /// Pushes a new scope to the scope stack. Returns false if the stack outgrows the capacity and realloc fails
 bool enter_scope(Symtable *st);
 
-/// Pop a scope from the scope stack
+/// Pop a scope from the scope stack, the names declared in it are bound to what they were bound to before
 void exit_scope(Symtable *st);
 
-/// Returns the id of the current scope
+/// Returns the depth of the current scope
 int current_scope(Symtable *st);
 
 /// Returns false if some internal error happens, true if the search is successful. In out_item, there is the found item or NULL if it is not in the symtable
-bool find_local_var(Symtable *st, char *var_name, SymtableItem **out_item);
+bool find_local_var(Symtable *st, const Ident *var_name, SymtableItem **out_item);
+
+/// Returns the local or global variable in the slot, the variables of exited scopes keep their slots
+SymtableItem *symtable_var(Symtable *st, int slot);
 
 /// Adds a new entry to the symtable for the var in the current scope. Returns the new entry or NULL if something fails
-SymtableItem *add_var_at_current_scope(Symtable *st, char *var_name, DataType data_type);
+SymtableItem *add_var_at_current_scope(Symtable *st, const Ident *var_name, DataType data_type);
 
 /// Checks if the variable is declared in the current scope
-bool contains_var_at_current_scope(Symtable *st, char *var_name);
+bool contains_var_at_current_scope(Symtable *st, const Ident *var_name);
 
 /// Adds a new entry to the symtable for the getter of the var. Returns the new entry or NULL if something fails
-SymtableItem *symtable_add_getter(Symtable *st, char *var_name, bool is_defined);
+SymtableItem *symtable_add_getter(Symtable *st, const Ident *var_name, bool is_defined);
 
 /// Adds a new entry to the symtable for the setter of the var. Returns the new entry or NULL if something fails
-SymtableItem *symtable_add_setter(Symtable *st, char *var_name, bool is_defined);
-
-/// Appends the scope id to the string. Returns false if some error happens
-bool append_scope_id(String *s, int scope);
+SymtableItem *symtable_add_setter(Symtable *st, const Ident *var_name, bool is_defined);
 
 /// Adds a new entry to the symtable for the function with param_count parameters. Returns the new entry or NULL if something fails
-SymtableItem *symtable_add_function(Symtable *st, char *var_name, int param_count, bool is_defined);
+SymtableItem *symtable_add_function(Symtable *st, const Ident *var_name, int param_count, bool is_defined);
 
 /// Checks if a getter with the given name exists in the symtable
-bool symtable_contains_getter(Symtable *st, char *var_name, SymtableItem **out_item);
+bool symtable_contains_getter(Symtable *st, const Ident *var_name, SymtableItem **out_item);
 
 /// Checks if a setter with the given name exists in the symtable
-bool symtable_contains_setter(Symtable *st, char *var_name, SymtableItem **out_item);
+bool symtable_contains_setter(Symtable *st, const Ident *var_name, SymtableItem **out_item);
 
 /// Checks if a function with the given name and parameter count exists in the symtable
-bool symtable_contains_function(Symtable *st, char *var_name, int param_count, SymtableItem **out_item);
+bool symtable_contains_function(Symtable *st, const Ident *var_name, int param_count, SymtableItem **out_item);
 
 /// Adds a new entry to the symtable for the global variable. Returns the new entry or NULL if something fails
-SymtableItem *symtable_add_global_var(Symtable *st, char *var_name, DataType data_type, bool is_defined);
+SymtableItem *symtable_add_global_var(Symtable *st, const Ident *var_name, DataType data_type, bool is_defined);
 
 /// Checks if a global variable with the given name exists in the symtable
-bool symtable_contains_global_var(Symtable *st, char *var_name, SymtableItem **out_item);
+bool symtable_contains_global_var(Symtable *st, const Ident *var_name, SymtableItem **out_item);
 
 /// Add a builtin function to the symtable. Returns NULL
 SymtableItem *add_builtin_function(Symtable *symtab, const char *name, int param_count, DataType return_type, DataType *param_types);
 
 /// Checks if a builtin function with the given name and parameter count exists in the symtable
-bool symtable_contains_builtin_function(Symtable *st, const char *name, SymtableItem **out_item);
+bool symtable_contains_builtin_function(Symtable *st, const Ident *name, SymtableItem **out_item);
 
 /// Increments the undefined items counter
 void symtable_increment_undefined_items_counter(Symtable *st);
@@ -0,0 +1,41 @@
+#!/usr/bin/env bash
+#
+# Compiles every test with the default build and with another build of the compiler
+# and checks that the output, the error message and the exit code are the same
+#
+# Usage: compare_builds.sh <executable relative to the repository root>
+#
+
+RED='\033[0;31m'
+GREEN='\033[0;32m'
+RESET='\033[0m'
+
+if [ $# -ne 1 ]; then
+    echo "Usage: $0 <executable>" >&2
+    exit 2
+fi
+
+DEFAULT_EXE=../main
+OTHER_EXE=../$1
+
+cd "$(dirname "$0")"
+
+sum=0
+err=0
+for i in */*.test; do
+    ((sum++))
+    default_out=$($DEFAULT_EXE < $i 2>&1)
+    default_code=$?
+    other_out=$($OTHER_EXE < $i 2>&1)
+    other_code=$?
+    if [ $default_code -ne $other_code ] || [ "$default_out" != "$other_out" ]; then
+        echo -e "${RED}[ DIFFERENT ]${RESET}" $i "returned $default_code and $other_code"
+        ((err++))
+    fi
+done
+
+if [ $err -ne 0 ]; then
+    echo -e "Different: ${RED}${err}${RESET}/${sum}"
+    exit 1
+fi
+echo -e "Same: ${GREEN}${sum}${RESET}/${sum}"
@@ -72,7 +72,7 @@ run_with_comp_error() {
     for i in *.test; do
         ((sum++))
         # Compile
-        $EXE < $i 2> /dev/null 1> /dev/null
+        $EXE < $i 2> $i.error 1> /dev/null
         code=$?
         if [ $code -ne $1 ]; then
             echo -e "${RED}[ COMPILATION ERROR ]" $RESET $i "${GRAY}returned $code${RESET}"
@@ -81,6 +81,17 @@ run_with_comp_error() {
             continue
         fi
 
+        # Compare the error message, only some tests check where the error was reported
+        if [ -f $i.referror ]; then
+            diff $i.error $i.referror -s 2>/dev/null 1>/dev/null
+            if [ $? -ne 0 ]; then
+                echo -e "${RED}[ ERROR MESSAGE ]    " $RESET $i
+                ((output_err++))
+                ((err++))
+                continue
+            fi
+        fi
+
         if [ $CHECK_MEM -eq 1 ]; then
             # Check memory leaks
             valgrind --leak-check=full --errors-for-leak-kinds=all --error-exitcode=42 $EXE < $i 1>/dev/null 2>/dev/null
@@ -176,6 +187,7 @@ run_with_comp_error 2
 run_with_comp_error 3
 run_with_comp_error 4
 run_with_comp_error 5
+run_with_comp_error 6
 run_with_int_error 25
 run_with_int_error 26
 
@@ -13,15 +13,17 @@
 #define _TOKEN_H_
 
 #include "string.h"
+#include "intern.h"
 #include "ast.h"
 
 typedef enum tok_type {
-    TOK_IDENTIFIER, // Name stored in string_val
-    TOK_GLOBAL_VAR, // Name stored in string_val
+    TOK_IDENTIFIER, // Interned name stored in ident_val
+    TOK_GLOBAL_VAR, // Interned name stored in ident_val
     TOK_EOL,
     // Literals
     TOK_LIT_NUM, // Value stored in double_val
-    TOK_LIT_STRING, // Value stored in string_val
+    TOK_LIT_INT, // Num literal with an integer value, stored in double_val
+    TOK_LIT_STRING, // Value stored in text, see lexer_token_text
     // Operators
     TOK_OP_ASSIGN, // =
     TOK_OP_PLUS, // +
@@ -78,17 +80,22 @@ typedef enum tok_type {
 
 typedef struct token {
     TokType type;
+    // Offset of the first character of the token in the input.
+    // Kept next to the type so that it fits into the padding before the union
+    unsigned pos;
     union {
-        String *string_val;
+        // Slice of the input or of the lexer's literal arena
+        struct {
+            unsigned offset;
+            unsigned length;
+        } text;
+        const Ident *ident_val;
         double double_val;
-        // pointer to ast_expression for precedence parsing
-        AstExpression *expr_val;
+        // Number of parameters and variables declared in the definition a static keyword starts
+        unsigned local_count;
+        // pointer to ast_expression for precedence parsing, owned by the AST
+        ExprId expr_val;
     };
-    unsigned pos_line;
-    unsigned pos_char;
 } Token;
 
-/// Frees resources allocated in the token, like string_val
-void token_free(Token *token);
-
 #endif // !_TOKEN_H_